@@ -14,6 +14,7 @@ import platform as plat
 import hashlib
 import hmac
 import base64
+import struct
 from pathlib import Path
 from typing import Optional, Tuple
 from datetime import datetime, timedelta
@@ -220,6 +221,196 @@ class SRCConfig:
             print(f"ERROR: Failed to write state: {e}", file=sys.stderr)
 
 
+class ImageCodec:
+    """Compressed backup image format (mirrors firmware/src/image_codec.h)
+    
+    A 32-byte header is followed by one block per 16KB of image. Each block
+    is a 4-byte little-endian header (payload length; top bit set when the
+    block is stored as-is, next bit set with no payload when it is all 0xFF)
+    and a payload of tokens: the top two bits pick
+    literal / match / fill, the low six bits hold the length (63 = more
+    length bytes follow, each added, until one is below 255).
+    """
+    
+    MAGIC = 0x5A435253          # "SRCZ"
+    VERSION = 2
+    HEADER = struct.Struct('<IHHII16x')
+    BLOCK_SIZE = 16 * 1024
+    BLOCK_RAW = 0x80000000
+    BLOCK_ERASED = 0x40000000
+    BLOCK_LEN_MASK = 0x00FFFFFF
+    OP_LITERAL, OP_MATCH, OP_FILL = 0, 1, 2
+    LENGTH_MORE = 63
+    MIN_MATCH = 4
+    MIN_FILL = 8
+    HASH_BITS = 12
+    MAX_IMAGE_SIZE = 64 * 1024 * 1024
+    
+    @classmethod
+    def is_compressed(cls, data: bytes) -> bool:
+        return len(data) >= 4 and struct.unpack_from('<I', data)[0] == cls.MAGIC
+    
+    @classmethod
+    def _token(cls, out: bytearray, op: int, length: int):
+        if length < cls.LENGTH_MORE:
+            out.append((op << 6) | length)
+            return
+        out.append((op << 6) | cls.LENGTH_MORE)
+        length -= cls.LENGTH_MORE
+        while length >= 255:
+            out.append(255)
+            length -= 255
+        out.append(length)
+    
+    @classmethod
+    def _literals(cls, out: bytearray, data: bytes):
+        if data:
+            cls._token(out, cls.OP_LITERAL, len(data) - 1)
+            out += data
+    
+    @classmethod
+    def compress_block(cls, data: bytes) -> bytes:
+        """Greedy block compressor, same parsing as the firmware"""
+        size = len(data)
+        if data.count(0xFF) == size:
+            return struct.pack('<I', cls.BLOCK_ERASED)
+        out = bytearray()
+        table = {}
+        pos = 0
+        literal = 0
+        while pos + cls.MIN_MATCH <= size and len(out) < size:
+            # Runs of one byte value (erased flash, padding)
+            run_end = pos + 1
+            while run_end < size and data[run_end] == data[pos]:
+                run_end += 1
+            if run_end - pos >= cls.MIN_FILL:
+                cls._literals(out, data[literal:pos])
+                cls._token(out, cls.OP_FILL, run_end - pos - cls.MIN_MATCH)
+                out.append(data[pos])
+                pos = literal = run_end
+                continue
+            
+            sequence = data[pos:pos + 4]
+            slot = (struct.unpack('<I', sequence)[0] * 2654435761 & 0xFFFFFFFF) >> (32 - cls.HASH_BITS)
+            candidate = table.get(slot)
+            table[slot] = pos
+            if candidate is not None and data[candidate:candidate + 4] == sequence:
+                length = cls.MIN_MATCH
+                while pos + length < size and data[candidate + length] == data[pos + length]:
+                    length += 1
+                offset = pos - candidate
+                cls._literals(out, data[literal:pos])
+                cls._token(out, cls.OP_MATCH, length - cls.MIN_MATCH)
+                out += struct.pack('<H', offset)
+                pos = literal = pos + length
+                continue
+            pos += 1
+        cls._literals(out, data[literal:])
+        
+        # Keep the block as-is unless compressing made it smaller
+        if len(out) >= size:
+            return struct.pack('<I', size | cls.BLOCK_RAW) + data
+        return struct.pack('<I', len(out)) + bytes(out)
+    
+    @classmethod
+    def compress(cls, image: bytes) -> bytes:
+        if not image or len(image) > cls.MAX_IMAGE_SIZE:
+            raise ValueError("image size out of range")
+        out = bytearray(cls.HEADER.pack(cls.MAGIC, cls.VERSION, cls.HEADER.size,
+                                        cls.BLOCK_SIZE, len(image)))
+        for offset in range(0, len(image), cls.BLOCK_SIZE):
+            out += cls.compress_block(image[offset:offset + cls.BLOCK_SIZE])
+        return bytes(out)
+    
+    @classmethod
+    def decompress(cls, data: bytes) -> bytes:
+        """Decode and validate a compressed image; raises ValueError"""
+        if len(data) < cls.HEADER.size:
+            raise ValueError("truncated header")
+        magic, version, header_size, block_size, image_size = cls.HEADER.unpack_from(data)
+        if (magic != cls.MAGIC or not 0 < version <= cls.VERSION or header_size != cls.HEADER.size or
+                block_size != cls.BLOCK_SIZE or not 0 < image_size <= cls.MAX_IMAGE_SIZE):
+            raise ValueError("unsupported header")
+        
+        image = bytearray()
+        pos = cls.HEADER.size
+        while len(image) < image_size:
+            if pos + 4 > len(data):
+                raise ValueError("truncated block header")
+            word = struct.unpack_from('<I', data, pos)[0]
+            pos += 4
+            block_len = min(cls.BLOCK_SIZE, image_size - len(image))
+            if word & cls.BLOCK_ERASED:
+                if word != cls.BLOCK_ERASED or version < 2:
+                    raise ValueError("bad erased block")
+                image += b'\xff' * block_len
+                continue
+            payload_len = word & cls.BLOCK_LEN_MASK
+            payload = data[pos:pos + payload_len]
+            if len(payload) != payload_len:
+                raise ValueError("truncated block")
+            pos += payload_len
+            
+            if word & cls.BLOCK_RAW:
+                if payload_len != block_len or word & ~(cls.BLOCK_RAW | cls.BLOCK_LEN_MASK):
+                    raise ValueError("bad raw block")
+                image += payload
+                continue
+            if word > cls.BLOCK_SIZE or payload_len == 0:
+                raise ValueError("bad block header")
+            
+            block = bytearray()
+            i = 0
+            while len(block) < block_len:
+                if i >= payload_len:
+                    raise ValueError("block payload too short")
+                op, length = payload[i] >> 6, payload[i] & cls.LENGTH_MORE
+                i += 1
+                if op > cls.OP_FILL:
+                    raise ValueError("bad token")
+                if length == cls.LENGTH_MORE:
+                    while True:
+                        if i >= payload_len:
+                            raise ValueError("block payload too short")
+                        more = payload[i]
+                        i += 1
+                        length += more
+                        if length > cls.BLOCK_SIZE:
+                            raise ValueError("bad length")
+                        if more != 255:
+                            break
+                length += 1 if op == cls.OP_LITERAL else cls.MIN_MATCH
+                if length > block_len - len(block):
+                    raise ValueError("op overruns block")
+                
+                if op == cls.OP_LITERAL:
+                    if i + length > payload_len:
+                        raise ValueError("block payload too short")
+                    block += payload[i:i + length]
+                    i += length
+                elif op == cls.OP_MATCH:
+                    if i + 2 > payload_len:
+                        raise ValueError("block payload too short")
+                    offset = payload[i] | (payload[i + 1] << 8)
+                    i += 2
+                    if offset == 0 or offset > len(block):
+                        raise ValueError("bad match offset")
+                    for _ in range(length):
+                        block.append(block[-offset])
+                else:
+                    if i >= payload_len:
+                        raise ValueError("block payload too short")
+                    block += bytes([payload[i]]) * length
+                    i += 1
+            if i != payload_len:
+                raise ValueError("trailing block payload")
+            image += block
+        
+        if pos != len(data):
+            raise ValueError("data after last block")
+        return bytes(image)
+
+
 class SRCInterface:
     """Interface to Recovery Core firmware"""
     
@@ -537,6 +728,38 @@ class SRCInterface:
         print()
         return True
     
+    def image(self, action: str, input_path: str, output_path: Optional[str] = None) -> bool:
+        """Compress, decompress or inspect a backup image (A.bin/B.bin)"""
+        try:
+            data = Path(input_path).read_bytes()
+            compressed = ImageCodec.is_compressed(data)
+            image = ImageCodec.decompress(data) if compressed else data
+        except (OSError, ValueError) as e:
+            print(f"ERROR: Cannot read image: {e}", file=sys.stderr)
+            return False
+        
+        if action == 'info':
+            print(f"Format: {'compressed' if compressed else 'raw'}")
+            print(f"File size: {len(data)} bytes")
+            print(f"Image size: {len(image)} bytes")
+            # Signatures cover the decompressed image
+            print(f"Image SHA-256: {hashlib.sha256(image).hexdigest()}")
+            return True
+        
+        if not output_path:
+            print("ERROR: Output file required", file=sys.stderr)
+            return False
+        
+        try:
+            out = ImageCodec.compress(image) if action == 'compress' else image
+            Path(output_path).write_bytes(out)
+        except (OSError, ValueError) as e:
+            print(f"ERROR: Cannot write image: {e}", file=sys.stderr)
+            return False
+        
+        print(f"✓ Wrote {output_path} ({len(out)} bytes, image {len(image)} bytes)")
+        return True
+    
     def config_show(self) -> bool:
         """Show current configuration"""
         print("\n=== Security Recovery Core Configuration ===\n")
@@ -814,8 +1037,8 @@ class SRCInterface:
         print("The drive must contain a /SECURITY_RECOVERY/ directory with:")
         print("  - A.bin (latest firmware backup)")
         print("  - B.bin (previous firmware backup)")
+        print("  - manifest.bin, manifest.sig (signed manifest)")
         print("  - manifest.json")
-        print("  - signature.sig")
         print("  - metadata.txt\n")
         
         response = input("Have you prepared the USB device? [yes/no]: ")
@@ -895,6 +1118,7 @@ Examples:
   security health-check       Perform comprehensive health check
   security logs               Display recovery logs
   security config             Show current configuration
+  security image compress A.bin A.z   Compress a backup image
   security remove --force     Remove recovery core (with confirmations)
   security install            Interactive installation tutorial
         """
@@ -942,6 +1166,12 @@ Examples:
     # Config command
     config_parser = subparsers.add_parser('config', help='Show current configuration')
     
+    # Image command
+    image_parser = subparsers.add_parser('image', help='Compress, decompress or inspect a backup image')
+    image_parser.add_argument('action', choices=['compress', 'decompress', 'info'])
+    image_parser.add_argument('input', help='Image file (raw or compressed)')
+    image_parser.add_argument('output', nargs='?', help='Output file (compress/decompress)')
+    
     args = parser.parse_args()
     
     if not args.command:
@@ -969,6 +1199,8 @@ Examples:
         success = interface.logs(getattr(args, 'lines', 50))
     elif args.command == 'config':
         success = interface.config_show()
+    elif args.command == 'image':
+        success = interface.image(args.action, args.input, args.output)
     elif args.command == 'remove':
         success = interface.remove(force=args.force)
     elif args.command == 'install':
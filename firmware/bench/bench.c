@@ -0,0 +1,1359 @@
+/**
+ * Security Recovery Core - Performance Benchmarks
+ *
+ * Runs end-to-end scenarios against the sim platform and prints one JSON
+ * object with wall time, simulated device time, flash/USB traffic and
+ * peak heap/stack per scenario, plus SHA-256 throughput per engine (one
+ * image, and the image as sectors for multi-buffer hashing). Built
+ * and run by `make bench`, once per image size (FIRMWARE_REGION_SIZE is
+ * fixed at compile time).
+ */
+
+#define _DEFAULT_SOURCE
+#include "recovery_core.h"
+#include "advanced_security.h"
+#include "enhanced_recovery.h"
+#include "integrity.h"
+#include "boot_detection.h"
+#include "log_store.h"
+#include "spi_flash.h"
+#include "usb_msd.h"
+#include "scheduler.h"
+#include "platform.h"
+#include "sha256.h"
+#include "sim.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/* Each scenario runs on its own painted stack */
+#define BENCH_STACK_SIZE (1024 * 1024)
+#define BENCH_STACK_FILL 0xCD
+
+/* Flash must hold the image plus the SRC region placed after it */
+#define BENCH_FLASH_SIZE \
+    ((FIRMWARE_REGION_SIZE + (1024 * 1024) > (16 * 1024 * 1024)) ? \
+     (FIRMWARE_REGION_SIZE + (1024 * 1024)) : (16 * 1024 * 1024))
+
+#if (SRC_RESERVED_REGION_START < FIRMWARE_REGION_START + FIRMWARE_REGION_SIZE)
+#error "Benchmarks need the SRC region outside the firmware region"
+#endif
+
+typedef bool (*bench_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    bench_fn_t run;
+} bench_scenario_t;
+
+/* Heap accounting via -Wl,--wrap=malloc,--wrap=free (core allocations only) */
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+
+static size_t heap_current = 0;
+static size_t heap_peak = 0;
+
+void *__wrap_malloc(size_t size) {
+    size_t *block = __real_malloc(size + 16);
+    if (!block) {
+        return NULL;
+    }
+    block[0] = size;
+    heap_current += size;
+    if (heap_current > heap_peak) {
+        heap_peak = heap_current;
+    }
+    return (uint8_t *)block + 16;
+}
+
+void __wrap_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    size_t *block = (size_t *)((uint8_t *)ptr - 16);
+    heap_current -= block[0];
+    __real_free(block);
+}
+
+static char usb_root[64];
+static char usb_dir[128];
+static char usb_image[128];     // The stick as a raw FAT32 image
+static uint8_t *image;          // Reference image served as A.bin/B.bin
+static uint8_t *baseline;       // Firmware as last backed up
+
+/**
+ * Deterministic image contents
+ */
+static void bench_fill(uint8_t *data, size_t size, uint32_t seed) {
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (uint8_t)x;
+    }
+}
+
+/**
+ * Firmware-like image: code built from a small set of instruction words,
+ * packed data, and an erased (0xFF) tail
+ */
+static void bench_fill_image(uint8_t *data, size_t size, uint32_t seed) {
+    uint8_t words[64][8];
+    bench_fill(&words[0][0], sizeof(words), seed);
+
+    size_t code = size / 100 * 55;
+    size_t packed = size / 100 * 15;
+    uint32_t x = seed;
+    for (size_t i = 0; i + 8 <= code; i += 8) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        memcpy(data + i, words[x % 64], 8);
+    }
+    bench_fill(data + code, packed, seed ^ 0xA5A5);
+    memset(data + code + packed, 0xFF, size - code - packed);
+}
+
+static bool bench_write_file(const char *name, const uint8_t *data, size_t size) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", usb_dir, name);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    return (fclose(file) == 0) && ok;
+}
+
+/**
+ * Put a signed image set (A.bin, B.bin, signed manifest) on the stick
+ */
+static bool bench_prepare_usb(void) {
+    static src_manifest_t manifest;
+    uint8_t hash[32];
+    uint8_t signature[SIM_SIGNATURE_SIZE];
+    size_t sig_size = sizeof(signature);
+    const char json[] = "{\"version\": \"1.0\", \"backup_a\": \"A.bin\", \"backup_b\": \"B.bin\"}\n";
+
+    /* A.bin is the newer of two identical images */
+    memset(&manifest, 0, sizeof(manifest));
+    manifest.magic = SRC_MANIFEST_MAGIC;
+    manifest.version = SRC_MANIFEST_VERSION;
+    manifest.entry_count = 2;
+    manifest.generation = 2;
+    manifest.region_size = FIRMWARE_REGION_SIZE;
+    strncpy(manifest.board_id, "DEFAULT", sizeof(manifest.board_id) - 1);  // src_init default
+    sha256(image, FIRMWARE_REGION_SIZE, hash);
+    for (unsigned i = 0; i < 2; i++) {
+        src_manifest_entry_t *entry = &manifest.entries[i];
+        snprintf(entry->name, sizeof(entry->name), "%s", i == 0 ? BACKUP_A_FILE : BACKUP_B_FILE);
+        entry->kind = SRC_MANIFEST_FULL;
+        entry->generation = 2 - i;
+        entry->size = FIRMWARE_REGION_SIZE;
+        memcpy(entry->hash, hash, sizeof(hash));
+        memcpy(entry->image_hash, hash, sizeof(hash));
+    }
+
+    size_t size = SRC_MANIFEST_HEADER_SIZE + 2 * sizeof(src_manifest_entry_t);
+    uint8_t manifest_hash[32];
+    sha256((const uint8_t *)&manifest, size, manifest_hash);
+    return platform_sign(manifest_hash, sizeof(manifest_hash), signature, &sig_size) &&
+           bench_write_file(BACKUP_A_FILE, image, FIRMWARE_REGION_SIZE) &&
+           bench_write_file(BACKUP_B_FILE, image, FIRMWARE_REGION_SIZE) &&
+           bench_write_file(SIGNED_MANIFEST_FILE, (const uint8_t *)&manifest, size) &&
+           bench_write_file(MANIFEST_SIGNATURE_FILE, signature, sig_size) &&
+           bench_write_file(MANIFEST_FILE, (const uint8_t *)json, strlen(json));
+}
+
+/* FAT32 image of the stick: 4KB clusters, one partition. B.bin is split
+ * into 64KB runs so its reads cross more extents than fat32.c resolves
+ * at a time. */
+#define BENCH_FAT32_PART_LBA 2048
+#define BENCH_FAT32_SPC 8
+#define BENCH_FAT32_RESERVED 32
+#define BENCH_FAT32_MIN_CLUSTERS 65536
+#define BENCH_FAT32_FRAGMENT 16                 // Clusters per run of B.bin
+#define BENCH_FAT32_CLUSTER (BENCH_FAT32_SPC * 512)
+#define BENCH_FAT32_MAX_FILES 32
+
+typedef struct {
+    int fd;
+    uint32_t *fat;
+    uint32_t clusters;
+    uint32_t next_free;
+    uint32_t data_lba;
+} bench_fat32_t;
+
+static void bench_put16(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void bench_put32(uint8_t *p, uint32_t value) {
+    bench_put16(p, value);
+    bench_put16(p + 2, value >> 16);
+}
+
+static bool bench_fat32_write(bench_fat32_t *fs, uint32_t lba, const void *data, size_t size) {
+    return pwrite(fs->fd, data, size, (off_t)lba * 512) == (ssize_t)size;
+}
+
+/**
+ * Allocate a chain of count clusters; fragmented chains skip a cluster
+ * after every run
+ */
+static uint32_t bench_fat32_alloc(bench_fat32_t *fs, uint32_t count, bool fragmented) {
+    uint32_t first = 0;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fragmented && i > 0 && i % BENCH_FAT32_FRAGMENT == 0) {
+            fs->next_free++;
+        }
+        uint32_t cluster = fs->next_free++;
+        if (prev) {
+            fs->fat[prev] = cluster;
+        } else {
+            first = cluster;
+        }
+        fs->fat[cluster] = 0x0FFFFFFF;
+        prev = cluster;
+    }
+    return first;
+}
+
+/**
+ * Case of an 8.3 name part: 0 upper case (or no letters), 1 lower case,
+ * -1 mixed case or characters 8.3 cannot hold
+ */
+static int bench_fat32_case(const char *part, size_t len) {
+    bool lower = false;
+    bool upper = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = part[i];
+        if (c >= 'a' && c <= 'z') {
+            lower = true;
+        } else if (c >= 'A' && c <= 'Z') {
+            upper = true;
+        } else if (!(c >= '0' && c <= '9') && c != '_') {
+            return -1;
+        }
+    }
+    return (lower && upper) ? -1 : lower;
+}
+
+/**
+ * Append a directory entry for name: plain 8.3 when it fits (case kept
+ * via the NT flags), else long-name entries and a numbered 8.3 alias
+ */
+static void bench_fat32_dirent(uint8_t *dir, uint32_t *used, const char *name,
+                               uint8_t attr, uint32_t cluster, uint32_t size) {
+    uint8_t short_name[11];
+    uint8_t case_flags = 0;
+    const char *dot = strchr(name, '.');
+    size_t base = dot ? (size_t)(dot - name) : strlen(name);
+    size_t ext = dot ? strlen(dot + 1) : 0;
+    int base_case = bench_fat32_case(name, base);
+    int ext_case = dot ? bench_fat32_case(dot + 1, ext) : 0;
+    bool fits = base >= 1 && base <= 8 && ext <= 3 && base_case >= 0 && ext_case >= 0;
+
+    memset(short_name, ' ', sizeof(short_name));
+    if (fits) {
+        for (size_t i = 0; i < base; i++) {
+            short_name[i] = (uint8_t)(name[i] & ~0x20);
+        }
+        for (size_t i = 0; i < ext; i++) {
+            short_name[8 + i] = (uint8_t)(dot[1 + i] & ~0x20);
+        }
+    } else {
+        char alias[9];
+        snprintf(alias, sizeof(alias), "SRC~%u", (unsigned)(*used / 32 % 1000));
+        memcpy(short_name, alias, strlen(alias));
+
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < 11; i++) {
+            checksum = (uint8_t)(((checksum & 1) << 7) + (checksum >> 1) + short_name[i]);
+        }
+        static const uint8_t positions[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+        size_t len = strlen(name);
+        uint32_t parts = (uint32_t)((len + 12) / 13);
+        for (uint32_t part = parts; part >= 1; part--) {
+            uint8_t *lfn = dir + *used;
+            memset(lfn, 0, 32);
+            lfn[0] = (uint8_t)(part | (part == parts ? 0x40 : 0));
+            lfn[11] = 0x0F;
+            lfn[13] = checksum;
+            for (size_t i = 0; i < 13; i++) {
+                size_t at = (part - 1) * 13 + i;
+                uint32_t c = at < len ? (uint8_t)name[at] : (at == len ? 0x0000 : 0xFFFF);
+                bench_put16(&lfn[positions[i]], c);
+            }
+            *used += 32;
+        }
+    }
+    if (fits) {
+        case_flags = (uint8_t)((base_case ? 0x08 : 0) | (ext_case ? 0x10 : 0));
+    }
+
+    uint8_t *entry = dir + *used;
+    memset(entry, 0, 32);
+    memcpy(entry, short_name, sizeof(short_name));
+    entry[11] = attr;
+    entry[12] = case_flags;
+    bench_put16(&entry[20], cluster >> 16);
+    bench_put16(&entry[26], cluster);
+    bench_put32(&entry[28], size);
+    *used += 32;
+}
+
+/**
+ * Write the files in usb_dir to usb_image as /SECURITY_RECOVERY
+ */
+static bool bench_build_fat32_image(void) {
+    static char paths[BENCH_FAT32_MAX_FILES][sizeof(usb_dir) + NAME_MAX + 2];
+    uint32_t sizes[BENCH_FAT32_MAX_FILES];
+    uint32_t count = 0;
+    uint64_t data_clusters = 2;
+
+    DIR *dir = opendir(usb_dir);
+    if (!dir) {
+        return false;
+    }
+    struct dirent *item;
+    while ((item = readdir(dir)) != NULL && count < BENCH_FAT32_MAX_FILES) {
+        char *path = paths[count];
+        struct stat st;
+        snprintf(path, sizeof(paths[count]), "%s/%s", usb_dir, item->d_name);
+        if (item->d_name[0] == '.' || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        sizes[count] = (uint32_t)st.st_size;
+        data_clusters += (sizes[count] + BENCH_FAT32_CLUSTER - 1) / BENCH_FAT32_CLUSTER * 2;
+        count++;
+    }
+    closedir(dir);
+
+    bench_fat32_t fs = { .next_free = 2 };
+    fs.clusters = data_clusters > BENCH_FAT32_MIN_CLUSTERS ?
+                  (uint32_t)data_clusters : BENCH_FAT32_MIN_CLUSTERS;
+    uint32_t fat_sectors = ((fs.clusters + 2) * 4 + 511) / 512;
+    uint32_t fat_lba = BENCH_FAT32_PART_LBA + BENCH_FAT32_RESERVED;
+    fs.data_lba = fat_lba + 2 * fat_sectors;
+    uint32_t total = BENCH_FAT32_RESERVED + 2 * fat_sectors + fs.clusters * BENCH_FAT32_SPC;
+
+    fs.fat = __real_malloc((size_t)fat_sectors * 512);
+    uint8_t *root = __real_malloc(BENCH_FAT32_CLUSTER);
+    uint8_t *recovery = __real_malloc(BENCH_FAT32_CLUSTER);
+    uint8_t *data = __real_malloc(BENCH_FAT32_CLUSTER);
+    fs.fd = open(usb_image, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool ok = fs.fat && root && recovery && data && fs.fd >= 0 &&
+              ftruncate(fs.fd, (off_t)(BENCH_FAT32_PART_LBA + total) * 512) == 0;
+    if (ok) {
+        memset(fs.fat, 0, (size_t)fat_sectors * 512);
+        memset(root, 0, BENCH_FAT32_CLUSTER);
+        memset(recovery, 0, BENCH_FAT32_CLUSTER);
+        fs.fat[0] = 0x0FFFFFF8;
+        fs.fat[1] = 0x0FFFFFFF;
+    }
+
+    /* MBR with one FAT32 (LBA) partition, then its boot sector */
+    uint8_t sector[512] = { 0 };
+    sector[446 + 4] = 0x0C;
+    bench_put32(&sector[446 + 8], BENCH_FAT32_PART_LBA);
+    bench_put32(&sector[446 + 12], total);
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+    ok = ok && bench_fat32_write(&fs, 0, sector, sizeof(sector));
+
+    uint32_t root_cluster = ok ? bench_fat32_alloc(&fs, 1, false) : 0;
+    uint32_t recovery_cluster = ok ? bench_fat32_alloc(&fs, 1, false) : 0;
+    memset(sector, 0, sizeof(sector));
+    memcpy(&sector[3], "SRCBENCH", 8);
+    bench_put16(&sector[11], 512);
+    sector[13] = BENCH_FAT32_SPC;
+    bench_put16(&sector[14], BENCH_FAT32_RESERVED);
+    sector[16] = 2;
+    sector[21] = 0xF8;
+    bench_put32(&sector[28], BENCH_FAT32_PART_LBA);
+    bench_put32(&sector[32], total);
+    bench_put32(&sector[36], fat_sectors);
+    bench_put32(&sector[44], root_cluster);
+    memcpy(&sector[82], "FAT32   ", 8);
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+    ok = ok && bench_fat32_write(&fs, BENCH_FAT32_PART_LBA, sector, sizeof(sector));
+
+    uint32_t root_used = 0;
+    uint32_t recovery_used = 0;
+    if (ok) {
+        bench_fat32_dirent(root, &root_used, USB_RECOVERY_PATH + 1, 0x10, recovery_cluster, 0);
+        memcpy(recovery, ".          ", 11);
+        recovery[11] = 0x10;
+        bench_put16(&recovery[20], recovery_cluster >> 16);
+        bench_put16(&recovery[26], recovery_cluster);
+        memcpy(recovery + 32, "..         ", 11);
+        recovery[32 + 11] = 0x10;
+        recovery_used = 64;
+    }
+
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const char *name = strrchr(paths[i], '/') + 1;
+        uint32_t clusters = (sizes[i] + BENCH_FAT32_CLUSTER - 1) / BENCH_FAT32_CLUSTER;
+        uint32_t first = clusters ? bench_fat32_alloc(&fs, clusters, strcmp(name, BACKUP_B_FILE) == 0) : 0;
+        ok = recovery_used + 3 * 32 <= BENCH_FAT32_CLUSTER;
+        bench_fat32_dirent(recovery, &recovery_used, name, 0x20, first, sizes[i]);
+
+        FILE *file = fopen(paths[i], "rb");
+        ok = ok && file;
+        for (uint32_t cluster = first; ok && cluster && cluster < 0x0FFFFFF8; cluster = fs.fat[cluster]) {
+            memset(data, 0, BENCH_FAT32_CLUSTER);
+            ok = fread(data, 1, BENCH_FAT32_CLUSTER, file) > 0 &&
+                 bench_fat32_write(&fs, fs.data_lba + (cluster - 2) * BENCH_FAT32_SPC,
+                                   data, BENCH_FAT32_CLUSTER);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    uint32_t cluster_lba = fs.data_lba - 2 * BENCH_FAT32_SPC;
+    ok = ok && fs.next_free <= fs.clusters + 2 &&
+         bench_fat32_write(&fs, fat_lba, fs.fat, (size_t)fat_sectors * 512) &&
+         bench_fat32_write(&fs, fat_lba + fat_sectors, fs.fat, (size_t)fat_sectors * 512) &&
+         bench_fat32_write(&fs, cluster_lba + root_cluster * BENCH_FAT32_SPC, root, BENCH_FAT32_CLUSTER) &&
+         bench_fat32_write(&fs, cluster_lba + recovery_cluster * BENCH_FAT32_SPC, recovery, BENCH_FAT32_CLUSTER);
+
+    if (fs.fd >= 0) {
+        ok = (close(fs.fd) == 0) && ok;
+    }
+    __real_free(fs.fat);
+    __real_free(root);
+    __real_free(recovery);
+    __real_free(data);
+    return ok;
+}
+
+static uint8_t *bench_firmware(void) {
+    return sim_flash_data() + FIRMWARE_REGION_START;
+}
+
+static void bench_erase_firmware(void) {
+    memset(bench_firmware(), 0xFF, FIRMWARE_REGION_SIZE);
+}
+
+/* Scenarios */
+
+static bool scenario_recovery_a(void) {
+    sim_stats_t stats;
+
+    /* Image bytes go from USB into pool buffers and on to SPI uncopied */
+    bool ok = src_recover_from_usb() &&
+              memcmp(bench_firmware(), image, FIRMWARE_REGION_SIZE) == 0;
+    sim_get_stats(&stats);
+    return ok && stats.copy_bytes < FIRMWARE_REGION_SIZE / 64;
+}
+
+static bool scenario_recovery_fat32(void) {
+    sim_stats_t stats;
+
+    /* One read command per chunk: every chunk lies inside one extent */
+    bool ok = src_recover_from_usb() &&
+              memcmp(bench_firmware(), image, FIRMWARE_REGION_SIZE) == 0;
+    sim_get_stats(&stats);
+    return ok && stats.usb_transfers <= 3 * (FIRMWARE_REGION_SIZE / SRC_RECOVERY_CHUNK_SIZE) + 256;
+}
+
+static bool scenario_recovery_fallback_b(void) {
+    /* A.bin fails verification, B.bin is intact */
+    uint8_t *corrupt = __real_malloc(FIRMWARE_REGION_SIZE);
+    if (!corrupt) {
+        return false;
+    }
+    memcpy(corrupt, image, FIRMWARE_REGION_SIZE);
+    corrupt[FIRMWARE_REGION_SIZE / 2] ^= 0x01;
+    bool ok = bench_write_file(BACKUP_A_FILE, corrupt, FIRMWARE_REGION_SIZE);
+    __real_free(corrupt);
+
+    ok = ok && src_recover_from_usb() &&
+         memcmp(bench_firmware(), image, FIRMWARE_REGION_SIZE) == 0;
+
+    return bench_write_file(BACKUP_A_FILE, image, FIRMWARE_REGION_SIZE) && ok;
+}
+
+/* A.bin reads back altered once verified, and there is no B.bin: the
+ * recovery fails with the altered chunk never programmed, while the
+ * chunks verified before it are in place */
+static bool scenario_recovery_tampered(void) {
+    uint32_t at = FIRMWARE_REGION_SIZE / 2 + 100;
+    uint32_t chunk = at - at % SRC_RECOVERY_CHUNK_SIZE;
+    char b_path[256];
+    char b_hold[256];
+    snprintf(b_path, sizeof(b_path), "%s/%s", usb_dir, BACKUP_B_FILE);
+    snprintf(b_hold, sizeof(b_hold), "%s/%s.hold", usb_dir, BACKUP_B_FILE);
+
+    bool ok = rename(b_path, b_hold) == 0;
+    sim_set_usb_tamper(USB_RECOVERY_PATH "/" BACKUP_A_FILE, at);
+    ok = ok && !src_recover_from_usb();
+    sim_set_usb_tamper(NULL, 0);
+
+    for (uint32_t i = 0; ok && i < SRC_RECOVERY_CHUNK_SIZE; i++) {
+        ok = bench_firmware()[chunk + i] == 0xFF;
+    }
+    ok = ok && memcmp(bench_firmware(), image, chunk) == 0;
+    return rename(b_hold, b_path) == 0 && ok;
+}
+
+/**
+ * Baseline recorded by the last backup matches the given firmware
+ */
+static bool bench_baseline_matches(const uint8_t *firmware) {
+    src_config_t config;
+    uint8_t hash[32];
+
+    sha256(firmware, FIRMWARE_REGION_SIZE, hash);
+    return src_read_config(&config) &&
+           memcmp(config.firmware_hash, hash, sizeof(hash)) == 0;
+}
+
+static bool scenario_backup_changed(void) {
+    src_perform_backup();
+
+    memcpy(baseline, bench_firmware(), FIRMWARE_REGION_SIZE);
+    return bench_baseline_matches(baseline);
+}
+
+/* Full backup whose image cannot be written (A.new is taken): the stick
+ * keeps the files its signed manifest lists, checked by the recovery that
+ * follows */
+static bool scenario_backup_interrupted(void) {
+    char path[256];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s", usb_dir, BACKUP_A_FILE);
+    bool ok = stat(path, &st) == 0;
+    off_t size = st.st_size;
+    time_t mtime = st.st_mtime;
+
+    src_perform_backup();
+
+    ok = ok && stat(path, &st) == 0 && st.st_size == size && st.st_mtime == mtime;
+    return ok && bench_baseline_matches(baseline);
+}
+
+static bool scenario_recovery_compressed(void) {
+    return src_recover_from_usb() &&
+           memcmp(bench_firmware(), baseline, FIRMWARE_REGION_SIZE) == 0;
+}
+
+static bool scenario_backup_unchanged(void) {
+    sim_stats_t stats;
+
+    src_perform_backup();
+
+    sim_get_stats(&stats);
+    return stats.usb_bytes_written == 0 && bench_baseline_matches(baseline);
+}
+
+static bool scenario_backup_delta(void) {
+    sim_stats_t stats;
+
+    src_perform_backup();
+
+    /* Only the changed sector (plus patch header and manifest) goes to USB */
+    sim_get_stats(&stats);
+    memcpy(baseline, bench_firmware(), FIRMWARE_REGION_SIZE);
+    return stats.usb_bytes_written < FIRMWARE_REGION_SIZE / 8 &&
+           bench_baseline_matches(baseline);
+}
+
+static bool scenario_backup_delta_erased(void) {
+    sim_stats_t stats;
+
+    src_perform_backup();
+
+    /* The erased sector is only a table entry in the patch */
+    sim_get_stats(&stats);
+    memcpy(baseline, bench_firmware(), FIRMWARE_REGION_SIZE);
+    return stats.usb_bytes_written < 8192 && bench_baseline_matches(baseline);
+}
+
+static bool scenario_audit(void) {
+    char report[1024];
+
+    return security_perform_audit(report, sizeof(report)) &&
+           strstr(report, "Integrity: OK") != NULL;
+}
+
+static bool scenario_health_check(void) {
+    health_status_t status;
+    sim_stats_t stats;
+
+    /* The first check lists the recovery directory; the second and the
+     * multi-source query are answered from the directory-entry cache */
+    bool ok = enhanced_health_check(&status) && status.backups_valid;
+    sim_get_stats(&stats);
+    uint32_t transfers = stats.usb_transfers;
+
+    ok = ok && enhanced_health_check(&status) && !enhanced_has_multiple_sources();
+    sim_get_stats(&stats);
+    return ok && stats.usb_transfers == transfers;
+}
+
+static bool scenario_verify_other_dir(void) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", usb_dir, BACKUP_A_FILE);
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t *copy = __real_malloc(FIRMWARE_REGION_SIZE);
+    size_t size = copy ? fread(copy, 1, FIRMWARE_REGION_SIZE, file) : 0;
+    fclose(file);
+
+    /* A.bin copied to another mount point with no manifest of its own:
+     * the manifest in /SECURITY_RECOVERY does not vouch for it */
+    char mnt[128];
+    char dir[192];
+    snprintf(mnt, sizeof(mnt), "%s/mnt", usb_root);
+    snprintf(dir, sizeof(dir), "%s%s", mnt, USB_RECOVERY_PATH);
+    snprintf(path, sizeof(path), "%s/%s", dir, BACKUP_A_FILE);
+    bool ok = copy && size > 0 && mkdir(mnt, 0755) == 0 && mkdir(dir, 0755) == 0;
+    file = ok ? fopen(path, "wb") : NULL;
+    ok = file && fwrite(copy, 1, size, file) == size;
+    ok = file && fclose(file) == 0 && ok;
+    __real_free(copy);
+    src_usb_cache_invalidate();     // Changed behind the firmware
+
+    bool valid = false;
+    bool other_valid = true;
+    ok = ok && enhanced_verify_backup(USB_RECOVERY_PATH "/" BACKUP_A_FILE, &valid) && valid;
+    ok = ok && enhanced_verify_backup("/mnt" USB_RECOVERY_PATH "/" BACKUP_A_FILE, &other_valid) &&
+         !other_valid;
+
+    unlink(path);
+    rmdir(dir);
+    rmdir(mnt);
+    src_usb_cache_invalidate();
+    return ok;
+}
+
+static bool scenario_repair_one_sector(void) {
+    return src_recover_from_usb() &&
+           memcmp(bench_firmware(), baseline, FIRMWARE_REGION_SIZE) == 0;
+}
+
+static bool scenario_recovery_known_erased(void) {
+    return src_recover_from_usb() &&
+           memcmp(bench_firmware(), baseline, FIRMWARE_REGION_SIZE) == 0;
+}
+
+/* Log text for scenarios */
+static char log_text[512 * 1024];
+
+/**
+ * Read the log records in range into text (terminated), chunk bytes per
+ * logging_read() call; false if they do not all fit
+ */
+static bool bench_log_text(const log_range_t *range, size_t chunk, char *text, size_t size) {
+    log_cursor_t cursor = { 0, 0 };
+    size_t used = 0;
+    for (;;) {
+        size_t read = chunk;
+        if (size - used - 1 < read ||
+            !logging_read(&cursor, range, (uint8_t *)text + used, &read)) {
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+        used += read;
+    }
+    text[used] = '\0';
+    return true;
+}
+
+/* Log ring: many more records than it holds, stored and read back as
+ * text. The newest must decode exactly, and the ring must still have held
+ * a few hundred. */
+#define BENCH_LOG_RECORDS 100000
+
+static bool scenario_log_ring(void) {
+    for (uint32_t i = 0; i < BENCH_LOG_RECORDS; i++) {
+        src_log("BENCH: Record %lu of %s, %zu bytes", (unsigned long)i, "log_ring", (size_t)i * 4);
+    }
+
+    log_range_t range = { logging_boot(), 0, UINT32_MAX };
+    if (!bench_log_text(&range, 64 * 1024, log_text, sizeof(log_text))) {
+        return false;
+    }
+    size_t size = strlen(log_text);
+    size_t lines = 0;
+    for (const char *line = strstr(log_text, "BENCH: Record "); line;
+         line = strstr(line + 1, "BENCH: Record ")) {
+        lines++;
+    }
+
+    char last[96];
+    int len = snprintf(last, sizeof(last), "] BENCH: Record %lu of log_ring, %zu bytes\n",
+                       (unsigned long)(BENCH_LOG_RECORDS - 1), (size_t)(BENCH_LOG_RECORDS - 1) * 4);
+    return len > 0 && size >= (size_t)len &&
+           strcmp(log_text + size - (size_t)len, last) == 0 &&
+           lines >= SRC_LOG_RING_SIZE / 64;
+}
+
+/* Log ring overrun between flushes by records of mixed sizes, so the
+ * oldest position left is most likely inside a record (a few rounds, one
+ * is). Flushing resumes at the next whole record: each round's loss is
+ * reported, its newest records are stored, and so is one logged after. */
+#define BENCH_OVERRUN_RECORDS 2001
+#define BENCH_OVERRUN_ROUNDS 4
+
+static bool scenario_log_overrun(void) {
+    static const char padding[] = "of log_overrun, padded out to several times a short one";
+    bool ok = true;
+    for (uint32_t round = 0; round < BENCH_OVERRUN_ROUNDS; round++) {
+        uint32_t count = BENCH_OVERRUN_RECORDS + 2 * round;
+        for (uint32_t i = 0; i < count; i++) {
+            if (i % 2) {
+                /* Lengths that vary, so no lap lines up with the one before */
+                src_log("BENCH: Long %lu.%lu %s", (unsigned long)round, (unsigned long)i,
+                        padding + i % 37);
+            } else {
+                src_log("BENCH: Short %lu.%lu", (unsigned long)round, (unsigned long)i);
+            }
+        }
+        ok = logging_flush() && ok;
+        src_log("BENCH: Logged after overrun %lu", (unsigned long)round);
+        ok = logging_flush() && ok;
+    }
+
+    log_range_t range = { logging_boot(), 0, UINT32_MAX };
+    ok = ok && bench_log_text(&range, 64 * 1024, log_text, sizeof(log_text));
+    const char *line = log_text;
+    for (uint32_t round = 0; ok && round < BENCH_OVERRUN_ROUNDS; round++) {
+        char newest[48];
+        char after[48];
+        snprintf(newest, sizeof(newest), "] BENCH: Short %lu.%lu\n", (unsigned long)round,
+                 (unsigned long)(BENCH_OVERRUN_RECORDS + 2 * round - 1));
+        snprintf(after, sizeof(after), "] BENCH: Logged after overrun %lu\n", (unsigned long)round);
+        line = strstr(line, "] LOG: Ring overran, ");
+        line = line ? strstr(line, newest) : NULL;
+        line = line ? strstr(line, after) : NULL;
+        ok = line != NULL;
+    }
+    return ok;
+}
+
+/* Persistent log store. A boot's records, one a millisecond, read back
+ * after a reboot through a buffer of about two lines: each exactly once,
+ * in order. The last few milliseconds by time range, reading no more
+ * flash than the segments holding them. A record torn by power loss ends
+ * its segment, keeping those before it. Logging several times the store's
+ * size reuses the oldest segments, leaving the newest records contiguous. */
+#define BENCH_STORE_RECORDS 300
+#define BENCH_STORE_CHUNK 200
+#define BENCH_STORE_RANGE_MS 20
+#define BENCH_STORE_FILL (3 * SRC_LOG_STORE_SIZE / 64)
+
+static bool scenario_log_store(void) {
+    uint32_t stamps[BENCH_STORE_RECORDS];
+    uint32_t boot = logging_boot();
+    for (uint32_t i = 0; i < BENCH_STORE_RECORDS; i++) {
+        stamps[i] = platform_get_timestamp();
+        src_log("BENCH: Stored %lu", (unsigned long)i);
+        platform_delay_ms(1);
+    }
+    bool ok = boot != 0 && logging_init() && logging_boot() == boot + 1;
+
+    log_range_t range = { boot, 0, UINT32_MAX };
+    ok = ok && bench_log_text(&range, BENCH_STORE_CHUNK, log_text, sizeof(log_text));
+    const char *line = log_text;
+    for (uint32_t i = 0; ok && i < BENCH_STORE_RECORDS; i++) {
+        char want[48];
+        snprintf(want, sizeof(want), "] BENCH: Stored %lu\n", (unsigned long)i);
+        line = strstr(line, want);
+        ok = line != NULL;
+        line = ok ? line + strlen(want) : line;
+    }
+    uint32_t stored = 0;
+    for (line = strstr(log_text, "BENCH: Stored "); ok && line; line = strstr(line + 1, "BENCH: Stored ")) {
+        stored++;
+    }
+    ok = ok && stored == BENCH_STORE_RECORDS;
+
+    /* By time: only the index and the segments in range are read */
+    sim_stats_t before;
+    sim_stats_t after;
+    uint32_t segment = spi_flash_get_erase_size() > LOG_STORE_MIN_SEGMENT ?
+                       spi_flash_get_erase_size() : LOG_STORE_MIN_SEGMENT;
+    range.start_ms = stamps[BENCH_STORE_RECORDS - BENCH_STORE_RANGE_MS];
+    range.end_ms = stamps[BENCH_STORE_RECORDS - 1];
+    sim_get_stats(&before);
+    ok = ok && bench_log_text(&range, BENCH_STORE_CHUNK, log_text, sizeof(log_text));
+    sim_get_stats(&after);
+    uint32_t in_range = 0;
+    for (line = strstr(log_text, "BENCH: Stored "); ok && line; line = strstr(line + 1, "BENCH: Stored ")) {
+        in_range++;
+    }
+    ok = ok && in_range == BENCH_STORE_RANGE_MS &&
+         after.spi_bytes_read - before.spi_bytes_read <= 2 * segment;
+
+    /* Power lost while the last record was programmed: bits left erased */
+    src_log("BENCH: Kept before the tear");
+    src_log("BENCH: Torn %s", "TEARME");
+    uint32_t torn_boot = logging_boot();
+    ok = ok && logging_flush();
+    uint8_t *store = sim_flash_data() + SRC_LOG_STORE_START;
+    uint8_t *torn = NULL;
+    for (uint32_t i = 0; ok && !torn && i + 6 <= SRC_LOG_STORE_SIZE; i++) {
+        torn = (memcmp(store + i, "TEARME", 6) == 0) ? store + i : NULL;
+    }
+    ok = torn != NULL;
+    if (torn) {
+        memset(torn + 3, 0xFF, 3);
+    }
+    src_log("BENCH: Lost with the power");
+    range = (log_range_t){ torn_boot, 0, UINT32_MAX };
+    ok = ok && logging_init() &&
+         bench_log_text(&range, BENCH_STORE_CHUNK, log_text, sizeof(log_text)) &&
+         strstr(log_text, "] BENCH: Kept before the tear\n") &&
+         !strstr(log_text, "BENCH: Torn") && !strstr(log_text, "BENCH: Lost with the power");
+
+    /* Round and round the store; flushes leave the integrity snapshot valid */
+    uint32_t fill_boot = logging_boot();
+    uint32_t epoch = spi_flash_get_epoch();
+    for (unsigned long i = 0; ok && i < BENCH_STORE_FILL; i++) {
+        src_log("BENCH: Fill %lu %s", i, "0123456789abcdef0123456789abcdef0123456789abcdef");
+        if (logging_flush_due()) {
+            ok = logging_flush();
+        }
+    }
+    ok = ok && spi_flash_get_epoch() == epoch;
+    range = (log_range_t){ fill_boot, 0, UINT32_MAX };
+    ok = ok && bench_log_text(&range, 64 * 1024, log_text, sizeof(log_text)) &&
+         !strstr(log_text, "LOG: Ring overran");
+    line = strstr(log_text, "BENCH: Fill ");
+    unsigned long first = 0;
+    ok = ok && line && sscanf(line, "BENCH: Fill %lu", &first) == 1 && first > 0;
+    unsigned long next = first;
+    for (; ok && line; line = strstr(line + 1, "BENCH: Fill ")) {
+        unsigned long n;
+        ok = sscanf(line, "BENCH: Fill %lu", &n) == 1 && n == next++;
+    }
+    range = (log_range_t){ boot, 0, UINT32_MAX };
+    ok = ok && next == BENCH_STORE_FILL &&
+         bench_log_text(&range, BENCH_STORE_CHUNK, log_text, sizeof(log_text)) &&
+         log_text[0] == '\0';
+    return ok;
+}
+
+/* Boot signals as interrupts: POST codes climb to 0xA2, which the next
+ * write replaces in the same microsecond. Boot success must be taken
+ * from the queued events within a millisecond, with the main loop asleep
+ * in between rather than polling. A task between the boot task and the
+ * jobs notes when the state leaves CHECKING_BOOT (a backup follows in the
+ * same pass). */
+#define BENCH_BOOT_SUCCESS_MS 7000
+#define BENCH_POLL_MS 100           // Poll period the wake-ups are held against
+
+static uint64_t boot_decided_us;
+
+static bool bench_boot_decided(void) {
+    return src_get_state() != SRC_STATE_CHECKING_BOOT;
+}
+
+static src_task_result_t bench_boot_watch_task(src_task_t *task) {
+    (void)task;
+    if (!bench_boot_decided()) {
+        return SRC_TASK_YIELDED;
+    }
+    boot_decided_us = sim_now_us();
+    return SRC_TASK_EXITED;
+}
+
+static bool scenario_boot_detect(void) {
+    static src_task_t watch_task = {
+        .name = "boot_watch",
+        .body = bench_boot_watch_task,
+        .priority = SRC_TASK_PRIORITY_BOOT + 1,
+        .period_ms = BOOT_TIMEOUT_MS,
+        .ready = bench_boot_decided
+    };
+
+    src_init();
+    boot_decided_us = 0;
+    src_sched_add(&watch_task);
+    uint64_t success_us = sim_now_us() + (uint64_t)BENCH_BOOT_SUCCESS_MS * 1000;
+    bool raised = sim_raise_boot_event(success_us - 2000000, BOOT_EVENT_POST_CODE, 0x10) &&
+                  sim_raise_boot_event(success_us, BOOT_EVENT_POST_CODE, 0xA2) &&
+                  sim_raise_boot_event(success_us, BOOT_EVENT_POST_CODE, 0x00);
+
+    for (uint32_t tick = 0; raised && tick < BOOT_TIMEOUT_MS && boot_decided_us == 0; tick++) {
+        src_main_loop();
+        if (boot_decided_us == 0) {
+            platform_wait_event(src_sched_idle_ms());
+        }
+    }
+
+    sim_stats_t stats;
+    sim_get_stats(&stats);
+    boot_status_t status;
+    boot_detection_get_status(&status);
+    src_state_t state = src_get_state();
+    log_range_t range = { logging_boot(), 0, UINT32_MAX };
+    bool logged = bench_log_text(&range, 64 * 1024, log_text, sizeof(log_text)) &&
+                  strstr(log_text, "SRC: Boot success - POST code 0xA2\n");
+
+    return raised && logged && boot_decided_us >= success_us && boot_decided_us - success_us < 1000 &&
+           (state == SRC_STATE_BOOT_SUCCESS || state == SRC_STATE_BACKUP_ACTIVE) &&
+           status.post_code == 0x00 && boot_detection_dropped() == 0 &&
+           stats.wakeups < BENCH_BOOT_SUCCESS_MS / BENCH_POLL_MS / 4;
+}
+
+/* Boot-priority probe for scenario_recovery_scheduled: the longest gap
+ * between its turns while a recovery step streams (steps are set up
+ * between checkpoints: pass-1 workers are joined, patches loaded), and a
+ * cancel once the first recovery has programmed a quarter of the image */
+static struct {
+    uint32_t last;
+    uint32_t max_gap;
+    bool streaming;             // Last turn was inside a step
+    uint64_t programmed;        // SPI bytes programmed before the scenario
+    bool progress_seen;
+    bool cancelled;
+    bool stop;
+} probe;
+
+static src_task_result_t bench_probe_task(src_task_t *task) {
+    (void)task;
+    src_job_status_t status;
+    sim_stats_t stats;
+    src_get_job_status(&status);
+    sim_get_stats(&stats);
+
+    uint32_t now = platform_get_timestamp();
+    bool streaming = status.job == SRC_JOB_RECOVERY && status.done > 0;
+    if (probe.streaming && streaming && now - probe.last > probe.max_gap) {
+        probe.max_gap = now - probe.last;
+    }
+    probe.last = now;
+    probe.streaming = streaming;
+    if (status.job == SRC_JOB_RECOVERY && status.total > 0) {
+        probe.progress_seen = probe.progress_seen || status.done > 0;
+        if (!probe.cancelled &&
+            stats.spi_bytes_programmed - probe.programmed >= FIRMWARE_REGION_SIZE / 4) {
+            probe.cancelled = src_cancel_job();
+        }
+    }
+    return probe.stop ? SRC_TASK_EXITED : SRC_TASK_YIELDED;
+}
+
+#define BENCH_PROBE_MS 50
+
+static bool scenario_recovery_scheduled(void) {
+    static src_task_t probe_task = {
+        .name = "probe",
+        .body = bench_probe_task,
+        .priority = SRC_TASK_PRIORITY_BOOT,
+        .period_ms = BENCH_PROBE_MS
+    };
+    sim_stats_t stats;
+    sim_get_stats(&stats);
+    uint32_t reboots = stats.reboots;
+    uint32_t safe_mode_entries = stats.safe_mode_entries;
+
+    /* Boot times out: the first recovery is cancelled half-written and
+     * ends in safe mode, the second one restores the firmware and reboots */
+    src_init();
+    memset(&probe, 0, sizeof(probe));
+    probe.programmed = stats.spi_bytes_programmed;
+    src_sched_add(&probe_task);
+    for (uint32_t tick = 0; tick < 4 * BOOT_TIMEOUT_MS / BENCH_PROBE_MS &&
+                            stats.reboots == reboots; tick++) {
+        src_main_loop();
+        platform_wait_event(src_sched_idle_ms());
+        sim_get_stats(&stats);
+    }
+    probe.stop = true;
+
+    /* Boot-priority turns kept their period while the image streamed,
+     * give or take a slice and one chunk erased and programmed */
+    return stats.reboots == reboots + 1 &&
+           stats.safe_mode_entries == safe_mode_entries + 1 &&
+           probe.cancelled && probe.progress_seen &&
+           probe.max_gap <= 3 * BENCH_PROBE_MS &&
+           memcmp(bench_firmware(), baseline, FIRMWARE_REGION_SIZE) == 0;
+}
+
+/* Scenario runner */
+
+typedef struct {
+    bench_fn_t run;
+    bool ok;
+} bench_thread_arg_t;
+
+static void *bench_thread(void *arg) {
+    bench_thread_arg_t *thread_arg = arg;
+    thread_arg->ok = thread_arg->run();
+    return NULL;
+}
+
+static double bench_wall_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 +
+           (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/**
+ * Run one scenario and print its JSON record
+ */
+static bool bench_run(const bench_scenario_t *scenario, bool first) {
+    uint8_t *stack = __real_malloc(BENCH_STACK_SIZE);
+    if (!stack) {
+        return false;
+    }
+    memset(stack, BENCH_STACK_FILL, BENCH_STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE);
+
+    bench_thread_arg_t arg = { scenario->run, false };
+    sim_reset_stats();
+    heap_peak = heap_current;
+    size_t heap_start = heap_current;
+    uint64_t sim_start_us = sim_now_us();
+    struct timespec wall_start;
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    pthread_t thread;
+    bool started = pthread_create(&thread, &attr, bench_thread, &arg) == 0;
+    if (started) {
+        pthread_join(thread, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    uint64_t sim_us = sim_now_us() - sim_start_us;
+    pthread_attr_destroy(&attr);
+
+    /* Untouched fill at the low end is stack that was never used */
+    size_t unused = 0;
+    while (unused < BENCH_STACK_SIZE && stack[unused] == BENCH_STACK_FILL) {
+        unused++;
+    }
+    __real_free(stack);
+
+    sim_stats_t stats;
+    sim_get_stats(&stats);
+
+    printf("%s    {\"name\": \"%s\", \"ok\": %s, \"wall_ms\": %.3f, \"sim_ms\": %.3f, "
+           "\"spi_bytes_read\": %llu, \"spi_bytes_programmed\": %llu, "
+           "\"spi_bytes_erased\": %llu, \"usb_bytes_read\": %llu, "
+           "\"usb_bytes_written\": %llu, \"sha_bytes\": %llu, \"verifies\": %u, "
+           "\"dma_bytes\": %llu, \"copy_bytes\": %llu, \"wakeups\": %u, "
+           "\"heap_peak_bytes\": %zu, \"stack_peak_bytes\": %zu}",
+           first ? "" : ",\n", scenario->name,
+           (started && arg.ok) ? "true" : "false",
+           bench_wall_ms(&wall_start, &wall_end), sim_us / 1000.0,
+           (unsigned long long)stats.spi_bytes_read,
+           (unsigned long long)stats.spi_bytes_programmed,
+           (unsigned long long)stats.spi_bytes_erased,
+           (unsigned long long)stats.usb_bytes_read,
+           (unsigned long long)stats.usb_bytes_written,
+           (unsigned long long)stats.sha_bytes, stats.verifies,
+           (unsigned long long)stats.dma_bytes, (unsigned long long)stats.copy_bytes,
+           stats.wakeups, heap_peak - heap_start, BENCH_STACK_SIZE - unused);
+    return started && arg.ok;
+}
+
+/**
+ * SHA-256 throughput of every compiled-in engine over the reference image
+ * Prints the "sha256_engines" JSON array; false if a supported engine fails
+ * its known-answer tests or disagrees with the portable engine.
+ */
+static bool bench_sha256_engines(void) {
+    const sha256_engine_t *active = sha256_engine_active();
+    const sha256_engine_t *portable = sha256_engine_get(sha256_engine_count() - 1);
+    uint8_t expected[32];
+    bool ok = true;
+
+    sha256_engine_select(portable);
+    sha256(image, FIRMWARE_REGION_SIZE, expected);
+
+    printf("\"sha256_engines\": [");
+    for (size_t i = 0; i < sha256_engine_count(); i++) {
+        const sha256_engine_t *engine = sha256_engine_get(i);
+        bool supported = sha256_engine_supported(engine);
+        bool kat_ok = supported && sha256_engine_select(engine);
+        double mb_per_s = 0.0;
+        bool matches = false;
+
+        if (kat_ok) {
+            uint8_t hash[32];
+            struct timespec start;
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sha256(image, FIRMWARE_REGION_SIZE, hash);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            mb_per_s = (FIRMWARE_REGION_SIZE / 1048576.0) / (bench_wall_ms(&start, &end) / 1000.0);
+            matches = memcmp(hash, expected, sizeof(hash)) == 0;
+        }
+        ok = ok && (!supported || (kat_ok && matches));
+
+        printf("%s{\"name\": \"%s\", \"supported\": %s, \"kat_ok\": %s, "
+               "\"active\": %s, \"mb_per_s\": %.1f}",
+               i ? ", " : "", engine->name, supported ? "true" : "false",
+               kat_ok ? "true" : "false", engine == active ? "true" : "false", mb_per_s);
+    }
+    printf("],\n");
+
+    sha256_engine_select(active);
+    return ok;
+}
+
+/**
+ * Per-sector hashing of the image: every batch engine against one
+ * sha256() call per sector with the active single-buffer engine
+ * Prints "sha256_sectors"; false if a supported engine fails its self test
+ * or disagrees with the serial hashes.
+ */
+static bool bench_sha256_sectors(void) {
+    const size_t sectors = FIRMWARE_REGION_SIZE / INTEGRITY_SECTOR_SIZE;
+    const sha256_batch_engine_t *active = sha256_batch_engine_active();
+    uint8_t (*expected)[32] = __real_malloc(sectors * 32);
+    uint8_t (*hashes)[32] = __real_malloc(sectors * 32);
+    struct timespec start;
+    struct timespec end;
+    bool ok = expected && hashes;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; ok && i < sectors; i++) {
+        sha256(image + i * INTEGRITY_SECTOR_SIZE, INTEGRITY_SECTOR_SIZE, expected[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double serial_mb_per_s = (FIRMWARE_REGION_SIZE / 1048576.0) /
+                             (bench_wall_ms(&start, &end) / 1000.0);
+
+    printf("\"sha256_sectors\": {\"sector_size\": %u, \"serial_mb_per_s\": %.1f, \"batch\": [",
+           (unsigned)INTEGRITY_SECTOR_SIZE, serial_mb_per_s);
+    for (size_t e = 0; ok && e < sha256_batch_engine_count(); e++) {
+        const sha256_batch_engine_t *engine = sha256_batch_engine_get(e);
+        bool supported = sha256_batch_engine_supported(engine);
+        bool kat_ok = supported && sha256_batch_engine_select(engine);
+        double mb_per_s = 0.0;
+
+        if (kat_ok) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (size_t first = 0; first < sectors; first += SHA256_BATCH_MAX) {
+                const uint8_t *data[SHA256_BATCH_MAX];
+                size_t count = sectors - first;
+                if (count > SHA256_BATCH_MAX) {
+                    count = SHA256_BATCH_MAX;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    data[i] = image + (first + i) * INTEGRITY_SECTOR_SIZE;
+                }
+                sha256_batch(data, count, INTEGRITY_SECTOR_SIZE, &hashes[first]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            mb_per_s = (FIRMWARE_REGION_SIZE / 1048576.0) / (bench_wall_ms(&start, &end) / 1000.0);
+            ok = memcmp(hashes, expected, sectors * 32) == 0;
+        }
+        ok = ok && (!supported || kat_ok);
+
+        printf("%s{\"name\": \"%s\", \"lanes\": %zu, \"supported\": %s, \"kat_ok\": %s, "
+               "\"active\": %s, \"mb_per_s\": %.1f}",
+               e ? ", " : "", engine->name, engine->lanes, supported ? "true" : "false",
+               kat_ok ? "true" : "false", engine == active ? "true" : "false", mb_per_s);
+    }
+    printf("]},\n");
+
+    sha256_batch_engine_select(active);
+    __real_free(expected);
+    __real_free(hashes);
+    return ok;
+}
+
+static void bench_cleanup(void) {
+    const char *names[] = { BACKUP_A_FILE, BACKUP_B_FILE, BACKUP_NEW_FILE, SIGNATURE_FILE,
+                            SIGNED_MANIFEST_FILE, MANIFEST_SIGNATURE_FILE,
+                            MANIFEST_FILE, METADATA_FILE };
+    char path[256];
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", usb_dir, names[i]);
+        unlink(path);
+    }
+    for (unsigned sequence = 1; sequence <= SRC_DELTA_MAX_CHAIN; sequence++) {
+        snprintf(path, sizeof(path), "%s/" DELTA_FILE_FORMAT, usb_dir, sequence);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s/" DELTA_SIGNATURE_FORMAT, usb_dir, sequence);
+        unlink(path);
+    }
+    unlink(usb_image);
+    rmdir(usb_dir);
+    rmdir(usb_root);
+}
+
+int main(void) {
+    snprintf(usb_root, sizeof(usb_root), "/tmp/src-bench-XXXXXX");
+    if (!mkdtemp(usb_root)) {
+        fprintf(stderr, "bench: cannot create USB directory\n");
+        return 1;
+    }
+    snprintf(usb_dir, sizeof(usb_dir), "%s%s", usb_root, USB_RECOVERY_PATH);
+    snprintf(usb_image, sizeof(usb_image), "%s/stick.img", usb_root);
+    if (mkdir(usb_dir, 0755) != 0) {
+        rmdir(usb_root);
+        return 1;
+    }
+
+    sim_config_t config;
+    sim_config_from_env(&config);
+    config.flash_path = NULL;
+    config.flash_size = BENCH_FLASH_SIZE;
+    config.usb_dir = usb_root;
+
+    image = __real_malloc(FIRMWARE_REGION_SIZE);
+    baseline = __real_malloc(FIRMWARE_REGION_SIZE);
+    if (!image || !baseline || !sim_start(&config)) {
+        fprintf(stderr, "bench: setup failed\n");
+        bench_cleanup();
+        return 1;
+    }
+    bench_fill_image(image, FIRMWARE_REGION_SIZE, 0x5EC0DE);
+    if (!bench_prepare_usb()) {
+        fprintf(stderr, "bench: cannot populate USB directory\n");
+        bench_cleanup();
+        return 1;
+    }
+
+    src_init();
+
+    printf("{\"image_mb\": %u, \"flash_mb\": %u, \"sim\": {\"spi_read_kbps\": %u, "
+           "\"page_program_us\": %u, \"sector_erase_ms\": %u, \"usb_kbps\": %u, "
+           "\"sha_kbps\": %u, \"verify_ms\": %u},\n",
+           (unsigned)(FIRMWARE_REGION_SIZE >> 20), (unsigned)(BENCH_FLASH_SIZE >> 20),
+           config.spi_read_kbps, config.page_program_us, config.sector_erase_ms,
+           config.usb_kbps, config.sha_kbps, config.verify_ms);
+
+    bool ok = bench_sha256_engines();
+    ok = bench_sha256_sectors() && ok;
+    printf("\"scenarios\": [\n");
+
+    /* Recovery onto blank flash, then again with A.bin failing verification */
+    bench_erase_firmware();
+    const bench_scenario_t recovery_a = { "recovery_a", scenario_recovery_a };
+    ok = bench_run(&recovery_a, true) && ok;
+
+    /* The same stick as a FAT32 image, read by fat32.c */
+    bench_erase_firmware();
+    const bench_scenario_t recovery_fat32 = { "recovery_fat32", scenario_recovery_fat32 };
+    ok = bench_build_fat32_image() && sim_set_usb_image(usb_image) &&
+         bench_run(&recovery_fat32, false) && ok;
+    sim_set_usb_image(NULL);
+
+    bench_erase_firmware();
+    const bench_scenario_t fallback_b = { "recovery_fallback_b", scenario_recovery_fallback_b };
+    ok = bench_run(&fallback_b, false) && ok;
+
+    bench_erase_firmware();
+    const bench_scenario_t tampered = { "recovery_tampered", scenario_recovery_tampered };
+    ok = bench_run(&tampered, false) && ok;
+
+    /* Firmware updated by the OS (one sector), then a backup tick */
+    bench_fill(bench_firmware() + FIRMWARE_REGION_SIZE / 4, 4096, 0xF00D);
+    sim_advance_us((uint64_t)MAX_BACKUP_INTERVAL_MS * 1000);
+    const bench_scenario_t backup_changed = { "backup_changed", scenario_backup_changed };
+    ok = bench_run(&backup_changed, false) && ok;
+
+    /* Most of the firmware changed (a full backup), but the USB write fails */
+    char backup_new[256];
+    snprintf(backup_new, sizeof(backup_new), "%s/%s", usb_dir, BACKUP_NEW_FILE);
+    bench_fill(bench_firmware(), FIRMWARE_REGION_SIZE / 2 + 4096, 0xBAD);
+    sim_advance_us((uint64_t)MAX_BACKUP_INTERVAL_MS * 1000);
+    const bench_scenario_t backup_interrupted = { "backup_interrupted", scenario_backup_interrupted };
+    ok = mkdir(backup_new, 0755) == 0 && bench_run(&backup_interrupted, false) && ok;
+    rmdir(backup_new);
+
+    /* Blank flash restored from the A.bin that backup just wrote */
+    bench_erase_firmware();
+    const bench_scenario_t recovery_compressed = { "recovery_compressed", scenario_recovery_compressed };
+    ok = bench_run(&recovery_compressed, false) && ok;
+
+    sim_advance_us((uint64_t)MAX_BACKUP_INTERVAL_MS * 1000);
+    const bench_scenario_t backup_unchanged = { "backup_unchanged", scenario_backup_unchanged };
+    ok = bench_run(&backup_unchanged, false) && ok;
+
+    const bench_scenario_t audit = { "audit", scenario_audit };
+    ok = bench_run(&audit, false) && ok;
+
+    const bench_scenario_t health_check = { "health_check", scenario_health_check };
+    ok = bench_run(&health_check, false) && ok;
+
+    /* A backup checked against the manifest in its own directory */
+    const bench_scenario_t verify_other_dir = { "verify_other_dir", scenario_verify_other_dir };
+    ok = bench_run(&verify_other_dir, false) && ok;
+
+    /* Another sector updated: appended to USB as a delta patch */
+    bench_fill(bench_firmware() + FIRMWARE_REGION_SIZE / 2, 4096, 0xD17A);
+    sim_advance_us((uint64_t)MAX_BACKUP_INTERVAL_MS * 1000);
+    const bench_scenario_t backup_delta = { "backup_delta", scenario_backup_delta };
+    ok = bench_run(&backup_delta, false) && ok;
+
+    /* A sector erased by the OS: recorded without its data */
+    memset(bench_firmware() + FIRMWARE_REGION_SIZE / 8, 0xFF, INTEGRITY_SECTOR_SIZE);
+    sim_advance_us((uint64_t)MAX_BACKUP_INTERVAL_MS * 1000);
+    const bench_scenario_t backup_delta_erased = { "backup_delta_erased", scenario_backup_delta_erased };
+    ok = bench_run(&backup_delta_erased, false) && ok;
+
+    /* One corrupted sector repaired from the backup (A.bin + patches) */
+    bench_fill(bench_firmware() + FIRMWARE_REGION_SIZE / 3 - 4096, 4096, 0xBAD);
+    const bench_scenario_t repair = { "repair_one_sector", scenario_repair_one_sector };
+    ok = bench_run(&repair, false) && ok;
+
+    /* Flash found erased by a full scan, then restored: the extent map
+     * lets blocks be programmed without reading them first */
+    uint8_t scan_hash[32];
+    bench_erase_firmware();
+    ok = src_hash_firmware(FIRMWARE_REGION_START, FIRMWARE_REGION_SIZE, scan_hash) && ok;
+    bench_firmware()[FIRMWARE_REGION_SIZE / 16] = 0x00;   // Changed behind the driver
+    const bench_scenario_t known_erased = { "recovery_known_erased", scenario_recovery_known_erased };
+    ok = bench_run(&known_erased, false) && ok;
+
+    /* Log records appended and decoded back */
+    const bench_scenario_t log_ring = { "log_ring", scenario_log_ring };
+    ok = bench_run(&log_ring, false) && ok;
+
+    const bench_scenario_t log_overrun = { "log_overrun", scenario_log_overrun };
+    ok = bench_run(&log_overrun, false) && ok;
+
+    /* Log records kept on flash across reboots */
+    const bench_scenario_t log_store = { "log_store", scenario_log_store };
+    ok = bench_run(&log_store, false) && ok;
+
+    /* Boot success from interrupt-fed events (restarts the core) */
+    const bench_scenario_t boot_detect = { "boot_detect", scenario_boot_detect };
+    ok = bench_run(&boot_detect, false) && ok;
+
+    /* The same recovery from the main loop after a boot timeout, with
+     * boot checks running alongside (restarts the core: runs last) */
+    bench_erase_firmware();
+    const bench_scenario_t recovery_scheduled = { "recovery_scheduled", scenario_recovery_scheduled };
+    ok = bench_run(&recovery_scheduled, false) && ok;
+
+    printf("\n  ]}\n");
+
+    sim_stop();
+    bench_cleanup();
+    return ok ? 0 : 1;
+}
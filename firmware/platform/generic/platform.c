@@ -4,6 +4,9 @@
  */
 
 #include "platform.h"
+#include "sha256.h"
+#include "fat32.h"
+#include "usb_bot.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -35,6 +38,19 @@ bool platform_spi_erase(uint32_t offset) {
     return true;
 }
 
+bool platform_spi_is_busy(void) {
+    /* Read status register WIP bit */
+    /* Platform-specific code */
+    return false;
+}
+
+bool platform_spi_get_chip_info(platform_spi_chip_info_t *info) {
+    /* Report page/erase geometry and typical timings (from JEDEC SFDP or a
+     * part table); returning false makes the core use common defaults */
+    /* Platform-specific code */
+    return false;  // Placeholder
+}
+
 bool platform_spi_lock(void) {
     /* Lock SPI flash (hardware protection) */
     /* Platform-specific code */
@@ -65,40 +81,225 @@ bool platform_usb_is_present(void) {
     return false;  // Placeholder
 }
 
+/* File reads go through fat32.c over platform_usb_read_blocks(); boards
+ * whose USB stack has a file system of its own read files with it instead */
+static bool usb_fat32_ready(void) {
+    return fat32_is_mounted() || fat32_mount();
+}
+
+/* Queued reads complete inside platform_usb_read_start(); the file opened
+ * last is kept so a stream resolves its cluster chain once */
+#define USB_READ_QUEUE_DEPTH 4
+
+static struct {
+    char path[64];
+    fat32_file_t file;
+    bool open;
+} usb_read_file;
+
+static struct {
+    size_t size;
+    bool ok;
+    platform_dma_buffer_t *dma;     /* From platform_usb_read_start_dma() */
+} usb_read_queue[USB_READ_QUEUE_DEPTH];
+
+static uint32_t usb_read_head = 0;
+static uint32_t usb_read_count = 0;
+
+/* The stick was written: FAT sectors, read-ahead and the open file may be
+ * stale */
+static void usb_fat32_changed(void) {
+    fat32_unmount();
+    usb_bot_detach();
+    usb_read_file.open = false;
+}
+
 bool platform_usb_read_file(const char *path, uint8_t *buffer, size_t *size) {
-    /* Read file from USB device */
-    /* Platform-specific code */
-    return false;  // Placeholder
+    /* Read file from USB device; the whole file must fit */
+    fat32_file_t file;
+    size_t got;
+    if (!usb_fat32_ready() || !fat32_open(path, &file) || file.is_dir ||
+        file.size > *size || !fat32_read(&file, 0, buffer, file.size, &got)) {
+        return false;
+    }
+    *size = got;
+    return true;
 }
 
 bool platform_usb_write_file(const char *path, const uint8_t *buffer, size_t size) {
     /* Write file to USB device */
     /* Platform-specific code */
+    usb_fat32_changed();
+    return false;  // Placeholder
+}
+
+bool platform_usb_append_file(const char *path, const uint8_t *buffer, size_t size) {
+    /* Append to an existing file on USB device */
+    /* Platform-specific code */
+    usb_fat32_changed();
     return false;  // Placeholder
 }
 
 bool platform_usb_delete_file(const char *path) {
     /* Delete file from USB device */
     /* Platform-specific code */
+    usb_fat32_changed();
     return false;  // Placeholder
 }
 
 bool platform_usb_file_exists(const char *path) {
     /* Check if file exists on USB device */
-    /* Platform-specific code */
-    return false;  // Placeholder
+    platform_usb_dirent_t entry;
+    return usb_fat32_ready() && fat32_stat(path, &entry);
 }
 
 bool platform_usb_rename_file(const char *old_path, const char *new_path) {
     /* Rename file on USB device */
     /* Platform-specific code */
+    usb_fat32_changed();
     return false;  // Placeholder
 }
 
+bool platform_usb_stat(const char *path, platform_usb_dirent_t *entry) {
+    /* Look up one directory entry on the USB device */
+    return usb_fat32_ready() && fat32_stat(path, entry);
+}
+
+bool platform_usb_list_dir(const char *path, platform_usb_dirent_t *entries,
+                           uint32_t max_entries, uint32_t *count) {
+    /* Read all entries of a directory on the USB device */
+    *count = 0;
+    return usb_fat32_ready() && fat32_list_dir(path, entries, max_entries, count);
+}
+
+bool platform_usb_read_start(const char *path, uint32_t offset,
+                             uint8_t *buffer, size_t size) {
+    /* Queue a chunk read from a file on the USB device */
+    if (usb_read_count == USB_READ_QUEUE_DEPTH || strlen(path) >= sizeof(usb_read_file.path)) {
+        return false;
+    }
+    if (!usb_read_file.open || strcmp(usb_read_file.path, path) != 0) {
+        usb_read_file.open = usb_fat32_ready() && fat32_open(path, &usb_read_file.file) &&
+                             !usb_read_file.file.is_dir;
+        strcpy(usb_read_file.path, path);
+    }
+
+    uint32_t slot = (usb_read_head + usb_read_count) % USB_READ_QUEUE_DEPTH;
+    usb_read_queue[slot].size = 0;
+    usb_read_queue[slot].dma = NULL;
+    usb_read_queue[slot].ok = usb_read_file.open &&
+        fat32_read(&usb_read_file.file, offset, buffer, size, &usb_read_queue[slot].size);
+    usb_read_count++;
+    return true;
+}
+
+bool platform_usb_read_wait(size_t *size) {
+    /* Wait for the oldest queued chunk read to complete */
+    *size = 0;
+    if (usb_read_count == 0) {
+        return false;
+    }
+    *size = usb_read_queue[usb_read_head].size;
+    bool ok = usb_read_queue[usb_read_head].ok;
+    platform_dma_buffer_t *dma = usb_read_queue[usb_read_head].dma;
+    usb_read_head = (usb_read_head + 1) % USB_READ_QUEUE_DEPTH;
+    usb_read_count--;
+    if (dma) {
+        dma->length = *size;
+        if (dma->callback) {
+            dma->callback(dma, ok);
+        }
+    }
+    return ok;
+}
+
+/* DMA buffer pool; must sit in RAM the USB and SPI DMA engines reach (a
+ * linker section on parts with TCM or non-coherent memory) */
+static uint8_t dma_memory[PLATFORM_DMA_BUFFERS][PLATFORM_DMA_BUFFER_SIZE];
+static platform_dma_buffer_t dma_buffers[PLATFORM_DMA_BUFFERS];
+static bool dma_owned[PLATFORM_DMA_BUFFERS];
+
+platform_dma_buffer_t *platform_dma_alloc(void) {
+    /* Take a free buffer (under a lock/critical section with threads) */
+    for (uint32_t i = 0; i < PLATFORM_DMA_BUFFERS; i++) {
+        if (!dma_owned[i]) {
+            dma_owned[i] = true;
+            memset(&dma_buffers[i], 0, sizeof(dma_buffers[i]));
+            dma_buffers[i].data = dma_memory[i];
+            return &dma_buffers[i];
+        }
+    }
+    return NULL;
+}
+
+void platform_dma_free(platform_dma_buffer_t *buffer) {
+    /* Return a buffer to the pool */
+    if (buffer) {
+        dma_owned[buffer - dma_buffers] = false;
+    }
+}
+
+bool platform_usb_read_start_dma(const char *path, uint32_t offset,
+                                 platform_dma_buffer_t *buffer, size_t size,
+                                 platform_dma_callback_t callback) {
+    /* Queue a chunk read into a pool buffer; whole sectors land there
+     * straight from the block device */
+    if (!buffer || size > PLATFORM_DMA_BUFFER_SIZE ||
+        !platform_usb_read_start(path, offset, buffer->data, size)) {
+        return false;
+    }
+    buffer->callback = callback;
+    usb_read_queue[(usb_read_head + usb_read_count - 1) % USB_READ_QUEUE_DEPTH].dma = buffer;
+    return true;
+}
+
+/* Bulk pipes of the attached mass storage device, for usb_bot.c */
+static bool usb_bulk_submit(void *context, bool in, uint8_t *data, size_t size) {
+    /* Queue a transfer on the bulk IN or OUT endpoint */
+    /* Platform-specific code (host controller driver) */
+    return false;  // Placeholder
+}
+
+static bool usb_bulk_wait(void *context, size_t *actual) {
+    /* Wait for the oldest queued bulk transfer */
+    /* Platform-specific code */
+    return false;  // Placeholder
+}
+
+static bool usb_bulk_reset(void *context) {
+    /* Bulk-Only Mass Storage Reset, then clear halt on both endpoints */
+    /* Platform-specific code */
+    return false;  // Placeholder
+}
+
+bool platform_usb_get_block_info(platform_usb_block_info_t *info) {
+    /* Block size, capacity and largest transfer of the USB device */
+    if (!usb_bot_is_attached()) {
+        usb_bot_backend_t backend = {
+            .submit = usb_bulk_submit,
+            .wait = usb_bulk_wait,
+            .reset = usb_bulk_reset,
+            .max_transfer = 64 * 1024,
+        };
+        if (!usb_bot_attach(&backend)) {
+            return false;
+        }
+    }
+    return usb_bot_get_info(info);
+}
+
+bool platform_usb_read_blocks(uint32_t lba, uint8_t *buffer, uint32_t count) {
+    /* Read count blocks from the USB device (queued SCSI READ(10)s) */
+    return usb_bot_read_blocks(lba, buffer, count);
+}
+
 /* Boot Detection Implementation */
 void platform_boot_detection_init(void) {
     /* Initialize boot detection hardware */
     /* Platform-specific code */
+    /* Enable the GPIO edge, watchdog clear, POST port and firmware flag
+     * interrupts at one priority level; their handlers call
+     * boot_detection_push() */
 }
 
 /* Cryptographic Implementation */
@@ -110,9 +311,40 @@ bool platform_crypto_init(void) {
 
 void platform_sha256(const uint8_t *data, size_t size, uint8_t *hash) {
     /* Calculate SHA-256 hash */
-    /* Use hardware acceleration if available */
-    /* Platform-specific code */
-    memset(hash, 0, 32);  // Placeholder
+    /* sha256.c dispatches to SHA-NI when present; replace with a hash engine if available */
+    sha256(data, size, hash);
+}
+
+void platform_sha256_init(platform_sha256_ctx_t *ctx) {
+    /* Start incremental SHA-256 */
+    sha256_init(ctx);
+}
+
+void platform_sha256_update(platform_sha256_ctx_t *ctx,
+                            const uint8_t *data, size_t size) {
+    /* Feed data into incremental SHA-256 */
+    sha256_update(ctx, data, size);
+}
+
+void platform_sha256_final(platform_sha256_ctx_t *ctx, uint8_t *hash) {
+    /* Finish incremental SHA-256 */
+    sha256_final(ctx, hash);
+}
+
+void platform_sha256_batch_init(platform_sha256_batch_ctx_t *ctx, size_t count) {
+    /* Start multi-buffer SHA-256 */
+    sha256_batch_init(ctx, count);
+}
+
+void platform_sha256_batch_update(platform_sha256_batch_ctx_t *ctx,
+                                  const uint8_t *const data[], size_t size) {
+    /* Feed every message; SIMD lanes where available */
+    sha256_batch_update(ctx, data, size);
+}
+
+void platform_sha256_batch_final(platform_sha256_batch_ctx_t *ctx, uint8_t hashes[][32]) {
+    /* Finish multi-buffer SHA-256 */
+    sha256_batch_final(ctx, hashes);
 }
 
 bool platform_sign(const uint8_t *data, size_t size, 
@@ -129,6 +361,18 @@ bool platform_verify(const uint8_t *data, size_t size,
     return false;  // Placeholder
 }
 
+bool platform_get_device_key(uint8_t key[32]) {
+    /* Read the device-unique secret (fuses, secure element, TPM) */
+    /* Platform-specific code */
+    return false;  // Placeholder: no key, verification results are not cached
+}
+
+bool platform_get_verify_key_id(uint8_t key_id[32]) {
+    /* Hash of the public key used by platform_verify() */
+    /* Platform-specific code */
+    return false;  // Placeholder
+}
+
 /* System Functions */
 uint32_t platform_get_timestamp(void) {
     /* Return milliseconds since boot */
@@ -137,6 +381,19 @@ uint32_t platform_get_timestamp(void) {
     return counter++;  // Placeholder
 }
 
+void platform_wait_event(uint32_t timeout_ms) {
+    /* Sleep until an event or timeout_ms */
+    /* Platform-specific code */
+    /* Arm a one-shot wake-up timer (RTC/LPTIM) and WFE; the event register
+     * keeps a platform_signal_event() (SEV) from before the WFE */
+    (void)timeout_ms;
+}
+
+void platform_signal_event(void) {
+    /* Wake platform_wait_event() */
+    /* Platform-specific code (e.g. SEV) */
+}
+
 void system_reboot(void) {
     /* Trigger system reboot */
     /* Platform-specific code */
@@ -168,3 +425,8 @@ void platform_delay_ms(uint32_t ms) {
     /* Delay for specified milliseconds */
     /* Platform-specific code */
 }
+
+void platform_delay_us(uint32_t us) {
+    /* Delay for specified microseconds (busy-wait or timer) */
+    /* Platform-specific code */
+}
@@ -0,0 +1,1563 @@
+/**
+ * Host Simulation Platform Implementation
+ * See sim.h for the model; build with make PLATFORM=sim
+ */
+
+#define _DEFAULT_SOURCE
+#include "platform.h"
+#include "sha256.h"
+#include "fat32.h"
+#include "usb_bot.h"
+#include "boot_detection.h"
+#include "logging.h"
+#include "sim.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef PLATFORM_THREADS
+#include <pthread.h>
+#endif
+
+/* Signing key for the simulated signature scheme (not a real algorithm) */
+static const char sim_sign_key[] = "SRC-SIM-SIGNING-KEY";
+
+/* Device-unique secret of the simulated board */
+static const char sim_device_key[] = "SRC-SIM-DEVICE-KEY";
+
+/* Queued USB read */
+typedef struct {
+    size_t bytes;
+    uint64_t done_us;
+    bool ok;
+    size_t copy_bytes;                  /* Bounced on completion (not pool memory) */
+    platform_dma_buffer_t *dma;         /* From platform_usb_read_start_dma() */
+    uint32_t ticket;                    /* Image read queued in usb_bot.c (0 = done) */
+    uint32_t epoch;                     /* usb_image_epoch the ticket belongs to */
+} sim_usb_request_t;
+
+static bool sim_started = false;
+static sim_config_t sim_config;
+static sim_stats_t sim_stats;
+
+/* Boot signal interrupts, by time; they only interrupt the main thread */
+typedef struct {
+    uint64_t at_us;
+    uint8_t type;
+    uint8_t value;
+} sim_boot_irq_t;
+
+static sim_boot_irq_t boot_irqs[SIM_MAX_BOOT_IRQS];
+static uint32_t boot_irq_count;
+static bool in_boot_irq;            /* Handlers do not nest */
+static volatile bool event_signalled;
+
+static uint8_t *flash = NULL;
+static int flash_fd = -1;
+static uint64_t spi_busy_until_us = 0;
+static bool spi_locked = false;
+
+static bool usb_present = true;
+
+/* sim_set_usb_tamper(): file served differently once read to its end */
+static char usb_tamper_path[64];
+static uint32_t usb_tamper_offset;
+static bool usb_tamper_armed;
+
+/* Raw FAT32 image served as the stick; bumping the epoch makes threads
+ * reopen the files they stream from */
+static int usb_image_fd = -1;
+static uint32_t usb_image_blocks = 0;
+static uint32_t usb_image_epoch = 0;
+
+static void sim_bot_detach(void);
+static uint64_t sim_bot_done_us(uint32_t tag);
+
+/* Per-thread view of the device: a clock and a USB queue. Every thread
+ * shares sim_main unless it is a worker from platform_thread_create(). */
+typedef struct {
+    uint64_t clock_us;
+    uint64_t usb_idle_us;
+    sim_usb_request_t usb_queue[SIM_USB_QUEUE_DEPTH];
+    uint32_t usb_queue_head;
+    uint32_t usb_queue_count;
+    bool image_file_open;           /* File streamed by queued image reads */
+    uint32_t image_file_epoch;
+    char image_file_path[64];
+    fat32_file_t image_file;
+} sim_context_t;
+
+static sim_context_t sim_main;
+#ifdef PLATFORM_THREADS
+static __thread sim_context_t *sim = &sim_main;
+
+/* Shared counters and the USB share are updated from workers too */
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SIM_LOCK()   pthread_mutex_lock(&sim_lock)
+#define SIM_UNLOCK() pthread_mutex_unlock(&sim_lock)
+
+/* fat32.c is not reentrant */
+static pthread_mutex_t sim_fat32_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SIM_FAT32_LOCK()   pthread_mutex_lock(&sim_fat32_lock)
+#define SIM_FAT32_UNLOCK() pthread_mutex_unlock(&sim_fat32_lock)
+#else
+static sim_context_t *const sim = &sim_main;
+#define SIM_LOCK()   ((void)0)
+#define SIM_UNLOCK() ((void)0)
+#define SIM_FAT32_LOCK()   ((void)0)
+#define SIM_FAT32_UNLOCK() ((void)0)
+#endif
+
+/* Threads currently queueing USB reads; they split the bus bandwidth */
+static uint32_t usb_users = 1;
+
+/**
+ * Time to move bytes at kbps (0 = free)
+ */
+static uint64_t sim_transfer_us(uint64_t bytes, uint32_t kbps) {
+    if (kbps == 0) {
+        return 0;
+    }
+    return (bytes * 1000000ULL) / ((uint64_t)kbps * 1024ULL);
+}
+
+/* DMA pool: the only memory the simulated controllers reach. Transfers to
+ * or from anywhere else are bounced by the CPU at copy_kbps. */
+static uint8_t sim_dma_memory[PLATFORM_DMA_BUFFERS][PLATFORM_DMA_BUFFER_SIZE];
+static platform_dma_buffer_t sim_dma_buffers[PLATFORM_DMA_BUFFERS];
+static bool sim_dma_owned[PLATFORM_DMA_BUFFERS];
+
+/**
+ * Bytes of a controller transfer the CPU has to copy (0 for pool memory);
+ * counts the transfer in the DMA/copy stats
+ */
+static size_t sim_dma_bounce(const uint8_t *buffer, size_t bytes) {
+    uintptr_t start = (uintptr_t)buffer;
+    uintptr_t pool = (uintptr_t)sim_dma_memory;
+    if (start >= pool && bytes <= sizeof(sim_dma_memory) &&
+        start - pool <= sizeof(sim_dma_memory) - bytes) {
+        sim_stats.dma_bytes += bytes;
+        return 0;
+    }
+    sim_stats.copy_bytes += bytes;
+    return bytes;
+}
+
+/**
+ * Charge a synchronous controller transfer's bounce copy, if any
+ */
+static void sim_dma_charge(const uint8_t *buffer, size_t bytes) {
+    sim->clock_us += sim_transfer_us(sim_dma_bounce(buffer, bytes), sim_config.copy_kbps);
+}
+
+static uint32_t sim_env_u32(const char *name, uint32_t fallback) {
+    const char *value = getenv(name);
+    if (!value || *value == '\0') {
+        return fallback;
+    }
+    return (uint32_t)strtoul(value, NULL, 0);
+}
+
+void sim_config_defaults(sim_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->flash_size = SIM_DEFAULT_FLASH_SIZE;
+    config->page_size = SIM_DEFAULT_PAGE_SIZE;
+    config->erase_size = SIM_DEFAULT_ERASE_SIZE;
+    config->spi_read_kbps = SIM_DEFAULT_SPI_READ_KBPS;
+    config->page_program_us = SIM_DEFAULT_PAGE_PROGRAM_US;
+    config->sector_erase_ms = SIM_DEFAULT_SECTOR_ERASE_MS;
+    config->block_erase_ms = SIM_DEFAULT_BLOCK_ERASE_MS;
+    config->usb_kbps = SIM_DEFAULT_USB_KBPS;
+    config->usb_latency_us = SIM_DEFAULT_USB_LATENCY_US;
+    config->usb_max_transfer = SIM_DEFAULT_USB_MAX_TRANSFER;
+    config->sha_kbps = SIM_DEFAULT_SHA_KBPS;
+    config->verify_ms = SIM_DEFAULT_VERIFY_MS;
+    config->copy_kbps = SIM_DEFAULT_COPY_KBPS;
+}
+
+void sim_config_from_env(sim_config_t *config) {
+    sim_config_defaults(config);
+    config->flash_path = getenv("SRC_SIM_FLASH");
+    config->usb_dir = getenv("SRC_SIM_USB_DIR");
+    config->usb_image = getenv("SRC_SIM_USB_IMAGE");
+    config->flash_size = sim_env_u32("SRC_SIM_FLASH_SIZE", config->flash_size);
+    config->page_size = sim_env_u32("SRC_SIM_PAGE_SIZE", config->page_size);
+    config->erase_size = sim_env_u32("SRC_SIM_ERASE_SIZE", config->erase_size);
+    config->spi_read_kbps = sim_env_u32("SRC_SIM_SPI_READ_KBPS", config->spi_read_kbps);
+    config->page_program_us = sim_env_u32("SRC_SIM_PAGE_PROGRAM_US", config->page_program_us);
+    config->sector_erase_ms = sim_env_u32("SRC_SIM_SECTOR_ERASE_MS", config->sector_erase_ms);
+    config->block_erase_ms = sim_env_u32("SRC_SIM_BLOCK_ERASE_MS", config->block_erase_ms);
+    config->usb_kbps = sim_env_u32("SRC_SIM_USB_KBPS", config->usb_kbps);
+    config->usb_latency_us = sim_env_u32("SRC_SIM_USB_LATENCY_US", config->usb_latency_us);
+    config->usb_max_transfer = sim_env_u32("SRC_SIM_USB_MAX_TRANSFER", config->usb_max_transfer);
+    config->sha_kbps = sim_env_u32("SRC_SIM_SHA_KBPS", config->sha_kbps);
+    config->verify_ms = sim_env_u32("SRC_SIM_VERIFY_MS", config->verify_ms);
+    config->copy_kbps = sim_env_u32("SRC_SIM_COPY_KBPS", config->copy_kbps);
+    config->verbose = sim_env_u32("SRC_SIM_VERBOSE", 0) != 0;
+}
+
+/**
+ * Map the flash image; new space reads as erased (0xFF)
+ */
+static bool sim_map_flash(void) {
+    size_t size = sim_config.flash_size;
+
+    if (!sim_config.flash_path) {
+        flash = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (flash == MAP_FAILED) {
+            flash = NULL;
+            return false;
+        }
+        memset(flash, 0xFF, size);
+        return true;
+    }
+
+    flash_fd = open(sim_config.flash_path, O_RDWR | O_CREAT, 0644);
+    if (flash_fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(flash_fd, &st) != 0) {
+        close(flash_fd);
+        flash_fd = -1;
+        return false;
+    }
+    size_t old_size = (size_t)st.st_size;
+    if (old_size < size && ftruncate(flash_fd, (off_t)size) != 0) {
+        close(flash_fd);
+        flash_fd = -1;
+        return false;
+    }
+
+    flash = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, flash_fd, 0);
+    if (flash == MAP_FAILED) {
+        flash = NULL;
+        close(flash_fd);
+        flash_fd = -1;
+        return false;
+    }
+    if (old_size < size) {
+        memset(flash + old_size, 0xFF, size - old_size);
+    }
+    return true;
+}
+
+bool sim_start(const sim_config_t *config) {
+    if (!config || config->flash_size == 0 || config->page_size == 0 ||
+        config->erase_size == 0 || config->erase_size % config->page_size != 0 ||
+        config->flash_size % config->erase_size != 0) {
+        return false;
+    }
+
+    sim_stop();
+    sim_config = *config;
+    if (!sim_map_flash()) {
+        fprintf(stderr, "sim: cannot map flash image (%s)\n", strerror(errno));
+        return false;
+    }
+
+    memset(&sim_main, 0, sizeof(sim_main));
+    spi_busy_until_us = 0;
+    spi_locked = false;
+    usb_present = true;
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    boot_irq_count = 0;
+    event_signalled = false;
+    sim_started = true;
+    logging_set_echo(config->verbose);
+    if (!sim_set_usb_image(config->usb_image)) {
+        fprintf(stderr, "sim: cannot open USB image (%s)\n", strerror(errno));
+        sim_stop();
+        return false;
+    }
+    return true;
+}
+
+void sim_stop(void) {
+    if (flash) {
+        if (flash_fd >= 0) {
+            msync(flash, sim_config.flash_size, MS_SYNC);
+        }
+        munmap(flash, sim_config.flash_size);
+        flash = NULL;
+    }
+    if (flash_fd >= 0) {
+        close(flash_fd);
+        flash_fd = -1;
+    }
+    sim_set_usb_image(NULL);
+    sim_started = false;
+}
+
+static bool sim_ensure_started(void) {
+    if (sim_started) {
+        return true;
+    }
+
+    sim_config_t config;
+    sim_config_from_env(&config);
+    return sim_start(&config);
+}
+
+uint64_t sim_now_us(void) {
+    return sim->clock_us;
+}
+
+void sim_advance_us(uint64_t us) {
+    sim->clock_us += us;
+}
+
+void sim_get_stats(sim_stats_t *stats) {
+    if (stats) {
+        *stats = sim_stats;
+    }
+}
+
+void sim_reset_stats(void) {
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+void sim_set_usb_present(bool present) {
+    SIM_FAT32_LOCK();
+    usb_present = present;
+    fat32_unmount();
+    sim_bot_detach();
+    usb_image_epoch++;
+    SIM_FAT32_UNLOCK();
+}
+
+void sim_set_usb_tamper(const char *path, uint32_t offset) {
+    SIM_LOCK();
+    usb_tamper_path[0] = '\0';
+    if (path) {
+        snprintf(usb_tamper_path, sizeof(usb_tamper_path), "%s", path);
+    }
+    usb_tamper_offset = offset;
+    usb_tamper_armed = false;
+    SIM_UNLOCK();
+}
+
+bool sim_set_usb_image(const char *path) {
+    bool ok = true;
+
+    SIM_FAT32_LOCK();
+    if (usb_image_fd >= 0) {
+        close(usb_image_fd);
+        usb_image_fd = -1;
+    }
+    sim_config.usb_image = NULL;
+    if (path) {
+        struct stat st;
+        usb_image_fd = open(path, O_RDONLY);
+        ok = usb_image_fd >= 0 && fstat(usb_image_fd, &st) == 0;
+        if (ok) {
+            sim_config.usb_image = path;
+            usb_image_blocks = (uint32_t)(st.st_size / FAT32_SECTOR_SIZE);
+        } else if (usb_image_fd >= 0) {
+            close(usb_image_fd);
+            usb_image_fd = -1;
+        }
+    }
+    fat32_unmount();
+    sim_bot_detach();
+    usb_image_epoch++;
+    SIM_FAT32_UNLOCK();
+    return ok;
+}
+
+uint8_t *sim_flash_data(void) {
+    return sim_ensure_started() ? flash : NULL;
+}
+
+/* SPI Flash Implementation */
+bool platform_spi_init(void) {
+    return sim_ensure_started();
+}
+
+static bool sim_spi_range_ok(uint32_t offset, size_t size) {
+    return flash && size <= sim_config.flash_size &&
+           offset <= sim_config.flash_size - size;
+}
+
+bool platform_spi_read(uint32_t offset, uint8_t *buffer, size_t size) {
+    /* A NOR chip does not answer reads while programming/erasing */
+    if (!sim_spi_range_ok(offset, size) || sim->clock_us < spi_busy_until_us) {
+        return false;
+    }
+
+    memcpy(buffer, flash + offset, size);
+    sim->clock_us += sim_transfer_us(size, sim_config.spi_read_kbps);
+    sim_dma_charge(buffer, size);
+    sim_stats.spi_bytes_read += size;
+    return true;
+}
+
+bool platform_spi_write(uint32_t offset, const uint8_t *buffer, size_t size) {
+    if (!sim_spi_range_ok(offset, size) || size == 0 || spi_locked ||
+        sim->clock_us < spi_busy_until_us) {
+        return false;
+    }
+
+    /* Page program: must stay inside one page, can only clear bits */
+    if (offset / sim_config.page_size != (offset + size - 1) / sim_config.page_size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        flash[offset + i] &= buffer[i];
+    }
+
+    sim_dma_charge(buffer, size);
+    spi_busy_until_us = sim->clock_us + sim_config.page_program_us;
+    sim_stats.spi_busy_us += sim_config.page_program_us;
+    sim_stats.spi_bytes_programmed += size;
+    sim_stats.spi_programs++;
+    return true;
+}
+
+bool platform_spi_erase(uint32_t offset) {
+    if (!sim_spi_range_ok(offset, sim_config.erase_size) || spi_locked ||
+        offset % sim_config.erase_size != 0 || sim->clock_us < spi_busy_until_us) {
+        return false;
+    }
+
+    memset(flash + offset, 0xFF, sim_config.erase_size);
+
+    uint32_t erase_ms = (sim_config.erase_size >= 64 * 1024) ?
+        sim_config.block_erase_ms : sim_config.sector_erase_ms;
+    spi_busy_until_us = sim->clock_us + (uint64_t)erase_ms * 1000;
+    sim_stats.spi_busy_us += (uint64_t)erase_ms * 1000;
+    sim_stats.spi_bytes_erased += sim_config.erase_size;
+    sim_stats.spi_erases++;
+    return true;
+}
+
+bool platform_spi_is_busy(void) {
+    return sim->clock_us < spi_busy_until_us;
+}
+
+bool platform_spi_get_chip_info(platform_spi_chip_info_t *info) {
+    if (!info || !sim_ensure_started()) {
+        return false;
+    }
+
+    info->page_size = sim_config.page_size;
+    info->erase_size = sim_config.erase_size;
+    info->page_program_us = sim_config.page_program_us;
+    info->sector_erase_ms = (sim_config.erase_size >= 64 * 1024) ?
+        sim_config.block_erase_ms : sim_config.sector_erase_ms;
+    return true;
+}
+
+bool platform_spi_lock(void) {
+    spi_locked = true;
+    return true;
+}
+
+bool platform_spi_unlock(void) {
+    spi_locked = false;
+    return true;
+}
+
+uint32_t platform_spi_get_size(void) {
+    return sim_started ? sim_config.flash_size : 0;
+}
+
+/* USB Mass Storage Implementation */
+
+/**
+ * Map a stick path onto the host directory
+ */
+static bool sim_usb_path(const char *path, char *host_path, size_t host_size) {
+    if (!sim_config.usb_dir || usb_image_fd >= 0 || !usb_present || !path ||
+        strstr(path, "..")) {
+        return false;
+    }
+
+    int written = snprintf(host_path, host_size, "%s%s%s", sim_config.usb_dir,
+                           (path[0] == '/') ? "" : "/", path);
+    return written > 0 && (size_t)written < host_size;
+}
+
+/**
+ * Charge one synchronous USB transfer
+ */
+static void sim_usb_charge(size_t bytes) {
+    uint64_t start = (sim->clock_us > sim->usb_idle_us) ? sim->clock_us : sim->usb_idle_us;
+    sim->usb_idle_us = start + sim_config.usb_latency_us +
+                  sim_transfer_us(bytes, sim_config.usb_kbps);
+    sim->clock_us = sim->usb_idle_us;
+    sim_stats.usb_transfers++;
+}
+
+bool platform_usb_init(void) {
+    return sim_ensure_started();
+}
+
+/* USB image: reads go through fat32.c, writes fail (sim_usb_path) */
+static bool sim_fat32_ready(void) {
+    return usb_present && (fat32_is_mounted() || fat32_mount());
+}
+
+/**
+ * Read from a file on the image, keeping it open for the next chunk.
+ * A chunk of whole sectors in one run is queued straight into buffer
+ * (*ticket for usb_bot_read_wait()); anything else is read at once.
+ */
+static bool sim_fat32_read_chunk(const char *path, uint32_t offset, uint8_t *buffer,
+                                 size_t size, size_t *got, uint32_t *ticket) {
+    SIM_FAT32_LOCK();
+    bool ok = sim_fat32_ready();
+    if (ok && (!sim->image_file_open || sim->image_file_epoch != usb_image_epoch ||
+               strcmp(sim->image_file_path, path) != 0)) {
+        sim->image_file_open = strlen(path) < sizeof(sim->image_file_path) &&
+                               fat32_open(path, &sim->image_file) &&
+                               !sim->image_file.is_dir;
+        snprintf(sim->image_file_path, sizeof(sim->image_file_path), "%s", path);
+        sim->image_file_epoch = usb_image_epoch;
+    }
+    ok = ok && sim->image_file_open;
+
+    uint32_t lba;
+    uint32_t sectors;
+    *ticket = 0;
+    if (ok && fat32_map(&sim->image_file, offset, size, &lba, &sectors, got)) {
+        *ticket = usb_bot_read_start(lba, buffer, sectors);
+    }
+    if (ok && *ticket == 0) {
+        ok = fat32_read(&sim->image_file, offset, buffer, size, got);
+    }
+    SIM_FAT32_UNLOCK();
+    return ok;
+}
+
+bool platform_usb_is_present(void) {
+    struct stat st;
+    if (usb_image_fd >= 0) {
+        return usb_present;
+    }
+    return sim_config.usb_dir && usb_present &&
+           stat(sim_config.usb_dir, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool platform_usb_read_file(const char *path, uint8_t *buffer, size_t *size) {
+    char host_path[512];
+    if (usb_image_fd >= 0) {
+        fat32_file_t file;
+        size_t got = 0;
+        SIM_FAT32_LOCK();
+        bool ok = sim_fat32_ready() && fat32_open(path, &file) && !file.is_dir &&
+                  file.size <= *size && fat32_read(&file, 0, buffer, file.size, &got);
+        SIM_FAT32_UNLOCK();
+        if (ok) {
+            *size = got;
+        }
+        return ok;
+    }
+    if (!sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    FILE *file = fopen(host_path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    /* Whole file must fit the caller's buffer */
+    size_t got = fread(buffer, 1, *size, file);
+    bool fits = (fgetc(file) == EOF);
+    fclose(file);
+    if (!fits) {
+        return false;
+    }
+
+    *size = got;
+    sim_usb_charge(got);
+    sim_dma_charge(buffer, got);
+    sim_stats.usb_bytes_read += got;
+    return true;
+}
+
+bool platform_usb_write_file(const char *path, const uint8_t *buffer, size_t size) {
+    char host_path[512];
+    if (!sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    FILE *file = fopen(host_path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(buffer, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+
+    sim_usb_charge(size);
+    sim_dma_charge(buffer, size);
+    sim_stats.usb_bytes_written += size;
+    return ok;
+}
+
+bool platform_usb_append_file(const char *path, const uint8_t *buffer, size_t size) {
+    char host_path[512];
+    if (!sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    /* Appending needs an existing file (created by platform_usb_write_file) */
+    FILE *file = fopen(host_path, "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = fseek(file, 0, SEEK_END) == 0 &&
+              fwrite(buffer, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+
+    sim_usb_charge(size);
+    sim_dma_charge(buffer, size);
+    sim_stats.usb_bytes_written += size;
+    return ok;
+}
+
+bool platform_usb_delete_file(const char *path) {
+    char host_path[512];
+    if (!sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    sim_usb_charge(0);
+    return unlink(host_path) == 0;
+}
+
+bool platform_usb_file_exists(const char *path) {
+    char host_path[512];
+    if (usb_image_fd >= 0) {
+        platform_usb_dirent_t entry;
+        return platform_usb_stat(path, &entry);
+    }
+    if (!sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    sim_usb_charge(0);
+    return access(host_path, F_OK) == 0;
+}
+
+bool platform_usb_rename_file(const char *old_path, const char *new_path) {
+    char old_host[512];
+    char new_host[512];
+    if (!sim_usb_path(old_path, old_host, sizeof(old_host)) ||
+        !sim_usb_path(new_path, new_host, sizeof(new_host))) {
+        return false;
+    }
+
+    sim_usb_charge(0);
+    return rename(old_host, new_host) == 0;
+}
+
+/* Directory reads are charged as FAT would do them: 32 bytes per entry */
+#define SIM_DIRENT_BYTES 32
+
+static bool sim_fill_dirent(const char *name, const struct stat *st,
+                            platform_usb_dirent_t *entry) {
+    if (strlen(name) >= sizeof(entry->name)) {
+        return false;
+    }
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->name, name, strlen(name));
+    entry->is_dir = S_ISDIR(st->st_mode);
+    entry->size = entry->is_dir ? 0 : (uint32_t)st->st_size;
+    return true;
+}
+
+bool platform_usb_stat(const char *path, platform_usb_dirent_t *entry) {
+    char host_path[512];
+    struct stat st;
+    if (entry && usb_image_fd >= 0) {
+        SIM_FAT32_LOCK();
+        bool ok = sim_fat32_ready() && fat32_stat(path, entry);
+        SIM_FAT32_UNLOCK();
+        return ok;
+    }
+    if (!entry || !sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+
+    sim_usb_charge(SIM_DIRENT_BYTES);
+    sim_stats.usb_bytes_read += SIM_DIRENT_BYTES;
+    const char *name = strrchr(path, '/');
+    return stat(host_path, &st) == 0 &&
+           sim_fill_dirent(name ? name + 1 : path, &st, entry);
+}
+
+bool platform_usb_list_dir(const char *path, platform_usb_dirent_t *entries,
+                           uint32_t max_entries, uint32_t *count) {
+    char host_path[512];
+    if (count && usb_image_fd >= 0) {
+        SIM_FAT32_LOCK();
+        bool ok = sim_fat32_ready() && fat32_list_dir(path, entries, max_entries, count);
+        SIM_FAT32_UNLOCK();
+        return ok;
+    }
+    if (!count || !sim_usb_path(path, host_path, sizeof(host_path))) {
+        return false;
+    }
+    *count = 0;
+
+    DIR *dir = opendir(host_path);
+    if (!dir) {
+        sim_usb_charge(SIM_DIRENT_BYTES);
+        return false;
+    }
+
+    struct dirent *item;
+    uint32_t seen = 0;
+    while ((item = readdir(dir)) != NULL) {
+        char item_path[1024];
+        struct stat st;
+        if (item->d_name[0] == '.') {
+            continue;
+        }
+        seen++;
+        snprintf(item_path, sizeof(item_path), "%s/%s", host_path, item->d_name);
+        if (stat(item_path, &st) != 0) {
+            continue;
+        }
+        platform_usb_dirent_t entry;
+        if (!sim_fill_dirent(item->d_name, &st, &entry)) {
+            continue;
+        }
+        if (*count < max_entries) {
+            entries[*count] = entry;
+        }
+        (*count)++;
+    }
+    closedir(dir);
+
+    sim_usb_charge((size_t)seen * SIM_DIRENT_BYTES);
+    sim_stats.usb_bytes_read += (uint64_t)seen * SIM_DIRENT_BYTES;
+    return true;
+}
+
+/* Queued reads: data lands at once, completion time follows the USB model
+ * so the transfer overlaps whatever the core does until it waits */
+/**
+ * Queue one chunk read (dma: the pool buffer buffer belongs to, if any)
+ */
+static bool sim_usb_read_queue(const char *path, uint32_t offset, uint8_t *buffer,
+                               size_t size, platform_dma_buffer_t *dma) {
+    char host_path[512];
+    if (sim->usb_queue_count == SIM_USB_QUEUE_DEPTH ||
+        (usb_image_fd < 0 && !sim_usb_path(path, host_path, sizeof(host_path)))) {
+        return false;
+    }
+
+    sim_usb_request_t *request =
+        &sim->usb_queue[(sim->usb_queue_head + sim->usb_queue_count) % SIM_USB_QUEUE_DEPTH];
+    memset(request, 0, sizeof(*request));
+    request->dma = dma;
+
+    if (usb_image_fd >= 0) {
+        /* Waits on the bulk pipes move the clock; the transfer overlaps
+         * the core while queued in usb_bot.c */
+        request->ok = sim_fat32_read_chunk(path, offset, buffer, size,
+                                           &request->bytes, &request->ticket);
+        request->epoch = sim->image_file_epoch;
+        request->done_us = sim->clock_us;
+        sim->usb_queue_count++;
+        return true;
+    }
+
+    FILE *file = fopen(host_path, "rb");
+    if (file) {
+        if (fseek(file, (long)offset, SEEK_SET) == 0) {
+            request->bytes = fread(buffer, 1, size, file);
+            request->ok = !ferror(file);
+        }
+        fclose(file);
+    }
+
+    SIM_LOCK();
+    if (usb_tamper_path[0] && strcmp(path, usb_tamper_path) == 0) {
+        if (usb_tamper_armed && usb_tamper_offset >= offset &&
+            usb_tamper_offset - offset < request->bytes) {
+            buffer[usb_tamper_offset - offset] ^= 0xFF;
+        }
+        usb_tamper_armed = usb_tamper_armed || request->bytes < size;
+    }
+    uint64_t busy_us = sim_config.usb_latency_us +
+                       sim_transfer_us(request->bytes, sim_config.usb_kbps) * usb_users;
+    sim_stats.usb_transfers++;
+    sim_stats.usb_bytes_read += request->bytes;
+    request->copy_bytes = sim_dma_bounce(buffer, request->bytes);
+
+    uint64_t start = (sim->clock_us > sim->usb_idle_us) ? sim->clock_us : sim->usb_idle_us;
+    request->done_us = start + busy_us;
+    sim->usb_idle_us = request->done_us;
+    SIM_UNLOCK();
+    sim->usb_queue_count++;
+    return true;
+}
+
+bool platform_usb_read_start(const char *path, uint32_t offset,
+                             uint8_t *buffer, size_t size) {
+    return sim_usb_read_queue(path, offset, buffer, size, NULL);
+}
+
+bool platform_usb_read_start_dma(const char *path, uint32_t offset,
+                                 platform_dma_buffer_t *buffer, size_t size,
+                                 platform_dma_callback_t callback) {
+    if (!buffer || size > PLATFORM_DMA_BUFFER_SIZE) {
+        return false;
+    }
+    buffer->callback = callback;
+    return sim_usb_read_queue(path, offset, buffer->data, size, buffer);
+}
+
+/* Completed reads land in place; reads into other memory are copied out
+ * of the controller's buffer by the CPU once they complete */
+bool platform_usb_read_wait(size_t *size) {
+    if (sim->usb_queue_count == 0) {
+        return false;
+    }
+
+    sim_usb_request_t *request = &sim->usb_queue[sim->usb_queue_head];
+    sim->usb_queue_head = (sim->usb_queue_head + 1) % SIM_USB_QUEUE_DEPTH;
+    sim->usb_queue_count--;
+
+    if (request->ticket) {
+        SIM_FAT32_LOCK();
+        request->ok = usb_image_epoch == request->epoch && usb_bot_read_wait(request->ticket);
+        request->done_us = sim_bot_done_us(request->ticket);
+        SIM_FAT32_UNLOCK();
+        if (!request->ok) {
+            request->bytes = 0;
+        }
+    }
+    if (sim->clock_us < request->done_us) {
+        sim->clock_us = request->done_us;
+    }
+    sim->clock_us += sim_transfer_us(request->copy_bytes, sim_config.copy_kbps);
+    *size = request->bytes;
+    if (request->dma) {
+        request->dma->length = request->bytes;
+        if (request->dma->callback) {
+            request->dma->callback(request->dma, request->ok);
+        }
+    }
+    return request->ok;
+}
+
+platform_dma_buffer_t *platform_dma_alloc(void) {
+    platform_dma_buffer_t *buffer = NULL;
+    SIM_LOCK();
+    for (uint32_t i = 0; i < PLATFORM_DMA_BUFFERS && !buffer; i++) {
+        if (!sim_dma_owned[i]) {
+            sim_dma_owned[i] = true;
+            buffer = &sim_dma_buffers[i];
+            memset(buffer, 0, sizeof(*buffer));
+            buffer->data = sim_dma_memory[i];
+        }
+    }
+    SIM_UNLOCK();
+    return buffer;
+}
+
+void platform_dma_free(platform_dma_buffer_t *buffer) {
+    if (buffer) {
+        SIM_LOCK();
+        sim_dma_owned[buffer - sim_dma_buffers] = false;
+        SIM_UNLOCK();
+    }
+}
+
+/* Bulk-only device behind the USB image: decodes each CBW, moves the
+ * data and answers with a CSW. It works through commands one at a time on
+ * its own timeline; data is in place as soon as a transfer is queued and
+ * waiting for the transfer moves the clock to its completion. */
+#define SIM_BOT_TRANSFERS (3 * USB_BOT_QUEUE_DEPTH)
+
+enum {
+    SIM_BOT_STAGE_CBW,
+    SIM_BOT_STAGE_DATA,
+    SIM_BOT_STAGE_CSW
+};
+
+typedef struct {
+    size_t actual;
+    uint64_t done_us;
+    size_t copy_bytes;          /* Bounced on completion (not pool memory) */
+    bool ok;
+} sim_bot_transfer_t;
+
+static struct {
+    sim_bot_transfer_t queue[SIM_BOT_TRANSFERS];
+    uint32_t head;
+    uint32_t count;
+    uint64_t idle_us;           /* Device busy until */
+    uint8_t stage;
+    uint8_t opcode;
+    uint8_t status;
+    uint32_t tag;
+    uint32_t length;
+    uint32_t residue;
+    uint32_t lba;
+    uint64_t tag_done_us[USB_BOT_TICKETS];     /* When each recent command's CSW came */
+} sim_bot;
+
+static uint32_t sim_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sim_put32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static void sim_put32_be(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+/**
+ * Decode a CBW; returns false to stall
+ */
+static bool sim_bot_command(const uint8_t *cbw, size_t size) {
+    if (size != 31 || sim_get32(cbw) != 0x43425355 || cbw[14] == 0 || cbw[14] > 16) {
+        return false;
+    }
+    sim_bot.tag = sim_get32(&cbw[4]);
+    sim_bot.length = sim_get32(&cbw[8]);
+    sim_bot.residue = sim_bot.length;
+    sim_bot.opcode = cbw[15];
+    sim_bot.status = 0;
+
+    uint32_t expected = 0;
+    switch (sim_bot.opcode) {
+    case 0x00:      /* TEST UNIT READY */
+        break;
+    case 0x03:      /* REQUEST SENSE */
+        expected = cbw[15 + 4];
+        break;
+    case 0x25:      /* READ CAPACITY(10) */
+        expected = 8;
+        break;
+    case 0x28: {    /* READ(10) */
+        sim_bot.lba = ((uint32_t)cbw[17] << 24) | ((uint32_t)cbw[18] << 16) |
+                      ((uint32_t)cbw[19] << 8) | cbw[20];
+        uint32_t blocks = ((uint32_t)cbw[22] << 8) | cbw[23];
+        expected = blocks * FAT32_SECTOR_SIZE;
+        if (sim_bot.lba > usb_image_blocks || blocks > usb_image_blocks - sim_bot.lba) {
+            sim_bot.status = 1;
+        }
+        break;
+    }
+    default:
+        sim_bot.status = 1;
+        break;
+    }
+    if (expected != sim_bot.length || (sim_bot.length && !(cbw[12] & 0x80))) {
+        sim_bot.status = 1;
+    }
+    sim_bot.stage = sim_bot.length ? SIM_BOT_STAGE_DATA : SIM_BOT_STAGE_CSW;
+    return true;
+}
+
+/**
+ * Data stage: bytes moved, or -1 to stall
+ */
+static ssize_t sim_bot_data(uint8_t *data, size_t size) {
+    if (size != sim_bot.length) {
+        return -1;
+    }
+    sim_bot.stage = SIM_BOT_STAGE_CSW;
+    if (sim_bot.status != 0) {
+        return 0;
+    }
+
+    switch (sim_bot.opcode) {
+    case 0x03:
+        memset(data, 0, size);
+        data[0] = 0x70;     /* Current error, fixed format, no sense */
+        break;
+    case 0x25:
+        sim_put32_be(&data[0], usb_image_blocks - 1);
+        sim_put32_be(&data[4], FAT32_SECTOR_SIZE);
+        break;
+    case 0x28:
+        if (pread(usb_image_fd, data, size, (off_t)sim_bot.lba * FAT32_SECTOR_SIZE) !=
+            (ssize_t)size) {
+            sim_bot.status = 1;
+            return 0;
+        }
+        break;
+    }
+    sim_bot.residue = 0;
+    return (ssize_t)size;
+}
+
+static bool sim_bot_submit(void *context, bool in, uint8_t *data, size_t size) {
+    (void)context;
+    if (sim_bot.count == SIM_BOT_TRANSFERS) {
+        return false;
+    }
+
+    sim_bot_transfer_t *transfer =
+        &sim_bot.queue[(sim_bot.head + sim_bot.count) % SIM_BOT_TRANSFERS];
+    uint64_t busy_us = 0;
+    ssize_t moved = -1;
+    transfer->copy_bytes = 0;
+    if (usb_image_fd >= 0 && usb_present) {
+        switch (sim_bot.stage) {
+        case SIM_BOT_STAGE_CBW:
+            if (!in && sim_bot_command(data, size)) {
+                moved = (ssize_t)size;
+                busy_us = sim_config.usb_latency_us;
+                SIM_LOCK();
+                sim_stats.usb_transfers++;
+                SIM_UNLOCK();
+            }
+            break;
+        case SIM_BOT_STAGE_DATA:
+            if (in) {
+                moved = sim_bot_data(data, size);
+            }
+            if (moved > 0) {
+                busy_us = sim_transfer_us((uint64_t)moved, sim_config.usb_kbps);
+                SIM_LOCK();
+                sim_stats.usb_bytes_read += (uint64_t)moved;
+                transfer->copy_bytes = sim_dma_bounce(data, (size_t)moved);
+                SIM_UNLOCK();
+            }
+            break;
+        case SIM_BOT_STAGE_CSW:
+            if (in && size == 13) {
+                sim_put32(&data[0], 0x53425355);
+                sim_put32(&data[4], sim_bot.tag);
+                sim_put32(&data[8], sim_bot.residue);
+                data[12] = sim_bot.status;
+                sim_bot.stage = SIM_BOT_STAGE_CBW;
+                sim_bot.tag_done_us[sim_bot.tag % USB_BOT_TICKETS] =
+                    (sim->clock_us > sim_bot.idle_us) ? sim->clock_us : sim_bot.idle_us;
+                moved = 13;
+            }
+            break;
+        }
+    }
+
+    uint64_t start = (sim->clock_us > sim_bot.idle_us) ? sim->clock_us : sim_bot.idle_us;
+    sim_bot.idle_us = start + busy_us;
+    transfer->done_us = sim_bot.idle_us;
+    transfer->ok = moved >= 0;
+    transfer->actual = (moved > 0) ? (size_t)moved : 0;
+    sim_bot.count++;
+    return true;
+}
+
+static bool sim_bot_wait(void *context, size_t *actual) {
+    (void)context;
+    if (sim_bot.count == 0) {
+        return false;
+    }
+
+    sim_bot_transfer_t *transfer = &sim_bot.queue[sim_bot.head];
+    sim_bot.head = (sim_bot.head + 1) % SIM_BOT_TRANSFERS;
+    sim_bot.count--;
+    if (sim->clock_us < transfer->done_us) {
+        sim->clock_us = transfer->done_us;
+    }
+    sim->clock_us += sim_transfer_us(transfer->copy_bytes, sim_config.copy_kbps);
+    *actual = transfer->actual;
+    return transfer->ok;
+}
+
+static bool sim_bot_reset(void *context) {
+    (void)context;
+    uint64_t start = (sim->clock_us > sim_bot.idle_us) ? sim->clock_us : sim_bot.idle_us;
+    sim_bot.idle_us = start + sim_config.usb_latency_us;
+    sim->clock_us = sim_bot.idle_us;
+    sim_bot.head = 0;
+    sim_bot.count = 0;
+    sim_bot.stage = SIM_BOT_STAGE_CBW;
+    return true;
+}
+
+static uint64_t sim_bot_done_us(uint32_t tag) {
+    return sim_bot.tag_done_us[tag % USB_BOT_TICKETS];
+}
+
+/* Unplug or image swap: the device and everything read ahead from it go */
+static void sim_bot_detach(void) {
+    usb_bot_detach();
+    sim_bot.head = 0;
+    sim_bot.count = 0;
+    sim_bot.stage = SIM_BOT_STAGE_CBW;
+}
+
+bool platform_usb_get_block_info(platform_usb_block_info_t *info) {
+    if (!info || usb_image_fd < 0 || !usb_present) {
+        return false;
+    }
+
+    if (!usb_bot_is_attached()) {
+        usb_bot_backend_t backend = {
+            .submit = sim_bot_submit,
+            .wait = sim_bot_wait,
+            .reset = sim_bot_reset,
+            .max_transfer = sim_config.usb_max_transfer * FAT32_SECTOR_SIZE,
+        };
+        if (!usb_bot_attach(&backend)) {
+            return false;
+        }
+    }
+    return usb_bot_get_info(info);
+}
+
+bool platform_usb_read_blocks(uint32_t lba, uint8_t *buffer, uint32_t count) {
+    return usb_image_fd >= 0 && usb_present && usb_bot_read_blocks(lba, buffer, count);
+}
+
+/* Boot Detection Implementation */
+void platform_boot_detection_init(void) {
+    /* Boot signals are interrupts the harness schedules with
+     * sim_raise_boot_event() */
+}
+
+/* Crypto Implementation */
+bool platform_crypto_init(void) {
+    return true;
+}
+
+static void sim_sha_charge(size_t size) {
+    sim->clock_us += sim_transfer_us(size, sim_config.sha_kbps);
+    SIM_LOCK();
+    sim_stats.sha_bytes += size;
+    SIM_UNLOCK();
+}
+
+void platform_sha256(const uint8_t *data, size_t size, uint8_t *hash) {
+    sim_sha_charge(size);
+    sha256(data, size, hash);
+}
+
+void platform_sha256_init(platform_sha256_ctx_t *ctx) {
+    sha256_init(ctx);
+}
+
+void platform_sha256_update(platform_sha256_ctx_t *ctx,
+                            const uint8_t *data, size_t size) {
+    sim_sha_charge(size);
+    sha256_update(ctx, data, size);
+}
+
+void platform_sha256_final(platform_sha256_ctx_t *ctx, uint8_t *hash) {
+    sha256_final(ctx, hash);
+}
+
+void platform_sha256_batch_init(platform_sha256_batch_ctx_t *ctx, size_t count) {
+    sha256_batch_init(ctx, count);
+}
+
+void platform_sha256_batch_update(platform_sha256_batch_ctx_t *ctx,
+                                  const uint8_t *const data[], size_t size) {
+    /* Modelled as one engine: lanes save host time, not device time */
+    sim_sha_charge(size * ctx->count);
+    sha256_batch_update(ctx, data, size);
+}
+
+void platform_sha256_batch_final(platform_sha256_batch_ctx_t *ctx, uint8_t hashes[][32]) {
+    sha256_batch_final(ctx, hashes);
+}
+
+/**
+ * Simulated signature: SHA-256(key || i || data) for i = 0, 1
+ * Deterministic stand-in for a real signature scheme; not secure.
+ */
+static void sim_signature(const uint8_t *data, size_t size, uint8_t *signature) {
+    for (uint8_t i = 0; i < 2; i++) {
+        platform_sha256_ctx_t ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, (const uint8_t *)sim_sign_key, sizeof(sim_sign_key) - 1);
+        sha256_update(&ctx, &i, 1);
+        sha256_update(&ctx, data, size);
+        sha256_final(&ctx, signature + i * 32);
+    }
+}
+
+bool platform_sign(const uint8_t *data, size_t size,
+                  uint8_t *signature, size_t *sig_size) {
+    if (!data || !signature || !sig_size || *sig_size < SIM_SIGNATURE_SIZE) {
+        return false;
+    }
+
+    sim_signature(data, size, signature);
+    *sig_size = SIM_SIGNATURE_SIZE;
+    return true;
+}
+
+bool platform_verify(const uint8_t *data, size_t size,
+                    const uint8_t *signature, size_t sig_size) {
+    if (!data || !signature || sig_size != SIM_SIGNATURE_SIZE) {
+        return false;
+    }
+
+    /* Modelled as a public-key verify, not as the hashes it really is */
+    sim->clock_us += (uint64_t)sim_config.verify_ms * 1000;
+    sim_stats.verifies++;
+
+    uint8_t expected[SIM_SIGNATURE_SIZE];
+    sim_signature(data, size, expected);
+
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(expected); i++) {
+        diff |= expected[i] ^ signature[i];
+    }
+    return diff == 0;
+}
+
+bool platform_get_device_key(uint8_t key[32]) {
+    if (!key) {
+        return false;
+    }
+    sha256((const uint8_t *)sim_device_key, sizeof(sim_device_key) - 1, key);
+    return true;
+}
+
+bool platform_get_verify_key_id(uint8_t key_id[32]) {
+    if (!key_id) {
+        return false;
+    }
+    sha256((const uint8_t *)sim_sign_key, sizeof(sim_sign_key) - 1, key_id);
+    return true;
+}
+
+#ifdef PLATFORM_THREADS
+/* Worker Threads Implementation */
+typedef struct {
+    bool in_use;
+    pthread_t thread;
+    void (*entry)(void *arg);
+    void *arg;
+    sim_context_t context;
+} sim_thread_t;
+
+static sim_thread_t sim_threads[SIM_MAX_THREADS];
+
+static void *sim_thread_main(void *arg) {
+    sim_thread_t *worker = arg;
+    sim = &worker->context;
+    worker->entry(worker->arg);
+    return NULL;
+}
+
+/* A worker gets its own clock, starting at its creator's, so the two run
+ * in parallel on the simulated timeline; joining waits for the later one */
+bool platform_thread_create(platform_thread_t *thread, void (*entry)(void *arg), void *arg) {
+    if (!thread || !entry) {
+        return false;
+    }
+
+    sim_thread_t *worker = NULL;
+    SIM_LOCK();
+    for (uint32_t i = 0; i < SIM_MAX_THREADS; i++) {
+        if (!sim_threads[i].in_use) {
+            worker = &sim_threads[i];
+            worker->in_use = true;
+            usb_users++;
+            break;
+        }
+    }
+    SIM_UNLOCK();
+    if (!worker) {
+        return false;
+    }
+
+    memset(&worker->context, 0, sizeof(worker->context));
+    worker->context.clock_us = sim->clock_us;
+    worker->entry = entry;
+    worker->arg = arg;
+    if (pthread_create(&worker->thread, NULL, sim_thread_main, worker) != 0) {
+        SIM_LOCK();
+        worker->in_use = false;
+        usb_users--;
+        SIM_UNLOCK();
+        return false;
+    }
+
+    thread->handle = worker;
+    return true;
+}
+
+void platform_thread_join(platform_thread_t *thread) {
+    sim_thread_t *worker = thread ? thread->handle : NULL;
+    if (!worker) {
+        return;
+    }
+
+    pthread_join(worker->thread, NULL);
+    if (sim->clock_us < worker->context.clock_us) {
+        sim->clock_us = worker->context.clock_us;
+    }
+
+    SIM_LOCK();
+    worker->in_use = false;
+    usb_users--;
+    SIM_UNLOCK();
+    thread->handle = NULL;
+}
+#endif
+
+bool sim_raise_boot_event(uint64_t at_us, uint8_t type, uint8_t value) {
+    if (boot_irq_count >= SIM_MAX_BOOT_IRQS) {
+        return false;
+    }
+    uint32_t slot = boot_irq_count++;
+    while (slot > 0 && boot_irqs[slot - 1].at_us > at_us) {
+        boot_irqs[slot] = boot_irqs[slot - 1];
+        slot--;
+    }
+    boot_irqs[slot] = (sim_boot_irq_t){ .at_us = at_us, .type = type, .value = value };
+    return true;
+}
+
+/**
+ * Run the handlers of interrupts due by the main clock
+ */
+static void sim_fire_boot_irqs(void) {
+    if (sim != &sim_main || in_boot_irq) {
+        return;
+    }
+    in_boot_irq = true;
+    uint32_t fired = 0;
+    while (fired < boot_irq_count && boot_irqs[fired].at_us <= sim_main.clock_us) {
+        boot_detection_push((boot_event_type_t)boot_irqs[fired].type, boot_irqs[fired].value);
+        fired++;
+    }
+    if (fired > 0) {
+        boot_irq_count -= fired;
+        memmove(boot_irqs, boot_irqs + fired, boot_irq_count * sizeof(boot_irqs[0]));
+    }
+    in_boot_irq = false;
+}
+
+/**
+ * Move the clock to until_us, taking interrupts at their own times
+ * (stops at the first one if stop_on_event)
+ */
+static void sim_sleep_until(uint64_t until_us, bool stop_on_event) {
+    if (sim == &sim_main) {
+        while (boot_irq_count > 0 && boot_irqs[0].at_us <= until_us) {
+            if (boot_irqs[0].at_us > sim->clock_us) {
+                sim->clock_us = boot_irqs[0].at_us;
+            }
+            sim_fire_boot_irqs();
+            if (stop_on_event && event_signalled) {
+                return;
+            }
+        }
+    }
+    if (until_us > sim->clock_us) {
+        sim->clock_us = until_us;
+    }
+}
+
+/* System Functions */
+uint32_t platform_get_timestamp(void) {
+    sim_fire_boot_irqs();
+    return (uint32_t)(sim->clock_us / 1000);
+}
+
+void platform_wait_event(uint32_t timeout_ms) {
+    sim_stats.wakeups++;
+    sim_fire_boot_irqs();
+    if (!event_signalled) {
+        sim_sleep_until(sim->clock_us + (uint64_t)timeout_ms * 1000, true);
+    }
+    event_signalled = false;
+}
+
+void platform_signal_event(void) {
+    event_signalled = true;
+}
+
+void system_reboot(void) {
+    sim_stats.reboots++;
+}
+
+void src_enter_safe_mode(void) {
+    sim_stats.safe_mode_entries++;
+}
+
+bool platform_authenticate(void) {
+    return true;
+}
+
+void platform_debug_log(const char *message) {
+    if (sim_config.verbose && message) {
+        fprintf(stderr, "[%10.3f ms] %s\n", sim->clock_us / 1000.0, message);
+    }
+}
+
+void platform_init(void) {
+    if (!sim_ensure_started()) {
+        fprintf(stderr, "sim: platform start failed\n");
+    }
+}
+
+void platform_delay_ms(uint32_t ms) {
+    sim_sleep_until(sim->clock_us + (uint64_t)ms * 1000, false);
+}
+
+void platform_delay_us(uint32_t us) {
+    sim_sleep_until(sim->clock_us + us, false);
+}
+
+/* Legacy motherboard support: the simulated board is a plain SPI/UEFI board */
+bool platform_has_ec(void) {
+    return false;
+}
+
+bool platform_has_tpm(void) {
+    return false;
+}
+
+bool platform_has_uefi(void) {
+    return true;
+}
+
+bool platform_has_watchdog(void) {
+    return false;
+}
+
+bool platform_supports_large_sectors(void) {
+    return sim_config.erase_size >= 64 * 1024;
+}
+
+bool platform_supports_write_protect(void) {
+    return true;
+}
+
+bool platform_read_bios_signature(uint8_t *signature) {
+    (void)signature;
+    return false;
+}
+
+bool platform_init_post_code_monitoring(void) {
+    return false;
+}
+
+uint8_t platform_read_post_code(void) {
+    return 0;
+}
+
+bool platform_lpc_init(void) {
+    return false;
+}
+
+bool platform_lpc_read(uint32_t offset, uint8_t *buffer, size_t size) {
+    (void)offset;
+    (void)buffer;
+    (void)size;
+    return false;
+}
+
+bool platform_lpc_write(uint32_t offset, const uint8_t *buffer, size_t size) {
+    (void)offset;
+    (void)buffer;
+    (void)size;
+    return false;
+}
+
+bool platform_lpc_erase(uint32_t offset) {
+    (void)offset;
+    return false;
+}
+
+bool platform_legacy_spi_init(void) {
+    return false;
+}
+
+bool platform_read_jedec_id(uint8_t *id) {
+    (void)id;
+    return false;
+}
+
+uint32_t platform_get_size_from_jedec(const uint8_t *jedec_id) {
+    (void)jedec_id;
+    return 0;
+}
+
+uint32_t platform_detect_flash_size_legacy(void) {
+    return 0;
+}
+
+bool platform_usb_init_legacy(void) {
+    return platform_usb_init();
+}
+
+/* Advanced security: no secure boot or TPM on the simulated board */
+bool platform_secure_boot_enabled(void) {
+    return false;
+}
+
+uint8_t platform_get_secure_boot_mode(void) {
+    return 0;
+}
+
+bool platform_verify_secure_boot_chain(void) {
+    return true;
+}
+
+bool platform_get_secure_boot_policy(char *policy, size_t policy_size) {
+    if (!policy || policy_size == 0) {
+        return false;
+    }
+    snprintf(policy, policy_size, "sim");
+    return true;
+}
+
+bool platform_detect_hardware_tampering(void) {
+    return false;
+}
+
+bool platform_is_spi_locked(void) {
+    return spi_locked;
+}
+
+uint8_t platform_get_tpm_version(void) {
+    return 0;
+}
+
+bool platform_tpm_init(void) {
+    return false;
+}
+
+bool platform_tpm_has_nvram(void) {
+    return false;
+}
+
+bool platform_tpm_nvram_write(uint32_t index, const uint8_t *data, size_t size) {
+    (void)index;
+    (void)data;
+    (void)size;
+    return false;
+}
+
+bool platform_tpm_nvram_read(uint32_t index, uint8_t *data, size_t size) {
+    (void)index;
+    (void)data;
+    (void)size;
+    return false;
+}
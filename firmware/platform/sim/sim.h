@@ -0,0 +1,169 @@
+/**
+ * Host Simulation Platform
+ * SPI flash backed by an mmap'ed image file, USB backed by a host
+ * directory or a raw FAT32 image, and a virtual clock driven by a simple
+ * timing model, so the core can be run and timed deterministically on a
+ * Linux host.
+ *
+ * Only modelled costs advance the clock: SPI reads/programs/erases, USB
+ * transfers, SHA-256, signature verification and the CPU copies of
+ * transfers that bypass the DMA pool (platform_dma_alloc()): the
+ * controllers only reach pool buffers, so every SPI or USB transfer to or
+ * from other memory is bounced at copy_kbps. Everything else the core
+ * does is free.
+ *
+ * Boot signals are interrupts scheduled with sim_raise_boot_event(). They
+ * fire on the main thread once its clock reaches them: in the middle of a
+ * delay or platform_wait_event() at their own time, otherwise at the next
+ * platform_get_timestamp().
+ *
+ * Workers from platform_thread_create() get their own clock, starting at
+ * the creator's; joining one moves the joiner to whichever clock is later.
+ * Threads queueing USB reads split the bus bandwidth evenly.
+ *
+ * A USB image is read-only and served through fat32.c and usb_bot.c by a
+ * simulated bulk-only device: each command costs usb_latency_us, its data
+ * moves at usb_kbps, and the device runs one command at a time.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Defaults (typical quad SPI NOR + USB 2.0 stick + software SHA-256) */
+#define SIM_DEFAULT_FLASH_SIZE (16 * 1024 * 1024)
+#define SIM_DEFAULT_PAGE_SIZE 256
+#define SIM_DEFAULT_ERASE_SIZE 4096
+#define SIM_DEFAULT_SPI_READ_KBPS (40 * 1024)
+#define SIM_DEFAULT_PAGE_PROGRAM_US 700
+#define SIM_DEFAULT_SECTOR_ERASE_MS 45     // 4KB erase
+#define SIM_DEFAULT_BLOCK_ERASE_MS 150     // 64KB erase
+#define SIM_DEFAULT_USB_KBPS (30 * 1024)
+#define SIM_DEFAULT_USB_LATENCY_US 250     // Per transfer command
+#define SIM_DEFAULT_USB_MAX_TRANSFER 128   // Sectors per bulk transfer (64KB)
+#define SIM_DEFAULT_SHA_KBPS (16 * 1024)
+#define SIM_DEFAULT_VERIFY_MS 150          // ECDSA-P256 verify in software on a Cortex-M
+#define SIM_DEFAULT_COPY_KBPS (128 * 1024) // CPU memcpy through a bounce buffer
+
+#define SIM_USB_QUEUE_DEPTH 4              // Outstanding platform_usb_read_start()s per thread
+#define SIM_MAX_THREADS 4                  // Live platform_thread_create() workers
+#define SIM_MAX_BOOT_IRQS 32               // Pending sim_raise_boot_event() interrupts
+#define SIM_SIGNATURE_SIZE 64
+
+/* Simulation setup; throughputs are KB/s (1 KB = 1024 bytes), 0 = free */
+typedef struct {
+    const char *flash_path;      // Flash image file, created if missing (NULL = RAM only)
+    uint32_t flash_size;
+    const char *usb_dir;         // Host directory served as the USB stick (NULL = none)
+    const char *usb_image;       // Raw FAT32 image served instead of usb_dir (NULL = none)
+    uint32_t page_size;
+    uint32_t erase_size;         // 4KB sectors or 64KB blocks
+    uint32_t spi_read_kbps;
+    uint32_t page_program_us;
+    uint32_t sector_erase_ms;    // Used when erase_size < 64KB
+    uint32_t block_erase_ms;     // Used when erase_size >= 64KB
+    uint32_t usb_kbps;
+    uint32_t usb_latency_us;
+    uint32_t usb_max_transfer;   // Sectors per bulk data transfer (image)
+    uint32_t sha_kbps;
+    uint32_t verify_ms;          // Per platform_verify() call
+    uint32_t copy_kbps;          // Bounce copies of transfers outside the DMA pool
+    bool verbose;                // Echo src_log() output to stderr
+} sim_config_t;
+
+/* Counters since sim_start() / sim_reset_stats() */
+typedef struct {
+    uint64_t spi_bytes_read;
+    uint64_t spi_bytes_programmed;
+    uint64_t spi_bytes_erased;
+    uint32_t spi_programs;
+    uint32_t spi_erases;
+    uint64_t spi_busy_us;        // Time the chip spent programming/erasing
+    uint64_t usb_bytes_read;
+    uint64_t usb_bytes_written;
+    uint32_t usb_transfers;
+    uint64_t sha_bytes;
+    uint32_t verifies;           // platform_verify() calls
+    uint32_t reboots;            // system_reboot() calls
+    uint32_t safe_mode_entries;  // src_enter_safe_mode() calls
+    uint64_t dma_bytes;          // Controller transfers to/from DMA pool buffers
+    uint64_t copy_bytes;         // Controller transfers bounced by the CPU
+    uint32_t wakeups;            // platform_wait_event() calls (idle wake-ups)
+} sim_stats_t;
+
+/**
+ * Fill config with the defaults above
+ */
+void sim_config_defaults(sim_config_t *config);
+
+/**
+ * Defaults overridden by SRC_SIM_* environment variables:
+ * SRC_SIM_FLASH, SRC_SIM_FLASH_SIZE, SRC_SIM_USB_DIR, SRC_SIM_USB_IMAGE,
+ * SRC_SIM_PAGE_SIZE, SRC_SIM_ERASE_SIZE, SRC_SIM_SPI_READ_KBPS,
+ * SRC_SIM_PAGE_PROGRAM_US, SRC_SIM_SECTOR_ERASE_MS, SRC_SIM_BLOCK_ERASE_MS,
+ * SRC_SIM_USB_KBPS, SRC_SIM_USB_LATENCY_US, SRC_SIM_USB_MAX_TRANSFER,
+ * SRC_SIM_SHA_KBPS, SRC_SIM_VERIFY_MS, SRC_SIM_COPY_KBPS, SRC_SIM_VERBOSE
+ */
+void sim_config_from_env(sim_config_t *config);
+
+/**
+ * Map the flash image and reset clock and counters
+ * The config strings must stay valid until sim_stop().
+ * platform_init()/platform_spi_init() start from the environment if
+ * this has not been called.
+ */
+bool sim_start(const sim_config_t *config);
+
+/**
+ * Flush and unmap the flash image
+ */
+void sim_stop(void);
+
+/**
+ * Virtual clock
+ */
+uint64_t sim_now_us(void);
+void sim_advance_us(uint64_t us);
+
+/**
+ * Counters
+ */
+void sim_get_stats(sim_stats_t *stats);
+void sim_reset_stats(void);
+
+/**
+ * Schedule a boot signal interrupt at at_us on the virtual clock; its
+ * handler calls boot_detection_push(type, value). False if
+ * SIM_MAX_BOOT_IRQS are already pending.
+ */
+bool sim_raise_boot_event(uint64_t at_us, uint8_t type, uint8_t value);
+
+/**
+ * Plug/unplug the simulated USB stick
+ */
+void sim_set_usb_present(bool present);
+
+/**
+ * Once path (on the stick, e.g. "/SECURITY_RECOVERY/A.bin") has been read
+ * to its end, invert the byte at offset in every later queued read of it:
+ * a device that answers a second pass differently. usb_dir sticks only;
+ * NULL turns it off.
+ */
+void sim_set_usb_tamper(const char *path, uint32_t offset);
+
+/**
+ * Serve a raw FAT32 image as the USB stick (NULL = back to usb_dir)
+ * The path must stay valid until the next call or sim_stop().
+ */
+bool sim_set_usb_image(const char *path);
+
+/**
+ * Direct access to the flash image (test setup, corruption injection)
+ * Bypasses the timing model and counters.
+ */
+uint8_t *sim_flash_data(void);
+
+#endif /* SIM_H */
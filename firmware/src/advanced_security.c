@@ -8,7 +8,9 @@
 #include "advanced_security.h"
 #include "recovery_core.h"
 #include "crypto.h"
+#include "integrity.h"
 #include "platform.h"
+#include <stdio.h>
 #include <string.h>
 
 static tpm_info_t tpm_info_cache = {0};
@@ -159,9 +161,11 @@ bool security_detect_tampering(tamper_detection_t *detection) {
     
     memset(detection, 0, sizeof(tamper_detection_t));
     
+    /* Shared with the other integrity consumers for this flash epoch */
+    const integrity_snapshot_t *snapshot = integrity_get_snapshot();
+    
     /* Check config tampering */
-    src_config_t config;
-    if (!src_read_config(&config)) {
+    if (!snapshot->config_ok) {
         detection->tamper_detected = true;
         detection->tamper_type = 1;  // Config tampering
         strncpy(detection->tamper_details, "Config read failed or invalid",
@@ -170,25 +174,23 @@ bool security_detect_tampering(tamper_detection_t *detection) {
         return true;
     }
     
-    /* Check firmware integrity */
-    uint8_t current_hash[32];
-    uint8_t stored_hash[32];
-    memcpy(stored_hash, config.firmware_hash, 32);
-    
-    /* Read current firmware and calculate hash */
-    uint8_t firmware[8 * 1024 * 1024];
-    size_t firmware_size = sizeof(firmware);
-    if (src_read_firmware(firmware, firmware_size, 0)) {
-        platform_sha256(firmware, firmware_size, current_hash);
-        
-        if (memcmp(current_hash, stored_hash, 32) != 0) {
-            detection->tamper_detected = true;
-            detection->tamper_type = 2;  // Firmware tampering
+    /* Check firmware integrity (sector index when available) */
+    if (snapshot->firmware_ok && !snapshot->firmware_match) {
+        detection->tamper_detected = true;
+        detection->tamper_type = 2;  // Firmware tampering
+        if (snapshot->sectors.sectors_bad > 0) {
+            uint32_t offset;
+            size_t size;
+            integrity_get_sector_range(snapshot->sectors.first_bad_sector, &offset, &size);
+            snprintf(detection->tamper_details, sizeof(detection->tamper_details),
+                     "Firmware hash mismatch in %lu sector(s), first at 0x%08lx",
+                     (unsigned long)snapshot->sectors.sectors_bad, (unsigned long)offset);
+        } else {
             strncpy(detection->tamper_details, "Firmware hash mismatch",
                     sizeof(detection->tamper_details) - 1);
-            detection->tamper_timestamp = platform_get_timestamp();
-            return true;
         }
+        detection->tamper_timestamp = platform_get_timestamp();
+        return true;
     }
     
     /* Check hardware tampering (if supported) */
@@ -214,31 +216,21 @@ bool security_monitor_integrity(integrity_status_t *status) {
     
     memset(status, 0, sizeof(integrity_status_t));
     
-    /* Read current firmware */
-    uint8_t firmware[8 * 1024 * 1024];
-    size_t firmware_size = sizeof(firmware);
-    
-    if (!src_read_firmware(firmware, firmware_size, 0)) {
-        return false;
-    }
-    
-    /* Calculate current hash */
-    platform_sha256(firmware, firmware_size, status->firmware_hash);
-    
-    /* Read stored config */
-    src_config_t config;
-    if (!src_read_config(&config)) {
+    /* Config and firmware are checked once per flash epoch */
+    const integrity_snapshot_t *snapshot = integrity_get_snapshot();
+    if (!snapshot->config_ok || !snapshot->firmware_ok) {
         return false;
     }
     
-    /* Calculate config hash */
-    platform_sha256((uint8_t *)&config, sizeof(config), status->config_hash);
-    
-    /* Compare firmware hash */
-    status->hash_match = (memcmp(status->firmware_hash, config.firmware_hash, 32) == 0);
+    memcpy(status->config_hash, snapshot->config_hash, 32);
+    memcpy(status->firmware_hash, snapshot->firmware_hash, 32);
+    status->hash_match = snapshot->firmware_match;
+    status->sectors_checked = snapshot->sectors.sectors_checked;
+    status->sectors_bad = snapshot->sectors.sectors_bad;
+    status->first_bad_sector = snapshot->sectors.first_bad_sector;
     
     status->integrity_ok = status->hash_match;
-    status->last_check_timestamp = platform_get_timestamp();
+    status->last_check_timestamp = snapshot->timestamp;
     
     return true;
 }
@@ -40,9 +40,12 @@ typedef struct {
 typedef struct {
     bool integrity_ok;
     uint32_t last_check_timestamp;
-    uint8_t firmware_hash[32];
+    uint8_t firmware_hash[32];   // Full-image hash (zero when the sector index was used)
     uint8_t config_hash[32];
     bool hash_match;
+    uint32_t sectors_checked;    // Index sectors verified by this check
+    uint32_t sectors_bad;        // Index sectors that differ from the baseline
+    uint32_t first_bad_sector;   // Valid when sectors_bad > 0
 } integrity_status_t;
 
 /* Function prototypes */
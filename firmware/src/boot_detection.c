@@ -5,13 +5,29 @@
 #include "boot_detection.h"
 #include "platform.h"
 #include <string.h>
+#include <stdatomic.h>
+
+#if (BOOT_EVENT_QUEUE_SIZE & (BOOT_EVENT_QUEUE_SIZE - 1)) != 0
+#error "BOOT_EVENT_QUEUE_SIZE must be a power of two"
+#endif
 
 static boot_status_t boot_status = {0};
 
+/* Event ring: head is only written by the producer, tail and boot_status
+ * only by the consumer. Indices run freely and wrap modulo 2^32. */
+static boot_event_t queue[BOOT_EVENT_QUEUE_SIZE];
+static atomic_uint queue_head;
+static atomic_uint queue_tail;
+static atomic_uint queue_dropped;
+
 void boot_detection_init(void) {
     memset(&boot_status, 0, sizeof(boot_status));
     boot_status.timestamp = platform_get_timestamp();
-    
+
+    /* Sources are not enabled yet: only this side touches the ring */
+    atomic_store_explicit(&queue_tail, atomic_load_explicit(&queue_head, memory_order_acquire),
+                          memory_order_release);
+
     /* Initialize platform-specific boot detection */
     platform_boot_detection_init();
 }
@@ -22,22 +38,79 @@ void boot_detection_get_status(boot_status_t *status) {
     }
 }
 
+bool boot_detection_push(boot_event_type_t type, uint8_t value) {
+    unsigned int head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+
+    if (head - tail >= BOOT_EVENT_QUEUE_SIZE) {
+        /* Single producer: a plain read-modify-write is enough */
+        atomic_store_explicit(&queue_dropped,
+                              atomic_load_explicit(&queue_dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        platform_signal_event();
+        return false;
+    }
+
+    boot_event_t *event = &queue[head % BOOT_EVENT_QUEUE_SIZE];
+    event->type = (uint8_t)type;
+    event->value = value;
+    event->timestamp = platform_get_timestamp();
+
+    /* Publish the slot before the consumer can see it */
+    atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+    platform_signal_event();
+    return true;
+}
+
+bool boot_detection_next_event(boot_event_t *event) {
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&queue_head, memory_order_acquire);
+    if (!event || tail == head) {
+        return false;
+    }
+
+    *event = queue[tail % BOOT_EVENT_QUEUE_SIZE];
+    atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+
+    switch (event->type) {
+        case BOOT_EVENT_GPIO:
+            boot_status.gpio_signal_received = event->value != 0;
+            break;
+        case BOOT_EVENT_WATCHDOG_CLEARED:
+            boot_status.watchdog_cleared = event->value != 0;
+            break;
+        case BOOT_EVENT_POST_CODE:
+            boot_status.post_code = event->value;
+            break;
+        case BOOT_EVENT_FIRMWARE_FLAG:
+            boot_status.firmware_flag_set = event->value != 0;
+            break;
+    }
+    boot_status.timestamp = event->timestamp;
+    return true;
+}
+
+bool boot_detection_pending(void) {
+    return atomic_load_explicit(&queue_head, memory_order_acquire) !=
+           atomic_load_explicit(&queue_tail, memory_order_relaxed);
+}
+
+uint32_t boot_detection_dropped(void) {
+    return atomic_load_explicit(&queue_dropped, memory_order_relaxed);
+}
+
 void boot_detection_set_gpio_signal(bool received) {
-    boot_status.gpio_signal_received = received;
-    boot_status.timestamp = platform_get_timestamp();
+    boot_detection_push(BOOT_EVENT_GPIO, received);
 }
 
 void boot_detection_set_watchdog_cleared(bool cleared) {
-    boot_status.watchdog_cleared = cleared;
-    boot_status.timestamp = platform_get_timestamp();
+    boot_detection_push(BOOT_EVENT_WATCHDOG_CLEARED, cleared);
 }
 
 void boot_detection_set_post_code(uint8_t code) {
-    boot_status.post_code = code;
-    boot_status.timestamp = platform_get_timestamp();
+    boot_detection_push(BOOT_EVENT_POST_CODE, code);
 }
 
 void boot_detection_set_firmware_flag(bool set) {
-    boot_status.firmware_flag_set = set;
-    boot_status.timestamp = platform_get_timestamp();
+    boot_detection_push(BOOT_EVENT_FIRMWARE_FLAG, set);
 }
@@ -1,6 +1,17 @@
 /**
  * Boot Detection System
  * Multiple redundant methods to detect successful boot
+ *
+ * Boot signals arrive as timestamped events in a lock-free single-producer,
+ * single-consumer ring: interrupt handlers (GPIO edge, watchdog clear, POST
+ * port write, firmware flag write) push with boot_detection_push(), and the
+ * main loop takes them in order with boot_detection_next_event(). Every
+ * transition is seen, even a POST code that is replaced within
+ * microseconds, and nothing is torn. A push also wakes the main loop from
+ * platform_wait_event().
+ *
+ * All sources must push from one interrupt priority level (or with the
+ * others masked): the ring has a single producer.
  */
 
 #ifndef BOOT_DETECTION_H
@@ -10,12 +21,47 @@
 #include <stdbool.h>
 #include "recovery_core.h"
 
-/* Initialize boot detection system */
+#ifndef BOOT_EVENT_QUEUE_SIZE
+#define BOOT_EVENT_QUEUE_SIZE 32        // Events buffered (power of two)
+#endif
+
+typedef enum {
+    BOOT_EVENT_GPIO,                    // value: signal level
+    BOOT_EVENT_WATCHDOG_CLEARED,        // value: cleared
+    BOOT_EVENT_POST_CODE,               // value: code written
+    BOOT_EVENT_FIRMWARE_FLAG            // value: flag set
+} boot_event_type_t;
+
+typedef struct {
+    uint8_t type;                       // boot_event_type_t
+    uint8_t value;
+    uint32_t timestamp;                 // platform_get_timestamp() at the push
+} boot_event_t;
+
+/* Initialize boot detection system (drops queued events) */
 void boot_detection_init(void);
 
-/* Get current boot status */
+/* Get current boot status (events taken so far) */
 void boot_detection_get_status(boot_status_t *status);
 
+/**
+ * Queue an event; interrupt safe, never blocks
+ * False if the ring was full and the event was dropped
+ */
+bool boot_detection_push(boot_event_type_t type, uint8_t value);
+
+/**
+ * Take the oldest event and apply it to the boot status (main loop only)
+ * False if none is queued
+ */
+bool boot_detection_next_event(boot_event_t *event);
+
+/* True if events are queued */
+bool boot_detection_pending(void);
+
+/* Events dropped because the ring was full */
+uint32_t boot_detection_dropped(void);
+
 /* Update GPIO signal status */
 void boot_detection_set_gpio_signal(bool received);
 
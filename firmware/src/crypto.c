@@ -61,6 +61,164 @@ int crypto_sha256(const uint8_t *data, size_t size, uint8_t *hash) {
     return CRYPTO_SUCCESS;
 }
 
+int crypto_sha256_init(crypto_sha256_ctx_t *ctx) {
+    if (!ctx) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (!crypto_initialized) {
+        return CRYPTO_ERROR_NOT_INITIALIZED;
+    }
+    
+    platform_sha256_init(&ctx->platform);
+    ctx->length = 0;
+    ctx->active = true;
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_update(crypto_sha256_ctx_t *ctx, const uint8_t *data, size_t size) {
+    /* SECURITY: Validate all parameters */
+    if (!ctx || !ctx->active || !data) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (size > SIZE_MAX / 2) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (size > 0) {
+        platform_sha256_update(&ctx->platform, data, size);
+        ctx->length += size;
+    }
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_final(crypto_sha256_ctx_t *ctx, uint8_t *hash) {
+    if (!ctx || !ctx->active || !hash) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    /* Reject empty input, as crypto_sha256() does */
+    bool empty = (ctx->length == 0);
+    
+    platform_sha256_final(&ctx->platform, hash);
+    ctx->active = false;
+    
+    if (empty) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    /* SECURITY: Same silent-failure check as crypto_sha256() */
+    bool all_zeros = true;
+    for (int i = 0; i < CRYPTO_SHA256_HASH_SIZE; i++) {
+        if (hash[i] != 0) {
+            all_zeros = false;
+            break;
+        }
+    }
+    
+    if (all_zeros) {
+        return CRYPTO_ERROR_PLATFORM_FAILED;
+    }
+    
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_batch_init(crypto_sha256_batch_ctx_t *ctx, size_t count) {
+    if (!ctx || count == 0 || count > CRYPTO_SHA256_BATCH_MAX) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (!crypto_initialized) {
+        return CRYPTO_ERROR_NOT_INITIALIZED;
+    }
+    
+    platform_sha256_batch_init(&ctx->platform, count);
+    ctx->length = 0;
+    ctx->count = count;
+    ctx->active = true;
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_batch_update(crypto_sha256_batch_ctx_t *ctx,
+                               const uint8_t *const data[], size_t size) {
+    /* SECURITY: Validate all parameters */
+    if (!ctx || !ctx->active || !data) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (size > SIZE_MAX / 2) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    for (size_t i = 0; i < ctx->count; i++) {
+        if (!data[i]) {
+            return CRYPTO_ERROR_INVALID_PARAM;
+        }
+    }
+    
+    if (size > 0) {
+        platform_sha256_batch_update(&ctx->platform, data, size);
+        ctx->length += size;
+    }
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_batch_final(crypto_sha256_batch_ctx_t *ctx,
+                              uint8_t hashes[][CRYPTO_SHA256_HASH_SIZE]) {
+    if (!ctx || !ctx->active || !hashes) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    /* Reject empty input, as crypto_sha256() does */
+    bool empty = (ctx->length == 0);
+    size_t count = ctx->count;
+    
+    platform_sha256_batch_final(&ctx->platform, hashes);
+    ctx->active = false;
+    
+    if (empty) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    /* SECURITY: Same silent-failure check as crypto_sha256(), per message */
+    for (size_t i = 0; i < count; i++) {
+        bool all_zeros = true;
+        for (int j = 0; j < CRYPTO_SHA256_HASH_SIZE; j++) {
+            if (hashes[i][j] != 0) {
+                all_zeros = false;
+                break;
+            }
+        }
+        if (all_zeros) {
+            return CRYPTO_ERROR_PLATFORM_FAILED;
+        }
+    }
+    
+    return CRYPTO_SUCCESS;
+}
+
+int crypto_sha256_batch(const uint8_t *const data[], size_t count, size_t size,
+                        uint8_t hashes[][CRYPTO_SHA256_HASH_SIZE]) {
+    if (size == 0) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    crypto_sha256_batch_ctx_t ctx;
+    int result = crypto_sha256_batch_init(&ctx, count);
+    if (result != CRYPTO_SUCCESS) {
+        return result;
+    }
+    
+    result = crypto_sha256_batch_update(&ctx, data, size);
+    if (result != CRYPTO_SUCCESS) {
+        platform_sha256_batch_final(&ctx.platform, hashes);
+        return result;
+    }
+    
+    return crypto_sha256_batch_final(&ctx, hashes);
+}
+
 int crypto_sign(const uint8_t *data, size_t size, 
                 uint8_t *signature, size_t *sig_size) {
     /* SECURITY: Validate all parameters */
@@ -88,6 +246,25 @@ int crypto_sign(const uint8_t *data, size_t size,
         return hash_result;
     }
     
+    return crypto_sign_hash(hash, signature, sig_size);
+}
+
+int crypto_sign_hash(const uint8_t *hash,
+                     uint8_t *signature, size_t *sig_size) {
+    /* SECURITY: Validate all parameters */
+    if (!hash || !signature || !sig_size) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (!crypto_initialized) {
+        return CRYPTO_ERROR_NOT_INITIALIZED;
+    }
+    
+    /* SECURITY: Enforce buffer size limits */
+    if (*sig_size < CRYPTO_MAX_SIGNATURE_SIZE) {
+        return CRYPTO_ERROR_BUFFER_TOO_SMALL;
+    }
+    
     /* Platform-specific signing */
     size_t actual_sig_size = *sig_size;
     bool sign_success = platform_sign(hash, CRYPTO_SHA256_HASH_SIZE, 
@@ -137,6 +314,26 @@ int crypto_verify(const uint8_t *data, size_t size,
         return hash_result;
     }
     
+    return crypto_verify_hash(hash, signature, sig_size);
+}
+
+int crypto_verify_hash(const uint8_t *hash,
+                       const uint8_t *signature, size_t sig_size) {
+    /* SECURITY: Validate all parameters */
+    if (!hash || !signature) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    /* SECURITY: Enforce signature size limits */
+    if (sig_size < CRYPTO_MIN_SIGNATURE_SIZE || 
+        sig_size > CRYPTO_MAX_SIGNATURE_SIZE) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (!crypto_initialized) {
+        return CRYPTO_ERROR_NOT_INITIALIZED;
+    }
+    
     /* Platform-specific verification */
     bool verify_success = platform_verify(hash, CRYPTO_SHA256_HASH_SIZE, 
                                          signature, sig_size);
@@ -147,3 +344,46 @@ int crypto_verify(const uint8_t *data, size_t size,
     
     return CRYPTO_SUCCESS;
 }
+
+int crypto_hmac_sha256(const uint8_t *key, size_t key_size,
+                       const uint8_t *data, size_t size, uint8_t *mac) {
+    /* SECURITY: Validate all parameters */
+    if (!key || !data || !mac || key_size == 0 || key_size > 64 || size == 0) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    uint8_t pad[64];
+    uint8_t inner[CRYPTO_SHA256_HASH_SIZE];
+    crypto_sha256_ctx_t ctx;
+    
+    /* Inner hash: H((key ^ ipad) || data) */
+    memset(pad, 0x36, sizeof(pad));
+    for (size_t i = 0; i < key_size; i++) {
+        pad[i] ^= key[i];
+    }
+    int result = crypto_sha256_init(&ctx);
+    if (result == CRYPTO_SUCCESS) {
+        crypto_sha256_update(&ctx, pad, sizeof(pad));
+        crypto_sha256_update(&ctx, data, size);
+        result = crypto_sha256_final(&ctx, inner);
+    }
+    
+    /* Outer hash: H((key ^ opad) || inner) */
+    memset(pad, 0x5C, sizeof(pad));
+    for (size_t i = 0; i < key_size; i++) {
+        pad[i] ^= key[i];
+    }
+    if (result == CRYPTO_SUCCESS) {
+        result = crypto_sha256_init(&ctx);
+    }
+    if (result == CRYPTO_SUCCESS) {
+        crypto_sha256_update(&ctx, pad, sizeof(pad));
+        crypto_sha256_update(&ctx, inner, sizeof(inner));
+        result = crypto_sha256_final(&ctx, mac);
+    }
+    
+    /* SECURITY: Do not leave key material on the stack */
+    memset(pad, 0, sizeof(pad));
+    memset(inner, 0, sizeof(inner));
+    return result;
+}
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "platform.h"
 
 /* Maximum signature sizes */
 #define CRYPTO_MAX_SIGNATURE_SIZE 512  /* Maximum signature size (RSA-2048 or ECDSA) */
@@ -29,6 +30,69 @@
  */
 int crypto_sha256(const uint8_t *data, size_t size, uint8_t *hash);
 
+/* Incremental SHA-256 context
+ * Lets callers hash data as it streams in (USB chunks, flash sectors)
+ * instead of buffering an entire image first.
+ */
+typedef struct {
+    platform_sha256_ctx_t platform;
+    uint64_t length;
+    bool active;
+} crypto_sha256_ctx_t;
+
+/* Start a new incremental hash
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_sha256_init(crypto_sha256_ctx_t *ctx);
+
+/* Feed the next chunk of data into an incremental hash
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_sha256_update(crypto_sha256_ctx_t *ctx, const uint8_t *data, size_t size);
+
+/* Finish an incremental hash; the context must be re-initialized before reuse
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ * hash must be at least CRYPTO_SHA256_HASH_SIZE bytes
+ */
+int crypto_sha256_final(crypto_sha256_ctx_t *ctx, uint8_t *hash);
+
+/* Multi-buffer SHA-256
+ * Hashes up to CRYPTO_SHA256_BATCH_MAX independent messages of the same
+ * length together (one per SIMD lane where the platform has them), e.g.
+ * the per-sector leaves of the integrity index.
+ */
+#define CRYPTO_SHA256_BATCH_MAX PLATFORM_SHA256_BATCH_MAX
+
+typedef struct {
+    platform_sha256_batch_ctx_t platform;
+    uint64_t length;        /* Bytes per message */
+    size_t count;
+    bool active;
+} crypto_sha256_batch_ctx_t;
+
+/* Start hashing `count` messages (1..CRYPTO_SHA256_BATCH_MAX)
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_sha256_batch_init(crypto_sha256_batch_ctx_t *ctx, size_t count);
+
+/* Feed the next `size` bytes of every message; data[i] belongs to message i
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_sha256_batch_update(crypto_sha256_batch_ctx_t *ctx,
+                               const uint8_t *const data[], size_t size);
+
+/* Finish the batch; hashes[i] receives the hash of message i
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_sha256_batch_final(crypto_sha256_batch_ctx_t *ctx,
+                              uint8_t hashes[][CRYPTO_SHA256_HASH_SIZE]);
+
+/* One-shot batch: `count` messages of `size` bytes each
+ * Returns: same codes as crypto_sha256()
+ */
+int crypto_sha256_batch(const uint8_t *const data[], size_t count, size_t size,
+                        uint8_t hashes[][CRYPTO_SHA256_HASH_SIZE]);
+
 /* Sign data (returns signature)
  * Returns: CRYPTO_SUCCESS on success, error code on failure
  * sig_size must point to buffer size, will be updated with actual signature size
@@ -37,6 +101,13 @@ int crypto_sha256(const uint8_t *data, size_t size, uint8_t *hash);
 int crypto_sign(const uint8_t *data, size_t size, 
                 uint8_t *signature, size_t *sig_size);
 
+/* Sign an already computed SHA-256 digest
+ * Used by streaming paths that hash data chunk by chunk
+ * Returns: same codes as crypto_sign()
+ */
+int crypto_sign_hash(const uint8_t *hash,
+                     uint8_t *signature, size_t *sig_size);
+
 /* Verify signature
  * Returns: CRYPTO_SUCCESS if valid, CRYPTO_ERROR_SIGNATURE_INVALID if invalid, other error codes on failure
  * sig_size must be between CRYPTO_MIN_SIGNATURE_SIZE and CRYPTO_MAX_SIGNATURE_SIZE
@@ -44,6 +115,20 @@ int crypto_sign(const uint8_t *data, size_t size,
 int crypto_verify(const uint8_t *data, size_t size, 
                   const uint8_t *signature, size_t sig_size);
 
+/* Verify signature over an already computed SHA-256 digest
+ * Used by streaming paths that hash data chunk by chunk
+ * Returns: same codes as crypto_verify()
+ */
+int crypto_verify_hash(const uint8_t *hash,
+                       const uint8_t *signature, size_t sig_size);
+
+/* HMAC-SHA256 (RFC 2104), key of at most 64 bytes
+ * Returns: CRYPTO_SUCCESS on success, error code on failure
+ * mac must be at least CRYPTO_SHA256_HASH_SIZE bytes
+ */
+int crypto_hmac_sha256(const uint8_t *key, size_t key_size,
+                       const uint8_t *data, size_t size, uint8_t *mac);
+
 /* Initialize crypto system (load keys, etc.) */
 bool crypto_init(void);
 
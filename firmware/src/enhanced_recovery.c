@@ -10,18 +10,42 @@
 #include "crypto.h"
 #include "spi_flash.h"
 #include "recovery_core.h"
+#include "integrity.h"
+#include "verify_cache.h"
 #include "platform.h"
+#include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
+
+/**
+ * Directory entry of name in a device's recovery directory (cached)
+ */
+static bool enhanced_stat(const usb_device_info_t *device, const char *name,
+                          platform_usb_dirent_t *entry) {
+    char path[128];
+    platform_usb_dirent_t local;
+    if (!entry) {
+        entry = &local;
+    }
+    snprintf(path, sizeof(path), "%s/%s", device->path, name);
+    return src_usb_stat(path, entry) && !entry->is_dir;
+}
 
 /**
  * Scan for multiple USB devices with recovery structure
+ * One pass over the candidate paths; each costs a single directory read,
+ * and repeat scans within SRC_USB_DIR_CACHE_TTL_MS cost none.
  */
 uint32_t enhanced_scan_usb_devices(usb_device_info_t *devices, uint32_t max_devices) {
     if (!devices || max_devices == 0) {
         return 0;
     }
     
+    /* Every candidate path is on the one USB mass storage device */
+    if (!platform_usb_is_present()) {
+        src_usb_cache_invalidate();
+        return 0;
+    }
+    
     uint32_t found_count = 0;
     
     /* Check multiple potential USB paths */
@@ -37,50 +61,30 @@ uint32_t enhanced_scan_usb_devices(usb_device_info_t *devices, uint32_t max_devi
         memset(device, 0, sizeof(usb_device_info_t));
         
         strncpy(device->path, usb_paths[i], sizeof(device->path) - 1);
+        device->present = true;
         
-        /* Check if USB device is present */
-        device->present = platform_usb_is_present();
-        
-        if (!device->present) {
-            continue;
-        }
-        
-        /* Check for recovery structure */
-        char manifest_path[128];
-        char backup_a_path[128];
-        char backup_b_path[128];
-        char signature_path[128];
-        
-        snprintf(manifest_path, sizeof(manifest_path), "%s/%s", device->path, MANIFEST_FILE);
-        snprintf(backup_a_path, sizeof(backup_a_path), "%s/%s", device->path, BACKUP_A_FILE);
-        snprintf(backup_b_path, sizeof(backup_b_path), "%s/%s", device->path, BACKUP_B_FILE);
-        snprintf(signature_path, sizeof(signature_path), "%s/%s", device->path, SIGNATURE_FILE);
-        
-        device->has_manifest = platform_usb_file_exists(manifest_path);
-        device->has_backup_a = platform_usb_file_exists(backup_a_path);
-        device->has_backup_b = platform_usb_file_exists(backup_b_path);
-        device->has_signature = platform_usb_file_exists(signature_path);
+        /* Check for recovery structure (signed manifest, or manifest.json +
+         * signature.sig on older sticks) */
+        platform_usb_dirent_t backup_a;
+        platform_usb_dirent_t backup_b;
+        device->has_manifest = enhanced_stat(device, SIGNED_MANIFEST_FILE, NULL) ||
+                               enhanced_stat(device, MANIFEST_FILE, NULL);
+        device->has_backup_a = enhanced_stat(device, BACKUP_A_FILE, &backup_a);
+        device->has_backup_b = enhanced_stat(device, BACKUP_B_FILE, &backup_b);
+        device->has_signature = enhanced_stat(device, MANIFEST_SIGNATURE_FILE, NULL) ||
+                                enhanced_stat(device, SIGNATURE_FILE, NULL);
         
         device->valid_structure = device->has_manifest && 
                                   (device->has_backup_a || device->has_backup_b) &&
                                   device->has_signature;
         
         if (device->valid_structure) {
-            /* Get file sizes */
+            /* File sizes come with the directory entries */
             if (device->has_backup_a) {
-                uint8_t dummy[1];
-                size_t size = 1;
-                if (platform_usb_read_file(backup_a_path, dummy, &size)) {
-                    device->backup_a_size = size;
-                }
+                device->backup_a_size = backup_a.size;
             }
-            
             if (device->has_backup_b) {
-                uint8_t dummy[1];
-                size_t size = 1;
-                if (platform_usb_read_file(backup_b_path, dummy, &size)) {
-                    device->backup_b_size = size;
-                }
+                device->backup_b_size = backup_b.size;
             }
             
             /* Set priority based on backup availability */
@@ -170,67 +174,69 @@ bool enhanced_recover_with_verification(const usb_device_info_t *device,
     char backup_path[128];
     snprintf(backup_path, sizeof(backup_path), "%s/%s", device->path, backup_file);
     
-    uint8_t *firmware_buffer = malloc(8 * 1024 * 1024);  // 8MB max
-    if (!firmware_buffer) {
-        strncpy(verification->error_message, "Memory allocation failed",
-                sizeof(verification->error_message) - 1);
-        return false;
-    }
-    
-    size_t firmware_size = 8 * 1024 * 1024;
-    if (!platform_usb_read_file(backup_path, firmware_buffer, &firmware_size)) {
-        free(firmware_buffer);
+    /* Stream and hash the firmware backup */
+    size_t firmware_size = 0;
+    if (!src_hash_usb_image(backup_path, verification->firmware_hash, &firmware_size)) {
         strncpy(verification->error_message, "Failed to read firmware",
                 sizeof(verification->error_message) - 1);
         return false;
     }
     
-    /* Calculate firmware hash */
-    platform_sha256(firmware_buffer, firmware_size, verification->firmware_hash);
-    
-    /* Read and verify signature */
-    char signature_path[128];
-    snprintf(signature_path, sizeof(signature_path), "%s/%s", device->path, SIGNATURE_FILE);
-    
-    uint8_t signature[512];
-    size_t sig_size = sizeof(signature);
-    if (!platform_usb_read_file(signature_path, signature, &sig_size)) {
-        free(firmware_buffer);
-        strncpy(verification->error_message, "Failed to read signature",
-                sizeof(verification->error_message) - 1);
-        return false;
-    }
-    
-    /* SECURITY: Strict signature verification using crypto module */
-    int verify_result = crypto_verify(firmware_buffer, firmware_size,
-                                     signature, sig_size);
-    
-    if (verify_result != CRYPTO_SUCCESS) {
-        free(firmware_buffer);
-        if (verify_result == CRYPTO_ERROR_SIGNATURE_INVALID) {
-            strncpy(verification->error_message, "Signature verification failed - invalid signature",
+    /* SECURITY: The signed manifest vouches for every image it lists; the
+     * one next to the image, not another directory's */
+    static src_manifest_t manifest;
+    if (src_read_manifest(device->path, &manifest)) {
+        const src_manifest_entry_t *entry = src_manifest_find(&manifest, backup_file);
+        verification->signature_valid =
+            entry != NULL && entry->kind == SRC_MANIFEST_FULL &&
+            entry->size == firmware_size &&
+            memcmp(entry->hash, verification->firmware_hash, sizeof(entry->hash)) == 0;
+        if (!verification->signature_valid) {
+            strncpy(verification->error_message, "Backup does not match the signed manifest",
                     sizeof(verification->error_message) - 1);
-        } else {
-            strncpy(verification->error_message, "Signature verification failed - cryptographic error",
+            return false;
+        }
+    } else {
+        /* Read and verify the legacy signature of A.bin */
+        char signature_path[128];
+        snprintf(signature_path, sizeof(signature_path), "%s/%s", device->path, SIGNATURE_FILE);
+        
+        uint8_t signature[512];
+        size_t sig_size = sizeof(signature);
+        if (!platform_usb_read_file(signature_path, signature, &sig_size)) {
+            strncpy(verification->error_message, "Failed to read signature",
                     sizeof(verification->error_message) - 1);
+            return false;
         }
-        verification->signature_valid = false;
-        return false;
+        
+        /* SECURITY: Strict signature verification using crypto module */
+        int verify_result = verify_cache_verify_hash(verification->firmware_hash,
+                                                     signature, sig_size);
+        
+        if (verify_result != CRYPTO_SUCCESS) {
+            if (verify_result == CRYPTO_ERROR_SIGNATURE_INVALID) {
+                strncpy(verification->error_message, "Signature verification failed - invalid signature",
+                        sizeof(verification->error_message) - 1);
+            } else {
+                strncpy(verification->error_message, "Signature verification failed - cryptographic error",
+                        sizeof(verification->error_message) - 1);
+            }
+            verification->signature_valid = false;
+            return false;
+        }
+        
+        verification->signature_valid = true;
     }
     
-    verification->signature_valid = true;
-    
     /* Verify firmware structure */
     verification->firmware_valid = (firmware_size > 0 && firmware_size <= 8 * 1024 * 1024);
     
     if (!verification->firmware_valid) {
-        free(firmware_buffer);
         strncpy(verification->error_message, "Invalid firmware size",
                 sizeof(verification->error_message) - 1);
         return false;
     }
     
-    free(firmware_buffer);
     verification->success = true;
     return true;
 }
@@ -332,30 +338,14 @@ bool enhanced_health_check(health_status_t *status) {
  * Monitor firmware integrity continuously
  */
 bool enhanced_monitor_integrity(void) {
-    src_config_t config;
-    if (!src_read_config(&config)) {
-        return false;
-    }
-    
-    /* Read current firmware */
-    uint8_t current_firmware[8 * 1024 * 1024];
-    size_t firmware_size = sizeof(current_firmware);
-    
-    if (!src_read_firmware(current_firmware, firmware_size, 0)) {
+    /* Shared snapshot: re-checked only after flash changes */
+    const integrity_snapshot_t *snapshot = integrity_get_snapshot();
+    if (!snapshot->config_ok || !snapshot->firmware_ok) {
         return false;
     }
     
-    /* Calculate hash */
-    uint8_t current_hash[32];
-    platform_sha256(current_firmware, firmware_size, current_hash);
-    
-    /* Compare with stored hash */
-    if (memcmp(current_hash, config.firmware_hash, 32) != 0) {
-        /* Integrity violation detected */
-        return false;
-    }
-    
-    return true;
+    /* Integrity violation detected if firmware differs from baseline */
+    return snapshot->firmware_match;
 }
 
 /**
@@ -419,14 +409,47 @@ bool enhanced_verify_backup(const char *backup_path, bool *is_valid) {
     *is_valid = false;
     
     /* Check if file exists */
-    if (!platform_usb_file_exists(backup_path)) {
+    platform_usb_dirent_t entry;
+    if (!src_usb_stat(backup_path, &entry) || entry.is_dir) {
         return false;
     }
     
-    /* Read and verify signature */
-    /* Implementation would verify cryptographic signature */
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    size_t size = 0;
+    if (!src_hash_usb_image(backup_path, hash, &size)) {
+        return false;
+    }
+    
+    /* SECURITY: Valid only if the signed manifest in the image's own
+     * directory lists exactly this image */
+    const char *slash = strrchr(backup_path, '/');
+    if (!slash) {
+        return true;    /* No directory, so no manifest can vouch for it */
+    }
+    const char *name = slash + 1;
+    char dir[128];
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - backup_path), backup_path);
+    static src_manifest_t manifest;
+    if (src_read_manifest(dir, &manifest)) {
+        const src_manifest_entry_t *entry = src_manifest_find(&manifest, name);
+        *is_valid = entry != NULL && entry->kind == SRC_MANIFEST_FULL &&
+                    entry->size == size &&
+                    memcmp(entry->hash, hash, sizeof(hash)) == 0;
+        return true;
+    }
+    
+    /* Older sticks: signature.sig signs A.bin */
+    char signature_path[128];
+    snprintf(signature_path, sizeof(signature_path), "%.*s%s",
+             (int)(name - backup_path), backup_path, SIGNATURE_FILE);
+    uint8_t signature[512];
+    size_t sig_size = sizeof(signature);
+    if (strcmp(name, BACKUP_A_FILE) != 0 ||
+        !platform_usb_read_file(signature_path, signature, &sig_size)) {
+        return true;
+    }
     
-    *is_valid = true;
+    *is_valid = verify_cache_verify_hash(hash, signature, sig_size) == CRYPTO_SUCCESS;
     return true;
 }
 
@@ -0,0 +1,619 @@
+/**
+ * FAT32 Driver Implementation
+ */
+
+#include "fat32.h"
+#include <string.h>
+
+#define FAT32_DIRENT_SIZE 32
+#define FAT32_ATTR_VOLUME_ID 0x08
+#define FAT32_ATTR_DIRECTORY 0x10
+#define FAT32_ATTR_LFN 0x0F
+#define FAT32_LFN_LAST 0x40
+#define FAT32_LFN_CHARS 13
+#define FAT32_LFN_MAX (5 * FAT32_LFN_CHARS)    // Longer names are only matched by 8.3
+#define FAT32_NT_LOWER_BASE 0x08                // 8.3 base name stored lower case
+#define FAT32_NT_LOWER_EXT 0x10                 // 8.3 extension stored lower case
+#define FAT32_CLUSTER_MASK 0x0FFFFFFF
+#define FAT32_CLUSTER_EOC 0x0FFFFFF8
+#define FAT32_DIR_MAX_BYTES (65536 * FAT32_DIRENT_SIZE)  // Spec limit, bounds corrupt chains
+
+/* Mounted volume */
+static struct {
+    bool mounted;
+    uint32_t fat_lba;             // First sector of the first FAT
+    uint32_t data_lba;            // First sector of cluster 2
+    uint32_t sectors_per_cluster;
+    uint32_t cluster_count;
+    uint32_t root_cluster;
+    uint32_t max_transfer;        // Sectors per platform_usb_read_blocks()
+} fat32;
+
+/* FAT sector cache, least recently used replaced first */
+typedef struct {
+    bool valid;
+    uint32_t lba;
+    uint32_t used;
+    uint8_t data[FAT32_SECTOR_SIZE];
+} fat32_fat_sector_t;
+
+static fat32_fat_sector_t fat32_fat_cache[FAT32_FAT_CACHE_SECTORS];
+static uint32_t fat32_fat_clock = 0;
+
+/* Partial sectors at the ends of a read, and directory sectors */
+static uint8_t fat32_sector[FAT32_SECTOR_SIZE];
+
+/* Directory walk: one entry at a time, long names collected on the way */
+typedef struct {
+    fat32_file_t dir;
+    uint32_t offset;
+    char lfn[FAT32_LFN_MAX + 1];
+    uint8_t lfn_next;             // Sequence number of the next LFN entry (0 = none pending)
+    uint8_t lfn_checksum;
+    bool lfn_ok;
+} fat32_dir_iter_t;
+
+/* One entry found by fat32_dir_next() */
+typedef struct {
+    char name[FAT32_LFN_MAX + 1]; // Long name, or the 8.3 name if it has none
+    char short_name[13];
+    uint32_t cluster;
+    uint32_t size;
+    bool is_dir;
+} fat32_entry_t;
+
+static uint16_t fat32_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t fat32_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static char fat32_upper(char c) {
+    return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+static char fat32_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/**
+ * Case-insensitive match of a path component against a name
+ */
+static bool fat32_name_equal(const char *component, size_t len, const char *name) {
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] == '\0' || fat32_upper(component[i]) != fat32_upper(name[i])) {
+            return false;
+        }
+    }
+    return name[len] == '\0';
+}
+
+/**
+ * Read a volume's boot sector; true if it is FAT32 with 512-byte sectors
+ */
+static bool fat32_read_bpb(uint32_t lba, uint32_t block_count) {
+    if (!platform_usb_read_blocks(lba, fat32_sector, 1) ||
+        fat32_sector[510] != 0x55 || fat32_sector[511] != 0xAA) {
+        return false;
+    }
+
+    uint32_t bytes_per_sector = fat32_u16(&fat32_sector[11]);
+    uint32_t sectors_per_cluster = fat32_sector[13];
+    uint32_t reserved = fat32_u16(&fat32_sector[14]);
+    uint32_t fat_count = fat32_sector[16];
+    uint32_t root_entries = fat32_u16(&fat32_sector[17]);
+    uint32_t total = fat32_u16(&fat32_sector[19]);
+    uint32_t fat16_size = fat32_u16(&fat32_sector[22]);
+    uint32_t fat_size = fat32_u32(&fat32_sector[36]);
+    if (total == 0) {
+        total = fat32_u32(&fat32_sector[32]);
+    }
+
+    /* FAT32: no fixed root directory, FAT size in the extended BPB */
+    if (bytes_per_sector != FAT32_SECTOR_SIZE || sectors_per_cluster == 0 ||
+        (sectors_per_cluster & (sectors_per_cluster - 1)) != 0 || reserved == 0 ||
+        fat_count == 0 || root_entries != 0 || fat16_size != 0 || fat_size == 0) {
+        return false;
+    }
+
+    uint64_t data_start = (uint64_t)reserved + (uint64_t)fat_count * fat_size;
+    if (total <= data_start || (uint64_t)lba + total > block_count) {
+        return false;
+    }
+    uint32_t clusters = (uint32_t)((total - data_start) / sectors_per_cluster);
+    if (clusters == 0 || (uint64_t)(clusters + 2) * 4 > (uint64_t)fat_size * FAT32_SECTOR_SIZE) {
+        return false;
+    }
+
+    fat32.fat_lba = lba + reserved;
+    fat32.data_lba = lba + (uint32_t)data_start;
+    fat32.sectors_per_cluster = sectors_per_cluster;
+    fat32.cluster_count = clusters;
+    fat32.root_cluster = fat32_u32(&fat32_sector[44]);
+    return fat32.root_cluster >= 2 && fat32.root_cluster < clusters + 2;
+}
+
+bool fat32_mount(void) {
+    platform_usb_block_info_t info;
+
+    fat32_unmount();
+    if (!platform_usb_get_block_info(&info) || info.block_size != FAT32_SECTOR_SIZE) {
+        return false;
+    }
+    fat32.max_transfer = info.max_transfer_blocks ? info.max_transfer_blocks : 1;
+
+    /* Superfloppy (volume at sector 0), or the first FAT32 partition */
+    if (!fat32_read_bpb(0, info.block_count)) {
+        if (!platform_usb_read_blocks(0, fat32_sector, 1) ||
+            fat32_sector[510] != 0x55 || fat32_sector[511] != 0xAA) {
+            return false;
+        }
+        uint32_t starts[4] = { 0 };
+        for (uint32_t i = 0; i < 4; i++) {
+            const uint8_t *partition = &fat32_sector[446 + i * 16];
+            if (partition[4] == 0x0B || partition[4] == 0x0C) {
+                starts[i] = fat32_u32(&partition[8]);
+            }
+        }
+        bool found = false;
+        for (uint32_t i = 0; i < 4 && !found; i++) {
+            found = starts[i] != 0 && fat32_read_bpb(starts[i], info.block_count);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    fat32.mounted = true;
+    return true;
+}
+
+void fat32_unmount(void) {
+    fat32.mounted = false;
+    for (uint32_t i = 0; i < FAT32_FAT_CACHE_SECTORS; i++) {
+        fat32_fat_cache[i].valid = false;
+    }
+}
+
+bool fat32_is_mounted(void) {
+    return fat32.mounted;
+}
+
+static uint32_t fat32_cluster_lba(uint32_t cluster) {
+    return fat32.data_lba + (cluster - 2) * fat32.sectors_per_cluster;
+}
+
+static bool fat32_cluster_valid(uint32_t cluster) {
+    return cluster >= 2 && cluster < fat32.cluster_count + 2;
+}
+
+/**
+ * FAT entry of cluster: the next cluster, or 0 at the end of the chain
+ */
+static bool fat32_next_cluster(uint32_t cluster, uint32_t *next) {
+    uint32_t lba = fat32.fat_lba + cluster / (FAT32_SECTOR_SIZE / 4);
+    fat32_fat_sector_t *sector = NULL;
+
+    for (uint32_t i = 0; i < FAT32_FAT_CACHE_SECTORS; i++) {
+        fat32_fat_sector_t *cached = &fat32_fat_cache[i];
+        if (cached->valid && cached->lba == lba) {
+            sector = cached;
+            break;
+        }
+        if (!sector || !cached->valid ||
+            (sector->valid && cached->used < sector->used)) {
+            sector = cached;
+        }
+    }
+    if (!sector->valid || sector->lba != lba) {
+        sector->valid = platform_usb_read_blocks(lba, sector->data, 1);
+        sector->lba = lba;
+        if (!sector->valid) {
+            return false;
+        }
+    }
+    sector->used = ++fat32_fat_clock;
+
+    uint32_t entry = fat32_u32(&sector->data[(cluster % (FAT32_SECTOR_SIZE / 4)) * 4]) &
+                     FAT32_CLUSTER_MASK;
+    if (entry >= FAT32_CLUSTER_EOC) {
+        *next = 0;
+        return true;
+    }
+    *next = entry;
+    return fat32_cluster_valid(entry);
+}
+
+/**
+ * Resolve the chain from cluster (at file offset) into the file's extent
+ * window, merging consecutive clusters; stops at the end of the file
+ */
+static bool fat32_resolve(fat32_file_t *file, uint32_t cluster, uint32_t offset) {
+    uint32_t cluster_bytes = fat32.sectors_per_cluster * FAT32_SECTOR_SIZE;
+
+    file->extent_count = 0;
+    file->next_cluster = 0;
+    while (cluster != 0 && offset < file->size) {
+        if (!fat32_cluster_valid(cluster)) {
+            return false;
+        }
+        if (file->extent_count == FAT32_MAX_EXTENTS) {
+            file->next_cluster = cluster;
+            break;
+        }
+
+        fat32_extent_t *extent = &file->extents[file->extent_count++];
+        extent->offset = offset;
+        extent->lba = fat32_cluster_lba(cluster);
+        extent->sectors = 0;
+
+        uint32_t next;
+        do {
+            extent->sectors += fat32.sectors_per_cluster;
+            if (!fat32_next_cluster(cluster, &next)) {
+                return false;
+            }
+            offset = (file->size - offset > cluster_bytes) ? offset + cluster_bytes : file->size;
+        } while (next == ++cluster && offset < file->size);
+        cluster = next;
+    }
+    file->next_offset = offset;
+    return true;
+}
+
+/**
+ * Extent holding offset, resolving further windows as needed; *extent is
+ * NULL where the chain ends before offset
+ */
+static bool fat32_find_extent(fat32_file_t *file, uint32_t offset,
+                              const fat32_extent_t **extent) {
+    *extent = NULL;
+    if (file->extent_count == 0 || offset < file->extents[0].offset) {
+        if (!fat32_resolve(file, file->first_cluster, 0)) {
+            return false;
+        }
+    }
+
+    for (;;) {
+        for (uint32_t i = 0; i < file->extent_count; i++) {
+            const fat32_extent_t *candidate = &file->extents[i];
+            if (offset - candidate->offset < candidate->sectors * FAT32_SECTOR_SIZE) {
+                *extent = candidate;
+                return true;
+            }
+        }
+        if (file->next_cluster == 0) {
+            return true;
+        }
+        if (!fat32_resolve(file, file->next_cluster, file->next_offset)) {
+            return false;
+        }
+    }
+}
+
+bool fat32_read(fat32_file_t *file, uint32_t offset, uint8_t *buffer,
+                size_t size, size_t *got) {
+    if (!fat32.mounted || !file || !buffer || !got) {
+        return false;
+    }
+    *got = 0;
+    if (offset >= file->size) {
+        return true;
+    }
+    if (size > file->size - offset) {
+        size = file->size - offset;
+    }
+
+    while (size > 0) {
+        const fat32_extent_t *extent;
+        if (!fat32_find_extent(file, offset, &extent)) {
+            return false;
+        }
+        if (!extent) {
+            /* A directory ends with its chain; a file must not */
+            return file->is_dir;
+        }
+
+        uint32_t in_extent = offset - extent->offset;
+        uint32_t lba = extent->lba + in_extent / FAT32_SECTOR_SIZE;
+        uint32_t skip = in_extent % FAT32_SECTOR_SIZE;
+        size_t n;
+
+        if (skip != 0 || size < FAT32_SECTOR_SIZE) {
+            /* Partial sector */
+            if (!platform_usb_read_blocks(lba, fat32_sector, 1)) {
+                return false;
+            }
+            n = FAT32_SECTOR_SIZE - skip;
+            if (n > size) {
+                n = size;
+            }
+            memcpy(buffer, &fat32_sector[skip], n);
+        } else {
+            /* Whole sectors straight into the caller's buffer, as many per
+             * read as the extent and the transport allow */
+            uint32_t sectors = extent->sectors - in_extent / FAT32_SECTOR_SIZE;
+            if (sectors > size / FAT32_SECTOR_SIZE) {
+                sectors = (uint32_t)(size / FAT32_SECTOR_SIZE);
+            }
+            if (sectors > fat32.max_transfer) {
+                sectors = fat32.max_transfer;
+            }
+            if (!platform_usb_read_blocks(lba, buffer, sectors)) {
+                return false;
+            }
+            n = (size_t)sectors * FAT32_SECTOR_SIZE;
+        }
+
+        buffer += n;
+        offset += (uint32_t)n;
+        size -= n;
+        *got += n;
+    }
+    return true;
+}
+
+bool fat32_map(fat32_file_t *file, uint32_t offset, size_t size,
+               uint32_t *lba, uint32_t *sectors, size_t *got) {
+    if (!fat32.mounted || !file || file->is_dir || offset >= file->size ||
+        offset % FAT32_SECTOR_SIZE != 0 || size == 0 || size % FAT32_SECTOR_SIZE != 0) {
+        return false;
+    }
+    if (size > file->size - offset) {
+        size = file->size - offset;
+    }
+
+    const fat32_extent_t *extent;
+    if (!fat32_find_extent(file, offset, &extent) || !extent) {
+        return false;
+    }
+    uint32_t in_extent = (offset - extent->offset) / FAT32_SECTOR_SIZE;
+    uint32_t count = (uint32_t)((size + FAT32_SECTOR_SIZE - 1) / FAT32_SECTOR_SIZE);
+    if (count > extent->sectors - in_extent) {
+        return false;
+    }
+
+    *lba = extent->lba + in_extent;
+    *sectors = count;
+    *got = size;
+    return true;
+}
+
+static void fat32_open_dir(fat32_file_t *file, uint32_t cluster) {
+    memset(file, 0, sizeof(*file));
+    file->first_cluster = cluster;
+    file->size = FAT32_DIR_MAX_BYTES;
+    file->is_dir = true;
+}
+
+static void fat32_dir_start(fat32_dir_iter_t *iter, uint32_t cluster) {
+    memset(iter, 0, sizeof(*iter));
+    fat32_open_dir(&iter->dir, cluster);
+}
+
+static uint8_t fat32_lfn_checksum(const uint8_t *short_name) {
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < 11; i++) {
+        sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + short_name[i]);
+    }
+    return sum;
+}
+
+/**
+ * Collect the characters of one LFN entry (ASCII only)
+ */
+static void fat32_lfn_collect(fat32_dir_iter_t *iter, const uint8_t *raw) {
+    static const uint8_t positions[FAT32_LFN_CHARS] = {
+        1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30
+    };
+    uint8_t sequence = raw[0] & 0x1F;
+
+    if (raw[0] & FAT32_LFN_LAST) {
+        memset(iter->lfn, 0, sizeof(iter->lfn));
+        iter->lfn_ok = sequence != 0 && sequence <= FAT32_LFN_MAX / FAT32_LFN_CHARS;
+        iter->lfn_next = sequence;
+        iter->lfn_checksum = raw[13];
+    }
+    if (!iter->lfn_ok || sequence == 0 || sequence != iter->lfn_next ||
+        raw[13] != iter->lfn_checksum) {
+        iter->lfn_ok = false;
+        return;
+    }
+
+    for (uint32_t i = 0; i < FAT32_LFN_CHARS; i++) {
+        uint16_t c = fat32_u16(&raw[positions[i]]);
+        if (c == 0x0000 || c == 0xFFFF) {
+            break;
+        }
+        if (c >= 0x80) {
+            iter->lfn_ok = false;
+            return;
+        }
+        iter->lfn[(sequence - 1) * FAT32_LFN_CHARS + i] = (char)c;
+    }
+    iter->lfn_next--;
+}
+
+/**
+ * 8.3 name as "NAME.EXT", lower-cased where the NT case flags say so
+ */
+static void fat32_short_name(const uint8_t *raw, char *name) {
+    size_t len = 0;
+    bool lower_base = (raw[12] & FAT32_NT_LOWER_BASE) != 0;
+    bool lower_ext = (raw[12] & FAT32_NT_LOWER_EXT) != 0;
+
+    for (uint32_t i = 0; i < 8 && raw[i] != ' '; i++) {
+        char c = (i == 0 && raw[0] == 0x05) ? (char)0xE5 : (char)raw[i];
+        name[len++] = lower_base ? fat32_lower(c) : c;
+    }
+    if (raw[8] != ' ') {
+        name[len++] = '.';
+        for (uint32_t i = 8; i < 11 && raw[i] != ' '; i++) {
+            name[len++] = lower_ext ? fat32_lower((char)raw[i]) : (char)raw[i];
+        }
+    }
+    name[len] = '\0';
+}
+
+/**
+ * Next file or directory entry; *found is false at the end of the directory
+ */
+static bool fat32_dir_next(fat32_dir_iter_t *iter, fat32_entry_t *entry, bool *found) {
+    *found = false;
+    for (;;) {
+        uint32_t in_sector = iter->offset % FAT32_SECTOR_SIZE;
+        if (in_sector == 0) {
+            size_t got;
+            if (!fat32_read(&iter->dir, iter->offset, fat32_sector, FAT32_SECTOR_SIZE, &got)) {
+                return false;
+            }
+            if (got < FAT32_SECTOR_SIZE) {
+                return true;
+            }
+        }
+        const uint8_t *raw = &fat32_sector[in_sector];
+        iter->offset += FAT32_DIRENT_SIZE;
+
+        if (raw[0] == 0x00) {
+            return true;
+        }
+        if (raw[0] == 0xE5) {
+            iter->lfn_ok = false;
+            continue;
+        }
+        if ((raw[11] & 0x3F) == FAT32_ATTR_LFN) {
+            fat32_lfn_collect(iter, raw);
+            continue;
+        }
+        bool lfn = iter->lfn_ok && iter->lfn_next == 0 &&
+                   iter->lfn_checksum == fat32_lfn_checksum(raw);
+        iter->lfn_ok = false;
+        if (raw[11] & FAT32_ATTR_VOLUME_ID) {
+            continue;
+        }
+
+        fat32_short_name(raw, entry->short_name);
+        if (lfn) {
+            memcpy(entry->name, iter->lfn, sizeof(entry->name));
+        } else {
+            memcpy(entry->name, entry->short_name, sizeof(entry->short_name));
+        }
+        entry->cluster = ((uint32_t)fat32_u16(&raw[20]) << 16) | fat32_u16(&raw[26]);
+        entry->is_dir = (raw[11] & FAT32_ATTR_DIRECTORY) != 0;
+        entry->size = entry->is_dir ? 0 : fat32_u32(&raw[28]);
+        *found = true;
+        return true;
+    }
+}
+
+/**
+ * Walk path from the root directory; "/" is the root itself
+ */
+static bool fat32_lookup(const char *path, fat32_entry_t *entry) {
+    if (!fat32.mounted || !path) {
+        return false;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->name[0] = '/';
+    entry->cluster = fat32.root_cluster;
+    entry->is_dir = true;
+
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        size_t len = strcspn(path, "/");
+        if (len == 0) {
+            break;
+        }
+        if (!entry->is_dir) {
+            return false;
+        }
+
+        fat32_dir_iter_t iter;
+        fat32_dir_start(&iter, entry->cluster ? entry->cluster : fat32.root_cluster);
+        bool found;
+        do {
+            if (!fat32_dir_next(&iter, entry, &found)) {
+                return false;
+            }
+        } while (found && !fat32_name_equal(path, len, entry->name) &&
+                 !fat32_name_equal(path, len, entry->short_name));
+        if (!found) {
+            return false;
+        }
+        path += len;
+    }
+    return true;
+}
+
+bool fat32_open(const char *path, fat32_file_t *file) {
+    fat32_entry_t entry;
+    if (!file || !fat32_lookup(path, &entry)) {
+        return false;
+    }
+
+    if (entry.is_dir) {
+        fat32_open_dir(file, entry.cluster ? entry.cluster : fat32.root_cluster);
+        return true;
+    }
+    memset(file, 0, sizeof(*file));
+    file->size = entry.size;
+    file->first_cluster = entry.cluster;
+    return entry.size == 0 || fat32_cluster_valid(entry.cluster);
+}
+
+static bool fat32_fill_dirent(const fat32_entry_t *entry, platform_usb_dirent_t *dirent) {
+    size_t len = strlen(entry->name);
+    if (len >= sizeof(dirent->name)) {
+        return false;
+    }
+    memset(dirent, 0, sizeof(*dirent));
+    memcpy(dirent->name, entry->name, len);
+    dirent->size = entry->size;
+    dirent->is_dir = entry->is_dir;
+    return true;
+}
+
+bool fat32_stat(const char *path, platform_usb_dirent_t *entry) {
+    fat32_entry_t found;
+    return entry && fat32_lookup(path, &found) && fat32_fill_dirent(&found, entry);
+}
+
+bool fat32_list_dir(const char *path, platform_usb_dirent_t *entries,
+                    uint32_t max_entries, uint32_t *count) {
+    fat32_entry_t entry;
+    if (!count) {
+        return false;
+    }
+    *count = 0;
+    if (!fat32_lookup(path, &entry) || !entry.is_dir) {
+        return false;
+    }
+
+    fat32_dir_iter_t iter;
+    fat32_dir_start(&iter, entry.cluster ? entry.cluster : fat32.root_cluster);
+    for (;;) {
+        bool found;
+        if (!fat32_dir_next(&iter, &entry, &found)) {
+            return false;
+        }
+        if (!found) {
+            return true;
+        }
+
+        platform_usb_dirent_t dirent;
+        if (strcmp(entry.short_name, ".") == 0 || strcmp(entry.short_name, "..") == 0 ||
+            !fat32_fill_dirent(&entry, &dirent)) {
+            continue;
+        }
+        if (*count < max_entries) {
+            entries[*count] = dirent;
+        }
+        (*count)++;
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * FAT32 Driver (read-only)
+ * Reference file system for boards whose USB stack stops at the block
+ * device (platform_usb_read_blocks). A file's cluster chain is resolved
+ * once into contiguous extents, so reading a file that was written in one
+ * go is a few multi-sector reads of up to the transport's maximum, not
+ * one read per cluster. The FAT sectors needed along the way are cached.
+ *
+ * Sector size is 512 bytes. Long file names are matched (ASCII only), as
+ * are 8.3 names, case-insensitively. Writing is left to the platform's
+ * file API.
+ */
+
+#ifndef FAT32_H
+#define FAT32_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+
+#define FAT32_SECTOR_SIZE 512
+#define FAT32_MAX_EXTENTS 8            // Extents resolved at a time per file
+#define FAT32_FAT_CACHE_SECTORS 4      // Cached FAT sectors (LRU)
+
+/* Run of consecutive clusters */
+typedef struct {
+    uint32_t offset;         // File offset of the first byte
+    uint32_t lba;            // First sector
+    uint32_t sectors;
+} fat32_extent_t;
+
+/* Open file: the window of extents resolved so far */
+typedef struct {
+    uint32_t size;
+    uint32_t first_cluster;
+    bool is_dir;
+    uint32_t extent_count;
+    fat32_extent_t extents[FAT32_MAX_EXTENTS];
+    uint32_t next_cluster;   // First cluster after the window (0 = chain ends)
+    uint32_t next_offset;    // File offset of next_cluster
+} fat32_file_t;
+
+/**
+ * Read the boot sector of the USB block device
+ */
+bool fat32_mount(void);
+
+/**
+ * Forget the mount and cached FAT sectors (medium changed underneath)
+ */
+void fat32_unmount(void);
+
+/**
+ * True once fat32_mount() has succeeded
+ */
+bool fat32_is_mounted(void);
+
+/**
+ * Look up path and resolve the start of its cluster chain
+ */
+bool fat32_open(const char *path, fat32_file_t *file);
+
+/**
+ * Read up to size bytes at offset; got receives the bytes read (0 at EOF)
+ */
+bool fat32_read(fat32_file_t *file, uint32_t offset, uint8_t *buffer,
+                size_t size, size_t *got);
+
+/**
+ * Sectors behind size bytes at offset, when they are one run and offset
+ * and size are whole sectors: lba and sectors receive the run, got the
+ * file bytes in it (less than sectors * FAT32_SECTOR_SIZE at the end of
+ * the file). Lets a caller read a chunk straight into its own buffer;
+ * false means use fat32_read().
+ */
+bool fat32_map(fat32_file_t *file, uint32_t offset, size_t size,
+               uint32_t *lba, uint32_t *sectors, size_t *got);
+
+/**
+ * Directory entry of path
+ */
+bool fat32_stat(const char *path, platform_usb_dirent_t *entry);
+
+/**
+ * List a directory (same contract as platform_usb_list_dir)
+ */
+bool fat32_list_dir(const char *path, platform_usb_dirent_t *entries,
+                    uint32_t max_entries, uint32_t *count);
+
+#endif /* FAT32_H */
@@ -0,0 +1,419 @@
+/**
+ * Compressed Image Format Implementation
+ */
+
+#include "image_codec.h"
+#include <string.h>
+
+#if IMAGE_CODEC_BLOCK_SIZE > 65535
+#error "Block size must fit 16-bit match offsets and hash table entries"
+#endif
+
+#define CODEC_MIN_MATCH 4
+#define CODEC_MIN_FILL 8      // Shorter runs are left to literals/matches
+
+/* Decoder states */
+enum {
+    DEC_HEADER,
+    DEC_BLOCK,
+    DEC_TOKEN,
+    DEC_LENGTH,
+    DEC_LITERAL,
+    DEC_OFFSET,
+    DEC_FILL,
+    DEC_RAW,
+    DEC_ERROR
+};
+
+/* Bounded output for one compressed block payload */
+typedef struct {
+    uint8_t *out;
+    size_t pos;
+    size_t cap;
+    bool overflow;
+} codec_writer_t;
+
+static void codec_put(codec_writer_t *writer, uint8_t byte) {
+    if (writer->pos >= writer->cap) {
+        writer->overflow = true;
+        return;
+    }
+    writer->out[writer->pos++] = byte;
+}
+
+static void codec_put_token(codec_writer_t *writer, uint32_t op, uint32_t length) {
+    if (length < IMAGE_CODEC_LENGTH_MORE) {
+        codec_put(writer, (uint8_t)((op << 6) | length));
+        return;
+    }
+
+    codec_put(writer, (uint8_t)((op << 6) | IMAGE_CODEC_LENGTH_MORE));
+    length -= IMAGE_CODEC_LENGTH_MORE;
+    while (length >= 255) {
+        codec_put(writer, 255);
+        length -= 255;
+    }
+    codec_put(writer, (uint8_t)length);
+}
+
+static void codec_put_literals(codec_writer_t *writer, const uint8_t *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    codec_put_token(writer, IMAGE_CODEC_OP_LITERAL, size - 1);
+    if (writer->overflow || size > writer->cap - writer->pos) {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->out + writer->pos, data, size);
+    writer->pos += size;
+}
+
+static uint32_t codec_read32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void codec_write32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+bool image_codec_is_compressed(const uint8_t *data, size_t size) {
+    return data && size >= sizeof(uint32_t) && codec_read32(data) == IMAGE_CODEC_MAGIC;
+}
+
+void image_codec_init_header(image_codec_header_t *header, uint32_t image_size) {
+    memset(header, 0, sizeof(*header));
+    header->magic = IMAGE_CODEC_MAGIC;
+    header->version = IMAGE_CODEC_VERSION;
+    header->header_size = sizeof(*header);
+    header->block_size = IMAGE_CODEC_BLOCK_SIZE;
+    header->image_size = image_size;
+}
+
+size_t image_codec_compress_block(const uint8_t *data, size_t size,
+                                  uint8_t *out, uint16_t *table) {
+    if (!data || !out || !table || size == 0 || size > IMAGE_CODEC_BLOCK_SIZE) {
+        return 0;
+    }
+
+    /* Erased flash needs no payload at all */
+    size_t erased = 0;
+    while (erased < size && data[erased] == 0xFF) {
+        erased++;
+    }
+    if (erased == size) {
+        codec_write32(out, IMAGE_CODEC_BLOCK_ERASED);
+        return IMAGE_CODEC_BLOCK_HEADER_SIZE;
+    }
+
+    /* Payload must come out smaller than the block to be worth keeping */
+    codec_writer_t writer = { out + IMAGE_CODEC_BLOCK_HEADER_SIZE, 0, size - 1, false };
+    memset(table, 0, IMAGE_CODEC_HASH_SIZE * sizeof(table[0]));
+
+    size_t pos = 0;
+    size_t literal = 0;    /* Start of the pending literal run */
+    while (pos + CODEC_MIN_MATCH <= size && !writer.overflow) {
+        /* Runs of one byte value (erased flash, padding) */
+        size_t run = 1;
+        while (pos + run < size && data[pos + run] == data[pos]) {
+            run++;
+        }
+        if (run >= CODEC_MIN_FILL) {
+            codec_put_literals(&writer, data + literal, pos - literal);
+            codec_put_token(&writer, IMAGE_CODEC_OP_FILL, run - CODEC_MIN_MATCH);
+            codec_put(&writer, data[pos]);
+            pos += run;
+            literal = pos;
+            continue;
+        }
+
+        /* Table holds position + 1 of the last sequence with this hash */
+        uint32_t sequence = codec_read32(data + pos);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - IMAGE_CODEC_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = (uint16_t)(pos + 1);
+
+        if (candidate != 0 && codec_read32(data + candidate - 1) == sequence) {
+            size_t match = candidate - 1;
+            size_t length = CODEC_MIN_MATCH;
+            while (pos + length < size && data[match + length] == data[pos + length]) {
+                length++;
+            }
+
+            size_t offset = pos - match;
+            codec_put_literals(&writer, data + literal, pos - literal);
+            codec_put_token(&writer, IMAGE_CODEC_OP_MATCH, length - CODEC_MIN_MATCH);
+            codec_put(&writer, (uint8_t)offset);
+            codec_put(&writer, (uint8_t)(offset >> 8));
+            pos += length;
+            literal = pos;
+            continue;
+        }
+
+        pos++;
+    }
+    codec_put_literals(&writer, data + literal, size - literal);
+
+    if (writer.overflow) {
+        codec_write32(out, (uint32_t)size | IMAGE_CODEC_BLOCK_RAW);
+        memcpy(out + IMAGE_CODEC_BLOCK_HEADER_SIZE, data, size);
+        return IMAGE_CODEC_BLOCK_HEADER_SIZE + size;
+    }
+
+    codec_write32(out, (uint32_t)writer.pos);
+    return IMAGE_CODEC_BLOCK_HEADER_SIZE + writer.pos;
+}
+
+void image_codec_decoder_init(image_codec_decoder_t *decoder, uint32_t max_image_size) {
+    memset(decoder, 0, offsetof(image_codec_decoder_t, block));
+    decoder->state = DEC_HEADER;
+    decoder->max_image_size = max_image_size;
+}
+
+static image_codec_status_t codec_fail(image_codec_decoder_t *decoder, size_t pos,
+                                       size_t *consumed) {
+    decoder->state = DEC_ERROR;
+    *consumed = pos;
+    return IMAGE_CODEC_ERROR;
+}
+
+/**
+ * Length is complete: add the op's base and pick the state that reads its
+ * operand. Returns false if the op would overrun the block.
+ */
+static bool codec_begin_op(image_codec_decoder_t *decoder) {
+    decoder->length += (decoder->op == IMAGE_CODEC_OP_LITERAL) ? 1 : CODEC_MIN_MATCH;
+
+    /* SECURITY: No op may write past the end of the block */
+    if (decoder->length > decoder->block_len - decoder->block_pos) {
+        return false;
+    }
+
+    switch (decoder->op) {
+        case IMAGE_CODEC_OP_LITERAL:
+            decoder->state = DEC_LITERAL;
+            break;
+        case IMAGE_CODEC_OP_MATCH:
+            decoder->state = DEC_OFFSET;
+            break;
+        default:
+            decoder->state = DEC_FILL;
+            break;
+    }
+    return true;
+}
+
+image_codec_status_t image_codec_decode(image_codec_decoder_t *decoder,
+                                        const uint8_t *data, size_t size,
+                                        size_t *consumed,
+                                        const uint8_t **block, size_t *block_size) {
+    size_t pos = 0;
+
+    if (!decoder || !consumed || !block || !block_size || (size > 0 && !data)) {
+        return IMAGE_CODEC_ERROR;
+    }
+
+    for (;;) {
+        if (decoder->state == DEC_ERROR) {
+            return codec_fail(decoder, pos, consumed);
+        }
+
+        /* Block complete once its output is full at an op boundary */
+        if (decoder->state == DEC_TOKEN && decoder->block_pos == decoder->block_len) {
+            if (decoder->payload_left != 0) {
+                return codec_fail(decoder, pos, consumed);
+            }
+            decoder->image_done += decoder->block_len;
+            decoder->state = DEC_BLOCK;
+            *consumed = pos;
+            *block = decoder->block;
+            *block_size = decoder->block_len;
+            return IMAGE_CODEC_BLOCK;
+        }
+
+        /* SECURITY: Nothing may follow the last block */
+        if (decoder->state == DEC_BLOCK &&
+            decoder->image_done == decoder->header.image_size && pos < size) {
+            return codec_fail(decoder, pos, consumed);
+        }
+
+        if (pos == size) {
+            *consumed = pos;
+            return IMAGE_CODEC_NEED_INPUT;
+        }
+
+        /* Every byte after the block header belongs to the block payload */
+        if (decoder->state != DEC_HEADER && decoder->state != DEC_BLOCK) {
+            if (decoder->payload_left == 0) {
+                return codec_fail(decoder, pos, consumed);
+            }
+        }
+
+        switch (decoder->state) {
+            case DEC_HEADER: {
+                size_t part = sizeof(decoder->header) - decoder->header_got;
+                if (part > size - pos) {
+                    part = size - pos;
+                }
+                memcpy((uint8_t *)&decoder->header + decoder->header_got, data + pos, part);
+                decoder->header_got += part;
+                pos += part;
+
+                if (decoder->header_got == sizeof(decoder->header)) {
+                    /* SECURITY: Only accept the layout this decoder implements */
+                    const image_codec_header_t *header = &decoder->header;
+                    if (header->magic != IMAGE_CODEC_MAGIC ||
+                        header->version == 0 || header->version > IMAGE_CODEC_VERSION ||
+                        header->header_size != sizeof(*header) ||
+                        header->block_size != IMAGE_CODEC_BLOCK_SIZE ||
+                        header->image_size == 0 ||
+                        header->image_size > decoder->max_image_size) {
+                        return codec_fail(decoder, pos, consumed);
+                    }
+                    decoder->state = DEC_BLOCK;
+                }
+                break;
+            }
+
+            case DEC_BLOCK:
+                decoder->word |= (uint32_t)data[pos++] << (8 * decoder->word_got);
+                if (++decoder->word_got < IMAGE_CODEC_BLOCK_HEADER_SIZE) {
+                    break;
+                }
+
+                decoder->block_len = decoder->header.image_size - decoder->image_done;
+                if (decoder->block_len > IMAGE_CODEC_BLOCK_SIZE) {
+                    decoder->block_len = IMAGE_CODEC_BLOCK_SIZE;
+                }
+                decoder->block_pos = 0;
+                decoder->payload_left = decoder->word & IMAGE_CODEC_BLOCK_LEN_MASK;
+
+                if (decoder->word & IMAGE_CODEC_BLOCK_ERASED) {
+                    if (decoder->word != IMAGE_CODEC_BLOCK_ERASED ||
+                        decoder->header.version < 2) {
+                        return codec_fail(decoder, pos, consumed);
+                    }
+                    memset(decoder->block, 0xFF, decoder->block_len);
+                    decoder->block_pos = decoder->block_len;
+                    decoder->state = DEC_TOKEN;
+                } else if (decoder->word & IMAGE_CODEC_BLOCK_RAW) {
+                    if (decoder->payload_left != decoder->block_len ||
+                        (decoder->word & ~(IMAGE_CODEC_BLOCK_RAW | IMAGE_CODEC_BLOCK_LEN_MASK))) {
+                        return codec_fail(decoder, pos, consumed);
+                    }
+                    decoder->state = DEC_RAW;
+                } else {
+                    if (decoder->word > IMAGE_CODEC_BLOCK_SIZE || decoder->payload_left == 0) {
+                        return codec_fail(decoder, pos, consumed);
+                    }
+                    decoder->state = DEC_TOKEN;
+                }
+                decoder->word = 0;
+                decoder->word_got = 0;
+                break;
+
+            case DEC_RAW:
+            case DEC_LITERAL: {
+                size_t part = size - pos;
+                uint32_t wanted = (decoder->state == DEC_RAW) ? decoder->payload_left
+                                                              : decoder->length;
+                if (part > wanted) {
+                    part = wanted;
+                }
+                if (part > decoder->payload_left) {
+                    part = decoder->payload_left;
+                }
+                memcpy(decoder->block + decoder->block_pos, data + pos, part);
+                decoder->block_pos += part;
+                decoder->payload_left -= part;
+                pos += part;
+
+                if (decoder->state == DEC_RAW) {
+                    if (decoder->payload_left == 0) {
+                        decoder->state = DEC_TOKEN;
+                    }
+                } else {
+                    decoder->length -= part;
+                    if (decoder->length == 0) {
+                        decoder->state = DEC_TOKEN;
+                    }
+                }
+                break;
+            }
+
+            case DEC_TOKEN: {
+                uint8_t token = data[pos++];
+                decoder->payload_left--;
+                decoder->op = token >> 6;
+                decoder->length = token & IMAGE_CODEC_LENGTH_MORE;
+                if (decoder->op > IMAGE_CODEC_OP_FILL) {
+                    return codec_fail(decoder, pos, consumed);
+                }
+                if (decoder->length == IMAGE_CODEC_LENGTH_MORE) {
+                    decoder->state = DEC_LENGTH;
+                } else if (!codec_begin_op(decoder)) {
+                    return codec_fail(decoder, pos, consumed);
+                }
+                break;
+            }
+
+            case DEC_LENGTH: {
+                uint8_t more = data[pos++];
+                decoder->payload_left--;
+                decoder->length += more;
+                if (decoder->length > IMAGE_CODEC_BLOCK_SIZE) {
+                    return codec_fail(decoder, pos, consumed);
+                }
+                if (more != 255 && !codec_begin_op(decoder)) {
+                    return codec_fail(decoder, pos, consumed);
+                }
+                break;
+            }
+
+            case DEC_OFFSET:
+                decoder->word |= (uint32_t)data[pos++] << (8 * decoder->word_got);
+                decoder->payload_left--;
+                if (++decoder->word_got == 2) {
+                    uint32_t offset = decoder->word;
+                    decoder->word = 0;
+                    decoder->word_got = 0;
+
+                    /* SECURITY: References must stay inside the decoded block */
+                    if (offset == 0 || offset > decoder->block_pos) {
+                        return codec_fail(decoder, pos, consumed);
+                    }
+
+                    /* Byte by byte: the source may overlap the output */
+                    uint8_t *dst = decoder->block + decoder->block_pos;
+                    const uint8_t *src = dst - offset;
+                    for (uint32_t i = 0; i < decoder->length; i++) {
+                        dst[i] = src[i];
+                    }
+                    decoder->block_pos += decoder->length;
+                    decoder->state = DEC_TOKEN;
+                }
+                break;
+
+            case DEC_FILL:
+                memset(decoder->block + decoder->block_pos, data[pos++], decoder->length);
+                decoder->payload_left--;
+                decoder->block_pos += decoder->length;
+                decoder->state = DEC_TOKEN;
+                break;
+
+            default:
+                return codec_fail(decoder, pos, consumed);
+        }
+    }
+}
+
+bool image_codec_decoder_done(const image_codec_decoder_t *decoder) {
+    return decoder && decoder->state == DEC_BLOCK &&
+           decoder->header_got == sizeof(decoder->header) &&
+           decoder->image_done == decoder->header.image_size;
+}
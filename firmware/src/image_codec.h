@@ -0,0 +1,117 @@
+/**
+ * Compressed Image Format
+ * Optional container for A.bin/B.bin: the image is cut into independent
+ * IMAGE_CODEC_BLOCK_SIZE blocks, each compressed with an LZ-style codec
+ * (literal runs, back-references within the block, fills for runs of one
+ * byte) or stored as-is when that is smaller. Erased blocks (all 0xFF)
+ * are a bare block header.
+ *
+ * The decoder is a byte-driven state machine: input may be supplied in
+ * pieces of any size, it needs no heap, and its only buffer is the one
+ * decompressed block it hands back. Hashes and signatures are always
+ * computed over the decompressed image.
+ */
+
+#ifndef IMAGE_CODEC_H
+#define IMAGE_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Format */
+#define IMAGE_CODEC_MAGIC 0x5A435253         // "SRCZ"
+#define IMAGE_CODEC_VERSION 2               // 2: erased blocks
+#define IMAGE_CODEC_BLOCK_SIZE (16 * 1024)   // Decompressed bytes per block
+#define IMAGE_CODEC_BLOCK_RAW 0x80000000u    // Block header flag: stored as-is
+#define IMAGE_CODEC_BLOCK_ERASED 0x40000000u // Block header flag: all 0xFF, no payload
+#define IMAGE_CODEC_BLOCK_LEN_MASK 0x00FFFFFFu
+#define IMAGE_CODEC_BLOCK_HEADER_SIZE 4
+#define IMAGE_CODEC_MAX_BLOCK_OUT (IMAGE_CODEC_BLOCK_HEADER_SIZE + IMAGE_CODEC_BLOCK_SIZE)
+
+/* Sequence tokens: op in the top two bits, length in the low six
+ * (63 = more length bytes follow, each added, until one is below 255) */
+#define IMAGE_CODEC_OP_LITERAL 0             // length + 1 literal bytes follow
+#define IMAGE_CODEC_OP_MATCH 1               // length + 4 bytes from 16-bit offset back
+#define IMAGE_CODEC_OP_FILL 2                // length + 4 copies of the next byte
+#define IMAGE_CODEC_LENGTH_MORE 63
+
+/* Compressor hash table entries (workspace supplied by the caller) */
+#define IMAGE_CODEC_HASH_BITS 12
+#define IMAGE_CODEC_HASH_SIZE (1 << IMAGE_CODEC_HASH_BITS)
+
+/* File header, followed by one block header + payload per block */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;      // sizeof(image_codec_header_t)
+    uint32_t block_size;       // IMAGE_CODEC_BLOCK_SIZE
+    uint32_t image_size;       // Decompressed size
+    uint8_t reserved[16];
+} image_codec_header_t;
+
+/* Decoder result */
+typedef enum {
+    IMAGE_CODEC_NEED_INPUT,    // All input consumed, no block complete yet
+    IMAGE_CODEC_BLOCK,         // A decompressed block is ready
+    IMAGE_CODEC_ERROR          // Malformed or oversized stream
+} image_codec_status_t;
+
+/* Streaming decoder state */
+typedef struct {
+    uint32_t state;
+    uint32_t max_image_size;
+    image_codec_header_t header;
+    uint32_t header_got;
+    uint32_t image_done;       // Decompressed bytes in completed blocks
+    uint32_t block_len;        // Decompressed size of the current block
+    uint32_t block_pos;        // Bytes decompressed in the current block
+    uint32_t payload_left;     // Compressed bytes left in the current block
+    uint32_t word;             // Block header / offset being assembled
+    uint32_t word_got;
+    uint32_t op;
+    uint32_t length;
+    uint8_t block[IMAGE_CODEC_BLOCK_SIZE];
+} image_codec_decoder_t;
+
+/**
+ * Check whether data starts with a compressed image header
+ */
+bool image_codec_is_compressed(const uint8_t *data, size_t size);
+
+/**
+ * Fill a file header for an image of image_size bytes
+ */
+void image_codec_init_header(image_codec_header_t *header, uint32_t image_size);
+
+/**
+ * Compress one block of up to IMAGE_CODEC_BLOCK_SIZE bytes
+ * out receives the block header and payload (at least
+ * IMAGE_CODEC_MAX_BLOCK_OUT bytes); the block is stored as-is if
+ * compressing would not make it smaller. table is a workspace of
+ * IMAGE_CODEC_HASH_SIZE entries. Returns the bytes written to out.
+ */
+size_t image_codec_compress_block(const uint8_t *data, size_t size,
+                                  uint8_t *out, uint16_t *table);
+
+/**
+ * Start decoding a compressed image of at most max_image_size bytes
+ */
+void image_codec_decoder_init(image_codec_decoder_t *decoder, uint32_t max_image_size);
+
+/**
+ * Feed input to the decoder
+ * consumed receives how much of data was used. On IMAGE_CODEC_BLOCK the
+ * block stays valid until the next call; call again with the rest of data.
+ */
+image_codec_status_t image_codec_decode(image_codec_decoder_t *decoder,
+                                        const uint8_t *data, size_t size,
+                                        size_t *consumed,
+                                        const uint8_t **block, size_t *block_size);
+
+/**
+ * True once the whole image has been decoded
+ */
+bool image_codec_decoder_done(const image_codec_decoder_t *decoder);
+
+#endif /* IMAGE_CODEC_H */
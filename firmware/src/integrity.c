@@ -0,0 +1,677 @@
+/**
+ * Firmware Integrity Index Implementation
+ */
+
+#include "integrity.h"
+#include "spi_flash.h"
+#include "crypto.h"
+#include "platform.h"
+#include "scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if (INTEGRITY_MAX_SECTORS > 0xFFFF)
+#error "Too many integrity sectors for the index header"
+#endif
+
+#if (64 + INTEGRITY_MAX_SECTORS * 32) > SRC_INTEGRITY_INDEX_SIZE
+#error "Integrity index does not fit SRC_INTEGRITY_INDEX_SIZE"
+#endif
+
+static integrity_header_t header;
+static uint8_t leaves[INTEGRITY_MAX_SECTORS][32];
+static bool index_loaded = false;
+
+/* Sectors written since they were last verified */
+static uint8_t dirty_map[INTEGRITY_MAP_BYTES];
+static uint32_t poll_cursor = 0;
+
+static integrity_snapshot_t snapshot;
+
+/* Erased-extent map: state known, and if so whether erased */
+static uint8_t extent_known[INTEGRITY_EXTENT_MAP_BYTES];
+static uint8_t extent_erased[INTEGRITY_EXTENT_MAP_BYTES];
+
+/* Leaf of an erased sector, computed on first use */
+static uint8_t erased_leaf[32];
+static bool erased_leaf_ready = false;
+
+#define MAP_TEST(map, bit) (((map)[(bit) / 8] >> ((bit) % 8)) & 1)
+#define MAP_SET(map, bit) ((map)[(bit) / 8] |= (uint8_t)(1 << ((bit) % 8)))
+#define MAP_CLEAR(map, bit) ((map)[(bit) / 8] &= (uint8_t)~(1 << ((bit) % 8)))
+
+/**
+ * Set the extent map for extents overlapping [start, end) of the region
+ * Extents the range only partly covers become unknown unless erased is false.
+ */
+static void integrity_mark_extents(uint32_t start, uint32_t end, bool erased) {
+    uint32_t first = start / INTEGRITY_EXTENT_SIZE;
+    uint32_t last = (end - 1) / INTEGRITY_EXTENT_SIZE;
+
+    for (uint32_t extent = first; extent <= last; extent++) {
+        uint32_t extent_start = extent * INTEGRITY_EXTENT_SIZE;
+        bool whole = start <= extent_start && end >= extent_start + INTEGRITY_EXTENT_SIZE;
+
+        if (erased && !whole) {
+            MAP_CLEAR(extent_known, extent);
+        } else {
+            MAP_SET(extent_known, extent);
+            if (erased) {
+                MAP_SET(extent_erased, extent);
+            } else {
+                MAP_CLEAR(extent_erased, extent);
+            }
+        }
+    }
+}
+
+/**
+ * SPI write observer: mark firmware sectors touched by a program/erase
+ * Erased extents are recorded when the erase is issued; a failed erase is
+ * caught by the read-back of whoever relies on it.
+ */
+static void integrity_note_write(uint32_t offset, size_t size, bool erase) {
+    uint32_t region_end = FIRMWARE_REGION_START + FIRMWARE_REGION_SIZE;
+
+    if (size == 0 || offset >= region_end ||
+        offset + size <= FIRMWARE_REGION_START) {
+        return;
+    }
+
+    uint32_t start = (offset > FIRMWARE_REGION_START) ? offset : FIRMWARE_REGION_START;
+    uint32_t end = (offset + size < region_end) ? offset + size : region_end;
+    uint32_t first = (start - FIRMWARE_REGION_START) / INTEGRITY_SECTOR_SIZE;
+    uint32_t last = (end - 1 - FIRMWARE_REGION_START) / INTEGRITY_SECTOR_SIZE;
+
+    for (uint32_t sector = first; sector <= last; sector++) {
+        MAP_SET(dirty_map, sector);
+    }
+
+    integrity_mark_extents(start - FIRMWARE_REGION_START,
+                           end - FIRMWARE_REGION_START, erase);
+}
+
+void integrity_note_read(uint32_t offset, const uint8_t *data, size_t size) {
+    /* Offsets below the region wrap around and fail the check too */
+    uint32_t rel = offset - FIRMWARE_REGION_START;
+    if (!data || size == 0 || rel >= FIRMWARE_REGION_SIZE ||
+        size > FIRMWARE_REGION_SIZE - rel) {
+        return;
+    }
+
+    /* Only extents the read covers completely */
+    uint32_t skip = (INTEGRITY_EXTENT_SIZE - rel % INTEGRITY_EXTENT_SIZE) % INTEGRITY_EXTENT_SIZE;
+    while (skip + INTEGRITY_EXTENT_SIZE <= size) {
+        uint32_t extent = (rel + skip) / INTEGRITY_EXTENT_SIZE;
+        MAP_SET(extent_known, extent);
+        if (integrity_is_erased(data + skip, INTEGRITY_EXTENT_SIZE)) {
+            MAP_SET(extent_erased, extent);
+        } else {
+            MAP_CLEAR(extent_erased, extent);
+        }
+        skip += INTEGRITY_EXTENT_SIZE;
+    }
+}
+
+bool integrity_extent_erased(uint32_t offset, size_t size) {
+    uint32_t rel = offset - FIRMWARE_REGION_START;
+    if (size == 0 || rel >= FIRMWARE_REGION_SIZE || size > FIRMWARE_REGION_SIZE - rel) {
+        return false;
+    }
+
+    uint32_t first = rel / INTEGRITY_EXTENT_SIZE;
+    uint32_t last = (rel + size - 1) / INTEGRITY_EXTENT_SIZE;
+    for (uint32_t extent = first; extent <= last; extent++) {
+        if (!MAP_TEST(extent_known, extent) || !MAP_TEST(extent_erased, extent)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool integrity_is_erased(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Feed count 0xFF bytes to a hash
+ */
+static void integrity_hash_erased(crypto_sha256_ctx_t *ctx, size_t count) {
+    uint8_t erased[64];
+    memset(erased, 0xFF, sizeof(erased));
+
+    while (count > 0) {
+        size_t part = (count < sizeof(erased)) ? count : sizeof(erased);
+        crypto_sha256_update(ctx, erased, part);
+        count -= part;
+    }
+}
+
+bool integrity_leaf_init(integrity_leaf_ctx_t *ctx) {
+    if (!ctx) {
+        return false;
+    }
+    /* The hash itself is started once real data shows up */
+    ctx->erased = 0;
+    ctx->populated = false;
+    return true;
+}
+
+void integrity_leaf_update(integrity_leaf_ctx_t *ctx, const uint8_t *data, size_t size) {
+    if (!ctx->populated) {
+        if (integrity_is_erased(data, size)) {
+            ctx->erased += size;
+            return;
+        }
+        /* First real data: catch up on the erased prefix */
+        crypto_sha256_init(&ctx->ctx);
+        integrity_hash_erased(&ctx->ctx, ctx->erased);
+        ctx->populated = true;
+    }
+    crypto_sha256_update(&ctx->ctx, data, size);
+}
+
+bool integrity_leaf_final(integrity_leaf_ctx_t *ctx, uint8_t *hash) {
+    if (ctx->populated) {
+        return crypto_sha256_final(&ctx->ctx, hash) == CRYPTO_SUCCESS;
+    }
+
+    /* Erased sector: precomputed leaf */
+    if (ctx->erased == INTEGRITY_SECTOR_SIZE && erased_leaf_ready) {
+        memcpy(hash, erased_leaf, sizeof(erased_leaf));
+        return true;
+    }
+
+    if (crypto_sha256_init(&ctx->ctx) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    integrity_hash_erased(&ctx->ctx, ctx->erased);
+    if (crypto_sha256_final(&ctx->ctx, hash) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    if (ctx->erased == INTEGRITY_SECTOR_SIZE) {
+        memcpy(erased_leaf, hash, sizeof(erased_leaf));
+        erased_leaf_ready = true;
+    }
+    return true;
+}
+
+bool integrity_init(void) {
+    memset(dirty_map, 0, sizeof(dirty_map));
+    memset(extent_known, 0, sizeof(extent_known));
+    memset(extent_erased, 0, sizeof(extent_erased));
+    poll_cursor = 0;
+    index_loaded = false;
+    snapshot.valid = false;
+
+    spi_flash_set_write_observer(integrity_note_write);
+    return true;
+}
+
+/**
+ * Hash of the subtree over count leaves (count >= 1)
+ * Split at the largest power of two below count, as in RFC 6962
+ */
+static bool integrity_subtree(const uint8_t subtree[][32], uint32_t count,
+                              uint8_t *hash) {
+    if (count == 1) {
+        memcpy(hash, subtree[0], 32);
+        return true;
+    }
+
+    uint32_t split = 1;
+    while (split * 2 < count) {
+        split *= 2;
+    }
+
+    uint8_t left[32];
+    uint8_t right[32];
+    if (!integrity_subtree(subtree, split, left) ||
+        !integrity_subtree(subtree + split, count - split, right)) {
+        return false;
+    }
+
+    /* Node prefix keeps inner nodes distinct from leaves */
+    const uint8_t prefix = 0x01;
+    crypto_sha256_ctx_t ctx;
+    if (crypto_sha256_init(&ctx) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    crypto_sha256_update(&ctx, &prefix, 1);
+    crypto_sha256_update(&ctx, left, sizeof(left));
+    crypto_sha256_update(&ctx, right, sizeof(right));
+    return crypto_sha256_final(&ctx, hash) == CRYPTO_SUCCESS;
+}
+
+bool integrity_compute_root(const uint8_t subtree[][32], uint32_t count, uint8_t *root) {
+    if (!subtree || !root || count == 0) {
+        return false;
+    }
+
+    return integrity_subtree(subtree, count, root);
+}
+
+bool integrity_get_sector_range(uint32_t sector, uint32_t *offset, size_t *size) {
+    if (!offset || !size || sector >= INTEGRITY_MAX_SECTORS) {
+        return false;
+    }
+
+    uint32_t start = sector * INTEGRITY_SECTOR_SIZE;
+    size_t len = FIRMWARE_REGION_SIZE - start;
+    if (len > INTEGRITY_SECTOR_SIZE) {
+        len = INTEGRITY_SECTOR_SIZE;
+    }
+
+    *offset = FIRMWARE_REGION_START + start;
+    *size = len;
+    return true;
+}
+
+/**
+ * Bind the in-RAM leaves into a new header/root and write the index
+ */
+static bool integrity_store(uint8_t *root) {
+    memset(&header, 0, sizeof(header));
+    header.magic = INTEGRITY_MAGIC;
+    header.version = INTEGRITY_VERSION;
+    header.sector_count = INTEGRITY_MAX_SECTORS;
+    header.sector_size = INTEGRITY_SECTOR_SIZE;
+    header.region_start = FIRMWARE_REGION_START;
+    header.region_size = FIRMWARE_REGION_SIZE;
+    if (!integrity_compute_root(leaves, INTEGRITY_MAX_SECTORS, header.root)) {
+        return false;
+    }
+
+    /* Store header and leaves as one stream */
+    size_t leaves_size = INTEGRITY_MAX_SECTORS * sizeof(leaves[0]);
+    spi_flash_batch_t batch;
+    if (!spi_flash_batch_begin(&batch, SRC_INTEGRITY_INDEX_START,
+                               sizeof(header) + leaves_size)) {
+        return false;
+    }
+    bool ok = spi_flash_batch_write(&batch, (const uint8_t *)&header, sizeof(header)) &&
+              spi_flash_batch_write(&batch, (const uint8_t *)leaves, leaves_size);
+    if (!spi_flash_batch_end(&batch) || !ok) {
+        return false;
+    }
+
+    /* New baseline: nothing is outstanding */
+    memset(dirty_map, 0, sizeof(dirty_map));
+    poll_cursor = 0;
+    index_loaded = true;
+
+    memcpy(root, header.root, sizeof(header.root));
+    return true;
+}
+
+bool integrity_build(const uint8_t hashes[][32], uint8_t *root) {
+    if (!hashes || !root) {
+        return false;
+    }
+
+    index_loaded = false;
+    memcpy(leaves, hashes, sizeof(leaves));
+
+    return integrity_store(root);
+}
+
+bool integrity_get_leaf(uint32_t sector, uint8_t *hash) {
+    if (!hash || !index_loaded || sector >= INTEGRITY_MAX_SECTORS) {
+        return false;
+    }
+
+    memcpy(hash, leaves[sector], sizeof(leaves[sector]));
+    return true;
+}
+
+bool integrity_update_sectors(const uint32_t *sectors, const uint8_t hashes[][32],
+                              uint32_t count, uint8_t *root) {
+    if (!sectors || !hashes || !root || !index_loaded) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (sectors[i] >= INTEGRITY_MAX_SECTORS) {
+            return false;
+        }
+    }
+
+    index_loaded = false;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(leaves[sectors[i]], hashes[i], sizeof(leaves[0]));
+    }
+
+    return integrity_store(root);
+}
+
+/**
+ * Load and self-check the stored index
+ */
+static bool integrity_load(void) {
+    index_loaded = false;
+
+    if (!spi_flash_read(SRC_INTEGRITY_INDEX_START, (uint8_t *)&header, sizeof(header))) {
+        return false;
+    }
+
+    /* SECURITY: Only accept an index describing this exact layout */
+    if (header.magic != INTEGRITY_MAGIC ||
+        header.version != INTEGRITY_VERSION ||
+        header.sector_count != INTEGRITY_MAX_SECTORS ||
+        header.sector_size != INTEGRITY_SECTOR_SIZE ||
+        header.region_start != FIRMWARE_REGION_START ||
+        header.region_size != FIRMWARE_REGION_SIZE) {
+        return false;
+    }
+
+    if (!spi_flash_read(SRC_INTEGRITY_INDEX_START + sizeof(header),
+                        (uint8_t *)leaves, sizeof(leaves))) {
+        return false;
+    }
+
+    /* SECURITY: Leaves must reproduce the recorded root */
+    uint8_t root[32];
+    if (!integrity_compute_root(leaves, INTEGRITY_MAX_SECTORS, root) ||
+        memcmp(root, header.root, sizeof(root)) != 0) {
+        return false;
+    }
+
+    index_loaded = true;
+    return true;
+}
+
+bool integrity_is_available(const uint8_t *root) {
+    static const uint8_t zero_root[32] = {0};
+
+    /* No baseline recorded yet */
+    if (!root || memcmp(root, zero_root, sizeof(zero_root)) == 0) {
+        return false;
+    }
+
+    if (!index_loaded || memcmp(header.root, root, sizeof(header.root)) != 0) {
+        if (!integrity_load()) {
+            return false;
+        }
+    }
+
+    /* SECURITY: Index must belong to the baseline in config */
+    return memcmp(header.root, root, sizeof(header.root)) == 0;
+}
+
+/**
+ * Leaf hash of one sector as it is in flash now
+ */
+static bool integrity_hash_sector(uint32_t sector, uint8_t *hash) {
+    uint32_t offset;
+    size_t len;
+    if (!integrity_get_sector_range(sector, &offset, &len)) {
+        return false;
+    }
+
+    integrity_leaf_ctx_t ctx;
+    if (!integrity_leaf_init(&ctx)) {
+        return false;
+    }
+
+    uint8_t block[SRC_HASH_BLOCK_SIZE];
+    for (size_t done = 0; done < len; done += sizeof(block)) {
+        size_t part = len - done;
+        if (part > sizeof(block)) {
+            part = sizeof(block);
+        }
+        if (!spi_flash_read(offset + done, block, part)) {
+            integrity_leaf_final(&ctx, hash);
+            return false;
+        }
+        integrity_note_read(offset + done, block, part);
+        integrity_leaf_update(&ctx, block, part);
+    }
+
+    return integrity_leaf_final(&ctx, hash);
+}
+
+/**
+ * Leaf hashes of count consecutive sectors of equal size, hashed together
+ * Flash is read one chunk per sector in turn, so only one chunk per sector
+ * is buffered; chunks has room for count + 1 of them.
+ */
+static bool integrity_hash_batch(uint32_t first, uint32_t count, uint8_t *chunks,
+                                 uint8_t hashes[][32]) {
+    uint32_t offset;
+    size_t len;
+    if (!integrity_get_sector_range(first, &offset, &len)) {
+        return false;
+    }
+
+    const uint8_t *lanes[CRYPTO_SHA256_BATCH_MAX];
+    const uint8_t *fill[CRYPTO_SHA256_BATCH_MAX];
+    uint8_t *erased_chunk = chunks + (size_t)count * SRC_HASH_BLOCK_SIZE;
+    crypto_sha256_batch_ctx_t ctx;
+    size_t erased = 0;      /* Leading bytes erased in every sector */
+    bool started = false;
+
+    memset(erased_chunk, 0xFF, SRC_HASH_BLOCK_SIZE);
+    for (uint32_t i = 0; i < count; i++) {
+        lanes[i] = chunks + (size_t)i * SRC_HASH_BLOCK_SIZE;
+        fill[i] = erased_chunk;
+    }
+
+    for (size_t done = 0; done < len; done += SRC_HASH_BLOCK_SIZE) {
+        size_t part = len - done;
+        if (part > SRC_HASH_BLOCK_SIZE) {
+            part = SRC_HASH_BLOCK_SIZE;
+        }
+
+        bool all_erased = true;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t address = offset + i * INTEGRITY_SECTOR_SIZE + done;
+            uint8_t *chunk = chunks + (size_t)i * SRC_HASH_BLOCK_SIZE;
+            if (!spi_flash_read(address, chunk, part)) {
+                if (started) {
+                    crypto_sha256_batch_final(&ctx, hashes);
+                }
+                return false;
+            }
+            integrity_note_read(address, chunk, part);
+            all_erased = all_erased && integrity_is_erased(chunk, part);
+        }
+
+        /* Like a leaf context: no hashing while everything is erased */
+        if (!started) {
+            if (all_erased) {
+                erased += part;
+                continue;
+            }
+            if (crypto_sha256_batch_init(&ctx, count) != CRYPTO_SUCCESS) {
+                return false;
+            }
+            started = true;
+            for (size_t skipped = 0; skipped < erased; skipped += SRC_HASH_BLOCK_SIZE) {
+                crypto_sha256_batch_update(&ctx, fill, SRC_HASH_BLOCK_SIZE);
+            }
+        }
+        crypto_sha256_batch_update(&ctx, lanes, part);
+    }
+
+    if (started) {
+        return crypto_sha256_batch_final(&ctx, hashes) == CRYPTO_SUCCESS;
+    }
+
+    /* All erased: the precomputed leaf */
+    integrity_leaf_ctx_t leaf_ctx;
+    integrity_leaf_init(&leaf_ctx);
+    leaf_ctx.erased = erased;
+    if (!integrity_leaf_final(&leaf_ctx, hashes[0])) {
+        return false;
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        memcpy(hashes[i], hashes[0], sizeof(hashes[i]));
+    }
+    return true;
+}
+
+/**
+ * Compare one sector's hash against its leaf and record the outcome
+ */
+static void integrity_record(uint32_t sector, const uint8_t *hash,
+                             integrity_result_t *result) {
+    result->sectors_checked++;
+    if (memcmp(hash, leaves[sector], sizeof(leaves[sector])) == 0) {
+        MAP_CLEAR(dirty_map, sector);
+        return;
+    }
+
+    /* Keep it dirty so it is reported again until repaired */
+    if (result->sectors_bad == 0) {
+        result->first_bad_sector = sector;
+    }
+    result->sectors_bad++;
+    MAP_SET(result->bad_map, sector);
+}
+
+/**
+ * Verify one sector against its leaf and record the outcome
+ */
+static bool integrity_check_one(uint32_t sector, integrity_result_t *result) {
+    uint8_t hash[32];
+
+    if (!integrity_hash_sector(sector, hash)) {
+        return false;
+    }
+
+    integrity_record(sector, hash, result);
+    return true;
+}
+
+bool integrity_check_sectors(uint32_t first, uint32_t count,
+                             integrity_result_t *result) {
+    if (!result || !index_loaded ||
+        first >= INTEGRITY_MAX_SECTORS || count > INTEGRITY_MAX_SECTORS - first) {
+        return false;
+    }
+
+    memset(result, 0, sizeof(*result));
+
+    /* Full-size sectors go through multi-buffer SHA-256 in groups; the
+     * short last sector (if any) and a failed allocation go one by one */
+    uint8_t *chunks = NULL;
+    if (count > 1) {
+        chunks = malloc((size_t)(INTEGRITY_BATCH_SECTORS + 1) * SRC_HASH_BLOCK_SIZE);
+    }
+
+    uint32_t sector = first;
+    while (sector < first + count) {
+        if (!src_sched_checkpoint((sector - first) * INTEGRITY_SECTOR_SIZE,
+                                  count * INTEGRITY_SECTOR_SIZE)) {
+            free(chunks);
+            return false;
+        }
+        uint32_t group = first + count - sector;
+        if (group > INTEGRITY_BATCH_SECTORS) {
+            group = INTEGRITY_BATCH_SECTORS;
+        }
+        while (group > 0 && (sector + group) * (uint64_t)INTEGRITY_SECTOR_SIZE > FIRMWARE_REGION_SIZE) {
+            group--;
+        }
+
+        if (!chunks || group < 2) {
+            if (!integrity_check_one(sector, result)) {
+                free(chunks);
+                return false;
+            }
+            sector++;
+            continue;
+        }
+
+        uint8_t hashes[INTEGRITY_BATCH_SECTORS][32];
+        if (!integrity_hash_batch(sector, group, chunks, hashes)) {
+            free(chunks);
+            return false;
+        }
+        for (uint32_t i = 0; i < group; i++) {
+            integrity_record(sector + i, hashes[i], result);
+        }
+        sector += group;
+    }
+
+    free(chunks);
+    return true;
+}
+
+bool integrity_poll(integrity_result_t *result) {
+    if (!result || !index_loaded) {
+        return false;
+    }
+
+    memset(result, 0, sizeof(*result));
+
+    /* Sectors written since their last check */
+    uint8_t pending[INTEGRITY_MAP_BYTES];
+    memcpy(pending, dirty_map, sizeof(pending));
+    for (uint32_t sector = 0; sector < INTEGRITY_MAX_SECTORS; sector++) {
+        if (MAP_TEST(pending, sector) && !integrity_check_one(sector, result)) {
+            return false;
+        }
+    }
+
+    /* Rotating window catches changes made behind the driver's back */
+    for (uint32_t i = 0; i < INTEGRITY_SECTORS_PER_POLL && i < INTEGRITY_MAX_SECTORS; i++) {
+        uint32_t sector = poll_cursor;
+        poll_cursor = (poll_cursor + 1) % INTEGRITY_MAX_SECTORS;
+
+        if (!MAP_TEST(pending, sector) && !integrity_check_one(sector, result)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void integrity_invalidate_snapshot(void) {
+    snapshot.valid = false;
+}
+
+const integrity_snapshot_t *integrity_get_snapshot(void) {
+    uint32_t now = platform_get_timestamp();
+
+    if (snapshot.valid && snapshot.epoch == spi_flash_get_epoch() &&
+        now - snapshot.timestamp < INTEGRITY_SNAPSHOT_MAX_AGE_MS) {
+        return &snapshot;
+    }
+
+    /* Epoch is sampled first: a write during the check makes the
+     * snapshot stale rather than wrongly current */
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.epoch = spi_flash_get_epoch();
+    snapshot.timestamp = now;
+    snapshot.valid = true;
+
+    snapshot.config_ok = src_read_config(&snapshot.config);
+    if (!snapshot.config_ok) {
+        return &snapshot;
+    }
+    crypto_sha256((const uint8_t *)&snapshot.config, sizeof(snapshot.config),
+                  snapshot.config_hash);
+
+    /* Firmware: changed/rotating sectors if indexed, else one full pass */
+    if (integrity_is_available(snapshot.config.firmware_root)) {
+        snapshot.firmware_ok = integrity_poll(&snapshot.sectors);
+        snapshot.firmware_match = snapshot.firmware_ok &&
+                                  snapshot.sectors.sectors_bad == 0;
+    } else {
+        snapshot.full_hash = true;
+        snapshot.firmware_ok = src_hash_firmware(FIRMWARE_REGION_START,
+                                                 FIRMWARE_REGION_SIZE,
+                                                 snapshot.firmware_hash);
+        snapshot.firmware_match = snapshot.firmware_ok &&
+            memcmp(snapshot.firmware_hash, snapshot.config.firmware_hash,
+                   sizeof(snapshot.firmware_hash)) == 0;
+    }
+
+    return &snapshot;
+}
@@ -0,0 +1,183 @@
+/**
+ * Firmware Integrity Index
+ * Per-sector SHA-256 hashes of the firmware region, kept in the SRC
+ * reserved region and bound into a Merkle root stored in src_config_t.
+ * Integrity polls verify only a few sectors at a time (those written
+ * since the last check plus a rotating window) instead of the whole image.
+ * Full checks hash INTEGRITY_BATCH_SECTORS sectors at a time with
+ * multi-buffer SHA-256.
+ *
+ * Also keeps the erased-extent map: which INTEGRITY_EXTENT_SIZE blocks of
+ * the firmware region read as erased (0xFF), learned from every flash
+ * read SRC hashes and kept current by the SPI write observer. Writes made
+ * behind the driver are not seen, so the map only ever saves work whose
+ * result is still checked against the flash contents.
+ */
+
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "recovery_core.h"
+#include "crypto.h"
+
+/* Index layout */
+#ifndef INTEGRITY_SECTOR_SIZE
+#define INTEGRITY_SECTOR_SIZE (64 * 1024)    // Firmware bytes per leaf
+#endif
+#define INTEGRITY_MAX_SECTORS ((FIRMWARE_REGION_SIZE + INTEGRITY_SECTOR_SIZE - 1) / INTEGRITY_SECTOR_SIZE)
+#define INTEGRITY_MAP_BYTES ((INTEGRITY_MAX_SECTORS + 7) / 8)
+#define INTEGRITY_SECTORS_PER_POLL 4         // Rotating window checked per poll
+#ifndef INTEGRITY_BATCH_SECTORS
+#define INTEGRITY_BATCH_SECTORS CRYPTO_SHA256_BATCH_MAX  // Sectors hashed together by full checks
+#endif
+#define INTEGRITY_SNAPSHOT_MAX_AGE_MS (60 * 1000)  // Re-check even without writes
+#define INTEGRITY_EXTENT_SIZE 4096           // Erased-extent map granularity
+#define INTEGRITY_MAX_EXTENTS ((FIRMWARE_REGION_SIZE + INTEGRITY_EXTENT_SIZE - 1) / INTEGRITY_EXTENT_SIZE)
+#define INTEGRITY_EXTENT_MAP_BYTES ((INTEGRITY_MAX_EXTENTS + 7) / 8)
+#define INTEGRITY_MAGIC 0x58444953           // "SIDX"
+#define INTEGRITY_VERSION 1
+
+/* Stored at SRC_INTEGRITY_INDEX_START, followed by the leaf hashes */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sector_count;
+    uint32_t sector_size;
+    uint32_t region_start;
+    uint32_t region_size;
+    uint8_t root[32];        // Merkle root over the leaves
+    uint8_t reserved[12];
+} integrity_header_t;
+
+/* Outcome of a sector check */
+typedef struct {
+    uint32_t sectors_checked;
+    uint32_t sectors_bad;
+    uint32_t first_bad_sector;          // Valid when sectors_bad > 0
+    uint8_t bad_map[INTEGRITY_MAP_BYTES];  // One bit per sector
+} integrity_result_t;
+
+/* Integrity snapshot
+ * One config read + firmware check, shared by every consumer until the
+ * flash changes (spi_flash_get_epoch()) or the snapshot gets too old.
+ */
+typedef struct {
+    bool valid;
+    uint32_t epoch;                 // Flash epoch the snapshot describes
+    uint32_t timestamp;             // When it was taken
+    bool config_ok;                 // Config could be read
+    src_config_t config;
+    uint8_t config_hash[32];
+    bool firmware_ok;               // Firmware check completed
+    bool firmware_match;            // Firmware matches the config baseline
+    bool full_hash;                 // firmware_hash covers the whole region
+    uint8_t firmware_hash[32];      // Zero when the sector index was used
+    integrity_result_t sectors;     // Sector outcome when the index was used
+} integrity_snapshot_t;
+
+/* Leaf hash computed piece by piece
+ * Leading 0xFF bytes are only hashed once other data shows up, so a fully
+ * erased sector costs a scan and gets the precomputed erased leaf.
+ */
+typedef struct {
+    crypto_sha256_ctx_t ctx;
+    size_t erased;                  // Leading 0xFF bytes not hashed yet
+    bool populated;                 // Something other than 0xFF was seen
+} integrity_leaf_ctx_t;
+
+/**
+ * Initialize integrity tracking
+ * Starts recording which sectors are written through the SPI driver
+ */
+bool integrity_init(void);
+
+/**
+ * Build the index for a new baseline image and store it in flash
+ * hashes: leaf hash of every sector, computed while the image was backed up
+ * root receives the Merkle root to store in src_config_t.firmware_root
+ */
+bool integrity_build(const uint8_t hashes[][32], uint8_t *root);
+
+/**
+ * Replace the leaves of count sectors (e.g. those a delta backup captured)
+ * and store the index; root receives the new Merkle root
+ */
+bool integrity_update_sectors(const uint32_t *sectors, const uint8_t hashes[][32],
+                              uint32_t count, uint8_t *root);
+
+/**
+ * Stored leaf hash of one sector (index must be available)
+ */
+bool integrity_get_leaf(uint32_t sector, uint8_t *hash);
+
+/**
+ * Check whether a usable index matching root is available
+ * Loads the stored index on first use; false means callers must fall
+ * back to hashing the whole region
+ */
+bool integrity_is_available(const uint8_t *root);
+
+/**
+ * Verify a range of sectors against the index
+ */
+bool integrity_check_sectors(uint32_t first, uint32_t count,
+                             integrity_result_t *result);
+
+/**
+ * Incremental poll: sectors written since they were last verified, plus the
+ * next INTEGRITY_SECTORS_PER_POLL sectors of a rotating window, so every
+ * sector is covered every sector_count / INTEGRITY_SECTORS_PER_POLL polls
+ */
+bool integrity_poll(integrity_result_t *result);
+
+/**
+ * Flash range covered by a sector (for reporting and localized repair)
+ */
+bool integrity_get_sector_range(uint32_t sector, uint32_t *offset, size_t *size);
+
+/**
+ * Leaf hashing (same result as SHA-256 over the sector's bytes)
+ */
+bool integrity_leaf_init(integrity_leaf_ctx_t *ctx);
+void integrity_leaf_update(integrity_leaf_ctx_t *ctx, const uint8_t *data, size_t size);
+bool integrity_leaf_final(integrity_leaf_ctx_t *ctx, uint8_t *hash);
+
+/**
+ * Check whether data is all 0xFF
+ */
+bool integrity_is_erased(const uint8_t *data, size_t size);
+
+/**
+ * Record what a flash read of the firmware region found
+ * Extents wholly inside [offset, offset + size) are marked erased or not.
+ */
+void integrity_note_read(uint32_t offset, const uint8_t *data, size_t size);
+
+/**
+ * True if every extent overlapping the range is known to be erased
+ * Only covers writes made through the SPI driver: callers must still
+ * verify whatever they do on the strength of it.
+ */
+bool integrity_extent_erased(uint32_t offset, size_t size);
+
+/**
+ * Merkle root over leaf hashes (RFC 6962 shape, 0x01-prefixed nodes)
+ */
+bool integrity_compute_root(const uint8_t leaves[][32], uint32_t count, uint8_t *root);
+
+/**
+ * Current integrity snapshot, refreshed only when stale
+ * Firmware is checked with integrity_poll() when an index for the config
+ * root exists, otherwise by hashing the whole region. Never returns NULL.
+ */
+const integrity_snapshot_t *integrity_get_snapshot(void);
+
+/**
+ * Force the next integrity_get_snapshot() to re-check
+ */
+void integrity_invalidate_snapshot(void);
+
+#endif /* INTEGRITY_H */
@@ -0,0 +1,286 @@
+/**
+ * In-Place JSON Tokenizer Implementation
+ */
+
+#include "json.h"
+#include <string.h>
+
+/* What may come next inside one container (or at the top level) */
+enum {
+    JSON_WANT_VALUE,
+    JSON_WANT_KEY,
+    JSON_WANT_COLON,
+    JSON_WANT_COMMA
+};
+
+typedef struct {
+    int token;              /* Container token, -1 at the top level */
+    uint8_t want;
+} json_level_t;
+
+static bool json_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool json_is_primitive_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') || c == '+' || c == '-' || c == '.';
+}
+
+/**
+ * Account for a new token at the current level; false if no value or key
+ * may appear here
+ */
+static bool json_place(json_level_t *level, json_token_t *tokens, json_type_t type) {
+    bool in_object = level->token >= 0 && tokens[level->token].type == JSON_OBJECT;
+
+    if (in_object && level->want == JSON_WANT_KEY) {
+        if (type != JSON_STRING) {
+            return false;
+        }
+        tokens[level->token].size++;
+        level->want = JSON_WANT_COLON;
+        return true;
+    }
+    if (level->want != JSON_WANT_VALUE) {
+        return false;
+    }
+    if (level->token >= 0 && !in_object) {
+        tokens[level->token].size++;
+    }
+    level->want = JSON_WANT_COMMA;
+    return true;
+}
+
+int json_parse(const char *json, size_t len, json_token_t *tokens, uint32_t max_tokens) {
+    json_level_t levels[JSON_MAX_DEPTH + 1];
+    uint32_t depth = 0;
+    uint32_t count = 0;
+
+    if (!json || !tokens || (uint64_t)len > UINT32_MAX) {
+        return JSON_ERROR_INVALID;
+    }
+    levels[0].token = -1;
+    levels[0].want = JSON_WANT_VALUE;
+
+    for (uint32_t pos = 0; pos < len; pos++) {
+        char c = json[pos];
+        json_level_t *level = &levels[depth];
+
+        if (json_is_space(c)) {
+            continue;
+        }
+
+        if (c == ':') {
+            if (level->want != JSON_WANT_COLON) {
+                return JSON_ERROR_INVALID;
+            }
+            level->want = JSON_WANT_VALUE;
+            continue;
+        }
+
+        if (c == ',') {
+            if (depth == 0 || level->want != JSON_WANT_COMMA) {
+                return JSON_ERROR_INVALID;
+            }
+            level->want = (tokens[level->token].type == JSON_OBJECT) ?
+                          JSON_WANT_KEY : JSON_WANT_VALUE;
+            continue;
+        }
+
+        if (c == '}' || c == ']') {
+            json_type_t type = (c == '}') ? JSON_OBJECT : JSON_ARRAY;
+            if (depth == 0 || tokens[level->token].type != type) {
+                return JSON_ERROR_INVALID;
+            }
+            /* Closing right after an opening or a complete member only */
+            bool empty = tokens[level->token].size == 0 &&
+                         level->want == (type == JSON_OBJECT ? JSON_WANT_KEY : JSON_WANT_VALUE);
+            if (!empty && level->want != JSON_WANT_COMMA) {
+                return JSON_ERROR_INVALID;
+            }
+            tokens[level->token].end = pos + 1;
+            depth--;
+            continue;
+        }
+
+        if (count == max_tokens) {
+            return JSON_ERROR_NOMEM;
+        }
+        json_token_t *token = &tokens[count];
+        memset(token, 0, sizeof(*token));
+
+        if (c == '{' || c == '[') {
+            token->type = (c == '{') ? JSON_OBJECT : JSON_ARRAY;
+            if (depth == JSON_MAX_DEPTH || !json_place(level, tokens, token->type)) {
+                return JSON_ERROR_INVALID;
+            }
+            token->start = pos;
+            depth++;
+            levels[depth].token = (int)count;
+            levels[depth].want = (token->type == JSON_OBJECT) ? JSON_WANT_KEY : JSON_WANT_VALUE;
+        } else if (c == '"') {
+            token->type = JSON_STRING;
+            if (!json_place(level, tokens, token->type)) {
+                return JSON_ERROR_INVALID;
+            }
+            token->start = pos + 1;
+            for (pos++; pos < len && json[pos] != '"'; pos++) {
+                if ((unsigned char)json[pos] < 0x20) {
+                    return JSON_ERROR_INVALID;
+                }
+                if (json[pos] == '\\') {
+                    pos++;
+                }
+            }
+            if (pos >= len) {
+                return JSON_ERROR_PARTIAL;
+            }
+            token->end = pos;
+        } else {
+            /* Numbers and true/false/null, up to the next delimiter */
+            if (!(c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')) {
+                return JSON_ERROR_INVALID;
+            }
+            token->type = JSON_PRIMITIVE;
+            if (!json_place(level, tokens, token->type)) {
+                return JSON_ERROR_INVALID;
+            }
+            token->start = pos;
+            while (pos + 1 < len && json_is_primitive_char(json[pos + 1])) {
+                pos++;
+            }
+            token->end = pos + 1;
+        }
+        count++;
+    }
+
+    if (depth != 0 || levels[0].want != JSON_WANT_COMMA) {
+        return JSON_ERROR_PARTIAL;
+    }
+    return (int)count;
+}
+
+int json_skip(const json_token_t *tokens, int count, int index) {
+    int next = index + 1;
+    while (next < count && tokens[next].start < tokens[index].end) {
+        next++;
+    }
+    return next;
+}
+
+int json_object_get(const char *json, const json_token_t *tokens, int count,
+                    int object, const char *key) {
+    if (object < 0 || object >= count || tokens[object].type != JSON_OBJECT) {
+        return -1;
+    }
+
+    int index = object + 1;
+    for (uint32_t i = 0; i < tokens[object].size && index + 1 < count; i++) {
+        if (json_string_equals(json, &tokens[index], key)) {
+            return index + 1;
+        }
+        index = json_skip(tokens, count, index + 1);
+    }
+    return -1;
+}
+
+int json_array_get(const json_token_t *tokens, int count, int array, uint32_t n) {
+    if (array < 0 || array >= count || tokens[array].type != JSON_ARRAY ||
+        n >= tokens[array].size) {
+        return -1;
+    }
+
+    int index = array + 1;
+    for (uint32_t i = 0; i < n && index < count; i++) {
+        index = json_skip(tokens, count, index);
+    }
+    return (index < count) ? index : -1;
+}
+
+bool json_string_equals(const char *json, const json_token_t *token, const char *text) {
+    size_t len = strlen(text);
+    return token->type == JSON_STRING &&
+           token->end - token->start == len &&
+           memcmp(json + token->start, text, len) == 0;
+}
+
+bool json_get_string(const char *json, const json_token_t *token, char *out, size_t size) {
+    if (token->type != JSON_STRING || size == 0) {
+        return false;
+    }
+
+    size_t used = 0;
+    for (uint32_t pos = token->start; pos < token->end; pos++) {
+        char c = json[pos];
+        if (c == '\\') {
+            switch (json[++pos]) {
+                case '"':  c = '"';  break;
+                case '\\': c = '\\'; break;
+                case '/':  c = '/';  break;
+                case 'b':  c = '\b'; break;
+                case 'f':  c = '\f'; break;
+                case 'n':  c = '\n'; break;
+                case 'r':  c = '\r'; break;
+                case 't':  c = '\t'; break;
+                default:
+                    return false;
+            }
+        }
+        if (used + 1 >= size) {
+            return false;
+        }
+        out[used++] = c;
+    }
+    out[used] = '\0';
+    return true;
+}
+
+bool json_get_u32(const char *json, const json_token_t *token, uint32_t *value) {
+    if (token->type != JSON_PRIMITIVE || token->end == token->start) {
+        return false;
+    }
+
+    uint64_t result = 0;
+    for (uint32_t pos = token->start; pos < token->end; pos++) {
+        char c = json[pos];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        result = result * 10 + (uint32_t)(c - '0');
+        if (result > UINT32_MAX) {
+            return false;
+        }
+    }
+    *value = (uint32_t)result;
+    return true;
+}
+
+static int json_hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool json_get_hex(const char *json, const json_token_t *token, uint8_t *out, size_t size) {
+    if (token->type != JSON_STRING || token->end - token->start != size * 2) {
+        return false;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        int high = json_hex_digit(json[token->start + 2 * i]);
+        int low = json_hex_digit(json[token->start + 2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = (uint8_t)((high << 4) | low);
+    }
+    return true;
+}
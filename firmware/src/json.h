@@ -0,0 +1,83 @@
+/**
+ * In-Place JSON Tokenizer
+ * Splits a JSON text into tokens that point back into the text, in one
+ * pass, with no heap and a caller-supplied token array. Nesting is limited
+ * to JSON_MAX_DEPTH, so the tokenizer's own stack use is fixed.
+ *
+ * Tokens come out in document order: a container is followed by its
+ * members, and the value of an object key is always the token after it.
+ * Strings are not unescaped in place; json_get_string() does that on copy.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSON_MAX_DEPTH 8
+
+/* json_parse() errors */
+#define JSON_ERROR_NOMEM -1      // More tokens than the array holds
+#define JSON_ERROR_INVALID -2    // Not JSON
+#define JSON_ERROR_PARTIAL -3    // Text ends inside a value
+
+typedef enum {
+    JSON_OBJECT = 1,
+    JSON_ARRAY = 2,
+    JSON_STRING = 3,
+    JSON_PRIMITIVE = 4           // Number, true, false or null
+} json_type_t;
+
+typedef struct {
+    json_type_t type;
+    uint32_t start;              // First byte (after the quote for strings)
+    uint32_t end;                // Past the last byte (before the quote for strings)
+    uint32_t size;               // Keys of an object, elements of an array
+} json_token_t;
+
+/**
+ * Tokenize len bytes of json
+ * Returns the number of tokens used, or a JSON_ERROR_* code.
+ */
+int json_parse(const char *json, size_t len, json_token_t *tokens, uint32_t max_tokens);
+
+/**
+ * Index of the token after index and everything nested in it
+ */
+int json_skip(const json_token_t *tokens, int count, int index);
+
+/**
+ * Index of the value stored under key in an object token, or -1
+ */
+int json_object_get(const char *json, const json_token_t *tokens, int count,
+                    int object, const char *key);
+
+/**
+ * Index of element n of an array token, or -1
+ */
+int json_array_get(const json_token_t *tokens, int count, int array, uint32_t n);
+
+/**
+ * True if a string token is exactly text, as written (no unescaping)
+ */
+bool json_string_equals(const char *json, const json_token_t *token, const char *text);
+
+/**
+ * Copy a string token, unescaped and NUL-terminated, into out
+ * Fails if it does not fit or uses \u escapes.
+ */
+bool json_get_string(const char *json, const json_token_t *token, char *out, size_t size);
+
+/**
+ * Read a non-negative integer token that fits in 32 bits
+ */
+bool json_get_u32(const char *json, const json_token_t *token, uint32_t *value);
+
+/**
+ * Read a string token of exactly 2 * size hex digits into size bytes
+ */
+bool json_get_hex(const char *json, const json_token_t *token, uint8_t *out, size_t size);
+
+#endif /* JSON_H */
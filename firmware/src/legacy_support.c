@@ -6,17 +6,18 @@
  */
 
 #include "legacy_support.h"
+#include "recovery_core.h"
 #include "platform.h"
 #include "spi_flash.h"
 #include <string.h>
 
-/* Known legacy motherboard signatures */
+/* Known legacy motherboard signatures (not matched against yet) */
 static const struct {
     const char *signature;
     legacy_motherboard_type_t type;
     uint32_t flash_size;
     bool has_ec;
-} legacy_boards[] = {
+} legacy_boards[] __attribute__((unused)) = {
     /* Legacy BIOS boards */
     {"AWARD", LEGACY_TYPE_BIOS_LEGACY, 4 * 1024 * 1024, false},
     {"AMI", LEGACY_TYPE_BIOS_LEGACY, 4 * 1024 * 1024, false},
@@ -164,22 +165,23 @@ bool legacy_spi_write(uint32_t offset, const uint8_t *buffer, size_t size,
         return false;
     }
     
-    /* Use appropriate sector size */
-    uint32_t sector_size = info->flash_sector_size;
-    
-    /* Erase sector before write if needed */
-    uint32_t sector_start = (offset / sector_size) * sector_size;
-    if (offset % sector_size == 0) {
-        if (!legacy_spi_erase(sector_start, info)) {
-            return false;
-        }
-    }
-    
     /* Use appropriate interface */
     if (info->spi_interface_type == 1) {
+        /* Use appropriate sector size */
+        uint32_t sector_size = info->flash_sector_size;
+        
+        /* Erase sector before write if needed */
+        uint32_t sector_start = (offset / sector_size) * sector_size;
+        if (offset % sector_size == 0) {
+            if (!legacy_spi_erase(sector_start, info)) {
+                return false;
+            }
+        }
+        
         return platform_lpc_write(offset, buffer, size);
     }
     
+    /* SPI write engine erases and preserves partial sectors itself */
     return spi_flash_write(offset, buffer, size);
 }
 
@@ -291,7 +293,8 @@ bool legacy_boot_detection_init(const legacy_board_info_t *info) {
     }
     
     /* Standard boot detection */
-    return platform_boot_detection_init();
+    platform_boot_detection_init();
+    return true;
 }
 
 /**
@@ -332,7 +335,7 @@ bool legacy_usb_init(const legacy_board_info_t *info) {
  */
 uint32_t legacy_get_src_region_offset(const legacy_board_info_t *info) {
     if (!info) {
-        return 0x100000;  // Default 1MB offset
+        return SRC_RESERVED_REGION_START;  // Default (after firmware)
     }
     
     /* For small flash, use smaller offset */
@@ -344,7 +347,7 @@ uint32_t legacy_get_src_region_offset(const legacy_board_info_t *info) {
         return 0x600000;  // 6MB offset for 8MB flash
     }
     
-    return 0x100000;  // Default 1MB offset
+    return SRC_RESERVED_REGION_START;  // Default (after firmware)
 }
 
 /**
@@ -0,0 +1,430 @@
+/**
+ * Persistent Log Store Implementation
+ *
+ * Segment layout: header, then records back to back from
+ * LOG_STORE_DATA_START, each a whole number of words. The rest of the
+ * segment stays erased, so the first record that is erased (words 0xFF),
+ * malformed or fails its CRC is the end.
+ */
+
+#include "log_store.h"
+#include "recovery_core.h"
+#include "spi_flash.h"
+#include <string.h>
+
+#if (SRC_LOG_STORE_START + SRC_LOG_STORE_SIZE) > (SRC_RESERVED_REGION_START + SRC_RESERVED_REGION_SIZE)
+#error "Log store does not fit the SRC reserved region"
+#endif
+
+/* Flushes program and erase every few seconds: never inside the measured image */
+#if (SRC_LOG_STORE_START < FIRMWARE_REGION_START + FIRMWARE_REGION_SIZE) && \
+    (SRC_LOG_STORE_START + SRC_LOG_STORE_SIZE > FIRMWARE_REGION_START)
+#error "Log store overlaps the firmware region"
+#endif
+
+#if (SRC_LOG_MAX_RECORD / 4) >= 0xFF
+#error "SRC_LOG_MAX_RECORD too large for the record length field"
+#endif
+
+#define LOG_STORE_DATA_START ((uint32_t)sizeof(log_segment_header_t))
+#define LOG_STORE_WINDOW_SIZE 256       // Read-ahead when walking records
+
+/* Index entry (RAM), one per segment */
+typedef struct {
+    uint32_t sequence;                  // 0: free (erased or unreadable)
+    uint32_t boot;
+    uint32_t tag;
+    uint32_t first_ms;
+    uint32_t last_ms;
+    uint32_t end;                       // Offset past the last record on flash
+} log_segment_t;
+
+static log_segment_t segments[LOG_STORE_MAX_SEGMENTS];
+static uint32_t store_base;             // First segment, segment-aligned
+static uint32_t segment_size;
+static uint32_t segment_count;
+static uint32_t erase_size;
+static bool store_ready = false;
+static uint32_t store_boot;
+static uint32_t store_tag;
+static uint32_t next_sequence;
+static int open_segment = -1;           // Appended to this boot
+
+/* Records not yet programmed, continuing the open segment */
+static uint8_t stage[LOG_STORE_STAGE_SIZE];
+static uint32_t stage_used;
+
+/* Flash bytes last read while walking records */
+static uint8_t window[LOG_STORE_WINDOW_SIZE];
+static uint32_t window_offset;
+static uint32_t window_size;            // 0: empty
+
+uint32_t log_store_crc32(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    crc = ~crc;
+    while (size--) {
+        crc ^= *bytes++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t log_store_segment_offset(uint32_t index) {
+    return store_base + index * segment_size;
+}
+
+/**
+ * Read through the window; reads ahead no further than limit
+ */
+static bool log_store_read(uint32_t offset, void *buffer, size_t size, uint32_t limit) {
+    if (size == 0) {
+        return true;
+    }
+    if (window_size == 0 || offset < window_offset ||
+        offset + size > window_offset + window_size) {
+        if (size > sizeof(window) || offset + size > limit) {
+            return false;
+        }
+        window_offset = offset;
+        window_size = limit - offset < sizeof(window) ? limit - offset : sizeof(window);
+        if (!spi_flash_read(window_offset, window, window_size)) {
+            window_size = 0;
+            return false;
+        }
+    }
+    memcpy(buffer, window + (offset - window_offset), size);
+    return true;
+}
+
+/**
+ * Read and check the record at offset of the segment at base; false at
+ * the end of its records (erased space, or a torn program)
+ */
+static bool log_store_load(uint32_t base, uint32_t offset, uint32_t end,
+                           log_store_entry_t *entry) {
+    log_store_record_t record;
+    if (offset + sizeof(record) > end ||
+        !log_store_read(base + offset, &record, sizeof(record), base + end)) {
+        return false;
+    }
+
+    size_t bytes = (size_t)record.words * sizeof(uint32_t);
+    if (bytes < sizeof(record) || bytes > SRC_LOG_MAX_RECORD || offset + bytes > end) {
+        return false;
+    }
+    entry->args_size = bytes - sizeof(record);
+    if (!log_store_read(base + offset + (uint32_t)sizeof(record), entry->args,
+                        entry->args_size, base + end)) {
+        return false;
+    }
+
+    uint32_t crc = record.crc;
+    record.crc = 0;
+    if (log_store_crc32(log_store_crc32(0, &record, sizeof(record)),
+                        entry->args, entry->args_size) != crc) {
+        return false;
+    }
+    entry->timestamp = record.timestamp;
+    entry->format = record.format;
+    entry->flags = record.flags;
+    return true;
+}
+
+/**
+ * Program a segment's seal from its index entry
+ */
+static bool log_store_seal(uint32_t index) {
+    const log_segment_t *segment = &segments[index];
+    uint32_t seal[3] = { segment->last_ms, segment->end, 0 };
+    seal[2] = log_store_crc32(0, seal, 2 * sizeof(uint32_t));
+    window_size = 0;
+    return spi_flash_program(log_store_segment_offset(index) +
+                             (uint32_t)offsetof(log_segment_header_t, last_ms),
+                             (const uint8_t *)seal, sizeof(seal));
+}
+
+/**
+ * Index one segment from its header, finding the end of an unsealed one
+ * by its records and sealing it
+ */
+static void log_store_scan(uint32_t index) {
+    log_segment_t *segment = &segments[index];
+    log_segment_header_t header;
+    uint32_t base = log_store_segment_offset(index);
+    memset(segment, 0, sizeof(*segment));
+
+    /* A torn or foreign header leaves the segment free */
+    if (!spi_flash_read(base, (uint8_t *)&header, sizeof(header)) ||
+        header.magic != LOG_STORE_MAGIC || header.version != LOG_STORE_VERSION ||
+        header.sequence == 0 ||
+        log_store_crc32(0, &header, offsetof(log_segment_header_t, header_crc)) != header.header_crc) {
+        return;
+    }
+    segment->sequence = header.sequence;
+    segment->boot = header.boot;
+    segment->tag = header.tag;
+    segment->first_ms = header.first_ms;
+    segment->last_ms = header.first_ms;
+    segment->end = LOG_STORE_DATA_START;
+
+    if (log_store_crc32(0, &header.last_ms, 2 * sizeof(uint32_t)) == header.seal_crc &&
+        header.end >= LOG_STORE_DATA_START && header.end <= segment_size) {
+        segment->last_ms = header.last_ms;
+        segment->end = header.end;
+        return;
+    }
+
+    /* Left open by a reset or power loss: keep the records that check */
+    log_store_entry_t entry;
+    while (log_store_load(base, segment->end, segment_size, &entry)) {
+        segment->last_ms = entry.timestamp;
+        segment->end += (uint32_t)(sizeof(log_store_record_t) + entry.args_size);
+    }
+    if (header.last_ms == 0xFFFFFFFF && header.end == 0xFFFFFFFF &&
+        header.seal_crc == 0xFFFFFFFF) {
+        log_store_seal(index);          /* A torn seal cannot be programmed again */
+    }
+}
+
+bool log_store_init(uint32_t tag) {
+    store_ready = false;
+    open_segment = -1;
+    stage_used = 0;
+    window_size = 0;
+    store_tag = tag;
+    memset(segments, 0, sizeof(segments));
+
+    erase_size = spi_flash_get_erase_size();
+    if (erase_size == 0) {
+        return false;
+    }
+    segment_size = (erase_size > LOG_STORE_MIN_SEGMENT) ? erase_size : LOG_STORE_MIN_SEGMENT;
+    if (segment_size % erase_size != 0) {
+        return false;
+    }
+
+    /* Whole segments inside the store area (large erase blocks lose some) */
+    uint32_t store_end = SRC_LOG_STORE_START + SRC_LOG_STORE_SIZE;
+    store_base = (SRC_LOG_STORE_START + segment_size - 1) / segment_size * segment_size;
+    segment_count = (store_end > store_base) ? (store_end - store_base) / segment_size : 0;
+    if (segment_count > LOG_STORE_MAX_SEGMENTS) {
+        segment_count = LOG_STORE_MAX_SEGMENTS;
+    }
+    if (segment_count < 2 || store_base + segment_count * segment_size > spi_flash_get_size()) {
+        return false;
+    }
+
+    uint32_t last_boot = 0;
+    next_sequence = 1;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        log_store_scan(i);
+        if (segments[i].sequence == 0) {
+            continue;
+        }
+        if (segments[i].sequence >= next_sequence) {
+            next_sequence = segments[i].sequence + 1;
+        }
+        if (segments[i].boot > last_boot) {
+            last_boot = segments[i].boot;
+        }
+    }
+    store_boot = last_boot + 1;
+    store_ready = true;
+    return true;
+}
+
+uint32_t log_store_boot(void) {
+    return store_ready ? store_boot : 0;
+}
+
+/**
+ * Erase the segment after the newest (the oldest, once all are used) and
+ * program its header
+ */
+static bool log_store_open(uint32_t timestamp) {
+    uint32_t index = 0;
+    uint32_t newest = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        if (segments[i].sequence > newest) {
+            newest = segments[i].sequence;
+            index = (i + 1) % segment_count;
+        }
+    }
+
+    log_segment_t *segment = &segments[index];
+    uint32_t base = log_store_segment_offset(index);
+    memset(segment, 0, sizeof(*segment));
+    window_size = 0;
+    for (uint32_t offset = 0; offset < segment_size; offset += erase_size) {
+        if (!spi_flash_erase_sector(base + offset)) {
+            return false;
+        }
+    }
+
+    log_segment_header_t header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = LOG_STORE_MAGIC;
+    header.version = LOG_STORE_VERSION;
+    header.boot = store_boot;
+    header.sequence = next_sequence;
+    header.tag = store_tag;
+    header.first_ms = timestamp;
+    header.header_crc = log_store_crc32(0, &header, offsetof(log_segment_header_t, header_crc));
+    if (!spi_flash_program(base, (const uint8_t *)&header, sizeof(header))) {
+        return false;
+    }
+
+    segment->sequence = next_sequence++;
+    segment->boot = store_boot;
+    segment->tag = store_tag;
+    segment->first_ms = timestamp;
+    segment->last_ms = timestamp;
+    segment->end = LOG_STORE_DATA_START;
+    open_segment = (int)index;
+    return true;
+}
+
+bool log_store_sync(void) {
+    if (!store_ready) {
+        return false;
+    }
+    if (open_segment < 0 || stage_used == 0) {
+        return true;
+    }
+
+    log_segment_t *segment = &segments[open_segment];
+    uint32_t offset = log_store_segment_offset((uint32_t)open_segment) + segment->end;
+    uint32_t size = stage_used;
+    stage_used = 0;
+    window_size = 0;
+    if (!spi_flash_program(offset, stage, size)) {
+        /* Part of it may be programmed: leave the rest of this segment
+         * to the scan at the next boot */
+        open_segment = -1;
+        return false;
+    }
+    segment->end += size;
+    return true;
+}
+
+bool log_store_append(uint32_t timestamp, uint16_t format, uint8_t flags,
+                      const uint8_t *args, size_t args_size) {
+    if (!store_ready || args_size > LOG_STORE_MAX_ARGS || (args_size && !args)) {
+        return false;
+    }
+
+    uint32_t bytes = (uint32_t)((sizeof(log_store_record_t) + args_size + 3) & ~(size_t)3);
+    if (open_segment >= 0 &&
+        segments[open_segment].end + stage_used + bytes > segment_size) {
+        /* Full: close it, the record goes to the next one */
+        bool sealed = log_store_sync() && log_store_seal((uint32_t)open_segment);
+        open_segment = -1;
+        if (!sealed) {
+            return false;
+        }
+    }
+    if (stage_used + bytes > sizeof(stage) && !log_store_sync()) {
+        return false;
+    }
+    if (open_segment < 0 && !log_store_open(timestamp)) {
+        return false;
+    }
+
+    log_store_record_t record = {
+        .words = (uint8_t)(bytes / sizeof(uint32_t)),
+        .flags = flags,
+        .format = format,
+        .timestamp = timestamp,
+        .crc = 0
+    };
+    uint8_t *slot = stage + stage_used;
+    memcpy(slot, &record, sizeof(record));
+    memcpy(slot + sizeof(record), args, args_size);
+    memset(slot + sizeof(record) + args_size, 0, bytes - sizeof(record) - args_size);
+    record.crc = log_store_crc32(0, slot, bytes);
+    memcpy(slot + offsetof(log_store_record_t, crc), &record.crc, sizeof(record.crc));
+
+    stage_used += bytes;
+    segments[open_segment].last_ms = timestamp;
+    return true;
+}
+
+/**
+ * Whether a segment can hold records in range
+ */
+static bool log_store_overlaps(const log_segment_t *segment, const log_range_t *range) {
+    return !range ||
+           ((range->boot == 0 || range->boot == segment->boot) &&
+            segment->first_ms <= range->end_ms && segment->last_ms >= range->start_ms);
+}
+
+bool log_store_next(log_cursor_t *cursor, const log_range_t *range,
+                    log_store_entry_t *entry) {
+    if (!store_ready || !cursor || !entry) {
+        return false;
+    }
+
+    for (;;) {
+        /* The cursor's segment, or the first written after it */
+        int index = -1;
+        for (uint32_t i = 0; i < segment_count; i++) {
+            if (segments[i].sequence != 0 && segments[i].sequence >= cursor->sequence &&
+                (index < 0 || segments[i].sequence < segments[index].sequence)) {
+                index = (int)i;
+            }
+        }
+        if (index < 0) {
+            return false;
+        }
+
+        const log_segment_t *segment = &segments[index];
+        if (segment->sequence != cursor->sequence || cursor->offset < LOG_STORE_DATA_START) {
+            cursor->sequence = segment->sequence;
+            cursor->offset = LOG_STORE_DATA_START;
+        }
+
+        uint32_t base = log_store_segment_offset((uint32_t)index);
+        if (log_store_overlaps(segment, range)) {
+            while (log_store_load(base, cursor->offset, segment->end, entry)) {
+                cursor->offset += (uint32_t)(sizeof(log_store_record_t) + entry->args_size);
+                if (!range ||
+                    (entry->timestamp >= range->start_ms && entry->timestamp <= range->end_ms)) {
+                    entry->boot = segment->boot;
+                    entry->tag = segment->tag;
+                    return true;
+                }
+            }
+        }
+
+        /* The open segment may still grow */
+        if (index == open_segment) {
+            cursor->offset = segment->end;
+            return false;
+        }
+        cursor->sequence = segment->sequence + 1;
+        cursor->offset = LOG_STORE_DATA_START;
+    }
+}
+
+bool log_store_clear(void) {
+    if (!store_ready) {
+        return false;
+    }
+
+    bool ok = true;
+    open_segment = -1;
+    stage_used = 0;
+    window_size = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        if (segments[i].sequence == 0) {
+            continue;
+        }
+        memset(&segments[i], 0, sizeof(segments[i]));
+        for (uint32_t offset = 0; offset < segment_size; offset += erase_size) {
+            ok = spi_flash_erase_sector(log_store_segment_offset(i) + offset) && ok;
+        }
+    }
+    return ok;
+}
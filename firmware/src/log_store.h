@@ -0,0 +1,108 @@
+/**
+ * Persistent Log Store
+ * Log records flushed from the RAM ring (logging.c) are appended to
+ * segments in the SRC reserved region, one erase block each, so they
+ * survive the reboot that follows a recovery.
+ *
+ * A segment belongs to one boot. Its header (boot number, sequence, first
+ * timestamp) is programmed when it is opened, and a seal (last timestamp,
+ * end of data) when it is closed. Segments are filled in physical order
+ * and the oldest is erased to make room, so every block sees the same
+ * number of erases. A small index in RAM holds each segment's boot and
+ * time range, and reads skip segments outside the range asked for.
+ *
+ * Power loss: each record carries a CRC and the first one that fails (a
+ * torn program) ends its segment. Segments whose header does not check
+ * are treated as erased, and segments left unsealed are scanned once at
+ * init and sealed then.
+ */
+
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "logging.h"
+
+#define LOG_STORE_MAGIC 0x474C5253      // "SRLG"
+#define LOG_STORE_VERSION 1
+#define LOG_STORE_MIN_SEGMENT 4096      // Segment = max(erase size, this)
+#define LOG_STORE_MAX_SEGMENTS 64
+#define LOG_STORE_STAGE_SIZE 256        // Records programmed per flash write
+
+/* At the start of each segment */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t boot;                      // Boot the records are from
+    uint32_t sequence;                  // Segment write order, from 1
+    uint32_t tag;                       // Set by the writer (format table id)
+    uint32_t first_ms;                  // Timestamp of the first record
+    uint32_t header_crc;                // CRC-32 of the fields above
+    /* Programmed when the segment is closed (0xFF until then) */
+    uint32_t last_ms;
+    uint32_t end;                       // Offset past the last record
+    uint32_t seal_crc;                  // CRC-32 of last_ms and end
+} log_segment_header_t;
+
+/* Record, followed by its arguments and padding to 4 bytes */
+typedef struct {
+    uint8_t words;                      // Length in words, header included (0xFF: erased)
+    uint8_t flags;
+    uint16_t format;
+    uint32_t timestamp;
+    uint32_t crc;                       // CRC-32 of the record with this field 0
+} log_store_record_t;
+
+#define LOG_STORE_MAX_ARGS (SRC_LOG_MAX_RECORD - sizeof(log_store_record_t))
+
+/* Record read back */
+typedef struct {
+    uint32_t boot;
+    uint32_t tag;
+    uint32_t timestamp;
+    uint16_t format;
+    uint8_t flags;
+    uint8_t args[LOG_STORE_MAX_ARGS];
+    size_t args_size;
+} log_store_entry_t;
+
+/**
+ * Scan the segment headers, seal segments left open and pick this boot's
+ * number; records appended from now on carry tag
+ * False if the flash has no room for two segments
+ */
+bool log_store_init(uint32_t tag);
+
+/* Boot number of records appended now (0 before init) */
+uint32_t log_store_boot(void);
+
+/**
+ * Stage one record; the stage is programmed when it fills
+ * Opens a segment (erasing the oldest) for the first record of a boot and
+ * when the open one is full.
+ */
+bool log_store_append(uint32_t timestamp, uint16_t format, uint8_t flags,
+                      const uint8_t *args, size_t args_size);
+
+/* Program staged records */
+bool log_store_sync(void);
+
+/**
+ * Next record at or after cursor within range (NULL: any), moving the
+ * cursor past it; false at the end of the log
+ * Staged records are not seen until log_store_sync(). The cursor stays in
+ * the open segment at its end, so reading on later picks up new records.
+ */
+bool log_store_next(log_cursor_t *cursor, const log_range_t *range,
+                    log_store_entry_t *entry);
+
+/* Erase every segment */
+bool log_store_clear(void);
+
+/* CRC-32 (IEEE), continuing from crc (0 to start) */
+uint32_t log_store_crc32(uint32_t crc, const void *data, size_t size);
+
+#endif /* LOG_STORE_H */
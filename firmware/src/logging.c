@@ -1,68 +1,599 @@
 /**
  * Logging Implementation
  * Stores logs in tamper-resistant storage
+ *
+ * Ring layout: records start on 4-byte boundaries and never wrap (a record
+ * that does not fit before the end starts at the beginning, and the bytes
+ * skipped hold nothing). Positions count bytes since boot, modulo 2^32.
+ * A record's first word is its own position, stored last: a reader takes
+ * a word equal to its position as a committed record, and skips anything
+ * else one word at a time. A copied record is valid if the head has not
+ * moved a whole ring past it meanwhile.
+ *
+ * Flushing follows the same rules from its own position, except that it
+ * stops at a word that is not committed yet rather than skipping it
+ * (only the last SRC_LOG_MAX_RECORD bytes of the ring can be skipped
+ * space). After the ring overran it, that position is most likely inside
+ * a record: it skips words to the next committed one, as a reader does.
  */
 
 #include "logging.h"
+#include "log_store.h"
 #include "platform.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 
-#define MAX_LOG_ENTRIES 1000
-#define MAX_LOG_SIZE 256
+#if (SRC_LOG_RING_SIZE & (SRC_LOG_RING_SIZE - 1)) != 0
+#error "SRC_LOG_RING_SIZE must be a power of two"
+#endif
+
+#define LOG_FORMAT_UNKNOWN 0xFFFF       // Format outside the src_log_fmt table
+#define LOG_TRUNCATED 0x01              // Arguments did not all fit
 
 typedef struct {
+    uint32_t pos;                       // Own ring position; written last
     uint32_t timestamp;
-    char message[MAX_LOG_SIZE];
+    uint16_t format;                    // Offset in the src_log_fmt table
+    uint8_t words;                      // Record length in words, header included
+    uint8_t flags;
+} log_record_t;
+
+#define LOG_MAX_ARGS (SRC_LOG_MAX_RECORD - sizeof(log_record_t))
+
+/* Record copied out of the ring */
+typedef struct {
+    log_record_t header;
+    uint8_t args[LOG_MAX_ARGS];
+    size_t args_size;
 } log_entry_t;
 
-static log_entry_t log_buffer[MAX_LOG_ENTRIES];
-static uint32_t log_index = 0;
+/* Format table, laid out by the linker (absent if nothing logs) */
+extern const char __start_src_log_fmt[] __attribute__((weak));
+extern const char __stop_src_log_fmt[] __attribute__((weak));
+
+static uint32_t log_ring[SRC_LOG_RING_SIZE / sizeof(uint32_t)];
+static atomic_uint log_head;            // Next free position
+static atomic_uint log_start;           // Oldest position not cleared
+static unsigned int log_flushed;        // Next position for the store
+static unsigned long log_lost;          // Bytes overrun before they were stored
+static uint32_t log_tag;                // Format table CRC, ties stored records to this build
 static bool logging_enabled = true;
+static bool logging_echo = false;
+
+/* Stored in place of records the ring lost before they were flushed */
+static const char log_lost_format[] __attribute__((section("src_log_fmt"), used)) =
+    "LOG: Ring overran, %lu bytes of records not stored";
+
+/* Argument classes of the conversions */
+typedef enum {
+    LOG_ARG_NONE,
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_PTR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING
+} log_arg_t;
+
+typedef struct {
+    const char *start;                  // The '%'
+    const char *end;                    // Past the conversion character
+    uint8_t stars;                      // '*' width/precision ints before the value
+    log_arg_t arg;
+} log_spec_t;
+
+/**
+ * Find the next conversion from *cursor ("%%" is literal text)
+ */
+static bool log_next_spec(const char **cursor, log_spec_t *spec) {
+    const char *p = *cursor;
+    for (;;) {
+        p = strchr(p, '%');
+        if (!p || p[1] == '\0') {
+            return false;
+        }
+        if (p[1] != '%') {
+            break;
+        }
+        p += 2;
+    }
+
+    spec->start = p++;
+    spec->stars = 0;
+    while (*p && strchr("-+ #0", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+
+    log_arg_t integer = LOG_ARG_INT;
+    if (*p == 'h') {
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (*p == 'l') {
+        integer = (p[1] == 'l') ? LOG_ARG_LLONG : LOG_ARG_LONG;
+        p += (p[1] == 'l') ? 2 : 1;
+    } else if (*p == 'j') {
+        integer = LOG_ARG_LLONG;
+        p++;
+    } else if (*p == 'z' || *p == 't') {
+        integer = LOG_ARG_SIZE;
+        p++;
+    } else if (*p == 'L') {
+        p++;
+    }
+
+    if (*p == '\0') {
+        return false;
+    }
+    if (strchr("diouxXc", *p)) {
+        spec->arg = integer;
+    } else if (*p == 's') {
+        spec->arg = LOG_ARG_STRING;
+    } else if (*p == 'p') {
+        spec->arg = LOG_ARG_PTR;
+    } else if (strchr("fFeEgGaA", *p)) {
+        spec->arg = LOG_ARG_DOUBLE;
+    } else {
+        spec->arg = LOG_ARG_NONE;
+    }
+    spec->end = p + 1;
+    *cursor = spec->end;
+    return true;
+}
+
+/* Stored width of an argument class (strings are length-prefixed) */
+static size_t log_arg_size(log_arg_t arg) {
+    switch (arg) {
+        case LOG_ARG_INT:    return sizeof(int);
+        case LOG_ARG_LONG:   return sizeof(long);
+        case LOG_ARG_LLONG:  return sizeof(long long);
+        case LOG_ARG_SIZE:   return sizeof(size_t);
+        case LOG_ARG_PTR:    return sizeof(void *);
+        case LOG_ARG_DOUBLE: return sizeof(double);
+        default:             return 0;
+    }
+}
+
+static const char *log_format(uint16_t id) {
+    if (id == LOG_FORMAT_UNKNOWN || !__start_src_log_fmt ||
+        id >= (size_t)(__stop_src_log_fmt - __start_src_log_fmt)) {
+        return NULL;
+    }
+    return __start_src_log_fmt + id;
+}
+
+/**
+ * Format a record's message (at most size - 1 characters, terminated)
+ */
+static void log_decode(const log_entry_t *entry, char *out, size_t size) {
+    const char *format = log_format(entry->header.format);
+    size_t len = 0;
+    if (!format) {
+        snprintf(out, size, "<unknown log format 0x%04X>", entry->header.format);
+        return;
+    }
+
+    const uint8_t *arg = entry->args;
+    const uint8_t *args_end = entry->args + entry->args_size;
+    const char *cursor = format;
+    const char *text = format;
+    log_spec_t spec = { 0 };
+    bool complete = true;
+    out[0] = '\0';
+
+    while (len < size - 1) {
+        bool more = log_next_spec(&cursor, &spec);
+        const char *text_end = more ? spec.start : text + strlen(text);
+
+        /* Literal text, "%%" as '%' */
+        while (text < text_end && len < size - 1) {
+            out[len++] = *text;
+            text += (text[0] == '%' && text[1] == '%') ? 2 : 1;
+        }
+        out[len] = '\0';
+        if (!more || len >= size - 1) {
+            break;
+        }
+
+        /* The conversion, with '*' replaced by the stored ints */
+        char conversion[32];
+        size_t clen = 0;
+        for (const char *c = spec.start; c < spec.end && clen < sizeof(conversion) - 12; c++) {
+            if (*c == '*') {
+                int star;
+                if (args_end - arg < (ptrdiff_t)sizeof(star)) {
+                    complete = false;
+                    break;
+                }
+                memcpy(&star, arg, sizeof(star));
+                arg += sizeof(star);
+                clen += (size_t)snprintf(conversion + clen, sizeof(conversion) - clen, "%d", star);
+            } else {
+                conversion[clen++] = *c;
+            }
+        }
+        conversion[clen] = '\0';
+
+        size_t width = spec.arg == LOG_ARG_STRING ? 1 : log_arg_size(spec.arg);
+        if (!complete || args_end - arg < (ptrdiff_t)width) {
+            complete = false;
+            break;
+        }
+
+        char *dest = out + len;
+        size_t room = size - len;
+        int written = 0;
+        union {
+            int i;
+            long l;
+            long long ll;
+            size_t z;
+            void *p;
+            double d;
+        } value;
+        if (spec.arg == LOG_ARG_STRING) {
+            char string[SRC_LOG_MAX_STRING + 1];
+            size_t string_len = *arg++;
+            if (string_len > SRC_LOG_MAX_STRING || args_end - arg < (ptrdiff_t)string_len) {
+                complete = false;
+                break;
+            }
+            memcpy(string, arg, string_len);
+            string[string_len] = '\0';
+            arg += string_len;
+            written = snprintf(dest, room, conversion, string);
+        } else {
+            memcpy(&value, arg, width);
+            arg += width;
+            switch (spec.arg) {
+                case LOG_ARG_INT:    written = snprintf(dest, room, conversion, value.i); break;
+                case LOG_ARG_LONG:   written = snprintf(dest, room, conversion, value.l); break;
+                case LOG_ARG_LLONG:  written = snprintf(dest, room, conversion, value.ll); break;
+                case LOG_ARG_SIZE:   written = snprintf(dest, room, conversion, value.z); break;
+                case LOG_ARG_PTR:    written = snprintf(dest, room, conversion, value.p); break;
+                case LOG_ARG_DOUBLE: written = snprintf(dest, room, conversion, value.d); break;
+                default:             written = snprintf(dest, room, "%s", conversion); break;
+            }
+        }
+        if (written > 0) {
+            len += ((size_t)written < room) ? (size_t)written : room - 1;
+        }
+        text = cursor;
+    }
+
+    if (!complete || (entry->header.flags & LOG_TRUNCATED)) {
+        snprintf(out + len, size - len, "...");
+    }
+}
 
 bool logging_init(void) {
-    memset(log_buffer, 0, sizeof(log_buffer));
-    log_index = 0;
+    /* Records of a previous init go to its boot */
+    logging_flush();
+
+    log_tag = 0;
+    if (__start_src_log_fmt) {
+        log_tag = log_store_crc32(0, __start_src_log_fmt,
+                                  (size_t)(__stop_src_log_fmt - __start_src_log_fmt));
+    }
+    if (!log_store_init(log_tag)) {
+        return false;
+    }
+    logging_flush();
     return true;
 }
 
-void src_log(const char *format, ...) {
+uint32_t logging_boot(void) {
+    return log_store_boot();
+}
+
+void logging_set_echo(bool echo) {
+    logging_echo = echo;
+}
+
+/**
+ * Reserve bytes of ring for one record
+ */
+static uint32_t log_reserve(uint32_t bytes) {
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_relaxed);
+    unsigned int pos;
+    do {
+        pos = head;
+        uint32_t room = SRC_LOG_RING_SIZE - pos % SRC_LOG_RING_SIZE;
+        if (room < bytes) {
+            pos += room;                /* Records do not wrap */
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&log_head, &head, pos + bytes,
+                                                    memory_order_acq_rel,
+                                                    memory_order_relaxed));
+    return pos;
+}
+
+void src_log_record(const char *format, const char *classes, ...) {
     if (!logging_enabled) {
         return;
     }
-    
-    if (log_index >= MAX_LOG_ENTRIES) {
-        log_index = 0;  // Wrap around
+
+    log_entry_t entry;
+    entry.header.timestamp = platform_get_timestamp();
+    entry.header.flags = 0;
+    entry.header.format = LOG_FORMAT_UNKNOWN;
+    if (__start_src_log_fmt && format >= __start_src_log_fmt && format < __stop_src_log_fmt &&
+        format - __start_src_log_fmt < LOG_FORMAT_UNKNOWN) {
+        entry.header.format = (uint16_t)(format - __start_src_log_fmt);
     }
-    
-    log_entry_t *entry = &log_buffer[log_index];
-    entry->timestamp = platform_get_timestamp();
-    
+
+    /* Raw arguments by their build-time classes; with the format checked
+     * against them, these are the widths the decoder reads back */
     va_list args;
-    va_start(args, format);
-    vsnprintf(entry->message, MAX_LOG_SIZE, format, args);
+    va_start(args, classes);
+    size_t used = 0;
+    for (const char *class = classes;
+         entry.header.format != LOG_FORMAT_UNKNOWN && *class; class++) {
+        union {
+            int i;
+            long l;
+            long long ll;
+            void *p;
+            double d;
+        } value;
+        size_t width = 0;
+        switch (*class) {
+            case SRC_LOG_ARG_STRING: {
+                const char *string = va_arg(args, const char *);
+                if (!string) {
+                    string = "(null)";
+                }
+                size_t string_len = strnlen(string, SRC_LOG_MAX_STRING);
+                if (LOG_MAX_ARGS - used < 1 + string_len) {
+                    entry.header.flags |= LOG_TRUNCATED;
+                    if (LOG_MAX_ARGS - used < 1) {
+                        break;
+                    }
+                    string_len = LOG_MAX_ARGS - used - 1;
+                }
+                entry.args[used++] = (uint8_t)string_len;
+                memcpy(entry.args + used, string, string_len);
+                used += string_len;
+                continue;
+            }
+            case SRC_LOG_ARG_LONG:   value.l = va_arg(args, long); width = sizeof(long); break;
+            case SRC_LOG_ARG_LLONG:  value.ll = va_arg(args, long long); width = sizeof(long long); break;
+            case SRC_LOG_ARG_PTR:    value.p = va_arg(args, void *); width = sizeof(void *); break;
+            case SRC_LOG_ARG_DOUBLE: value.d = va_arg(args, double); width = sizeof(double); break;
+            default:                 value.i = va_arg(args, int); width = sizeof(int); break;
+        }
+        if (entry.header.flags & LOG_TRUNCATED) {
+            break;
+        }
+        if (LOG_MAX_ARGS - used < width) {
+            entry.header.flags |= LOG_TRUNCATED;
+            break;
+        }
+        memcpy(entry.args + used, &value, width);
+        used += width;
+    }
     va_end(args);
-    
-    /* Also output to platform debug interface if available */
-    platform_debug_log(entry->message);
-    
-    log_index++;
+    entry.args_size = used;
+
+    /* Copy into the ring, then commit with the position word */
+    uint32_t bytes = (uint32_t)((sizeof(log_record_t) + used + 3) & ~(size_t)3);
+    uint32_t pos = log_reserve(bytes);
+    uint8_t *record = (uint8_t *)log_ring + pos % SRC_LOG_RING_SIZE;
+    entry.header.words = (uint8_t)(bytes / sizeof(uint32_t));
+    memcpy(record + sizeof(uint32_t), (const uint8_t *)&entry.header + sizeof(uint32_t),
+           sizeof(log_record_t) - sizeof(uint32_t));
+    memcpy(record + sizeof(log_record_t), entry.args, used);
+    atomic_store_explicit((_Atomic uint32_t *)record, pos, memory_order_release);
+
+    if (logging_echo) {
+        char message[SRC_LOG_MAX_LINE];
+        log_decode(&entry, message, sizeof(message));
+        platform_debug_log(message);
+    }
 }
 
-bool logging_read(uint8_t *buffer, size_t *size) {
-    if (!buffer || !size) {
+/**
+ * Copy the committed record at pos; false if there is none (or it was
+ * overwritten while being copied)
+ */
+static bool log_fetch(uint32_t pos, log_entry_t *entry) {
+    const uint8_t *record = (const uint8_t *)log_ring + pos % SRC_LOG_RING_SIZE;
+    if (atomic_load_explicit((_Atomic uint32_t *)record, memory_order_acquire) != pos) {
+        return false;
+    }
+
+    memcpy(&entry->header, record, sizeof(log_record_t));
+    size_t bytes = (size_t)entry->header.words * sizeof(uint32_t);
+    if (bytes < sizeof(log_record_t) || bytes > SRC_LOG_MAX_RECORD ||
+        pos % SRC_LOG_RING_SIZE + bytes > SRC_LOG_RING_SIZE) {
         return false;
     }
-    
-    /* Serialize log entries */
-    size_t available = sizeof(log_buffer);
-    if (*size < available) {
+    entry->args_size = bytes - sizeof(log_record_t);
+    memcpy(entry->args, record + sizeof(log_record_t), entry->args_size);
+
+    atomic_thread_fence(memory_order_acquire);
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_relaxed);
+    return head - pos <= SRC_LOG_RING_SIZE;
+}
+
+bool logging_flush(void) {
+    if (log_store_boot() == 0) {
         return false;
     }
-    
-    memcpy(buffer, log_buffer, sizeof(log_buffer));
-    *size = sizeof(log_buffer);
+
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_acquire);
+    uint32_t resync = 0;
+    if (head - log_flushed > SRC_LOG_RING_SIZE) {
+        log_lost += head - SRC_LOG_RING_SIZE - log_flushed;
+        log_flushed = head - SRC_LOG_RING_SIZE;
+        resync = SRC_LOG_MAX_RECORD;    /* The next record starts within one */
+    }
+
+    bool ok = true;
+    log_entry_t entry;
+    while (ok && log_flushed != head) {
+        if (!log_fetch(log_flushed, &entry)) {
+            if (resync > 0) {
+                log_flushed += sizeof(uint32_t);    /* Rest of an overrun record */
+                log_lost += sizeof(uint32_t);
+                resync -= sizeof(uint32_t);
+                continue;
+            }
+            uint32_t room = SRC_LOG_RING_SIZE - log_flushed % SRC_LOG_RING_SIZE;
+            if (room >= SRC_LOG_MAX_RECORD || head - log_flushed <= room) {
+                break;                  /* Still being written: next flush */
+            }
+            log_flushed += room;        /* Skipped before the wrap */
+            continue;
+        }
+        resync = 0;
+
+        if (log_lost) {
+            ok = log_store_append(entry.header.timestamp,
+                                  (uint16_t)(log_lost_format - __start_src_log_fmt), 0,
+                                  (const uint8_t *)&log_lost, sizeof(log_lost));
+            log_lost = ok ? 0 : log_lost;
+        }
+        ok = ok && log_store_append(entry.header.timestamp, entry.header.format,
+                                    entry.header.flags, entry.args, entry.args_size);
+        if (ok) {
+            log_flushed += (unsigned int)entry.header.words * sizeof(uint32_t);
+        }
+    }
+    return log_store_sync() && ok;
+}
+
+bool logging_flush_due(void) {
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_relaxed);
+    return log_store_boot() != 0 && head - log_flushed >= SRC_LOG_RING_SIZE / 4;
+}
+
+/**
+ * Text line of a record ("[boot:timestamp] message\n"); its length
+ */
+static size_t log_line(const log_entry_t *entry, uint32_t boot, uint32_t tag,
+                       char *line, size_t size) {
+    char message[SRC_LOG_MAX_LINE];
+    if (tag != log_tag) {
+        snprintf(message, sizeof(message), "<log format 0x%04X of another build>",
+                 entry->header.format);
+    } else {
+        log_decode(entry, message, sizeof(message));
+    }
+    int len = snprintf(line, size, "[%lu:%lu] %s\n", (unsigned long)boot,
+                       (unsigned long)entry->header.timestamp, message);
+    return (len < 0) ? 0 : ((size_t)len < size ? (size_t)len : size - 1);
+}
+
+/**
+ * Append a line if it fits; a line too long for the empty buffer is cut
+ */
+static bool log_put_line(uint8_t *buffer, size_t size, size_t *used,
+                         const char *line, size_t len) {
+    if (size - *used < len) {
+        if (*used != 0 || size == 0) {
+            return false;
+        }
+        len = size;
+        memcpy(buffer, line, len - 1);
+        buffer[len - 1] = '\n';
+    } else {
+        memcpy(buffer + *used, line, len);
+    }
+    *used += len;
+    return true;
+}
+
+static bool log_in_range(const log_range_t *range, uint32_t boot, uint32_t timestamp) {
+    return !range ||
+           ((range->boot == 0 || range->boot == boot) &&
+            timestamp >= range->start_ms && timestamp <= range->end_ms);
+}
+
+bool logging_read(log_cursor_t *cursor, const log_range_t *range,
+                  uint8_t *buffer, size_t *size) {
+    if (!buffer || !size) {
+        return false;
+    }
+
+    log_cursor_t oldest = { 0, 0 };
+    if (!cursor) {
+        cursor = &oldest;
+    }
+    size_t used = 0;
+    char line[SRC_LOG_MAX_LINE + 32];
+    log_entry_t entry;
+
+    if (logging_boot() != 0) {
+        logging_flush();
+        log_store_entry_t stored;
+        for (;;) {
+            log_cursor_t at = *cursor;
+            if (!log_store_next(cursor, range, &stored)) {
+                break;
+            }
+            entry.header.timestamp = stored.timestamp;
+            entry.header.format = stored.format;
+            entry.header.flags = stored.flags;
+            entry.args_size = stored.args_size;
+            memcpy(entry.args, stored.args, stored.args_size);
+            size_t len = log_line(&entry, stored.boot, stored.tag, line, sizeof(line));
+            if (!log_put_line(buffer, *size, &used, line, len)) {
+                *cursor = at;
+                break;
+            }
+        }
+        *size = used;
+        return true;
+    }
+
+    /* No store: the RAM ring, positions as offsets */
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_acquire);
+    unsigned int start = atomic_load_explicit(&log_start, memory_order_acquire);
+    unsigned int pos = cursor->offset;
+    if (cursor->sequence != 0 || pos - start > head - start) {
+        pos = start;
+    }
+    if (head - pos > SRC_LOG_RING_SIZE) {
+        pos = head - SRC_LOG_RING_SIZE;
+    }
+
+    while (pos != head) {
+        if (!log_fetch(pos, &entry)) {
+            pos += sizeof(uint32_t);
+            continue;
+        }
+        unsigned int next = pos + (unsigned int)entry.header.words * sizeof(uint32_t);
+        if (log_in_range(range, 0, entry.header.timestamp)) {
+            size_t len = log_line(&entry, 0, log_tag, line, sizeof(line));
+            if (!log_put_line(buffer, *size, &used, line, len)) {
+                break;
+            }
+        }
+        pos = next;
+    }
+
+    cursor->sequence = 0;
+    cursor->offset = pos;
+    *size = used;
     return true;
 }
 
@@ -71,8 +602,11 @@ bool logging_clear(void) {
     if (!platform_authenticate()) {
         return false;
     }
-    
-    memset(log_buffer, 0, sizeof(log_buffer));
-    log_index = 0;
-    return true;
+
+    /* Records before the head are no longer read back or stored */
+    unsigned int head = atomic_load_explicit(&log_head, memory_order_acquire);
+    atomic_store_explicit(&log_start, head, memory_order_release);
+    log_flushed = head;
+    log_lost = 0;
+    return log_store_boot() == 0 || log_store_clear();
 }
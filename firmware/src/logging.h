@@ -1,5 +1,26 @@
 /**
  * Tamper-Resistant Logging System
+ *
+ * src_log() does not format. Each call appends a binary record (timestamp,
+ * format ID, raw arguments) to a variable-length ring; text is only made
+ * by logging_read(), or on the host from a dump of the ring and the format
+ * table.
+ *
+ * Format IDs are resolved at build time: src_log() places its format
+ * string in the src_log_fmt section, and the ID is its offset there. The
+ * section is the string table (objcopy --only-section=src_log_fmt), so
+ * format strings must be literals. The argument classes are also fixed at
+ * build time, from the arguments' types, so logging only copies them; the
+ * format is parsed when records are decoded.
+ *
+ * Appending is lock-free (one compare-and-swap to reserve space) and
+ * reentrant: interrupt handlers and worker threads may log. When the ring
+ * is full, the oldest records are overwritten.
+ *
+ * logging_flush() moves records, still binary, from the ring to the
+ * persistent store on SPI flash (log_store.c), where they are kept across
+ * reboots under a boot number. Records from the ring that were overwritten
+ * before a flush are noted in the store as lost.
  */
 
 #ifndef LOGGING_H
@@ -7,17 +28,120 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
-/* Log message (tamper-resistant) */
-void src_log(const char *format, ...);
+#ifndef SRC_LOG_RING_SIZE
+#define SRC_LOG_RING_SIZE (16 * 1024)   // Ring bytes (power of two)
+#endif
+#define SRC_LOG_MAX_RECORD 128          // Header and arguments; longer ones are truncated
+#define SRC_LOG_MAX_STRING 48           // Bytes kept of a %s argument
+#define SRC_LOG_MAX_LINE 256            // Decoded message, timestamp excluded
 
-/* Initialize logging system */
+#define SRC_LOG_MAX_ARGS 8              // Arguments per src_log() call
+
+/* Argument classes, one per src_log() argument (after promotion) */
+#define SRC_LOG_ARG_INT 'i'
+#define SRC_LOG_ARG_LONG 'l'
+#define SRC_LOG_ARG_LLONG 'q'
+#define SRC_LOG_ARG_DOUBLE 'd'
+#define SRC_LOG_ARG_STRING 's'
+#define SRC_LOG_ARG_PTR 'p'             // Any other pointer
+
+#define SRC_LOG_ARG_CLASS(arg)                                              \
+    _Generic((arg),                                                         \
+        char *: SRC_LOG_ARG_STRING, const char *: SRC_LOG_ARG_STRING,       \
+        _Bool: SRC_LOG_ARG_INT, char: SRC_LOG_ARG_INT,                      \
+        signed char: SRC_LOG_ARG_INT, unsigned char: SRC_LOG_ARG_INT,       \
+        short: SRC_LOG_ARG_INT, unsigned short: SRC_LOG_ARG_INT,            \
+        int: SRC_LOG_ARG_INT, unsigned int: SRC_LOG_ARG_INT,                \
+        long: SRC_LOG_ARG_LONG, unsigned long: SRC_LOG_ARG_LONG,            \
+        long long: SRC_LOG_ARG_LLONG, unsigned long long: SRC_LOG_ARG_LLONG, \
+        float: SRC_LOG_ARG_DOUBLE, double: SRC_LOG_ARG_DOUBLE,              \
+        default: SRC_LOG_ARG_PTR),
+
+/* SRC_LOG_ARG_CLASS() of each argument, comma-separated */
+#define SRC_LOG_ARG_COUNT_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define SRC_LOG_ARG_COUNT(...) SRC_LOG_ARG_COUNT_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define SRC_LOG_ARG_CLASSES_0(...)
+#define SRC_LOG_ARG_CLASSES_1(a, ...) SRC_LOG_ARG_CLASS(a)
+#define SRC_LOG_ARG_CLASSES_2(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_1(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_3(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_2(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_4(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_3(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_5(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_4(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_6(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_5(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_7(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_6(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_8(a, ...) SRC_LOG_ARG_CLASS(a) SRC_LOG_ARG_CLASSES_7(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES__(n, ...) SRC_LOG_ARG_CLASSES_##n(__VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES_(n, ...) SRC_LOG_ARG_CLASSES__(n, __VA_ARGS__)
+#define SRC_LOG_ARG_CLASSES(...) \
+    SRC_LOG_ARG_CLASSES_(SRC_LOG_ARG_COUNT(__VA_ARGS__), ##__VA_ARGS__)
+
+/* Log message (tamper-resistant); at most SRC_LOG_MAX_ARGS arguments */
+#define src_log(format, ...)                                                \
+    do {                                                                    \
+        static const char src_log_format_[]                                 \
+            __attribute__((section("src_log_fmt"), used)) = format;         \
+        static const char src_log_args_[] = {                               \
+            SRC_LOG_ARG_CLASSES(__VA_ARGS__) '\0'                           \
+        };                                                                  \
+        src_log_record(src_log_format_, src_log_args_, ##__VA_ARGS__);      \
+    } while (0)
+
+/**
+ * Append a record; format must be a src_log_fmt string and classes the
+ * SRC_LOG_ARG_* of each argument, terminated (use src_log())
+ * Arguments are stored at the build's widths: int, long, size_t and
+ * pointers as the compiler passes them, %s as up to SRC_LOG_MAX_STRING
+ * bytes. long double is not supported.
+ */
+void src_log_record(const char *format, const char *classes, ...)
+    __attribute__((format(printf, 1, 3)));
+
+/* Position in the log; zeroed, the oldest record */
+typedef struct {
+    uint32_t sequence;                  // Store segment (0 when reading the RAM ring)
+    uint32_t offset;                    // In the segment, or ring position
+} log_cursor_t;
+
+/* Records wanted by logging_read() */
+typedef struct {
+    uint32_t boot;                      // 0 = any boot
+    uint32_t start_ms;                  // Timestamps, inclusive
+    uint32_t end_ms;
+} log_range_t;
+
+/**
+ * Initialize logging system; records logged before are kept
+ * Opens the persistent store and flushes to it once open. False if there
+ * is no store and logs are kept in RAM only.
+ */
 bool logging_init(void);
 
-/* Read log entries */
-bool logging_read(uint8_t *buffer, size_t *size);
+/**
+ * Read log records, oldest first, as text lines ("[boot:timestamp] message")
+ * Flushes, then streams records in range (NULL: all) from *cursor (NULL:
+ * the oldest), skipping store segments outside the range unread. Writes
+ * as many whole lines as fit in *size bytes, sets *size to the bytes
+ * written and moves the cursor past them; 0 bytes means no more records.
+ * A line longer than the whole buffer is cut to fit. Without a store,
+ * reads the RAM ring.
+ */
+bool logging_read(log_cursor_t *cursor, const log_range_t *range,
+                  uint8_t *buffer, size_t *size);
+
+/* Move records from the RAM ring to the persistent store (main loop only) */
+bool logging_flush(void);
+
+/* True once a quarter of the ring is waiting for logging_flush() */
+bool logging_flush_due(void);
+
+/* Boot number records are stored under (0 without a store) */
+uint32_t logging_boot(void);
 
 /* Clear logs (requires authentication) */
 bool logging_clear(void);
 
+/* Also decode every record to platform_debug_log() as it is logged */
+void logging_set_echo(bool echo);
+
 #endif /* LOGGING_H */
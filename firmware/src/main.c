@@ -5,6 +5,7 @@
  */
 
 #include "recovery_core.h"
+#include "scheduler.h"
 #include "platform.h"
 #include <stdint.h>
 
@@ -12,7 +13,7 @@
  * Firmware entry point
  * Called by bootloader or directly from reset vector
  */
-void main(void) {
+int main(void) {
     /* Initialize platform first */
     platform_init();
     
@@ -23,7 +24,9 @@ void main(void) {
     while (1) {
         src_main_loop();
         
-        /* Platform-specific delay/yield */
-        platform_delay_ms(100);
+        /* Sleep until a task is due or an interrupt queues an event */
+        platform_wait_event(src_sched_idle_ms());
     }
+    
+    return 0;
 }
@@ -10,11 +10,25 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-/* SPI Flash */
+/* SPI Flash
+ * platform_spi_write() programs at most one page and never crosses a page
+ * boundary; platform_spi_erase() erases one erase block. Both may return
+ * while the chip is still busy; the core polls platform_spi_is_busy()
+ * before the next operation.
+ */
+typedef struct {
+    uint32_t page_size;          /* Page program size (typically 256) */
+    uint32_t erase_size;         /* Smallest erase block (typically 4096) */
+    uint32_t page_program_us;    /* Typical page program time */
+    uint32_t sector_erase_ms;    /* Typical erase block time */
+} platform_spi_chip_info_t;
+
 bool platform_spi_init(void);
 bool platform_spi_read(uint32_t offset, uint8_t *buffer, size_t size);
 bool platform_spi_write(uint32_t offset, const uint8_t *buffer, size_t size);
 bool platform_spi_erase(uint32_t offset);
+bool platform_spi_is_busy(void);
+bool platform_spi_get_chip_info(platform_spi_chip_info_t *info);
 bool platform_spi_lock(void);
 bool platform_spi_unlock(void);
 uint32_t platform_spi_get_size(void);
@@ -24,29 +38,188 @@ bool platform_usb_init(void);
 bool platform_usb_is_present(void);
 bool platform_usb_read_file(const char *path, uint8_t *buffer, size_t *size);
 bool platform_usb_write_file(const char *path, const uint8_t *buffer, size_t size);
+bool platform_usb_append_file(const char *path, const uint8_t *buffer, size_t size);
 bool platform_usb_delete_file(const char *path);
 bool platform_usb_file_exists(const char *path);
 bool platform_usb_rename_file(const char *old_path, const char *new_path);
 
+/* USB directory entries
+ * platform_usb_stat() reports a file's size without reading its data.
+ * platform_usb_list_dir() reads a whole directory in one go, storing up to
+ * max_entries entries; *count receives how many the directory holds, which
+ * may be more. Names longer than PLATFORM_USB_NAME_MAX - 1 are left out. */
+#define PLATFORM_USB_NAME_MAX 16
+
+typedef struct {
+    char name[PLATFORM_USB_NAME_MAX];
+    uint32_t size;
+    bool is_dir;
+} platform_usb_dirent_t;
+
+bool platform_usb_stat(const char *path, platform_usb_dirent_t *entry);
+bool platform_usb_list_dir(const char *path, platform_usb_dirent_t *entries,
+                           uint32_t max_entries, uint32_t *count);
+
+/* Chunked USB reads (streaming recovery)
+ * platform_usb_read_start() queues a read of up to size bytes at offset into
+ * buffer and may return before the transfer completes. Reads complete in
+ * the order they were queued; platform_usb_read_wait() blocks until the
+ * oldest queued read is done and reports the bytes read (0 past EOF).
+ * Platforms without asynchronous transfers may complete the read inside
+ * platform_usb_read_start(). */
+bool platform_usb_read_start(const char *path, uint32_t offset,
+                             uint8_t *buffer, size_t size);
+bool platform_usb_read_wait(size_t *size);
+
+/* DMA buffers
+ * A pool of buffers in memory the USB and SPI controllers reach by DMA.
+ * A buffer has one owner at a time: platform_dma_alloc() hands it to the
+ * caller, platform_usb_read_start_dma() hands it to the USB controller,
+ * and completing that read (in platform_usb_read_wait()) sets length and
+ * hands it back through the callback. The owner can then hash it and pass
+ * it to platform_spi_write() as is, and finally returns it with
+ * platform_dma_free(). Other memory may cost the platform a copy through
+ * a bounce buffer on every transfer. Allocation is thread-safe.
+ */
+#define PLATFORM_DMA_BUFFER_SIZE (16 * 1024)
+#ifndef PLATFORM_DMA_BUFFERS
+#define PLATFORM_DMA_BUFFERS 4
+#endif
+
+typedef struct platform_dma_buffer platform_dma_buffer_t;
+
+/* Runs when the transfer queued on buffer completes (ok = no error) */
+typedef void (*platform_dma_callback_t)(platform_dma_buffer_t *buffer, bool ok);
+
+struct platform_dma_buffer {
+    uint8_t *data;                      /* PLATFORM_DMA_BUFFER_SIZE bytes */
+    size_t length;                      /* Bytes the last transfer moved */
+    platform_dma_callback_t callback;   /* Set when a transfer is queued */
+    void *context;                      /* The owner's */
+};
+
+platform_dma_buffer_t *platform_dma_alloc(void);     /* NULL when all are owned */
+void platform_dma_free(platform_dma_buffer_t *buffer);       /* NULL is ignored */
+bool platform_usb_read_start_dma(const char *path, uint32_t offset,
+                                 platform_dma_buffer_t *buffer, size_t size,
+                                 platform_dma_callback_t callback);
+
+/* USB block device
+ * Boards whose USB stack stops at the block device (no file system of its
+ * own) provide these two and implement the read calls above by forwarding
+ * to fat32_*() in fat32.c, which reads whole runs of sectors at a time.
+ * max_transfer_blocks is the largest count one platform_usb_read_blocks()
+ * call accepts. fat32.c is not reentrant; platforms with threads serialize
+ * their calls into it, and platforms that also write the stick call
+ * fat32_unmount() after each write. Boards with raw bulk pipes get both
+ * from usb_bot.c. Others return false here.
+ */
+typedef struct {
+    uint32_t block_size;            /* Bytes per block (fat32.c needs 512) */
+    uint32_t block_count;
+    uint32_t max_transfer_blocks;   /* Blocks per read (e.g. 128 for 64KB) */
+} platform_usb_block_info_t;
+
+bool platform_usb_get_block_info(platform_usb_block_info_t *info);
+bool platform_usb_read_blocks(uint32_t lba, uint8_t *buffer, uint32_t count);
+
 /* Boot Detection */
 void platform_boot_detection_init(void);
 
-/* Crypto */
+/* Crypto
+ * platform_sha256*() are the hash hook points. Message-level hash engines
+ * (STM32 HASH and others that pad by themselves) implement them against the
+ * engine and may use the context fields as they see fit; others forward to
+ * sha256_*() in sha256.c, which uses SHA-NI / ARMv8 CE when built in.
+ *
+ * Block-level engines (take a chaining state and whole 64-byte blocks)
+ * define PLATFORM_SHA256_BLOCKS in the platform build and provide the two
+ * functions below; sha256.c then prefers them after a known-answer test.
+ */
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;        /* Total bytes hashed */
+    uint8_t block[64];      /* Pending partial block */
+    size_t block_used;
+} platform_sha256_ctx_t;
+
+/* Multi-buffer SHA-256: up to PLATFORM_SHA256_BATCH_MAX messages of the
+ * same length hashed together (SIMD lanes). Same hook rules as above;
+ * others forward to sha256_batch_*() in sha256_mb.c.
+ */
+#define PLATFORM_SHA256_BATCH_MAX 16
+
+typedef struct {
+    uint32_t state[PLATFORM_SHA256_BATCH_MAX][8];
+    uint8_t block[PLATFORM_SHA256_BATCH_MAX][64];   /* Pending partial blocks */
+    uint64_t length;                                /* Bytes per message */
+    size_t block_used;
+    size_t count;                                   /* Messages in the batch */
+} platform_sha256_batch_ctx_t;
+
+#ifdef PLATFORM_SHA256_BLOCKS
+void platform_sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks);
+bool platform_sha256_blocks_ready(void);
+#endif
+
 bool platform_crypto_init(void);
 void platform_sha256(const uint8_t *data, size_t size, uint8_t *hash);
+void platform_sha256_init(platform_sha256_ctx_t *ctx);
+void platform_sha256_update(platform_sha256_ctx_t *ctx,
+                            const uint8_t *data, size_t size);
+void platform_sha256_final(platform_sha256_ctx_t *ctx, uint8_t *hash);
+void platform_sha256_batch_init(platform_sha256_batch_ctx_t *ctx, size_t count);
+void platform_sha256_batch_update(platform_sha256_batch_ctx_t *ctx,
+                                  const uint8_t *const data[], size_t size);
+void platform_sha256_batch_final(platform_sha256_batch_ctx_t *ctx, uint8_t hashes[][32]);
 bool platform_sign(const uint8_t *data, size_t size, 
                   uint8_t *signature, size_t *sig_size);
 bool platform_verify(const uint8_t *data, size_t size, 
                     const uint8_t *signature, size_t sig_size);
 
+/* Device-bound secret (e.g. fused or derived in a secure element), used to
+ * MAC state the core keeps in SPI flash; false if the board has none */
+bool platform_get_device_key(uint8_t key[32]);
+
+/* Identifier (e.g. SHA-256) of the public key platform_verify() checks
+ * against; changes whenever that key is rotated */
+bool platform_get_verify_key_id(uint8_t key_id[32]);
+
+/* Worker threads (optional)
+ * Boards with an OS or a second core define PLATFORM_THREADS and provide
+ * these; recovery then verifies its candidate images in parallel. Workers
+ * only use queued USB reads (tracked per thread) and SHA-256. SPI flash,
+ * logging and configuration stay on the thread that started them.
+ */
+#ifdef PLATFORM_THREADS
+typedef struct {
+    void *handle;
+} platform_thread_t;
+
+bool platform_thread_create(platform_thread_t *thread,
+                            void (*entry)(void *arg), void *arg);
+void platform_thread_join(platform_thread_t *thread);
+#endif
+
 /* System */
 uint32_t platform_get_timestamp(void);
+
+/* Tickless idle
+ * platform_wait_event() sleeps (wake-up timer plus WFE/WFI, no periodic
+ * tick) until platform_signal_event() is called, typically from an
+ * interrupt handler, or timeout_ms passes. It returns at once if an event
+ * was signalled since it last returned. platform_signal_event() is
+ * interrupt safe.
+ */
+void platform_wait_event(uint32_t timeout_ms);
+void platform_signal_event(void);
 void system_reboot(void);
 void src_enter_safe_mode(void);
 bool platform_authenticate(void);
 void platform_debug_log(const char *message);
 void platform_init(void);
 void platform_delay_ms(uint32_t ms);
+void platform_delay_us(uint32_t us);
 
 /* Legacy motherboard support functions */
 bool platform_has_ec(void);
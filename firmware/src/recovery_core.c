@@ -12,20 +12,86 @@
 #include "logging.h"
 #include "platform.h"
 #include "legacy_support.h"
+#include "integrity.h"
+#include "verify_cache.h"
+#include "image_codec.h"
+#include "scheduler.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdatomic.h>
+
+#if (FIRMWARE_REGION_SIZE % INTEGRITY_SECTOR_SIZE) != 0
+#error "Delta backups need whole integrity sectors in the firmware region"
+#endif
+
+#if (INTEGRITY_SECTOR_SIZE % IMAGE_CODEC_BLOCK_SIZE) != 0
+#error "Full backups hash integrity sectors from whole codec blocks"
+#endif
+
+#if (SRC_BACKUP_WRITE_SIZE % 512) != 0 || SRC_BACKUP_WRITE_SIZE < IMAGE_CODEC_MAX_BLOCK_OUT
+#error "Full backup writes must be whole sectors and hold one block"
+#endif
+
+#if SRC_RECOVERY_CHUNK_SIZE > PLATFORM_DMA_BUFFER_SIZE
+#error "Recovery chunks must fit a DMA buffer"
+#endif
+
+#if SRC_DELTA_MAX_CHAIN > 99
+#error "Delta patch names have room for two digits"
+#endif
+
+#if IMAGE_CODEC_BLOCK_SIZE != SRC_RECOVERY_CHUNK_SIZE
+#error "Chunk digests need decoded blocks of one recovery chunk"
+#endif
 
 /* Global State */
 static src_state_t current_state = SRC_STATE_INIT;
 static src_config_t config;
-static boot_status_t boot_status;
 static uint32_t boot_start_timestamp = 0;
 static bool removal_scheduled = false;
 static legacy_board_info_t legacy_info;
 static bool legacy_detected = false;
 
+/* Main loop tasks
+ * The boot task takes boot events as they are queued, and otherwise wakes
+ * only for the boot timeout or the end of a temporary disable. It never
+ * blocks, so it keeps up with events while the job task is backing up or
+ * recovering, from the checkpoints in their streaming loops. The job task
+ * runs as soon as another task changes the state. The log task moves the
+ * RAM log to flash when nothing else is due, or sooner once the ring fills.
+ */
+static src_task_result_t src_boot_task(src_task_t *task);
+static src_task_result_t src_job_task(src_task_t *task);
+static src_task_result_t src_log_task(src_task_t *task);
+static bool src_job_ready(void);
+
+static src_task_t boot_task = {
+    .name = "boot",
+    .body = src_boot_task,
+    .priority = SRC_TASK_PRIORITY_BOOT,
+    .period_ms = SRC_BOOT_CHECK_MS,
+    .ready = boot_detection_pending
+};
+static src_task_t job_task = {
+    .name = "job",
+    .body = src_job_task,
+    .priority = SRC_TASK_PRIORITY_JOB,
+    .period_ms = SRC_JOB_POLL_MS,
+    .ready = src_job_ready
+};
+static src_task_t log_task = {
+    .name = "log",
+    .body = src_log_task,
+    .priority = SRC_TASK_PRIORITY_LOG,
+    .period_ms = SRC_LOG_FLUSH_MS,
+    .ready = logging_flush_due
+};
+static src_job_t current_job = SRC_JOB_NONE;
+static src_state_t job_state_seen = SRC_STATE_INIT;  // State after the job task's last turn
+static uint32_t backup_cancelled_at;
+
 /**
  * Initialize Recovery Core
  */
@@ -37,7 +103,7 @@ void src_init(void) {
     legacy_detected = legacy_detect_motherboard(&legacy_info);
     if (legacy_detected) {
         src_log("SRC: Legacy motherboard detected (type: %d, flash: %lu MB)",
-                legacy_info.type, legacy_info.flash_size / (1024 * 1024));
+                legacy_info.type, (unsigned long)(legacy_info.flash_size / (1024 * 1024)));
     }
     
     /* Initialize hardware interfaces with legacy support */
@@ -59,7 +125,7 @@ void src_init(void) {
     }
     
     if (!logging_init()) {
-        src_log("SRC: WARNING - Logging initialization failed");
+        src_log("SRC: WARNING - No persistent log store, logs kept in RAM only");
     }
     
     if (!src_usb_init()) {
@@ -74,6 +140,14 @@ void src_init(void) {
         strncpy(config.board_id, "DEFAULT", sizeof(config.board_id) - 1);
     }
     
+    /* Track firmware writes for incremental integrity checks */
+    integrity_init();
+    
+    /* Images verified on earlier boots skip the public-key operation */
+    if (!verify_cache_init()) {
+        src_log("SRC: No device key, signature verifications are not cached");
+    }
+    
     /* Check if removal is scheduled (read from config) */
     /* In production, this would be stored in a separate flag */
     if (removal_scheduled) {
@@ -85,8 +159,8 @@ void src_init(void) {
     /* Check if temporarily disabled */
     if (src_is_disabled()) {
         current_state = SRC_STATE_DISABLED;
-        uint32_t remaining = config.disable_until_timestamp - src_get_timestamp();
-        src_log("SRC: Temporarily disabled, %lu ms remaining", remaining);
+        uint32_t remaining = config.disable_until_timestamp - platform_get_timestamp();
+        src_log("SRC: Temporarily disabled, %lu ms remaining", (unsigned long)remaining);
         return;
     }
     
@@ -111,322 +185,2126 @@ void src_init(void) {
 }
 
 /**
- * Main state machine loop
+ * Boot detection and config timers: short checks only
  */
-void src_main_loop(void) {
-    switch (current_state) {
-        case SRC_STATE_INIT:
-            src_init();
-            break;
-            
-        case SRC_STATE_CHECKING_BOOT: {
-            /* Check if boot timeout has elapsed (use legacy timeout if detected) */
-            uint32_t timeout = legacy_detected ? 
-                legacy_get_boot_timeout(&legacy_info) : BOOT_TIMEOUT_MS;
-            if ((platform_get_timestamp() - boot_start_timestamp) > timeout) {
-                src_log("SRC: Boot timeout exceeded, boot considered failed");
-                current_state = SRC_STATE_BOOT_FAILED;
-            } else if (src_check_boot_success()) {
-                src_log("SRC: Boot success detected");
-                current_state = SRC_STATE_BOOT_SUCCESS;
+static src_task_result_t src_boot_task(src_task_t *task) {
+    boot_event_t event;
+    
+    /* Sleep until the next deadline; events wake the task earlier */
+    task->period_ms = SRC_BOOT_CHECK_MS;
+    
+    if (current_state == SRC_STATE_CHECKING_BOOT) {
+        /* Check if boot timeout has elapsed (use legacy timeout if detected) */
+        uint32_t timeout = legacy_detected ? 
+            legacy_get_boot_timeout(&legacy_info) : BOOT_TIMEOUT_MS;
+        uint32_t elapsed = platform_get_timestamp() - boot_start_timestamp;
+        if (src_check_boot_success()) {
+            src_log("SRC: Boot success detected");
+            current_state = SRC_STATE_BOOT_SUCCESS;
+        } else if (elapsed > timeout) {
+            src_log("SRC: Boot timeout exceeded, boot considered failed");
+            current_state = SRC_STATE_BOOT_FAILED;
+        } else if (timeout - elapsed < task->period_ms) {
+            task->period_ms = timeout - elapsed + 1;
+        }
+    } else if (current_state == SRC_STATE_DISABLED) {
+        /* Recovery core is disabled, check if re-enable time has passed */
+        if (src_is_disabled() && config.disable_until_timestamp > 0) {
+            uint32_t now = platform_get_timestamp();
+            if (now >= config.disable_until_timestamp) {
+                src_log("SRC: Disable period expired, re-enabling");
+                config.disable_until_timestamp = 0;
+                src_write_config(&config);
+                current_state = SRC_STATE_CHECKING_BOOT;
+                boot_start_timestamp = platform_get_timestamp();
+                task->period_ms = 0;
+            } else if (config.disable_until_timestamp - now < task->period_ms) {
+                task->period_ms = config.disable_until_timestamp - now;
             }
-            break;
-            
-        case SRC_STATE_BOOT_SUCCESS:
-            /* System booted successfully, perform backup if needed */
+        }
+    }
+    
+    /* Events outside boot checking only update the status */
+    while (boot_detection_next_event(&event)) {
+    }
+    
+    return SRC_TASK_YIELDED;
+}
+
+/**
+ * Job task wake-up: the state moved on since its last turn
+ */
+static bool src_job_ready(void) {
+    return current_state != job_state_seen;
+}
+
+/**
+ * Long operations the state calls for, one per turn
+ * (if/else rather than switch: task yields cannot sit inside a switch)
+ */
+static src_task_result_t src_job_task(src_task_t *task) {
+    SRC_TASK_BEGIN(task);
+    
+    for (;;) {
+        task->cancel = false;
+        task->done = 0;
+        task->total = 0;
+        
+        if (current_state == SRC_STATE_INIT) {
+            src_init();
+        } else if (current_state == SRC_STATE_BOOT_SUCCESS ||
+                   current_state == SRC_STATE_BACKUP_ACTIVE) {
+            /* Back up once the system is up, then periodically */
+            current_job = SRC_JOB_BACKUP;
             src_perform_backup();
-            /* Transition to monitoring state */
-            current_state = SRC_STATE_BACKUP_ACTIVE;
-            break;
+            current_job = SRC_JOB_NONE;
+            if (current_state == SRC_STATE_BOOT_SUCCESS) {
+                current_state = SRC_STATE_BACKUP_ACTIVE;
+            }
             
-        case SRC_STATE_BOOT_FAILED:
+            if (task->cancel) {
+                src_log("SRC: Backup cancelled");
+                backup_cancelled_at = platform_get_timestamp();
+                SRC_TASK_WAIT_UNTIL(task, current_state != SRC_STATE_BACKUP_ACTIVE ||
+                    platform_get_timestamp() - backup_cancelled_at >= MAX_BACKUP_INTERVAL_MS);
+            }
+        } else if (current_state == SRC_STATE_BOOT_FAILED) {
             /* Boot failed, attempt recovery */
             src_log("SRC: Boot failure detected, attempting recovery");
-            if (src_recover_from_usb()) {
+            current_job = SRC_JOB_RECOVERY;
+            bool recovered = src_recover_from_usb();
+            current_job = SRC_JOB_NONE;
+            if (recovered) {
                 src_log("SRC: Recovery successful, rebooting");
+                logging_flush();
                 /* Trigger system reboot */
                 system_reboot();
             } else {
-                src_log("SRC: Recovery failed, system may be bricked");
+                if (task->cancel) {
+                    src_log("SRC: Recovery cancelled, entering safe mode");
+                } else {
+                    src_log("SRC: Recovery failed, system may be bricked");
+                }
                 /* Enter safe mode - allow manual intervention */
                 src_enter_safe_mode();
             }
-            break;
-            
-        case SRC_STATE_RECOVERING:
-            /* Recovery in progress, wait for completion */
-            break;
-            
-        case SRC_STATE_BACKUP_ACTIVE:
-            /* System is healthy, perform periodic backups */
-            src_perform_backup();
-            break;
-            
-        case SRC_STATE_DISABLED:
-            /* Recovery core is disabled, check if re-enable time has passed */
-            if (src_is_disabled() && config.disable_until_timestamp > 0) {
-                uint32_t now = platform_get_timestamp();
-                if (now >= config.disable_until_timestamp) {
-                    src_log("SRC: Disable period expired, re-enabling");
-                    config.disable_until_timestamp = 0;
-                    src_write_config(&config);
-                    current_state = SRC_STATE_CHECKING_BOOT;
-                    boot_start_timestamp = platform_get_timestamp();
-                }
-            }
-            break;
-            
-        case SRC_STATE_REMOVING:
+        } else if (current_state == SRC_STATE_REMOVING) {
             /* Handle removal process */
+            current_job = SRC_JOB_REMOVAL;
             src_handle_removal();
-            break;
+            current_job = SRC_JOB_NONE;
+        }
+        
+        job_state_seen = current_state;
+        SRC_TASK_YIELD(task);
     }
+    
+    SRC_TASK_END(task);
 }
 
 /**
- * Check if boot was successful
+ * Persist the RAM log
  */
-bool src_check_boot_success(void) {
-    boot_status_t status;
-    boot_detection_get_status(&status);
-    
-    /* Boot is successful if ANY of these conditions are met */
-    if (status.gpio_signal_received) {
+static src_task_result_t src_log_task(src_task_t *task) {
+    (void)task;
+    logging_flush();
+    return SRC_TASK_YIELDED;
+}
+
+/**
+ * Main state machine loop
+ */
+void src_main_loop(void) {
+    /* No-ops once scheduled */
+    src_sched_add(&boot_task);
+    src_sched_add(&job_task);
+    src_sched_add(&log_task);
+    src_sched_run();
+}
+
+src_state_t src_get_state(void) {
+    return current_state;
+}
+
+void src_get_job_status(src_job_status_t *status) {
+    if (!status) {
+        return;
+    }
+    status->job = current_job;
+    status->done = current_job != SRC_JOB_NONE ? job_task.done : 0;
+    status->total = current_job != SRC_JOB_NONE ? job_task.total : 0;
+    status->cancelling = current_job != SRC_JOB_NONE && job_task.cancel;
+}
+
+bool src_cancel_job(void) {
+    if (current_job == SRC_JOB_NONE) {
+        return false;
+    }
+    src_task_cancel(&job_task);
+    return true;
+}
+
+/**
+ * Check one boot status: successful if ANY of the methods says so
+ */
+static bool src_boot_status_success(const boot_status_t *status) {
+    if (status->gpio_signal_received) {
         src_log("SRC: Boot success - GPIO signal received");
         return true;
     }
     
-    if (status.watchdog_cleared) {
+    if (status->watchdog_cleared) {
         src_log("SRC: Boot success - Watchdog cleared");
         return true;
     }
     
-    if (status.post_code >= 0xA0) {  // POST code threshold
-        src_log("SRC: Boot success - POST code 0x%02X", status.post_code);
+    if (status->post_code >= 0xA0) {  // POST code threshold
+        src_log("SRC: Boot success - POST code 0x%02X", status->post_code);
         return true;
     }
     
-    if (status.firmware_flag_set) {
+    if (status->firmware_flag_set) {
         src_log("SRC: Boot success - Firmware flag set");
         return true;
     }
-    
-    return false;
+    
+    return false;
+}
+
+/**
+ * Check if boot was successful (takes the queued boot events)
+ */
+bool src_check_boot_success(void) {
+    boot_status_t status;
+    boot_event_t event;
+    
+    /* Judge the status after every queued event, so a success signal is
+     * seen even if a later event took it back (a POST code moving on) */
+    boot_detection_get_status(&status);
+    bool success = src_boot_status_success(&status);
+    while (boot_detection_next_event(&event)) {
+        if (!success) {
+            boot_detection_get_status(&status);
+            success = src_boot_status_success(&status);
+        }
+    }
+    return success;
+}
+
+/* Image chunks, one digest each in pass 1 */
+#define SRC_RECOVERY_IMAGE_CHUNKS \
+    ((FIRMWARE_REGION_SIZE + SRC_RECOVERY_CHUNK_SIZE - 1) / SRC_RECOVERY_CHUNK_SIZE)
+
+/* RAM behind one image stream: the chunk ring (SRC_RECOVERY_RING_DEPTH x
+ * SRC_RECOVERY_CHUNK_SIZE), the decoder for compressed A.bin/B.bin (one
+ * decompressed block) and the chunk digests of the last image hashed.
+ * Recovery streams use recovery_buffers; concurrent pass-1 workers bring
+ * their own.
+ */
+typedef struct {
+    uint8_t ring[SRC_RECOVERY_RING_DEPTH][SRC_RECOVERY_CHUNK_SIZE];
+    image_codec_decoder_t decoder;
+    uint8_t chunk_hash[SRC_RECOVERY_IMAGE_CHUNKS][CRYPTO_SHA256_HASH_SIZE];
+    uint32_t chunk_count;                   /* 0: no image hashed to the end */
+    uint8_t chunk_image[CRYPTO_SHA256_HASH_SIZE];   /* Image the chunks make up */
+} recovery_buffers_t;
+
+static recovery_buffers_t recovery_buffers;
+
+/* Chunked reader over a USB file
+ * Keeps up to SRC_RECOVERY_RING_DEPTH - 1 reads in flight while the caller
+ * works on the chunk returned by recovery_stream_next(). The ring is made
+ * of DMA pool buffers when enough are free, so chunks are hashed and
+ * programmed where the USB controller put them; otherwise of buffers->ring.
+ */
+typedef struct {
+    const char *path;
+    uint8_t (*ring)[SRC_RECOVERY_CHUNK_SIZE];
+    platform_dma_buffer_t *dma[SRC_RECOVERY_RING_DEPTH];    /* Pool ring (NULL = ring) */
+    uint32_t next_offset;   /* File offset of the next read to queue */
+    uint32_t queued;        /* Reads queued but not yet collected */
+    uint32_t slot;          /* Ring slot of the oldest queued read */
+    bool eof;
+    bool error;
+    bool closing;
+} recovery_stream_t;
+
+/**
+ * A chunk read into a pool buffer completed; once the stream is closing
+ * nobody wants the chunk, so the buffer goes back to the pool
+ */
+static void recovery_stream_dma_done(platform_dma_buffer_t *buffer, bool ok) {
+    recovery_stream_t *stream = buffer->context;
+    (void)ok;
+    if (!stream->closing) {
+        return;
+    }
+    for (uint32_t i = 0; i < SRC_RECOVERY_RING_DEPTH; i++) {
+        if (stream->dma[i] == buffer) {
+            stream->dma[i] = NULL;
+        }
+    }
+    platform_dma_free(buffer);
+}
+
+static void recovery_stream_open(recovery_stream_t *stream, const char *path,
+                                 recovery_buffers_t *buffers) {
+    memset(stream, 0, sizeof(*stream));
+    stream->path = path;
+    stream->ring = buffers->ring;
+    
+    for (uint32_t i = 0; i < SRC_RECOVERY_RING_DEPTH; i++) {
+        stream->dma[i] = platform_dma_alloc();
+        if (!stream->dma[i]) {
+            while (i > 0) {
+                platform_dma_free(stream->dma[--i]);
+                stream->dma[i] = NULL;
+            }
+            break;
+        }
+        stream->dma[i]->context = stream;
+    }
+}
+
+static uint8_t *recovery_stream_slot(recovery_stream_t *stream, uint32_t slot) {
+    return stream->dma[slot] ? stream->dma[slot]->data : stream->ring[slot];
+}
+
+/**
+ * Return the next chunk of the file; false at end of file or on error.
+ * The returned chunk stays valid until the next call.
+ */
+static bool recovery_stream_next(recovery_stream_t *stream,
+                                 const uint8_t **chunk, size_t *len) {
+    *len = 0;
+    
+    /* Refill the ring; the slot handed out last time is free again */
+    while (!stream->eof && !stream->error &&
+           stream->queued < SRC_RECOVERY_RING_DEPTH) {
+        uint32_t slot = (stream->slot + stream->queued) % SRC_RECOVERY_RING_DEPTH;
+        bool started = stream->dma[slot]
+            ? src_usb_read_start_dma(stream->path, stream->next_offset, stream->dma[slot],
+                                     SRC_RECOVERY_CHUNK_SIZE, recovery_stream_dma_done)
+            : src_usb_read_start(stream->path, stream->next_offset,
+                                 stream->ring[slot], SRC_RECOVERY_CHUNK_SIZE);
+        if (!started) {
+            stream->error = true;
+            break;
+        }
+        stream->next_offset += SRC_RECOVERY_CHUNK_SIZE;
+        stream->queued++;
+    }
+    
+    if (stream->queued == 0) {
+        return false;
+    }
+    
+    /* Collect the oldest read */
+    uint32_t slot = stream->slot;
+    size_t got = 0;
+    bool ok = src_usb_read_wait(&got);
+    stream->slot = (slot + 1) % SRC_RECOVERY_RING_DEPTH;
+    stream->queued--;
+    
+    if (!ok || got > SRC_RECOVERY_CHUNK_SIZE) {
+        stream->error = true;
+        return false;
+    }
+    
+    /* Short read marks end of file; reads queued behind it return nothing */
+    if (got < SRC_RECOVERY_CHUNK_SIZE) {
+        stream->eof = true;
+    }
+    if (got == 0) {
+        return false;
+    }
+    
+    *chunk = recovery_stream_slot(stream, slot);
+    *len = got;
+    return true;
+}
+
+static void recovery_stream_close(recovery_stream_t *stream) {
+    /* Drain reads still in flight so the next stream starts clean; their
+     * completions return pool buffers */
+    stream->closing = true;
+    while (stream->queued > 0) {
+        size_t got;
+        src_usb_read_wait(&got);
+        stream->queued--;
+    }
+    for (uint32_t i = 0; i < SRC_RECOVERY_RING_DEPTH; i++) {
+        platform_dma_free(stream->dma[i]);
+        stream->dma[i] = NULL;
+    }
+}
+
+/* Image reader over a recovery stream
+ * Backup images are stored raw or in the compressed container
+ * (image_codec.h); either way callers get decompressed image bytes.
+ */
+typedef struct {
+    recovery_stream_t stream;
+    image_codec_decoder_t *decoder;
+    bool started;
+    bool compressed;
+    bool error;
+    const uint8_t *input;   /* Stream chunk not yet fed to the decoder */
+    size_t input_len;
+} recovery_image_t;
+
+static void recovery_image_open(recovery_image_t *image, const char *path,
+                                recovery_buffers_t *buffers) {
+    memset(image, 0, sizeof(*image));
+    recovery_stream_open(&image->stream, path, buffers);
+    image->decoder = &buffers->decoder;
+}
+
+/**
+ * Return the next piece of the image; false at the end or on error.
+ * The returned piece stays valid until the next call.
+ */
+static bool recovery_image_next(recovery_image_t *image,
+                                const uint8_t **chunk, size_t *len) {
+    *len = 0;
+    if (image->error) {
+        return false;
+    }
+    
+    /* The first chunk tells raw and compressed images apart */
+    if (!image->started) {
+        image->started = true;
+        if (!recovery_stream_next(&image->stream, &image->input, &image->input_len)) {
+            return false;
+        }
+        image->compressed = image_codec_is_compressed(image->input, image->input_len);
+        if (!image->compressed) {
+            *chunk = image->input;
+            *len = image->input_len;
+            image->input_len = 0;
+            return true;
+        }
+        image_codec_decoder_init(image->decoder, FIRMWARE_REGION_SIZE);
+    } else if (!image->compressed) {
+        return recovery_stream_next(&image->stream, chunk, len);
+    }
+    
+    /* Feed the decoder until it completes a block */
+    for (;;) {
+        if (image->input_len == 0 &&
+            !recovery_stream_next(&image->stream, &image->input, &image->input_len)) {
+            /* SECURITY: A truncated container is an error, not a short image */
+            if (!image->stream.error && !image_codec_decoder_done(image->decoder)) {
+                image->error = true;
+            }
+            return false;
+        }
+        
+        size_t consumed = 0;
+        image_codec_status_t status = image_codec_decode(image->decoder,
+                                                         image->input, image->input_len,
+                                                         &consumed, chunk, len);
+        image->input += consumed;
+        image->input_len -= consumed;
+        
+        if (status == IMAGE_CODEC_BLOCK) {
+            return true;
+        }
+        if (status == IMAGE_CODEC_ERROR) {
+            image->error = true;
+            return false;
+        }
+    }
+}
+
+/**
+ * Finish reading; false if the file could not be read or decoded
+ */
+static bool recovery_image_close(recovery_image_t *image) {
+    recovery_stream_close(&image->stream);
+    return !image->error && !image->stream.error;
+}
+
+/**
+ * Pass 1: record the digest of the chunk at stream position, the next in
+ * list. Chunks must come whole and in order (a short one only at the end).
+ */
+static bool recovery_chunk_record(uint8_t (*list)[CRYPTO_SHA256_HASH_SIZE], uint32_t max,
+                                  uint32_t *count, size_t position,
+                                  const uint8_t *chunk, size_t len) {
+    if (position % SRC_RECOVERY_CHUNK_SIZE != 0 || len > SRC_RECOVERY_CHUNK_SIZE ||
+        position / SRC_RECOVERY_CHUNK_SIZE != *count || *count >= max) {
+        return false;
+    }
+    if (crypto_sha256(chunk, len, list[*count]) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    (*count)++;
+    return true;
+}
+
+/**
+ * Pass 2: whether the chunk at stream position is the one recorded in
+ * pass 1. SECURITY: Nothing from a chunk may reach flash before this.
+ */
+static bool recovery_chunk_matches(const uint8_t (*list)[CRYPTO_SHA256_HASH_SIZE],
+                                   uint32_t count, size_t position,
+                                   const uint8_t *chunk, size_t len) {
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    return position % SRC_RECOVERY_CHUNK_SIZE == 0 && len <= SRC_RECOVERY_CHUNK_SIZE &&
+           position / SRC_RECOVERY_CHUNK_SIZE < count &&
+           crypto_sha256(chunk, len, hash) == CRYPTO_SUCCESS &&
+           memcmp(hash, list[position / SRC_RECOVERY_CHUNK_SIZE], sizeof(hash)) == 0;
+}
+
+/**
+ * Recovery pass 1 over one image file: nothing is written to flash and
+ * nothing is logged, so worker threads can run it. Stops early, returning
+ * false, once cancel is set or (scheduled: on the scheduler's thread) a
+ * checkpoint says the job was cancelled. An image too large for the
+ * firmware region fails with *image_size past FIRMWARE_REGION_SIZE.
+ * The digest of each chunk is kept in buffers for pass 2.
+ */
+static bool recovery_hash_image(const char *path, recovery_buffers_t *buffers,
+                                const atomic_bool *cancel, bool scheduled,
+                                uint8_t *hash, size_t *image_size) {
+    crypto_sha256_ctx_t ctx;
+    if (crypto_sha256_init(&ctx) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    
+    recovery_image_t image;
+    recovery_image_open(&image, path, buffers);
+    buffers->chunk_count = 0;
+    
+    const uint8_t *chunk;
+    size_t len;
+    size_t total = 0;
+    uint32_t chunks = 0;
+    bool ok = true;
+    
+    while (recovery_image_next(&image, &chunk, &len)) {
+        /* SECURITY: Stop reading as soon as the image is too large */
+        if (len > FIRMWARE_REGION_SIZE - total) {
+            total += len;
+            ok = false;
+            break;
+        }
+        if ((cancel && atomic_load(cancel)) ||
+            (scheduled && !src_sched_checkpoint(total, FIRMWARE_REGION_SIZE))) {
+            ok = false;
+            break;
+        }
+        crypto_sha256_update(&ctx, chunk, len);
+        if (!recovery_chunk_record(buffers->chunk_hash, SRC_RECOVERY_IMAGE_CHUNKS,
+                                   &chunks, total, chunk, len)) {
+            ok = false;
+            break;
+        }
+        total += len;
+    }
+    
+    if (!recovery_image_close(&image)) {
+        ok = false;
+    }
+    
+    if (crypto_sha256_final(&ctx, hash) != CRYPTO_SUCCESS) {
+        ok = false;
+    }
+    
+    if (ok) {
+        buffers->chunk_count = chunks;
+        memcpy(buffers->chunk_image, hash, sizeof(buffers->chunk_image));
+    }
+    *image_size = total;
+    return ok;
+}
+
+/**
+ * Hash an image file on USB
+ * Also recovery pass 1: nothing is written to flash. Compressed images are
+ * hashed (and later signature-checked) over their decompressed content.
+ */
+bool src_hash_usb_image(const char *path, uint8_t *hash, size_t *image_size) {
+    bool ok = recovery_hash_image(path, &recovery_buffers, NULL, true, hash, image_size);
+    if (!ok && *image_size > FIRMWARE_REGION_SIZE) {
+        src_log("SRC: ERROR - %s exceeds firmware region size", path);
+    }
+    return ok;
+}
+
+static void src_add_write_stats(src_write_stats_t *total, const src_write_stats_t *part) {
+    total->blocks_skipped += part->blocks_skipped;
+    total->blocks_programmed += part->blocks_programmed;
+    total->blocks_erased += part->blocks_erased;
+}
+
+/**
+ * Recovery pass 2: stream a verified image from USB into SPI flash.
+ * The USB read of the next chunk is in flight while the current chunk is
+ * checked and programmed. Blocks already matching the image are left alone.
+ * SECURITY: Each chunk must hash to the digest pass 1 recorded for it
+ * (recovery_buffers, taken from the bytes that hash to verified_hash)
+ * before any of it is written, so a stick that answers the second read
+ * differently gets nothing unverified into flash.
+ * Sectors with a non-zero entry in skip (optional, one per integrity
+ * sector) are checked but not written; a delta patch supplies them.
+ */
+static bool src_stream_commit_image(const char *path, const uint8_t *verified_hash,
+                                    size_t image_size, const uint8_t *skip) {
+    if (recovery_buffers.chunk_count == 0 ||
+        memcmp(recovery_buffers.chunk_image, verified_hash, CRYPTO_SHA256_HASH_SIZE) != 0) {
+        src_log("SRC: ERROR - No chunk digests for %s", path);
+        return false;
+    }
+    
+    recovery_image_t image;
+    recovery_image_open(&image, path, &recovery_buffers);
+    
+    src_write_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    
+    const uint8_t *chunk;
+    size_t len;
+    size_t total = 0;
+    bool ok = true;
+    
+    while (recovery_image_next(&image, &chunk, &len)) {
+        if (len > image_size - total) {
+            src_log("SRC: ERROR - %s grew after verification", path);
+            ok = false;
+            break;
+        }
+        if (!src_sched_checkpoint(total, image_size)) {
+            ok = false;
+            break;
+        }
+        
+        if (!recovery_chunk_matches(recovery_buffers.chunk_hash, recovery_buffers.chunk_count,
+                                    total, chunk, len)) {
+            src_log("SRC: ERROR - %s changed between verification and write at offset %lu",
+                    path, (unsigned long)total);
+            ok = false;
+            break;
+        }
+        
+        /* Write (differentially) and read back this chunk, sector by sector
+         * when some sectors are left to the delta chain */
+        for (size_t done = 0; ok && done < len; ) {
+            size_t offset = total + done;
+            size_t part = len - done;
+            if (skip) {
+                size_t left = INTEGRITY_SECTOR_SIZE - offset % INTEGRITY_SECTOR_SIZE;
+                if (part > left) {
+                    part = left;
+                }
+                if (skip[offset / INTEGRITY_SECTOR_SIZE]) {
+                    done += part;
+                    continue;
+                }
+            }
+            
+            src_write_stats_t chunk_stats;
+            if (!src_write_firmware(chunk + done, part, FIRMWARE_REGION_START + offset,
+                                    &chunk_stats)) {
+                src_log("SRC: ERROR - Failed to write firmware to SPI at offset %lu",
+                        (unsigned long)(FIRMWARE_REGION_START + offset));
+                ok = false;
+                break;
+            }
+            src_add_write_stats(&stats, &chunk_stats);
+            done += part;
+        }
+        if (!ok) {
+            break;
+        }
+        total += len;
+    }
+    
+    if (!recovery_image_close(&image)) {
+        ok = false;
+    }
+    
+    src_log("SRC: Flash blocks: %lu unchanged, %lu programmed, %lu erased+programmed",
+            (unsigned long)stats.blocks_skipped,
+            (unsigned long)stats.blocks_programmed,
+            (unsigned long)stats.blocks_erased);
+    
+    /* SECURITY: Every verified chunk, and nothing more, was written */
+    if (ok && total != image_size) {
+        src_log("SRC: ERROR - %s changed between verification and write", path);
+        ok = false;
+    }
+    
+    return ok;
+}
+
+/* Signed manifest of the stick, trusted only while usb_manifest_valid */
+static src_manifest_t usb_manifest;
+static bool usb_manifest_valid = false;
+
+/**
+ * Bytes of a manifest as stored in manifest.bin
+ */
+static size_t src_manifest_size(const src_manifest_t *manifest) {
+    return SRC_MANIFEST_HEADER_SIZE +
+           (size_t)manifest->entry_count * sizeof(src_manifest_entry_t);
+}
+
+/**
+ * Read and verify the signed manifest on USB
+ */
+bool src_read_manifest(const char *dir, src_manifest_t *manifest) {
+    if (!dir || !manifest) {
+        return false;
+    }
+    
+    char path[128];
+    char sig_path[128];
+    snprintf(path, sizeof(path), "%s/%s", dir, SIGNED_MANIFEST_FILE);
+    snprintf(sig_path, sizeof(sig_path), "%s/%s", dir, MANIFEST_SIGNATURE_FILE);
+    if (!src_usb_file_exists(path) || !src_usb_file_exists(sig_path)) {
+        return false;
+    }
+    
+    size_t size = sizeof(*manifest);
+    uint8_t signature[512];
+    size_t sig_size = sizeof(signature);
+    if (!src_usb_read_file(path, (uint8_t *)manifest, &size) ||
+        !src_usb_read_file(sig_path, signature, &sig_size)) {
+        src_log("SRC: ERROR - Cannot read %s", SIGNED_MANIFEST_FILE);
+        return false;
+    }
+    
+    if (size < SRC_MANIFEST_HEADER_SIZE ||
+        manifest->magic != SRC_MANIFEST_MAGIC ||
+        manifest->version != SRC_MANIFEST_VERSION ||
+        manifest->entry_count > SRC_MANIFEST_MAX_ENTRIES ||
+        size != src_manifest_size(manifest)) {
+        src_log("SRC: ERROR - %s is malformed", SIGNED_MANIFEST_FILE);
+        return false;
+    }
+    
+    /* SECURITY: One signature check covers every image the manifest lists */
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    int verify_result = crypto_sha256((const uint8_t *)manifest, size, hash);
+    if (verify_result == CRYPTO_SUCCESS) {
+        verify_result = verify_cache_verify_hash(hash, signature, sig_size);
+    }
+    if (verify_result != CRYPTO_SUCCESS) {
+        src_log("SRC: ERROR - Signature verification failed for %s (error: %d)",
+                SIGNED_MANIFEST_FILE, verify_result);
+        return false;
+    }
+    
+    /* SECURITY: Signed for another board or flash layout */
+    if (manifest->region_size != FIRMWARE_REGION_SIZE ||
+        (config.board_id[0] != '\0' &&
+         strncmp(manifest->board_id, config.board_id, sizeof(manifest->board_id)) != 0)) {
+        src_log("SRC: ERROR - %s was written for another board", SIGNED_MANIFEST_FILE);
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < manifest->entry_count; i++) {
+        const src_manifest_entry_t *entry = &manifest->entries[i];
+        if (memchr(entry->name, '\0', sizeof(entry->name)) == NULL ||
+            entry->name[0] == '\0' || strchr(entry->name, '/') != NULL ||
+            (entry->kind != SRC_MANIFEST_FULL && entry->kind != SRC_MANIFEST_DELTA) ||
+            (entry->kind == SRC_MANIFEST_FULL &&
+             (entry->size == 0 || entry->size > FIRMWARE_REGION_SIZE))) {
+            src_log("SRC: ERROR - %s is malformed", SIGNED_MANIFEST_FILE);
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Find the entry for a file in a verified manifest
+ */
+const src_manifest_entry_t *src_manifest_find(const src_manifest_t *manifest,
+                                              const char *name) {
+    if (!manifest || !name) {
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < manifest->entry_count; i++) {
+        if (strncmp(manifest->entries[i].name, name, sizeof(manifest->entries[i].name)) == 0) {
+            return &manifest->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Full image with the highest generation, the one patches apply to
+ */
+static const src_manifest_entry_t *src_manifest_newest_full(const src_manifest_t *manifest) {
+    const src_manifest_entry_t *newest = NULL;
+    
+    for (uint32_t i = 0; i < manifest->entry_count; i++) {
+        const src_manifest_entry_t *entry = &manifest->entries[i];
+        if (entry->kind == SRC_MANIFEST_FULL &&
+            (!newest || entry->generation > newest->generation)) {
+            newest = entry;
+        }
+    }
+    return newest;
+}
+
+/**
+ * Entry for the patch at a position in the chain
+ */
+static const src_manifest_entry_t *src_manifest_find_patch(const src_manifest_t *manifest,
+                                                           uint32_t sequence) {
+    for (uint32_t i = 0; i < manifest->entry_count; i++) {
+        const src_manifest_entry_t *entry = &manifest->entries[i];
+        if (entry->kind == SRC_MANIFEST_DELTA && entry->sequence == sequence) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Fill in a manifest entry
+ */
+static void src_manifest_set_entry(src_manifest_entry_t *entry, const char *name,
+                                   src_manifest_kind_t kind, uint32_t sequence,
+                                   uint32_t size, const uint8_t *hash,
+                                   const uint8_t *image_hash, const uint8_t *root) {
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->kind = (uint8_t)kind;
+    entry->sequence = (uint16_t)sequence;
+    entry->generation = usb_manifest.generation;
+    entry->size = size;
+    memcpy(entry->hash, hash, sizeof(entry->hash));
+    memcpy(entry->image_hash, image_hash, sizeof(entry->image_hash));
+    memcpy(entry->root, root, sizeof(entry->root));
+}
+
+/**
+ * Sign usb_manifest and write it to USB
+ * The old signature is removed first and the new one written last, so a
+ * half-written manifest never verifies.
+ */
+static bool src_manifest_write(void) {
+    char path[64];
+    char sig_path[64];
+    snprintf(path, sizeof(path), "%s/%s", USB_RECOVERY_PATH, SIGNED_MANIFEST_FILE);
+    snprintf(sig_path, sizeof(sig_path), "%s/%s", USB_RECOVERY_PATH, MANIFEST_SIGNATURE_FILE);
+    usb_manifest_valid = false;
+    
+    usb_manifest.magic = SRC_MANIFEST_MAGIC;
+    usb_manifest.version = SRC_MANIFEST_VERSION;
+    usb_manifest.region_size = FIRMWARE_REGION_SIZE;
+    memcpy(usb_manifest.board_id, config.board_id, sizeof(usb_manifest.board_id));
+    memset(usb_manifest.reserved, 0, sizeof(usb_manifest.reserved));
+    size_t size = src_manifest_size(&usb_manifest);
+    
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    uint8_t signature[512];
+    size_t sig_size = sizeof(signature);
+    if (crypto_sha256((const uint8_t *)&usb_manifest, size, hash) != CRYPTO_SUCCESS ||
+        crypto_sign_hash(hash, signature, &sig_size) != CRYPTO_SUCCESS) {
+        src_log("SRC: ERROR - Failed to sign %s", SIGNED_MANIFEST_FILE);
+        return false;
+    }
+    
+    src_usb_delete_file(sig_path);
+    if (!src_usb_write_file(path, (const uint8_t *)&usb_manifest, size) ||
+        !src_usb_write_file(sig_path, signature, sig_size)) {
+        src_log("SRC: ERROR - Failed to write %s", SIGNED_MANIFEST_FILE);
+        return false;
+    }
+    
+    usb_manifest_valid = true;
+    return true;
+}
+
+/* Largest well-formed patch: every sector, table padded to SRC_DELTA_DATA_ALIGN */
+#define SRC_DELTA_HEAD_MAX (sizeof(src_delta_header_t) + INTEGRITY_MAX_SECTORS * sizeof(uint32_t))
+#define SRC_DELTA_HEAD_PADDED \
+    (((SRC_DELTA_HEAD_MAX + SRC_DELTA_DATA_ALIGN - 1) / SRC_DELTA_DATA_ALIGN) * SRC_DELTA_DATA_ALIGN)
+#define SRC_DELTA_MAX_FILE_SIZE (SRC_DELTA_HEAD_PADDED + FIRMWARE_REGION_SIZE)
+
+/* Chunks of the longest chain backups still extend: SRC_DELTA_MAX_BYTES of
+ * sector data, and per patch its header and a partial last chunk */
+#define SRC_DELTA_MAX_CHUNKS \
+    ((SRC_DELTA_MAX_BYTES + SRC_DELTA_MAX_CHAIN * SRC_DELTA_HEAD_PADDED) / \
+     SRC_RECOVERY_CHUNK_SIZE + SRC_DELTA_MAX_CHAIN)
+
+/* Delta chain verified in recovery pass 1 */
+typedef struct {
+    uint32_t count;                                 /* Usable patches (chain prefix) */
+    size_t file_size[SRC_DELTA_MAX_CHAIN];
+    uint8_t file_hash[SRC_DELTA_MAX_CHAIN][32];     /* Verified against the manifest */
+    size_t head_size[SRC_DELTA_MAX_CHAIN];
+    uint8_t head_hash[SRC_DELTA_MAX_CHAIN][32];     /* Header + sector table */
+    uint8_t result_hash[32];                        /* Image after the last patch */
+    uint32_t chunk_first[SRC_DELTA_MAX_CHAIN];      /* Patch's first entry in chunk_hash */
+    uint32_t chunk_count[SRC_DELTA_MAX_CHAIN];
+    uint8_t chunk_hash[SRC_DELTA_MAX_CHUNKS][32];   /* Per file chunk, all patches */
+} src_delta_chain_t;
+
+static src_delta_chain_t delta_chain;
+
+/* Patch supplying each sector (sequence number), 0 = the base image */
+static uint8_t delta_source[INTEGRITY_MAX_SECTORS];
+
+/* Header and sector table of the patch being streamed */
+static uint8_t delta_head[SRC_DELTA_HEAD_MAX];
+
+/**
+ * USB path of a delta patch or of its signature
+ */
+static void src_delta_path(char *path, size_t size, uint32_t sequence, bool signature) {
+    if (signature) {
+        snprintf(path, size, "%s/" DELTA_SIGNATURE_FORMAT, USB_RECOVERY_PATH,
+                 (unsigned)sequence);
+    } else {
+        snprintf(path, size, "%s/" DELTA_FILE_FORMAT, USB_RECOVERY_PATH,
+                 (unsigned)sequence);
+    }
+}
+
+/**
+ * File offset of the sector data in a patch carrying count sectors
+ */
+static size_t src_delta_data_offset(uint32_t count) {
+    size_t head_size = sizeof(src_delta_header_t) + count * sizeof(uint32_t);
+    return (head_size + SRC_DELTA_DATA_ALIGN - 1) / SRC_DELTA_DATA_ALIGN *
+           SRC_DELTA_DATA_ALIGN;
+}
+
+/**
+ * Sector whose data is the index-th in the patch in delta_head
+ * (erased sectors have no data)
+ */
+static bool src_delta_data_sector(uint32_t index, uint32_t *sector) {
+    const src_delta_header_t *header = (const src_delta_header_t *)delta_head;
+    const uint32_t *table = (const uint32_t *)(delta_head + sizeof(*header));
+    
+    for (uint32_t i = 0; i < header->sector_count; i++) {
+        if (table[i] & SRC_DELTA_SECTOR_ERASED) {
+            continue;
+        }
+        if (index-- == 0) {
+            *sector = table[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Erase the sectors the patch in delta_head marks as erased, where this
+ * patch is their newest source
+ */
+static bool src_delta_commit_erased(uint32_t sequence, src_write_stats_t *stats) {
+    const src_delta_header_t *header = (const src_delta_header_t *)delta_head;
+    const uint32_t *table = (const uint32_t *)(delta_head + sizeof(*header));
+    uint8_t erased[SRC_HASH_BLOCK_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    
+    for (uint32_t i = 0; i < header->sector_count; i++) {
+        uint32_t sector = table[i] & ~SRC_DELTA_SECTOR_ERASED;
+        if (!(table[i] & SRC_DELTA_SECTOR_ERASED) || delta_source[sector] != sequence) {
+            continue;
+        }
+        
+        uint32_t offset = FIRMWARE_REGION_START + sector * INTEGRITY_SECTOR_SIZE;
+        for (size_t done = 0; done < INTEGRITY_SECTOR_SIZE; done += sizeof(erased)) {
+            src_write_stats_t piece_stats;
+            if (!src_write_firmware(erased, sizeof(erased), offset + done, &piece_stats)) {
+                src_log("SRC: ERROR - Failed to erase firmware sector at offset %lu",
+                        (unsigned long)offset);
+                return false;
+            }
+            src_add_write_stats(stats, &piece_stats);
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Write the sector data found in one chunk of a patch (at file offset
+ * position) for the sectors this patch supplies; a later patch may
+ * override some of the sectors it carries
+ */
+static bool src_delta_commit_chunk(uint32_t sequence, const uint8_t *chunk,
+                                   size_t position, size_t len,
+                                   src_write_stats_t *stats) {
+    const src_delta_header_t *header = (const src_delta_header_t *)delta_head;
+    size_t end = position + len;
+    size_t pos = (position > header->data_offset) ? position : header->data_offset;
+    
+    while (pos < end) {
+        size_t rel = pos - header->data_offset;
+        uint32_t index = rel / INTEGRITY_SECTOR_SIZE;
+        size_t in_sector = rel % INTEGRITY_SECTOR_SIZE;
+        size_t part = INTEGRITY_SECTOR_SIZE - in_sector;
+        if (part > end - pos) {
+            part = end - pos;
+        }
+        uint32_t sector;
+        if (!src_delta_data_sector(index, &sector)) {
+            return false;
+        }
+        
+        if (delta_source[sector] == sequence) {
+            uint32_t offset = FIRMWARE_REGION_START + sector * INTEGRITY_SECTOR_SIZE +
+                              in_sector;
+            src_write_stats_t piece_stats;
+            if (!src_write_firmware(chunk + (pos - position), part, offset, &piece_stats)) {
+                src_log("SRC: ERROR - Failed to write firmware to SPI at offset %lu",
+                        (unsigned long)offset);
+                return false;
+            }
+            src_add_write_stats(stats, &piece_stats);
+        }
+        pos += part;
+    }
+    
+    return true;
+}
+
+/**
+ * Stream one patch from USB, hashing it and keeping its header and sector
+ * table in delta_head. Pass 1 records the digest of each chunk in
+ * delta_chain. With commit set (recovery pass 2) the sectors it supplies
+ * are also written, each chunk once it matches its pass-1 digest.
+ */
+static bool src_delta_stream_patch(uint32_t sequence, bool commit,
+                                   uint8_t *file_hash, size_t *file_size,
+                                   src_write_stats_t *stats) {
+    char path[64];
+    src_delta_path(path, sizeof(path), sequence, false);
+    
+    crypto_sha256_ctx_t ctx;
+    if (crypto_sha256_init(&ctx) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    
+    uint32_t slot = sequence - 1;
+    size_t head_size = commit ? delta_chain.head_size[slot] : 0;
+    bool head_ok = false;
+    uint8_t (*chunk_hash)[32] = delta_chain.chunk_hash + delta_chain.chunk_first[slot];
+    uint32_t chunk_max = SRC_DELTA_MAX_CHUNKS - delta_chain.chunk_first[slot];
+    uint32_t chunks = 0;
+    
+    recovery_stream_t stream;
+    recovery_stream_open(&stream, path, &recovery_buffers);
+    
+    const uint8_t *chunk;
+    size_t len;
+    size_t total = 0;
+    bool ok = true;
+    
+    while (recovery_stream_next(&stream, &chunk, &len)) {
+        /* SECURITY: Stop reading as soon as the patch is too large */
+        if (len > SRC_DELTA_MAX_FILE_SIZE - total) {
+            src_log("SRC: ERROR - %s exceeds maximum patch size", path);
+            ok = false;
+            break;
+        }
+        crypto_sha256_update(&ctx, chunk, len);
+        
+        if (!commit && !recovery_chunk_record(chunk_hash, chunk_max, &chunks,
+                                              total, chunk, len)) {
+            src_log("SRC: ERROR - %s is too large for the delta chain", path);
+            ok = false;
+            break;
+        }
+        /* SECURITY: Nothing of a chunk is used before it matches pass 1 */
+        if (commit && !recovery_chunk_matches((const uint8_t (*)[32])chunk_hash,
+                                              delta_chain.chunk_count[slot],
+                                              total, chunk, len)) {
+            src_log("SRC: ERROR - %s changed between verification and write", path);
+            ok = false;
+            break;
+        }
+        
+        if (total < sizeof(delta_head)) {
+            size_t part = sizeof(delta_head) - total;
+            memcpy(delta_head + total, chunk, (len < part) ? len : part);
+        }
+        
+        if (commit) {
+            /* SECURITY: Header and table must be the ones verified in pass 1 */
+            if (!head_ok && total + len >= head_size) {
+                uint8_t head_hash[CRYPTO_SHA256_HASH_SIZE];
+                head_ok = crypto_sha256(delta_head, head_size, head_hash) == CRYPTO_SUCCESS &&
+                          memcmp(head_hash, delta_chain.head_hash[slot],
+                                 sizeof(head_hash)) == 0;
+                if (!head_ok) {
+                    src_log("SRC: ERROR - %s changed between verification and write", path);
+                    ok = false;
+                    break;
+                }
+                if (!src_delta_commit_erased(sequence, stats)) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (head_ok && !src_delta_commit_chunk(sequence, chunk, total, len, stats)) {
+                ok = false;
+                break;
+            }
+        }
+        total += len;
+    }
+    recovery_stream_close(&stream);
+    
+    if (stream.error) {
+        ok = false;
+    }
+    
+    if (crypto_sha256_final(&ctx, file_hash) != CRYPTO_SUCCESS) {
+        ok = false;
+    }
+    
+    if (!commit) {
+        delta_chain.chunk_count[slot] = chunks;
+    }
+    *file_size = total;
+    return ok;
+}
+
+/**
+ * Recovery pass 1 for one patch: hash it, check it against its manifest
+ * entry (its own .sig on legacy sticks) and check that it is well formed
+ * and applies to the image hashing to base_hash.
+ * On success the sectors it carries are assigned to it in delta_source.
+ */
+static bool src_delta_verify_patch(uint32_t sequence, const uint8_t *base_hash) {
+    uint32_t slot = sequence - 1;
+    
+    const src_manifest_entry_t *entry = NULL;
+    uint8_t signature[512];
+    size_t sig_size = sizeof(signature);
+    if (usb_manifest_valid) {
+        entry = src_manifest_find_patch(&usb_manifest, sequence);
+        if (!entry) {
+            src_log("SRC: ERROR - D%02u is not in the manifest", (unsigned)sequence);
+            return false;
+        }
+    } else {
+        char sig_path[64];
+        src_delta_path(sig_path, sizeof(sig_path), sequence, true);
+        if (!src_usb_read_file(sig_path, signature, &sig_size)) {
+            src_log("SRC: ERROR - Cannot read signature for D%02u", (unsigned)sequence);
+            return false;
+        }
+    }
+    
+    delta_chain.chunk_first[slot] = (slot == 0) ? 0 :
+        delta_chain.chunk_first[slot - 1] + delta_chain.chunk_count[slot - 1];
+    size_t file_size = 0;
+    if (!src_delta_stream_patch(sequence, false, delta_chain.file_hash[slot],
+                                &file_size, NULL)) {
+        src_log("SRC: ERROR - Cannot read D%02u", (unsigned)sequence);
+        return false;
+    }
+    
+    /* SECURITY: Authenticate the patch before trusting anything in it */
+    if (entry) {
+        if (file_size != entry->size ||
+            memcmp(delta_chain.file_hash[slot], entry->hash, sizeof(entry->hash)) != 0) {
+            src_log("SRC: ERROR - D%02u does not match the manifest", (unsigned)sequence);
+            return false;
+        }
+    } else {
+        int verify_result = verify_cache_verify_hash(delta_chain.file_hash[slot],
+                                                     signature, sig_size);
+        if (verify_result != 0) {
+            src_log("SRC: ERROR - Signature verification failed for D%02u (error: %d)",
+                    (unsigned)sequence, verify_result);
+            return false;
+        }
+    }
+    
+    /* SECURITY: Patch must match this layout and continue the chain */
+    const src_delta_header_t *header = (const src_delta_header_t *)delta_head;
+    if (file_size < sizeof(*header) ||
+        header->magic != SRC_DELTA_MAGIC ||
+        header->version == 0 || header->version > SRC_DELTA_VERSION ||
+        header->sequence != sequence ||
+        header->sector_size != INTEGRITY_SECTOR_SIZE ||
+        header->region_size != FIRMWARE_REGION_SIZE ||
+        header->sector_count == 0 ||
+        header->sector_count > INTEGRITY_MAX_SECTORS ||
+        memcmp(header->base_hash, base_hash, sizeof(header->base_hash)) != 0) {
+        src_log("SRC: ERROR - D%02u does not continue the backup chain", (unsigned)sequence);
+        return false;
+    }
+    
+    size_t head_size = sizeof(*header) + header->sector_count * sizeof(uint32_t);
+    const uint32_t *table = (const uint32_t *)(delta_head + sizeof(*header));
+    uint32_t stored = 0;
+    for (uint32_t i = 0; i < header->sector_count; i++) {
+        uint32_t sector = table[i] & ~SRC_DELTA_SECTOR_ERASED;
+        if (sector >= INTEGRITY_MAX_SECTORS ||
+            (i > 0 && sector <= (table[i - 1] & ~SRC_DELTA_SECTOR_ERASED)) ||
+            (header->version < 2 && sector != table[i])) {
+            src_log("SRC: ERROR - D%02u is malformed", (unsigned)sequence);
+            return false;
+        }
+        if (!(table[i] & SRC_DELTA_SECTOR_ERASED)) {
+            stored++;
+        }
+    }
+    
+    if (header->data_offset != src_delta_data_offset(header->sector_count) ||
+        file_size != header->data_offset + (size_t)stored * INTEGRITY_SECTOR_SIZE) {
+        src_log("SRC: ERROR - D%02u is malformed", (unsigned)sequence);
+        return false;
+    }
+    
+    if (crypto_sha256(delta_head, head_size, delta_chain.head_hash[slot]) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    delta_chain.head_size[slot] = head_size;
+    delta_chain.file_size[slot] = file_size;
+    
+    for (uint32_t i = 0; i < header->sector_count; i++) {
+        delta_source[table[i] & ~SRC_DELTA_SECTOR_ERASED] = (uint8_t)sequence;
+    }
+    memcpy(delta_chain.result_hash, header->result_hash, sizeof(delta_chain.result_hash));
+    delta_chain.count = sequence;
+    return true;
+}
+
+/**
+ * Recovery pass 1 for the patches following A.bin (which hashes to base_hash)
+ * Stops at the first missing or invalid patch; the patches before it
+ * still describe an earlier backup and are used.
+ */
+static void src_delta_load_chain(const uint8_t *base_hash) {
+    memset(&delta_chain, 0, sizeof(delta_chain));
+    memset(delta_source, 0, sizeof(delta_source));
+    
+    uint8_t link[CRYPTO_SHA256_HASH_SIZE];
+    memcpy(link, base_hash, sizeof(link));
+    
+    for (uint32_t sequence = 1; sequence <= SRC_DELTA_MAX_CHAIN; sequence++) {
+        char path[64];
+        src_delta_path(path, sizeof(path), sequence, false);
+        if (!src_usb_file_exists(path)) {
+            break;
+        }
+        
+        if (!src_delta_verify_patch(sequence, link)) {
+            src_log("SRC: WARNING - Delta chain cut at D%02u, using %lu patches",
+                    (unsigned)sequence, (unsigned long)delta_chain.count);
+            break;
+        }
+        memcpy(link, delta_chain.result_hash, sizeof(link));
+    }
+}
+
+/**
+ * Recovery pass 2 for the delta chain: write each patch's sectors over the
+ * base image, then check the rebuilt image against the last patch
+ */
+static bool src_delta_commit_chain(void) {
+    src_write_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    
+    for (uint32_t sequence = 1; sequence <= delta_chain.count; sequence++) {
+        uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+        size_t size = 0;
+        if (!src_delta_stream_patch(sequence, true, hash, &size, &stats)) {
+            return false;
+        }
+        
+        /* SECURITY: The bytes written must be exactly the bytes verified */
+        if (size != delta_chain.file_size[sequence - 1] ||
+            memcmp(hash, delta_chain.file_hash[sequence - 1], sizeof(hash)) != 0) {
+            src_log("SRC: ERROR - D%02u changed between verification and write",
+                    (unsigned)sequence);
+            return false;
+        }
+    }
+    
+    src_log("SRC: Delta flash blocks: %lu unchanged, %lu programmed, %lu erased+programmed",
+            (unsigned long)stats.blocks_skipped,
+            (unsigned long)stats.blocks_programmed,
+            (unsigned long)stats.blocks_erased);
+    
+    /* SECURITY: The rebuilt image must be the one the last patch recorded */
+    uint8_t image_hash[CRYPTO_SHA256_HASH_SIZE];
+    if (!src_hash_firmware(FIRMWARE_REGION_START, FIRMWARE_REGION_SIZE, image_hash) ||
+        memcmp(image_hash, delta_chain.result_hash, sizeof(image_hash)) != 0) {
+        src_log("SRC: ERROR - Image rebuilt from the delta chain does not verify");
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * Restore one full image on USB whose hash (pass 1) has been authenticated,
+ * then the delta chain recorded on top of it if deltas is set
+ */
+static bool src_recover_image(const char *file, const uint8_t *image_hash,
+                              size_t firmware_size, bool deltas) {
+    char backup_path[64];
+    snprintf(backup_path, sizeof(backup_path), "%s/%s", USB_RECOVERY_PATH, file);
+    
+    /* SECURITY: Additional validation - verify firmware structure before write */
+    if (firmware_size == 0 || firmware_size > FIRMWARE_REGION_SIZE) {
+        src_log("SRC: ERROR - Invalid firmware size: %zu", firmware_size);
+        return false;
+    }
+    
+    /* Delta patches recorded on top of the image */
+    memset(&delta_chain, 0, sizeof(delta_chain));
+    if (deltas && firmware_size == FIRMWARE_REGION_SIZE) {
+        src_delta_load_chain(image_hash);
+    }
+    
+    /* Pass 2: stream the verified image into SPI flash
+     * SECURITY: Each chunk is read back after programming, and the whole
+     * stream must hash to the digest verified above */
+    if (!src_stream_commit_image(backup_path, image_hash, firmware_size,
+                                 delta_chain.count ? delta_source : NULL)) {
+        src_log("SRC: ERROR - Firmware verification failed after write");
+        return false;
+    }
+    
+    if (delta_chain.count > 0 && !src_delta_commit_chain()) {
+        src_log("SRC: ERROR - Delta chain verification failed after write");
+        return false;
+    }
+    
+    return true;
+}
+
+/* Pass 1 over one full image listed in the verified manifest */
+typedef struct {
+    const src_manifest_entry_t *entry;
+    char path[64];
+    recovery_buffers_t *buffers;
+    atomic_bool cancel;     /* A higher-priority candidate already matched */
+    bool hashed;            /* Pass 1 ran to the end */
+    bool read_ok;
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    size_t size;
+} recovery_candidate_t;
+
+static void recovery_check_candidate(recovery_candidate_t *candidate, bool scheduled) {
+    candidate->read_ok = recovery_hash_image(candidate->path, candidate->buffers,
+                                             &candidate->cancel, scheduled,
+                                             candidate->hash, &candidate->size);
+    candidate->hashed = !atomic_load(&candidate->cancel);
+}
+
+/* SECURITY: The image must be the one the signed manifest lists */
+static bool recovery_candidate_matches(const recovery_candidate_t *candidate) {
+    return candidate->hashed && candidate->read_ok &&
+           candidate->size == candidate->entry->size &&
+           memcmp(candidate->hash, candidate->entry->hash, sizeof(candidate->hash)) == 0;
+}
+
+#ifdef PLATFORM_THREADS
+static void recovery_candidate_worker(void *arg) {
+    recovery_check_candidate(arg, false);
+}
+
+/**
+ * Pass 1 over all candidates at once: the first on this thread, the others
+ * on workers with buffers of their own, so a corrupt A costs no more than
+ * the slower of A and B. Results are taken in priority order; once one
+ * matches, the workers behind it are cancelled as they can no longer win,
+ * and its chunk digests are kept in recovery_buffers for pass 2.
+ * Candidates left without a worker are hashed by the sequential pass.
+ */
+static void src_hash_candidates_concurrently(recovery_candidate_t *candidates,
+                                             uint32_t count) {
+    platform_thread_t threads[SRC_MANIFEST_MAX_ENTRIES];
+    bool started[SRC_MANIFEST_MAX_ENTRIES] = { false };
+    
+    for (uint32_t i = 1; i < count; i++) {
+        candidates[i].buffers = malloc(sizeof(recovery_buffers_t));
+        if (!candidates[i].buffers) {
+            break;
+        }
+        started[i] = platform_thread_create(&threads[i], recovery_candidate_worker,
+                                            &candidates[i]);
+        if (!started[i]) {
+            free(candidates[i].buffers);
+            candidates[i].buffers = NULL;
+            break;
+        }
+    }
+    
+    recovery_check_candidate(&candidates[0], true);
+    bool matched = recovery_candidate_matches(&candidates[0]);
+    
+    for (uint32_t i = 1; i < count; i++) {
+        if (matched || src_sched_cancelled()) {
+            for (uint32_t j = i; j < count; j++) {
+                atomic_store(&candidates[j].cancel, true);
+            }
+        }
+        if (!started[i]) {
+            continue;
+        }
+        platform_thread_join(&threads[i]);
+        if (!matched && recovery_candidate_matches(&candidates[i])) {
+            matched = true;
+            recovery_buffers_t *buffers = candidates[i].buffers;
+            memcpy(recovery_buffers.chunk_hash, buffers->chunk_hash,
+                   buffers->chunk_count * sizeof(buffers->chunk_hash[0]));
+            recovery_buffers.chunk_count = buffers->chunk_count;
+            memcpy(recovery_buffers.chunk_image, buffers->chunk_image,
+                   sizeof(recovery_buffers.chunk_image));
+        }
+        free(candidates[i].buffers);
+        candidates[i].buffers = NULL;
+    }
+}
+#endif
+
+/**
+ * Recovery with a verified manifest: its full images are tried newest
+ * first, each checked against its entry rather than a signature of its own
+ */
+static bool src_recover_with_manifest(void) {
+    recovery_candidate_t candidates[SRC_MANIFEST_MAX_ENTRIES];
+    uint32_t count = 0;
+    
+    /* Full images by generation, newest first (ties keep manifest order) */
+    for (uint32_t i = 0; i < usb_manifest.entry_count; i++) {
+        const src_manifest_entry_t *entry = &usb_manifest.entries[i];
+        if (entry->kind != SRC_MANIFEST_FULL) {
+            continue;
+        }
+        uint32_t at = count++;
+        while (at > 0 && candidates[at - 1].entry->generation < entry->generation) {
+            candidates[at] = candidates[at - 1];
+            at--;
+        }
+        memset(&candidates[at], 0, sizeof(candidates[at]));
+        candidates[at].entry = entry;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        recovery_candidate_t *candidate = &candidates[i];
+        snprintf(candidate->path, sizeof(candidate->path), "%s/%s",
+                 USB_RECOVERY_PATH, candidate->entry->name);
+        candidate->buffers = &recovery_buffers;
+        atomic_init(&candidate->cancel, false);
+    }
+    
+#ifdef PLATFORM_THREADS
+    if (count > 1) {
+        src_hash_candidates_concurrently(candidates, count);
+    }
+#endif
+    
+    for (uint32_t i = 0; i < count && !src_sched_cancelled(); i++) {
+        recovery_candidate_t *candidate = &candidates[i];
+        const src_manifest_entry_t *entry = candidate->entry;
+        src_log("SRC: Attempting recovery from %s", entry->name);
+        
+        /* Pass 1: hash the image as it streams in from USB, unless a
+         * worker already has */
+        if (!candidate->hashed) {
+            candidate->buffers = &recovery_buffers;
+            atomic_store(&candidate->cancel, false);
+            recovery_check_candidate(candidate, true);
+        }
+        if (!candidate->read_ok) {
+            if (candidate->size > FIRMWARE_REGION_SIZE) {
+                src_log("SRC: ERROR - %s exceeds firmware region size", candidate->path);
+            }
+            src_log("SRC: ERROR - Cannot read %s", entry->name);
+            continue;
+        }
+        
+        if (!recovery_candidate_matches(candidate)) {
+            src_log("SRC: ERROR - %s does not match the manifest", entry->name);
+            continue;
+        }
+        
+        /* Pass 2 needs this image's chunk digests; a worker's are gone
+         * unless it was the first to match */
+        if (recovery_buffers.chunk_count == 0 ||
+            memcmp(recovery_buffers.chunk_image, candidate->hash, sizeof(candidate->hash)) != 0) {
+            candidate->buffers = &recovery_buffers;
+            recovery_check_candidate(candidate, true);
+            if (!recovery_candidate_matches(candidate)) {
+                src_log("SRC: ERROR - %s changed between verification and write", entry->name);
+                continue;
+            }
+        }
+        
+        if (src_recover_image(entry->name, candidate->hash, candidate->size, i == 0)) {
+            src_log("SRC: Successfully recovered from %s", entry->name);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Images to try on a stick without a signed manifest, newest first
+ * manifest.json is not signed: it may only order A.bin and B.bin and pass
+ * over an image it lists as too large. Whatever is tried is still checked
+ * against signature.sig. Returns 0 if there is nothing worth trying.
+ */
+static uint32_t src_legacy_candidates(const char *files[SRC_MANIFEST_JSON_MAX_BACKUPS]) {
+    files[0] = BACKUP_A_FILE;
+    files[1] = BACKUP_B_FILE;
+    
+    src_manifest_json_t hint;
+    if (!src_read_manifest_json(&hint)) {
+        return 2;
+    }
+    if (hint.board_id[0] != '\0' && config.board_id[0] != '\0' &&
+        strncmp(hint.board_id, config.board_id, sizeof(hint.board_id)) != 0) {
+        src_log("SRC: ERROR - %s was written for another board", MANIFEST_FILE);
+        return 0;
+    }
+    
+    uint32_t count = 0;
+    uint32_t generations[SRC_MANIFEST_JSON_MAX_BACKUPS];
+    for (uint32_t i = 0; i < hint.backup_count; i++) {
+        const src_manifest_json_backup_t *backup = &hint.backups[i];
+        const char *file = strcmp(backup->name, BACKUP_A_FILE) == 0 ? BACKUP_A_FILE :
+                           strcmp(backup->name, BACKUP_B_FILE) == 0 ? BACKUP_B_FILE : NULL;
+        bool listed = false;
+        for (uint32_t j = 0; j < count; j++) {
+            listed = listed || files[j] == file;
+        }
+        if (!file || listed) {
+            continue;
+        }
+        if (backup->size > FIRMWARE_REGION_SIZE) {
+            src_log("SRC: WARNING - %s lists %s at %lu bytes, skipping it",
+                    MANIFEST_FILE, file, (unsigned long)backup->size);
+            continue;
+        }
+        
+        /* Newest first; equal generations keep the listed order */
+        uint32_t at = count++;
+        while (at > 0 && generations[at - 1] < backup->generation) {
+            files[at] = files[at - 1];
+            generations[at] = generations[at - 1];
+            at--;
+        }
+        files[at] = file;
+        generations[at] = backup->generation;
+    }
+    
+    if (count == 0 && hint.backup_count == 0) {
+        return 2;
+    }
+    return count;
+}
+
+/**
+ * Recovery from a stick written before the signed manifest: A.bin or B.bin
+ * signed by signature.sig, and the patches of A.bin, each with a signature
+ * file of its own
+ */
+static bool src_recover_legacy(void) {
+    const char *files[SRC_MANIFEST_JSON_MAX_BACKUPS];
+    uint32_t count = src_legacy_candidates(files);
+    if (count == 0) {
+        return false;
+    }
+    
+    char sig_path[64];
+    snprintf(sig_path, sizeof(sig_path), "%s/%s", USB_RECOVERY_PATH, SIGNATURE_FILE);
+    
+    /* Read signature */
+    uint8_t signature[512];
+    size_t sig_size = sizeof(signature);
+    if (!src_usb_read_file(sig_path, signature, &sig_size)) {
+        src_log("SRC: ERROR - Cannot read signature");
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < count && !src_sched_cancelled(); i++) {
+        src_log("SRC: Attempting recovery from %s", files[i]);
+        
+        char backup_path[64];
+        snprintf(backup_path, sizeof(backup_path), "%s/%s", USB_RECOVERY_PATH, files[i]);
+        
+        /* Pass 1: hash the image as it streams in from USB */
+        uint8_t image_hash[CRYPTO_SHA256_HASH_SIZE];
+        size_t firmware_size = 0;
+        if (!src_hash_usb_image(backup_path, image_hash, &firmware_size)) {
+            src_log("SRC: ERROR - Cannot read %s", files[i]);
+            continue;
+        }
+        
+        /* SECURITY: Verify signature before any flash write */
+        int verify_result = verify_cache_verify_hash(image_hash, signature, sig_size);
+        if (verify_result != 0) {
+            src_log("SRC: ERROR - Signature verification failed for %s (error: %d)", 
+                   files[i], verify_result);
+            continue;
+        }
+        
+        if (src_recover_image(files[i], image_hash, firmware_size, i == 0)) {
+            src_log("SRC: Successfully recovered from %s", files[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Attempt recovery from USB device
+ */
+bool src_recover_from_usb(void) {
+    src_log("SRC: Starting USB recovery process");
+    
+    if (!src_usb_check_present()) {
+        src_log("SRC: ERROR - USB device not present");
+        return false;
+    }
+    
+    current_state = SRC_STATE_RECOVERING;
+    
+    /* The signed manifest names the images to use; sticks written before
+     * it have A.bin signed by signature.sig */
+    bool recovery_success;
+    usb_manifest_valid = src_read_manifest(USB_RECOVERY_PATH, &usb_manifest);
+    if (usb_manifest_valid) {
+        recovery_success = src_recover_with_manifest();
+    } else {
+        src_log("SRC: WARNING - No valid %s, trying %s", SIGNED_MANIFEST_FILE,
+                SIGNATURE_FILE);
+        recovery_success = src_recover_legacy();
+    }
+    
+    if (recovery_success) {
+        config.last_recovery_timestamp = platform_get_timestamp();
+        src_write_config(&config);
+    }
+    
+    current_state = SRC_STATE_CHECKING_BOOT;
+    return recovery_success;
+}
+
+/**
+ * Check that the backup chain in the signed manifest ends at
+ * config.firmware_hash, so a patch against that image can be appended to it
+ * (usb_manifest then holds the manifest to extend)
+ */
+static bool src_delta_tail_matches(void) {
+    usb_manifest_valid = src_read_manifest(USB_RECOVERY_PATH, &usb_manifest);
+    if (!usb_manifest_valid || usb_manifest.entry_count >= SRC_MANIFEST_MAX_ENTRIES ||
+        src_manifest_find_patch(&usb_manifest, config.delta_count + 1) != NULL) {
+        return false;
+    }
+    
+    const src_manifest_entry_t *tail = (config.delta_count == 0)
+        ? src_manifest_newest_full(&usb_manifest)
+        : src_manifest_find_patch(&usb_manifest, config.delta_count);
+    return tail != NULL &&
+           memcmp(tail->image_hash, config.firmware_hash, sizeof(tail->image_hash)) == 0;
+}
+
+/**
+ * Remove every delta patch and signature from USB
+ */
+static void src_delta_remove_chain(void) {
+    for (uint32_t sequence = 1; sequence <= SRC_DELTA_MAX_CHAIN; sequence++) {
+        char path[64];
+        src_delta_path(path, sizeof(path), sequence, false);
+        if (src_usb_file_exists(path)) {
+            src_usb_delete_file(path);
+        }
+        src_delta_path(path, sizeof(path), sequence, true);
+        if (src_usb_file_exists(path)) {
+            src_usb_delete_file(path);
+        }
+    }
 }
 
 /**
- * Attempt recovery from USB device
+ * Delta backup: write the sectors that changed since the last backup as the
+ * next patch of the chain. One pass over flash hashes the whole image,
+ * copies the changed sectors and re-checks every other sector against the
+ * index, so the patch, its result hash and the new index describe the same
+ * bytes. Returns false if nothing was committed and a full backup is needed.
  */
-bool src_recover_from_usb(void) {
-    src_log("SRC: Starting USB recovery process");
-    
-    if (!src_usb_check_present()) {
-        src_log("SRC: ERROR - USB device not present");
+static bool src_backup_delta(const integrity_result_t *changes, uint32_t now) {
+    uint32_t count = changes->sectors_bad;
+    if (count == 0 || config.delta_count >= SRC_DELTA_MAX_CHAIN ||
+        config.delta_bytes > SRC_DELTA_MAX_BYTES ||
+        (size_t)count * INTEGRITY_SECTOR_SIZE > SRC_DELTA_MAX_BYTES - config.delta_bytes) {
+        src_log("SRC: Delta chain full, compacting into a full backup");
         return false;
     }
     
-    current_state = SRC_STATE_RECOVERING;
-    
-    /* Read manifest to determine which backup to use */
-    uint8_t manifest_buffer[4096];
-    size_t manifest_size = sizeof(manifest_buffer);
-    
-    if (!src_usb_read_file("/SECURITY_RECOVERY/manifest.json", 
-                           manifest_buffer, &manifest_size)) {
-        src_log("SRC: ERROR - Cannot read manifest.json");
+    if (!src_delta_tail_matches()) {
+        src_log("SRC: Backup chain on USB does not match, starting a full backup");
         return false;
     }
     
-    /* Parse manifest (simplified - in production use proper JSON parser) */
-    /* For now, try backup A first, then B */
-    const char *backup_files[] = {BACKUP_A_FILE, BACKUP_B_FILE};
-    bool recovery_success = false;
-    
-    for (int i = 0; i < 2; i++) {
-        src_log("SRC: Attempting recovery from %s", backup_files[i]);
-        
-        char backup_path[256];
-        snprintf(backup_path, sizeof(backup_path), 
-                "/SECURITY_RECOVERY/%s", backup_files[i]);
-        
-        /* Read firmware image */
-        uint8_t *firmware_buffer = malloc(FIRMWARE_REGION_SIZE);
-        if (!firmware_buffer) {
-            src_log("SRC: ERROR - Memory allocation failed");
-            continue;
+    /* Patch file (room for every changed sector's data), followed by the
+     * new leaf hashes and the sector numbers for the index */
+    size_t data_offset = src_delta_data_offset(count);
+    size_t patch_max = data_offset + (size_t)count * INTEGRITY_SECTOR_SIZE;
+    uint8_t *patch = malloc(patch_max + count * (CRYPTO_SHA256_HASH_SIZE + sizeof(uint32_t)));
+    if (!patch) {
+        src_log("SRC: ERROR - Memory allocation failed");
+        return false;
+    }
+    memset(patch, 0, data_offset);
+    src_delta_header_t *header = (src_delta_header_t *)patch;
+    uint32_t *table = (uint32_t *)(patch + sizeof(*header));
+    uint8_t (*hashes)[CRYPTO_SHA256_HASH_SIZE] =
+        (uint8_t (*)[CRYPTO_SHA256_HASH_SIZE])(patch + patch_max);
+    uint32_t *sectors = (uint32_t *)(patch + patch_max + count * CRYPTO_SHA256_HASH_SIZE);
+    
+    crypto_sha256_ctx_t image_ctx;
+    bool ok = crypto_sha256_init(&image_ctx) == CRYPTO_SUCCESS;
+    uint32_t captured = 0;
+    uint32_t stored = 0;    /* Captured sectors with data in the patch */
+    
+    for (uint32_t sector = 0; ok && sector < INTEGRITY_MAX_SECTORS; sector++) {
+        uint32_t offset;
+        size_t len;
+        integrity_get_sector_range(sector, &offset, &len);
+        if (!src_sched_checkpoint(offset, FIRMWARE_REGION_SIZE)) {
+            ok = false;
+            break;
         }
         
-        size_t firmware_size = FIRMWARE_REGION_SIZE;
-        if (!src_usb_read_file(backup_path, firmware_buffer, &firmware_size)) {
-            src_log("SRC: ERROR - Cannot read %s", backup_files[i]);
-            free(firmware_buffer);
+        if ((changes->bad_map[sector / 8] >> (sector % 8)) & 1) {
+            if (captured == count) {
+                ok = false;
+                break;
+            }
+            /* Erased sectors go in the table only */
+            uint8_t *data = patch + data_offset + (size_t)stored * INTEGRITY_SECTOR_SIZE;
+            integrity_leaf_ctx_t leaf_ctx;
+            ok = integrity_leaf_init(&leaf_ctx) && spi_flash_read(offset, data, len);
+            if (ok) {
+                integrity_note_read(offset, data, len);
+                integrity_leaf_update(&leaf_ctx, data, len);
+                ok = integrity_leaf_final(&leaf_ctx, hashes[captured]);
+            }
+            crypto_sha256_update(&image_ctx, data, len);
+            sectors[captured] = sector;
+            if (leaf_ctx.populated) {
+                table[captured++] = sector;
+                stored++;
+            } else {
+                table[captured++] = sector | SRC_DELTA_SECTOR_ERASED;
+            }
             continue;
         }
         
-        /* Read signature */
-        char sig_path[256];
-        snprintf(sig_path, sizeof(sig_path), 
-                "/SECURITY_RECOVERY/signature.sig", backup_files[i]);
-        
-        uint8_t signature[512];
-        size_t sig_size = sizeof(signature);
-        if (!src_usb_read_file(sig_path, signature, &sig_size)) {
-            src_log("SRC: ERROR - Cannot read signature");
-            free(firmware_buffer);
-            continue;
+        /* Unchanged sectors must still be those of the previous backup */
+        integrity_leaf_ctx_t sector_ctx;
+        ok = integrity_leaf_init(&sector_ctx);
+        uint8_t block[SRC_HASH_BLOCK_SIZE];
+        for (size_t done = 0; ok && done < len; done += sizeof(block)) {
+            size_t part = len - done;
+            if (part > sizeof(block)) {
+                part = sizeof(block);
+            }
+            ok = spi_flash_read(offset + done, block, part);
+            integrity_note_read(offset + done, block, part);
+            integrity_leaf_update(&sector_ctx, block, part);
+            crypto_sha256_update(&image_ctx, block, part);
         }
         
-        /* SECURITY: Verify signature before any flash write */
-        int verify_result = src_verify_signature(firmware_buffer, firmware_size, 
-                                                   signature, sig_size);
-        if (verify_result != 0) {
-            src_log("SRC: ERROR - Signature verification failed for %s (error: %d)", 
-                   backup_files[i], verify_result);
-            free(firmware_buffer);
-            continue;
+        uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+        uint8_t leaf[CRYPTO_SHA256_HASH_SIZE];
+        ok = integrity_leaf_final(&sector_ctx, hash) && ok &&
+             integrity_get_leaf(sector, leaf);
+        if (ok && memcmp(hash, leaf, sizeof(hash)) != 0) {
+            src_log("SRC: WARNING - Firmware changed during backup (sector %lu)",
+                    (unsigned long)sector);
+            ok = false;
         }
+    }
+    
+    uint8_t image_hash[CRYPTO_SHA256_HASH_SIZE];
+    uint8_t file_hash[CRYPTO_SHA256_HASH_SIZE];
+    ok = (crypto_sha256_final(&image_ctx, image_hash) == CRYPTO_SUCCESS) && ok &&
+         captured == count;
+    
+    uint32_t sequence = config.delta_count + 1;
+    size_t patch_size = data_offset + (size_t)stored * INTEGRITY_SECTOR_SIZE;
+    if (ok) {
+        header->magic = SRC_DELTA_MAGIC;
+        header->version = SRC_DELTA_VERSION;
+        header->sequence = (uint16_t)sequence;
+        header->sector_size = INTEGRITY_SECTOR_SIZE;
+        header->sector_count = count;
+        header->region_size = FIRMWARE_REGION_SIZE;
+        header->data_offset = data_offset;
+        memcpy(header->base_hash, config.firmware_hash, sizeof(header->base_hash));
+        memcpy(header->result_hash, image_hash, sizeof(header->result_hash));
         
-        /* SECURITY: Additional validation - verify firmware structure before write */
-        if (firmware_size == 0 || firmware_size > FIRMWARE_REGION_SIZE) {
-            src_log("SRC: ERROR - Invalid firmware size: %zu", firmware_size);
-            free(firmware_buffer);
-            continue;
+        char patch_path[64];
+        src_delta_path(patch_path, sizeof(patch_path), sequence, false);
+        if (crypto_sha256(patch, patch_size, file_hash) != CRYPTO_SUCCESS ||
+            !src_usb_write_file(patch_path, patch, patch_size)) {
+            src_log("SRC: ERROR - Failed to write D%02u", (unsigned)sequence);
+            ok = false;
         }
-        
-        /* SECURITY: Verify firmware is signed and authentic before flash write */
-        /* Write firmware to SPI flash */
-        if (!src_write_firmware(firmware_buffer, firmware_size, 
-                               FIRMWARE_REGION_START)) {
-            src_log("SRC: ERROR - Failed to write firmware to SPI");
-            free(firmware_buffer);
-            continue;
+    }
+    
+    if (ok) {
+        /* Move the index to the new image */
+        if (!integrity_update_sectors(sectors, (const uint8_t (*)[32])hashes, count,
+                                      config.firmware_root)) {
+            src_log("SRC: WARNING - Failed to update integrity index");
+            memset(config.firmware_root, 0, sizeof(config.firmware_root));
         }
         
-        /* SECURITY: Post-write verification - verify firmware was written correctly */
-        uint8_t *verify_read = malloc(firmware_size);
-        if (verify_read) {
-            if (src_read_firmware(verify_read, firmware_size, FIRMWARE_REGION_START)) {
-                if (memcmp(firmware_buffer, verify_read, firmware_size) != 0) {
-                    src_log("SRC: ERROR - Firmware verification failed after write");
-                    free(verify_read);
-                    free(firmware_buffer);
-                    continue;
-                }
-            }
-            free(verify_read);
+        /* Manifest goes last: recovery ignores a patch until it is listed */
+        char patch_name[16];
+        snprintf(patch_name, sizeof(patch_name), DELTA_FILE_FORMAT, (unsigned)sequence);
+        usb_manifest.generation++;
+        src_manifest_set_entry(&usb_manifest.entries[usb_manifest.entry_count++],
+                               patch_name, SRC_MANIFEST_DELTA, sequence,
+                               (uint32_t)patch_size, file_hash, image_hash,
+                               config.firmware_root);
+        ok = src_manifest_write();
+        if (!ok) {
+            /* Next tick must not take the index as backed up */
+            memset(config.firmware_root, 0, sizeof(config.firmware_root));
         }
+    }
+    
+    if (ok) {
+        src_update_metadata(image_hash);
         
-        src_log("SRC: Successfully recovered from %s", backup_files[i]);
-        recovery_success = true;
-        config.last_recovery_timestamp = platform_get_timestamp();
+        memcpy(config.firmware_hash, image_hash, sizeof(config.firmware_hash));
+        config.delta_count = (uint16_t)sequence;
+        config.delta_bytes += stored * INTEGRITY_SECTOR_SIZE;
+        config.last_backup_timestamp = now;
         src_write_config(&config);
         
-        free(firmware_buffer);
-        break;
+        src_log("SRC: Delta backup D%02u completed (%lu sectors changed)",
+                (unsigned)sequence, (unsigned long)count);
     }
     
-    current_state = SRC_STATE_CHECKING_BOOT;
-    return recovery_success;
+    free(patch);
+    return ok;
 }
 
+/* Full backup work area: one flash block at a time, never the whole image */
+typedef struct {
+    uint8_t block[IMAGE_CODEC_BLOCK_SIZE];
+    uint8_t out[SRC_BACKUP_WRITE_SIZE + IMAGE_CODEC_MAX_BLOCK_OUT];
+    uint16_t table[IMAGE_CODEC_HASH_SIZE];
+    uint8_t leaves[INTEGRITY_MAX_SECTORS][32];
+} src_backup_work_t;
+
 /**
- * Perform automatic backup if conditions are met
+ * Stream the firmware region into a new file at path
+ * Each block is read from flash once; the image hash, the sector hashes
+ * (work->leaves) and the file contents are all computed from that read,
+ * so they describe the same bytes even if flash changes meanwhile.
  */
-void src_perform_backup(void) {
-    if (!config.enabled || src_is_disabled()) {
-        return;
+static bool src_backup_write_image(const char *path, src_backup_work_t *work,
+                                   uint8_t *hash) {
+    crypto_sha256_ctx_t image_ctx;
+    integrity_leaf_ctx_t sector_ctx;
+    if (crypto_sha256_init(&image_ctx) != CRYPTO_SUCCESS ||
+        !integrity_leaf_init(&sector_ctx)) {
+        src_log("SRC: ERROR - Hash calculation failed");
+        return false;
     }
     
-    /* Check if backup interval has elapsed */
-    uint32_t now = platform_get_timestamp();
-    uint32_t time_since_backup = now - config.last_backup_timestamp;
-    
-    if (time_since_backup < MAX_BACKUP_INTERVAL_MS) {
-        return;  // Too soon for next backup
+    size_t pending = 0;
+    size_t written = 0;
+#if SRC_COMPRESS_BACKUPS
+    image_codec_header_t header;
+    image_codec_init_header(&header, FIRMWARE_REGION_SIZE);
+    memcpy(work->out, &header, sizeof(header));
+    pending = sizeof(header);
+#endif
+    
+    for (uint32_t offset = 0; offset < FIRMWARE_REGION_SIZE;
+         offset += IMAGE_CODEC_BLOCK_SIZE) {
+        if (!src_sched_checkpoint(offset, FIRMWARE_REGION_SIZE)) {
+            return false;
+        }
+        if (!src_read_firmware(work->block, IMAGE_CODEC_BLOCK_SIZE,
+                               FIRMWARE_REGION_START + offset)) {
+            src_log("SRC: ERROR - Failed to read firmware");
+            return false;
+        }
+        
+        integrity_note_read(FIRMWARE_REGION_START + offset, work->block,
+                            IMAGE_CODEC_BLOCK_SIZE);
+        crypto_sha256_update(&image_ctx, work->block, IMAGE_CODEC_BLOCK_SIZE);
+        integrity_leaf_update(&sector_ctx, work->block, IMAGE_CODEC_BLOCK_SIZE);
+        if ((offset + IMAGE_CODEC_BLOCK_SIZE) % INTEGRITY_SECTOR_SIZE == 0) {
+            if (!integrity_leaf_final(&sector_ctx, work->leaves[offset / INTEGRITY_SECTOR_SIZE]) ||
+                !integrity_leaf_init(&sector_ctx)) {
+                src_log("SRC: ERROR - Hash calculation failed");
+                return false;
+            }
+        }
+        
+#if SRC_COMPRESS_BACKUPS
+        pending += image_codec_compress_block(work->block, IMAGE_CODEC_BLOCK_SIZE,
+                                              work->out + pending, work->table);
+#else
+        memcpy(work->out + pending, work->block, IMAGE_CODEC_BLOCK_SIZE);
+        pending += IMAGE_CODEC_BLOCK_SIZE;
+#endif
+        
+        /* Write whole SRC_BACKUP_WRITE_SIZE units, so every write but the
+         * last covers whole clusters of the file; the rest carries over */
+        bool last = (offset + IMAGE_CODEC_BLOCK_SIZE >= FIRMWARE_REGION_SIZE);
+        while (pending >= SRC_BACKUP_WRITE_SIZE || (last && pending > 0)) {
+            size_t n = (pending < SRC_BACKUP_WRITE_SIZE) ? pending : SRC_BACKUP_WRITE_SIZE;
+            bool ok = (written == 0) ? src_usb_write_file(path, work->out, n)
+                                     : src_usb_append_file(path, work->out, n);
+            if (!ok) {
+                src_log("SRC: ERROR - Failed to write backup A");
+                return false;
+            }
+            written += n;
+            pending -= n;
+            memmove(work->out, work->out + n, pending);
+        }
     }
     
-    if (!src_usb_check_present()) {
-        src_log("SRC: USB not present, skipping backup");
-        return;
+    if (crypto_sha256_final(&image_ctx, hash) != CRYPTO_SUCCESS) {
+        src_log("SRC: ERROR - Hash calculation failed");
+        return false;
     }
     
-    src_log("SRC: Starting automatic backup");
-    
-    /* Read current firmware */
-    uint8_t *firmware_buffer = malloc(FIRMWARE_REGION_SIZE);
-    if (!firmware_buffer) {
-        src_log("SRC: ERROR - Memory allocation failed");
-        return;
+    src_log("SRC: Backup image %lu bytes (%lu%% of firmware)",
+            (unsigned long)written,
+            (unsigned long)((uint64_t)written * 100 / FIRMWARE_REGION_SIZE));
+    return true;
+}
+
+/**
+ * Mirror the full images of the signed manifest into manifest.json
+ */
+static void src_write_manifest_json(uint32_t now) {
+    src_manifest_json_t json;
+    memset(&json, 0, sizeof(json));
+    memcpy(json.board_id, config.board_id, sizeof(json.board_id) - 1);
+    json.timestamp = now;
+    
+    for (uint32_t i = 0; i < usb_manifest.entry_count &&
+                         json.backup_count < SRC_MANIFEST_JSON_MAX_BACKUPS; i++) {
+        const src_manifest_entry_t *entry = &usb_manifest.entries[i];
+        if (entry->kind != SRC_MANIFEST_FULL) {
+            continue;
+        }
+        src_manifest_json_backup_t *backup = &json.backups[json.backup_count++];
+        memcpy(backup->name, entry->name, sizeof(backup->name));
+        backup->generation = entry->generation;
+        backup->size = entry->size;
+        backup->has_hash = true;
+        memcpy(backup->hash, entry->hash, sizeof(backup->hash));
     }
     
-    if (!src_read_firmware(firmware_buffer, FIRMWARE_REGION_SIZE, 
-                          FIRMWARE_REGION_START)) {
-        src_log("SRC: ERROR - Failed to read firmware");
-        free(firmware_buffer);
+    src_update_manifest(&json);
+}
+
+/**
+ * Start usb_manifest for a full backup: the new image under name, and the
+ * previous A.bin image (if any) under each of renamed
+ */
+static void src_backup_manifest(uint32_t generation, const char *name, const uint8_t *hash,
+                                const src_manifest_entry_t *previous,
+                                const char *const *renamed, uint32_t renamed_count) {
+    memset(&usb_manifest, 0, sizeof(usb_manifest));
+    usb_manifest.generation = generation;
+    src_manifest_set_entry(&usb_manifest.entries[usb_manifest.entry_count++],
+                           name, SRC_MANIFEST_FULL, 0, FIRMWARE_REGION_SIZE,
+                           hash, hash, config.firmware_root);
+    for (uint32_t i = 0; previous && i < renamed_count; i++) {
+        src_manifest_entry_t *entry = &usb_manifest.entries[usb_manifest.entry_count++];
+        *entry = *previous;
+        memset(entry->name, 0, sizeof(entry->name));
+        snprintf(entry->name, sizeof(entry->name), "%s", renamed[i]);
+    }
+}
+
+/**
+ * Full backup: write the whole image as A.bin, rotating A.bin to B.bin
+ * Also compacts the delta chain, whose patches no longer apply to A.bin.
+ * The new manifest lists A.bin and, if the old manifest verified, the image
+ * now in B.bin; entries from an unverified manifest are never re-signed.
+ *
+ * The image is written as A.new and signed before anything is renamed:
+ * the manifest signed for the rotation lists A.new, and the old image as
+ * both A.bin and B.bin. Whichever step a reset or unplug interrupts, some
+ * listed file matches its entry.
+ */
+static void src_backup_full(uint32_t now) {
+    src_backup_work_t *work = malloc(sizeof(*work));
+    if (!work) {
+        src_log("SRC: ERROR - Memory allocation failed");
         return;
     }
     
-    /* Calculate hash */
-    uint8_t hash[32];
-    crypto_sha256(firmware_buffer, FIRMWARE_REGION_SIZE, hash);
-    
-    /* Check if firmware has changed */
-    if (memcmp(hash, config.firmware_hash, 32) == 0) {
-        src_log("SRC: Firmware unchanged, skipping backup");
-        free(firmware_buffer);
-        return;
+    /* The current A.bin entry becomes the B.bin entry */
+    src_manifest_entry_t previous;
+    bool have_previous = false;
+    uint32_t generation = 0;
+    usb_manifest_valid = src_read_manifest(USB_RECOVERY_PATH, &usb_manifest);
+    if (usb_manifest_valid) {
+        const src_manifest_entry_t *entry = src_manifest_find(&usb_manifest, BACKUP_A_FILE);
+        have_previous = (entry != NULL && entry->kind == SRC_MANIFEST_FULL);
+        if (have_previous) {
+            previous = *entry;
+        }
+        generation = usb_manifest.generation;
     }
     
-    /* Rotate backups: B -> deleted, A -> B, new -> A */
-    /* First, delete old B if it exists */
+    char backup_a_path[256];
     char backup_b_path[256];
+    char backup_new_path[256];
+    snprintf(backup_a_path, sizeof(backup_a_path), 
+            "/SECURITY_RECOVERY/%s", BACKUP_A_FILE);
     snprintf(backup_b_path, sizeof(backup_b_path), 
             "/SECURITY_RECOVERY/%s", BACKUP_B_FILE);
-    src_usb_delete_file(backup_b_path);
+    snprintf(backup_new_path, sizeof(backup_new_path), 
+            "/SECURITY_RECOVERY/%s", BACKUP_NEW_FILE);
     
-    /* Move A to B */
-    char backup_a_path[256];
-    snprintf(backup_a_path, sizeof(backup_a_path), 
-            "/SECURITY_RECOVERY/%s", BACKUP_A_FILE);
+    /* Write new firmware to A.new; the stick is unchanged if this fails */
+    uint8_t hash[32];
+    if (!src_backup_write_image(backup_new_path, work, hash)) {
+        src_usb_delete_file(backup_new_path);
+        free(work);
+        return;
+    }
     
-    if (src_usb_file_exists(backup_a_path)) {
-        src_usb_rename_file(backup_a_path, backup_b_path);
+    /* Index the new baseline so integrity checks can go sector by sector */
+    if (!integrity_build((const uint8_t (*)[32])work->leaves, config.firmware_root)) {
+        src_log("SRC: WARNING - Failed to build integrity index");
+        memset(config.firmware_root, 0, sizeof(config.firmware_root));
     }
     
-    /* Write new firmware to A */
-    if (!src_usb_write_file(backup_a_path, firmware_buffer, 
-                           FIRMWARE_REGION_SIZE)) {
-        src_log("SRC: ERROR - Failed to write backup A");
-        free(firmware_buffer);
+    /* Sign the rotation (the raw image hash for the new image) */
+    const char *rotating[] = { BACKUP_A_FILE, BACKUP_B_FILE };
+    src_backup_manifest(generation + 1, BACKUP_NEW_FILE, hash,
+                        have_previous ? &previous : NULL, rotating, 2);
+    if (!src_manifest_write()) {
+        memset(config.firmware_root, 0, sizeof(config.firmware_root));
+        free(work);
         return;
     }
     
-    /* Generate signature */
-    uint8_t signature[512];
-    size_t sig_size = sizeof(signature);
-    if (!crypto_sign(firmware_buffer, FIRMWARE_REGION_SIZE, 
-                    signature, &sig_size)) {
-        src_log("SRC: ERROR - Failed to generate signature");
-        free(firmware_buffer);
+    /* Patches were made against the old A.bin; signature.sig is superseded
+     * by the manifest */
+    src_delta_remove_chain();
+    char sig_path[64];
+    snprintf(sig_path, sizeof(sig_path), "%s/%s", USB_RECOVERY_PATH, SIGNATURE_FILE);
+    if (src_usb_file_exists(sig_path)) {
+        src_usb_delete_file(sig_path);
+    }
+    
+    /* Rotate backups: B -> deleted, A -> B, new -> A */
+    src_usb_delete_file(backup_b_path);
+    if (!src_usb_file_exists(backup_a_path) ||
+        !src_usb_rename_file(backup_a_path, backup_b_path)) {
+        have_previous = false;
+    }
+    if (!src_usb_rename_file(backup_new_path, backup_a_path)) {
+        /* A.new stays signed; the next full backup rotates again */
+        src_log("SRC: ERROR - Failed to rename %s", BACKUP_NEW_FILE);
+        memset(config.firmware_root, 0, sizeof(config.firmware_root));
+        free(work);
         return;
     }
     
-    /* Write signature */
-    char sig_path[256];
-    snprintf(sig_path, sizeof(sig_path), "/SECURITY_RECOVERY/signature.sig");
-    src_usb_write_file(sig_path, signature, sig_size);
+    /* Sign the manifest listing both images */
+    src_backup_manifest(generation + 1, BACKUP_A_FILE, hash,
+                        have_previous ? &previous : NULL, rotating + 1, 1);
+    if (!src_manifest_write()) {
+        memset(config.firmware_root, 0, sizeof(config.firmware_root));
+        free(work);
+        return;
+    }
     
     /* Update manifest and metadata */
-    src_update_manifest();
+    src_write_manifest_json(now);
     src_update_metadata(hash);
     
     /* Update config */
     memcpy(config.firmware_hash, hash, 32);
+    config.delta_count = 0;
+    config.delta_bytes = 0;
     config.last_backup_timestamp = now;
     src_write_config(&config);
     
     src_log("SRC: Backup completed successfully");
-    free(firmware_buffer);
+    free(work);
+}
+
+/**
+ * Perform automatic backup if conditions are met
+ */
+void src_perform_backup(void) {
+    if (!config.enabled || src_is_disabled()) {
+        return;
+    }
+    
+    /* Check if backup interval has elapsed */
+    uint32_t now = platform_get_timestamp();
+    uint32_t time_since_backup = now - config.last_backup_timestamp;
+    
+    if (time_since_backup < MAX_BACKUP_INTERVAL_MS) {
+        return;  // Too soon for next backup
+    }
+    
+    if (!src_usb_check_present()) {
+        src_log("SRC: USB not present, skipping backup");
+        return;
+    }
+    
+    src_log("SRC: Starting automatic backup");
+    
+    if (integrity_is_available(config.firmware_root)) {
+        /* The index describes the last backup: find the sectors that changed */
+        integrity_result_t changes;
+        if (!integrity_check_sectors(0, INTEGRITY_MAX_SECTORS, &changes)) {
+            src_log("SRC: ERROR - Failed to read firmware");
+            return;
+        }
+        
+        if (changes.sectors_bad == 0) {
+            src_log("SRC: Firmware unchanged, skipping backup");
+            return;
+        }
+        
+        if (src_backup_delta(&changes, now)) {
+            return;
+        }
+    } else {
+        /* Hash current firmware without buffering it */
+        uint8_t hash[32];
+        if (!src_hash_firmware(FIRMWARE_REGION_START, FIRMWARE_REGION_SIZE, hash)) {
+            src_log("SRC: ERROR - Failed to read firmware");
+            return;
+        }
+        
+        /* Check if firmware has changed */
+        if (memcmp(hash, config.firmware_hash, 32) == 0) {
+            src_log("SRC: Firmware unchanged, skipping backup");
+            return;
+        }
+    }
+    
+    src_backup_full(now);
 }
 
 /**
@@ -463,7 +2341,7 @@ bool src_disable_temporary(uint32_t duration_ms) {
     config.disable_until_timestamp = now + duration_ms;
     src_write_config(&config);
     
-    src_log("SRC: Recovery core disabled for %lu ms", duration_ms);
+    src_log("SRC: Recovery core disabled for %lu ms", (unsigned long)duration_ms);
     return true;
 }
 
@@ -496,27 +2374,10 @@ void src_handle_removal(void) {
     src_log("SRC: Starting removal process");
     
     /* Validate firmware integrity before removal */
-    uint8_t *firmware_buffer = malloc(FIRMWARE_REGION_SIZE);
-    if (!firmware_buffer) {
-        src_log("SRC: ERROR - Memory allocation failed");
-        return;
-    }
-    
-    if (!src_read_firmware(firmware_buffer, FIRMWARE_REGION_SIZE, 
-                          FIRMWARE_REGION_START)) {
-        src_log("SRC: ERROR - Failed to read firmware, aborting removal");
-        free(firmware_buffer);
-        removal_scheduled = false;
-        src_write_config(&config);
-        return;
-    }
-    
     /* SECURITY: Verify firmware hash using crypto module */
     uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
-    int hash_result = crypto_sha256(firmware_buffer, FIRMWARE_REGION_SIZE, hash);
-    if (hash_result != CRYPTO_SUCCESS) {
-        src_log("SRC: ERROR - Hash calculation failed during removal verification");
-        free(firmware_buffer);
+    if (!src_hash_firmware(FIRMWARE_REGION_START, FIRMWARE_REGION_SIZE, hash)) {
+        src_log("SRC: ERROR - Failed to hash firmware, aborting removal");
         removal_scheduled = false;
         src_write_config(&config);
         return;
@@ -524,7 +2385,6 @@ void src_handle_removal(void) {
     
     if (memcmp(hash, config.firmware_hash, CRYPTO_SHA256_HASH_SIZE) != 0) {
         src_log("SRC: ERROR - Firmware integrity check failed, aborting removal");
-        free(firmware_buffer);
         removal_scheduled = false;
         src_write_config(&config);
         return;
@@ -532,12 +2392,15 @@ void src_handle_removal(void) {
     
     /* Restore stock firmware layout */
     /* Clear SRC reserved region */
-    uint8_t zero_buffer[4096] = {0};
-    for (uint32_t offset = 0; offset < SRC_RESERVED_REGION_SIZE; 
-         offset += sizeof(zero_buffer)) {
-        spi_flash_write(SRC_RESERVED_REGION_START + offset, 
-                       zero_buffer, 
-                       sizeof(zero_buffer));
+    uint8_t zero_buffer[SPI_FLASH_MAX_PAGE_SIZE] = {0};
+    spi_flash_batch_t batch;
+    if (spi_flash_batch_begin(&batch, SRC_RESERVED_REGION_START,
+                              SRC_RESERVED_REGION_SIZE)) {
+        for (uint32_t offset = 0; offset < SRC_RESERVED_REGION_SIZE; 
+             offset += sizeof(zero_buffer)) {
+            spi_flash_batch_write(&batch, zero_buffer, sizeof(zero_buffer));
+        }
+        spi_flash_batch_end(&batch);
     }
     
     /* Disable recovery logic */
@@ -548,7 +2411,6 @@ void src_handle_removal(void) {
     spi_flash_lock();
     
     src_log("SRC: Removal completed successfully");
-    free(firmware_buffer);
     
     /* Reboot system */
     system_reboot();
@@ -559,34 +2421,53 @@ void src_handle_removal(void) {
  */
 int src_verify_signature(const uint8_t *firmware, size_t size,
                          const uint8_t *signature, size_t sig_size) {
-    return crypto_verify(firmware, size, signature, sig_size);
+    uint8_t hash[CRYPTO_SHA256_HASH_SIZE];
+    int hash_result = crypto_sha256(firmware, size, hash);
+    if (hash_result != CRYPTO_SUCCESS) {
+        return hash_result;
+    }
+    
+    return verify_cache_verify_hash(hash, signature, sig_size);
 }
 
 /**
  * Read configuration from SPI flash
  */
 bool src_read_config(src_config_t *config) {
-    uint32_t offset = SRC_RESERVED_REGION_START;
+    uint32_t offset = SRC_CONFIG_START;
     
     /* Use legacy offset if legacy board detected */
     if (legacy_detected) {
         offset = legacy_get_src_region_offset(&legacy_info);
     }
     
+    bool ok;
     if (legacy_detected) {
-        return legacy_spi_read(offset, (uint8_t *)config, 
-                              sizeof(src_config_t), &legacy_info);
+        ok = legacy_spi_read(offset, (uint8_t *)config, 
+                             sizeof(src_config_t), &legacy_info);
+    } else {
+        ok = spi_flash_read(offset, (uint8_t *)config, 
+                            sizeof(src_config_t));
+    }
+    if (!ok) {
+        return false;
     }
     
-    return spi_flash_read(offset, (uint8_t *)config, 
-                         sizeof(src_config_t));
+    /* Erased flash is not a config (it would read as disabled-forever) */
+    const uint8_t *bytes = (const uint8_t *)config;
+    for (size_t i = 0; i < sizeof(src_config_t); i++) {
+        if (bytes[i] != 0xFF) {
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
  * Write configuration to SPI flash
  */
 bool src_write_config(const src_config_t *config) {
-    uint32_t offset = SRC_RESERVED_REGION_START;
+    uint32_t offset = SRC_CONFIG_START;
     
     /* Use legacy offset if legacy board detected */
     if (legacy_detected) {
@@ -609,10 +2490,184 @@ bool src_read_firmware(uint8_t *buffer, size_t size, uint32_t offset) {
     return spi_flash_read(offset, buffer, size);
 }
 
+/**
+ * Hash a flash range in small chunks
+ */
+bool src_hash_firmware(uint32_t offset, size_t size, uint8_t *hash) {
+    if (!hash || size == 0) {
+        return false;
+    }
+    
+    crypto_sha256_ctx_t ctx;
+    if (crypto_sha256_init(&ctx) != CRYPTO_SUCCESS) {
+        return false;
+    }
+    
+    uint8_t block[SRC_HASH_BLOCK_SIZE];
+    for (size_t done = 0; done < size; done += sizeof(block)) {
+        size_t len = size - done;
+        if (len > sizeof(block)) {
+            len = sizeof(block);
+        }
+        
+        if (!src_sched_checkpoint(done, size) ||
+            !spi_flash_read(offset + done, block, len)) {
+            crypto_sha256_final(&ctx, hash);
+            return false;
+        }
+        integrity_note_read(offset + done, block, len);
+        crypto_sha256_update(&ctx, block, len);
+    }
+    
+    return crypto_sha256_final(&ctx, hash) == CRYPTO_SUCCESS;
+}
+
+/* Differential write action for one erase block */
+typedef enum {
+    SRC_BLOCK_SKIP,
+    SRC_BLOCK_PROGRAM,
+    SRC_BLOCK_ERASE
+} src_block_action_t;
+
+/* Buffer flash is read back into for compares */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} src_scratch_t;
+
+/**
+ * Compare an erase block's range with the live flash and decide how to write it
+ */
+static bool src_classify_block(uint32_t offset, const uint8_t *data, size_t len,
+                               const src_scratch_t *scratch, src_block_action_t *action) {
+    uint8_t *current = scratch->data;
+    bool identical = true;
+    
+    for (size_t done = 0; done < len; done += scratch->size) {
+        size_t part = len - done;
+        if (part > scratch->size) {
+            part = scratch->size;
+        }
+        
+        if (!spi_flash_read(offset + done, current, part)) {
+            return false;
+        }
+        
+        if (memcmp(current, data + done, part) == 0) {
+            continue;
+        }
+        identical = false;
+        
+        /* Programming can only clear bits; any 0->1 needs an erase */
+        for (size_t i = 0; i < part; i++) {
+            if ((current[i] & data[done + i]) != data[done + i]) {
+                *action = SRC_BLOCK_ERASE;
+                return true;
+            }
+        }
+    }
+    
+    *action = identical ? SRC_BLOCK_SKIP : SRC_BLOCK_PROGRAM;
+    return true;
+}
+
+/**
+ * Read back a written range and compare it with the source
+ */
+static bool src_verify_written(uint32_t offset, const uint8_t *data, size_t len,
+                               const src_scratch_t *scratch) {
+    uint8_t *verify_buffer = scratch->data;
+    
+    for (size_t done = 0; done < len; done += scratch->size) {
+        size_t part = len - done;
+        if (part > scratch->size) {
+            part = scratch->size;
+        }
+        
+        if (!spi_flash_read(offset + done, verify_buffer, part)) {
+            return false;
+        }
+        
+        if (memcmp(data + done, verify_buffer, part) != 0) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Write block by block, touching only blocks that differ
+ */
+static bool src_write_blocks(const uint8_t *buffer, size_t size, uint32_t offset,
+                             src_write_stats_t *stats, const src_scratch_t *scratch) {
+    uint32_t erase_size = spi_flash_get_erase_size();
+    size_t done = 0;
+    while (done < size) {
+        uint32_t block_offset = offset + done;
+        uint32_t block_start = block_offset - (block_offset % erase_size);
+        size_t len = block_start + erase_size - block_offset;
+        if (len > size - done) {
+            len = size - done;
+        }
+        const uint8_t *data = buffer + done;
+        
+        /* Known-erased target: program it without reading it first. The
+         * read-back below still checks the result, since the map cannot see
+         * writes made behind the SPI driver. */
+        src_block_action_t action;
+        bool assumed_erased = integrity_extent_erased(block_offset, len) &&
+                              !integrity_is_erased(data, len);
+        if (assumed_erased) {
+            action = SRC_BLOCK_PROGRAM;
+        } else if (!src_classify_block(block_offset, data, len, scratch, &action)) {
+            return false;
+        }
+        
+        switch (action) {
+            case SRC_BLOCK_SKIP:
+                stats->blocks_skipped++;
+                break;
+                
+            case SRC_BLOCK_PROGRAM:
+                if (!spi_flash_program(block_offset, data, len)) {
+                    return false;
+                }
+                stats->blocks_programmed++;
+                break;
+                
+            case SRC_BLOCK_ERASE:
+                /* Preserves bytes of a partial block outside the range */
+                if (!spi_flash_write(block_offset, data, len)) {
+                    return false;
+                }
+                stats->blocks_erased++;
+                break;
+        }
+        
+        /* SECURITY: Verify by reading back and comparing */
+        if (action != SRC_BLOCK_SKIP && !src_verify_written(block_offset, data, len, scratch)) {
+            /* Block was not erased after all: rewrite it the full way */
+            if (!assumed_erased || !spi_flash_write(block_offset, data, len) ||
+                !src_verify_written(block_offset, data, len, scratch)) {
+                src_log("SRC: ERROR - Firmware verification failed after write");
+                return false;
+            }
+            stats->blocks_programmed--;
+            stats->blocks_erased++;
+        }
+        
+        done += len;
+    }
+    
+    return true;
+}
+
 /**
  * Write firmware to SPI flash with verification
  */
-bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset) {
+bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset,
+                        src_write_stats_t *stats) {
     /* SECURITY: Validate parameters before any write */
     if (!buffer || size == 0) {
         return false;
@@ -632,7 +2687,7 @@ bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset) {
     /* Check bounds */
     if (offset >= flash_size || (offset + size) > flash_size) {
         src_log("SRC: ERROR - Firmware write out of bounds (offset: %lu, size: %zu, flash_size: %lu)",
-                offset, size, flash_size);
+                (unsigned long)offset, size, (unsigned long)flash_size);
         return false;
     }
     
@@ -643,29 +2698,24 @@ bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset) {
         return false;
     }
     
-    /* Write firmware */
-    if (!spi_flash_write(offset, buffer, size)) {
-        return false;
-    }
-    
-    /* SECURITY: Verify by reading back and comparing */
-    uint8_t *verify_buffer = malloc(size);
-    if (!verify_buffer) {
-        return false;
-    }
-    
-    if (!spi_flash_read(offset, verify_buffer, size)) {
-        free(verify_buffer);
-        return false;
+    src_write_stats_t local_stats;
+    if (!stats) {
+        stats = &local_stats;
     }
-    
-    bool match = (memcmp(buffer, verify_buffer, size) == 0);
-    free(verify_buffer);
-    
-    if (!match) {
-        src_log("SRC: ERROR - Firmware verification failed after write");
-        return false;
+    memset(stats, 0, sizeof(*stats));
+    
+    /* Read back into a DMA buffer when one is free, so the SPI controller
+     * fills it directly and whole blocks compare in one read */
+    uint8_t stack_scratch[SRC_VERIFY_BLOCK_SIZE];
+    platform_dma_buffer_t *dma = platform_dma_alloc();
+    src_scratch_t scratch = { stack_scratch, sizeof(stack_scratch) };
+    if (dma) {
+        scratch.data = dma->data;
+        scratch.size = PLATFORM_DMA_BUFFER_SIZE;
     }
     
-    return true;
+    bool ok = src_write_blocks(buffer, size, offset, stats, &scratch);
+    platform_dma_free(dma);
+    return ok;
 }
+
@@ -10,6 +10,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "logging.h"                  // src_log()
 
 /* Version Information */
 #define SRC_VERSION_MAJOR 1
@@ -20,22 +22,144 @@
 #define MAX_BACKUP_INTERVAL_MS (10 * 60 * 1000)  // 10 minutes
 #define BOOT_TIMEOUT_MS (30000)                   // 30 seconds
 #define MAX_DISABLE_DURATION_MS (7 * 24 * 60 * 60 * 1000)  // 7 days max
+#define SRC_BOOT_CHECK_MS (1000)                  // Longest boot task sleep; events wake it
+#define SRC_JOB_POLL_MS (1000)                    // Job task poll; state changes wake it
+#define SRC_LOG_FLUSH_MS (10000)                  // Log flush period; a filling ring wakes it
 
-/* SPI Flash Layout */
+/* SPI Flash Layout (sizes/offsets may be overridden at build time) */
+#ifndef SPI_FLASH_SIZE
 #define SPI_FLASH_SIZE (16 * 1024 * 1024)  // 16MB typical
-#define SRC_RESERVED_REGION_START (0x100000)  // 1MB offset
-#define SRC_RESERVED_REGION_SIZE (512 * 1024)  // 512KB for SRC
+#endif
 #define FIRMWARE_REGION_START (0x0)
+#ifndef FIRMWARE_REGION_SIZE
 #define FIRMWARE_REGION_SIZE (8 * 1024 * 1024)  // 8MB for main firmware
+#endif
+#ifndef SRC_RESERVED_REGION_START
+#define SRC_RESERVED_REGION_START (FIRMWARE_REGION_START + FIRMWARE_REGION_SIZE)  // Right after firmware
+#endif
+#define SRC_RESERVED_REGION_SIZE (512 * 1024)  // 512KB for SRC
+
+/* SRC writes its own region at run time; it must stay out of the measured firmware */
+#if (SRC_RESERVED_REGION_START < FIRMWARE_REGION_START + FIRMWARE_REGION_SIZE) && \
+    (SRC_RESERVED_REGION_START + SRC_RESERVED_REGION_SIZE > FIRMWARE_REGION_START)
+#error "SRC reserved region overlaps the firmware region"
+#endif
+
+/* SRC reserved region layout */
+#define SRC_CONFIG_START (SRC_RESERVED_REGION_START)                   // src_config_t
+#define SRC_INTEGRITY_INDEX_START (SRC_RESERVED_REGION_START + 0x1000)  // Sector hash index
+#define SRC_INTEGRITY_INDEX_SIZE (64 * 1024)
+#define SRC_VERIFY_CACHE_START (SRC_INTEGRITY_INDEX_START + SRC_INTEGRITY_INDEX_SIZE)  // Verified images
+#define SRC_VERIFY_CACHE_SIZE (4 * 1024)
+#define SRC_LOG_STORE_START (SRC_VERIFY_CACHE_START + SRC_VERIFY_CACHE_SIZE)  // Log segments
+#define SRC_LOG_STORE_SIZE (256 * 1024)
+
+/* Streaming recovery pipeline
+ * Images are moved USB -> SPI in fixed chunks through a small ring of
+ * buffers, so the USB read of chunk N+1 overlaps hashing/programming of
+ * chunk N. Chunk size must be a multiple of the 4KB erase sector.
+ */
+#define SRC_RECOVERY_CHUNK_SIZE (16 * 1024)  // 16KB per chunk
+#define SRC_RECOVERY_RING_DEPTH 2            // Chunk buffers (>= 2 to overlap)
+#define SRC_VERIFY_BLOCK_SIZE (512)          // Read-back compare granularity
+#define SRC_HASH_BLOCK_SIZE (4096)           // Flash read size when hashing
 
 /* USB Recovery Path */
 #define USB_RECOVERY_PATH "/SECURITY_RECOVERY"
 #define BACKUP_A_FILE "A.bin"
 #define BACKUP_B_FILE "B.bin"
+#define BACKUP_NEW_FILE "A.new"             // Full backup being written
 #define MANIFEST_FILE "manifest.json"
-#define SIGNATURE_FILE "signature.sig"
+#define SIGNED_MANIFEST_FILE "manifest.bin"
+#define MANIFEST_SIGNATURE_FILE "manifest.sig"
+#define SIGNATURE_FILE "signature.sig"      // Legacy: signs A.bin only
 #define METADATA_FILE "metadata.txt"
 
+/* Full backups
+ * The firmware region is streamed to A.bin one block at a time, by default
+ * in the compressed container of image_codec.h (recovery reads raw and
+ * compressed images alike). Signatures always cover the raw image.
+ */
+#ifndef SRC_COMPRESS_BACKUPS
+#define SRC_COMPRESS_BACKUPS 1
+#endif
+#define SRC_BACKUP_WRITE_SIZE (64 * 1024)    // Bytes per USB write (whole sectors)
+
+/* Delta backups
+ * A.bin is followed by a chain of sector patches (D01.bin, D02.bin, ...),
+ * each listed in the signed manifest. A patch carries only the integrity
+ * sectors that changed since the previous backup; once the chain is too
+ * long it is compacted into a new A.bin by a full backup.
+ */
+#define SRC_DELTA_MAX_CHAIN 8                           // Patches before compaction
+#define SRC_DELTA_MAX_BYTES (FIRMWARE_REGION_SIZE / 2)  // Patch data before compaction
+#define SRC_DELTA_DATA_ALIGN 4096                       // File offset of sector data
+#define SRC_DELTA_MAGIC 0x544C4453                      // "SDLT"
+#define SRC_DELTA_VERSION 2                             // 2: erased sectors carry no data
+#define SRC_DELTA_SECTOR_ERASED 0x80000000u             // Table flag: sector is all 0xFF
+#define DELTA_FILE_FORMAT "D%02u.bin"
+#define DELTA_SIGNATURE_FORMAT "D%02u.sig"   // Legacy per-patch signature
+
+/* Patch file header, followed by sector_count uint32_t sector numbers
+ * (ascending, SRC_DELTA_SECTOR_ERASED set for sectors that are now all
+ * 0xFF), zero padding up to data_offset, then the data of the other
+ * sectors in table order */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sequence;         // 1-based position in the chain
+    uint32_t sector_size;      // INTEGRITY_SECTOR_SIZE
+    uint32_t sector_count;
+    uint32_t region_size;      // FIRMWARE_REGION_SIZE
+    uint32_t data_offset;
+    uint8_t base_hash[32];     // Image the patch applies to
+    uint8_t result_hash[32];   // Image after applying it
+    uint8_t reserved[40];
+} src_delta_header_t;
+
+/* Signed manifest
+ * manifest.bin lists every image on the stick with its hash and size, and
+ * manifest.sig signs the SHA-256 of manifest.bin. Recovery verifies that
+ * one signature, then checks each image against its entry, so A.bin, B.bin
+ * and the patches need no signatures of their own. Full images carry a
+ * generation (higher is newer); patches apply to the newest full image.
+ */
+#define SRC_MANIFEST_MAGIC 0x464E4D53                   // "SMNF"
+#define SRC_MANIFEST_VERSION 1
+#define SRC_MANIFEST_MAX_ENTRIES (2 + SRC_DELTA_MAX_CHAIN)
+
+typedef enum {
+    SRC_MANIFEST_FULL = 1,     // Whole image (raw or image_codec.h container)
+    SRC_MANIFEST_DELTA = 2     // Sector patch, src_delta_header_t
+} src_manifest_kind_t;
+
+typedef struct {
+    char name[16];             // File in USB_RECOVERY_PATH, NUL terminated
+    uint8_t kind;              // src_manifest_kind_t
+    uint8_t reserved;
+    uint16_t sequence;         // Patch position in the chain, 0 for full images
+    uint32_t generation;       // Manifest generation that added the entry
+    uint32_t size;             // Raw image bytes (full) or file bytes (patch)
+    uint32_t reserved2;
+    uint8_t hash[32];          // SHA-256 of the raw image (full) or of the file (patch)
+    uint8_t image_hash[32];    // Firmware image the entry restores
+    uint8_t root[32];          // Merkle root of that image's sector index (0 = none)
+} src_manifest_entry_t;
+
+/* manifest.bin: the header followed by entry_count entries */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_count;
+    uint32_t generation;       // Incremented by every backup
+    uint32_t region_size;      // FIRMWARE_REGION_SIZE
+    char board_id[32];
+    uint8_t reserved[16];
+    src_manifest_entry_t entries[SRC_MANIFEST_MAX_ENTRIES];
+} src_manifest_t;
+
+#define SRC_MANIFEST_HEADER_SIZE (offsetof(src_manifest_t, entries))
+
 /* State Machine States */
 typedef enum {
     SRC_STATE_INIT,
@@ -65,8 +189,33 @@ typedef struct {
     uint32_t last_recovery_timestamp;
     char board_id[32];
     uint8_t firmware_hash[32];  // SHA-256
+    uint8_t firmware_root[32];  // Merkle root of the sector index (0 = none)
+    uint16_t delta_count;       // Patches on USB since the last full backup
+    uint32_t delta_bytes;       // Sector data carried by those patches
 } src_config_t;
 
+/* Long-running work of the main loop (scheduler.h job task) */
+typedef enum {
+    SRC_JOB_NONE,
+    SRC_JOB_BACKUP,
+    SRC_JOB_RECOVERY,
+    SRC_JOB_REMOVAL
+} src_job_t;
+
+typedef struct {
+    src_job_t job;
+    uint32_t done;              // Bytes through the job's current step
+    uint32_t total;             // Bytes in that step (0 = not known)
+    bool cancelling;            // src_cancel_job() was called
+} src_job_status_t;
+
+/* Differential write statistics (per src_write_firmware call, in erase blocks) */
+typedef struct {
+    uint32_t blocks_skipped;      // Already identical, not touched
+    uint32_t blocks_programmed;   // Only 1->0 bit changes, programmed without erase
+    uint32_t blocks_erased;       // Erased and reprogrammed
+} src_write_stats_t;
+
 /* Function Prototypes */
 
 /**
@@ -77,10 +226,31 @@ void src_init(void);
 
 /**
  * Main state machine loop
- * Must be called periodically from main loop
+ * Must be called periodically from main loop; gives every due task one
+ * turn (see scheduler.h). Between calls, wait for an event for up to
+ * src_sched_idle_ms() with platform_wait_event().
  */
 void src_main_loop(void);
 
+/**
+ * Current state machine state
+ */
+src_state_t src_get_state(void);
+
+/**
+ * Job the main loop is running and how far it got
+ * A recovery's pass 1 and pass 2, and a backup's firmware scan and image
+ * write, are steps of their own, each counting up to its total.
+ */
+void src_get_job_status(src_job_status_t *status);
+
+/**
+ * Stop the running job at its next checkpoint; false if there is none
+ * A cancelled recovery ends in safe mode; after a cancelled backup the
+ * next one waits MAX_BACKUP_INTERVAL_MS.
+ */
+bool src_cancel_job(void);
+
 /**
  * Check if boot was successful using multiple methods
  */
@@ -116,12 +286,31 @@ bool src_enable(void);
  */
 bool src_schedule_removal(void);
 
+/**
+ * Carry out a scheduled removal (verify firmware, clear SRC region, lock)
+ */
+void src_handle_removal(void);
+
 /**
  * Verify cryptographic signature of firmware image
  */
 int src_verify_signature(const uint8_t *firmware, size_t size,
                          const uint8_t *signature, size_t sig_size);
 
+/**
+ * Read the signed manifest in a recovery directory on USB (normally
+ * USB_RECOVERY_PATH) and verify manifest.sig over it
+ * Fails if either file is missing, the signature does not verify or the
+ * manifest is not for this board and firmware layout.
+ */
+bool src_read_manifest(const char *dir, src_manifest_t *manifest);
+
+/**
+ * Find the entry for a file in a verified manifest (NULL if not listed)
+ */
+const src_manifest_entry_t *src_manifest_find(const src_manifest_t *manifest,
+                                              const char *name);
+
 /**
  * Read configuration from SPI flash
  */
@@ -137,10 +326,26 @@ bool src_write_config(const src_config_t *config);
  */
 bool src_read_firmware(uint8_t *buffer, size_t size, uint32_t offset);
 
+/**
+ * Hash a flash range (SHA-256), reading it in SRC_HASH_BLOCK_SIZE chunks
+ */
+bool src_hash_firmware(uint32_t offset, size_t size, uint8_t *hash);
+
+/**
+ * Hash an image file on USB (SHA-256), streaming it chunk by chunk
+ * image_size receives the file size; fails if it exceeds FIRMWARE_REGION_SIZE
+ */
+bool src_hash_usb_image(const char *path, uint8_t *hash, size_t *image_size);
+
 /**
  * Write firmware to SPI flash with verification
+ * Differential: each flash erase block is compared with the live flash first.
+ * Identical blocks are skipped, blocks needing only 1->0 bit changes are
+ * programmed without an erase, and the rest are erased and reprogrammed.
+ * stats (optional) receives the per-block outcome counts.
  */
-bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset);
+bool src_write_firmware(const uint8_t *buffer, size_t size, uint32_t offset,
+                        src_write_stats_t *stats);
 
 /**
  * Initialize USB Mass Storage interface
@@ -162,9 +367,4 @@ bool src_usb_read_file(const char *path, uint8_t *buffer, size_t *size);
  */
 bool src_usb_write_file(const char *path, const uint8_t *buffer, size_t size);
 
-/**
- * Log message (tamper-resistant)
- */
-void src_log(const char *message, ...);
-
 #endif /* RECOVERY_CORE_H */
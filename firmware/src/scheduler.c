@@ -0,0 +1,147 @@
+/**
+ * Cooperative Task Scheduler Implementation
+ */
+
+#include "scheduler.h"
+#include "platform.h"
+#include <stddef.h>
+
+static src_task_t *tasks;           // By priority, then in order added
+static src_task_t *current;         // Task whose turn is in progress
+static uint32_t slice_start;        // When current's slice began
+
+static bool src_sched_due(const src_task_t *task, uint32_t now) {
+    return !task->running && !task->exited &&
+           (!task->started || now - task->last_run >= task->period_ms ||
+            (task->ready && task->ready()));
+}
+
+/**
+ * Give a task one turn
+ */
+static void src_sched_turn(src_task_t *task, uint32_t now) {
+    src_task_t *preempted = current;
+    uint32_t preempted_slice = slice_start;
+
+    task->started = true;
+    task->running = true;
+    task->last_run = now;
+    current = task;
+    slice_start = now;
+
+    if (task->body(task) == SRC_TASK_EXITED) {
+        task->exited = true;
+    }
+
+    task->running = false;
+    current = preempted;
+    slice_start = preempted_slice;
+}
+
+bool src_sched_add(src_task_t *task) {
+    if (!task || !task->body) {
+        return false;
+    }
+    for (src_task_t *other = tasks; other; other = other->next) {
+        if (other == task) {
+            return false;
+        }
+    }
+
+    task->resume = 0;
+    task->started = false;
+    task->running = false;
+    task->exited = false;
+    task->cancel = false;
+    task->done = 0;
+    task->total = 0;
+
+    src_task_t **link = &tasks;
+    while (*link && (*link)->priority <= task->priority) {
+        link = &(*link)->next;
+    }
+    task->next = *link;
+    *link = task;
+    return true;
+}
+
+/**
+ * Drop exited tasks from the list
+ */
+static void src_sched_reap(void) {
+    src_task_t **link = &tasks;
+    while (*link) {
+        if ((*link)->exited && !(*link)->running) {
+            *link = (*link)->next;
+        } else {
+            link = &(*link)->next;
+        }
+    }
+}
+
+void src_sched_run(void) {
+    for (src_task_t *task = tasks; task; task = task->next) {
+        uint32_t now = platform_get_timestamp();
+        if (src_sched_due(task, now)) {
+            src_sched_turn(task, now);
+        }
+    }
+    src_sched_reap();
+}
+
+uint32_t src_sched_idle_ms(void) {
+    uint32_t now = platform_get_timestamp();
+    uint32_t idle = UINT32_MAX;
+
+    for (const src_task_t *task = tasks; task; task = task->next) {
+        if (task->exited) {
+            continue;
+        }
+        if (src_sched_due(task, now)) {
+            return 0;
+        }
+        if (task->running) {
+            continue;
+        }
+        uint32_t left = task->period_ms - (now - task->last_run);
+        if (left < idle) {
+            idle = left;
+        }
+    }
+    return idle == UINT32_MAX ? SRC_SCHED_IDLE_MS : idle;
+}
+
+bool src_sched_checkpoint(uint32_t done, uint32_t total) {
+    src_task_t *task = current;
+    if (!task) {
+        return true;
+    }
+    task->done = done;
+    task->total = total;
+
+    /* Tasks ahead of this one in the list have higher (or equal) priority;
+     * only those strictly higher preempt it */
+    uint32_t now = platform_get_timestamp();
+    if (now - slice_start >= SRC_SCHED_SLICE_MS) {
+        for (src_task_t *other = tasks; other && other->priority < task->priority;
+             other = other->next) {
+            if (src_sched_due(other, now)) {
+                src_sched_turn(other, now);
+                now = platform_get_timestamp();
+            }
+        }
+        slice_start = now;
+    }
+
+    return !task->cancel;
+}
+
+bool src_sched_cancelled(void) {
+    return current && current->cancel;
+}
+
+void src_task_cancel(src_task_t *task) {
+    if (task) {
+        task->cancel = true;
+    }
+}
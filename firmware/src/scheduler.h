@@ -0,0 +1,128 @@
+/**
+ * Cooperative Task Scheduler
+ * Boot detection, config timers and the long jobs (backup, recovery,
+ * removal) share the main loop as tasks. Each task is a stackless
+ * coroutine in the protothread style: its body runs until it yields with
+ * SRC_TASK_YIELD() and continues after that point on its next turn.
+ * Locals do not survive a yield, so state kept across turns lives in
+ * statics or in the task's context, and a yield cannot sit inside a
+ * switch statement of the body.
+ *
+ * Most of a job's time is spent deep in a call chain: streaming an image,
+ * hashing the firmware region. Those loops call src_sched_checkpoint()
+ * between bounded pieces of work. Once the running task has used up
+ * SRC_SCHED_SLICE_MS, the checkpoint runs every due task of higher
+ * priority in place. A task of higher priority than every job therefore
+ * gets its turn within period + slice + one piece of work, whatever the
+ * jobs are doing. Checkpoints also record the job's progress and tell it
+ * when it has been cancelled.
+ *
+ * Tasks run on one thread. Code that pass-1 workers run
+ * (PLATFORM_THREADS) must not call src_sched_checkpoint(), and waiting
+ * for those workers has no checkpoints: it is bounded by the slower of
+ * two concurrent passes rather than by the slice.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef SRC_SCHED_SLICE_MS
+#define SRC_SCHED_SLICE_MS 10       // Work between checks for due tasks
+#endif
+#define SRC_SCHED_IDLE_MS 100       // Sleep when no task is periodic
+
+/* Priorities: lower runs first, and preempts higher at checkpoints */
+#define SRC_TASK_PRIORITY_BOOT 0    // Boot detection, config timers
+#define SRC_TASK_PRIORITY_JOB 8     // Backup, recovery, removal
+#define SRC_TASK_PRIORITY_LOG 12    // Log flushes to flash
+
+/* Task body results */
+typedef enum {
+    SRC_TASK_YIELDED,               // Give it another turn when due
+    SRC_TASK_EXITED                 // Done; the scheduler drops it
+} src_task_result_t;
+
+typedef struct src_task src_task_t;
+typedef src_task_result_t (*src_task_body_t)(src_task_t *task);
+
+struct src_task {
+    const char *name;
+    src_task_body_t body;
+    void *context;
+    uint8_t priority;
+    uint32_t period_ms;             // Turn at most this often (0 = every pass)
+    bool (*ready)(void);            // Optional: due early while this is true
+    /* Scheduler state */
+    uint32_t resume;                // Line to continue at (0 = top)
+    uint32_t last_run;              // When its last turn started
+    bool started;                   // Has had a turn
+    bool running;                   // Turn in progress (on the stack)
+    bool exited;
+    src_task_t *next;
+    /* Job progress and control, updated by checkpoints */
+    volatile bool cancel;
+    uint32_t done;
+    uint32_t total;                 // 0 = not known
+};
+
+/* Protothread-style body; one SRC_TASK_YIELD per source line:
+ *
+ *   static src_task_result_t body(src_task_t *task) {
+ *       SRC_TASK_BEGIN(task);
+ *       ...
+ *       SRC_TASK_YIELD(task);
+ *       ...
+ *       SRC_TASK_END(task);
+ *   }
+ */
+#define SRC_TASK_BEGIN(task) switch ((task)->resume) { case 0:
+#define SRC_TASK_YIELD(task)                                        \
+    do {                                                            \
+        (task)->resume = __LINE__;                                  \
+        return SRC_TASK_YIELDED;                                    \
+        case __LINE__:;                                             \
+    } while (0)
+#define SRC_TASK_WAIT_UNTIL(task, condition)                        \
+    while (!(condition)) SRC_TASK_YIELD(task)
+#define SRC_TASK_END(task) } (task)->resume = 0; return SRC_TASK_EXITED
+
+/**
+ * Add a task (name, body, priority and period set); false if it is
+ * already scheduled
+ */
+bool src_sched_add(src_task_t *task);
+
+/**
+ * One pass: every due task gets a turn, in priority order
+ */
+void src_sched_run(void);
+
+/**
+ * Milliseconds until a periodic task is due, for the caller's sleep
+ * (0 if one is due or ready now)
+ */
+uint32_t src_sched_idle_ms(void);
+
+/**
+ * Called by long-running work between bounded pieces. Records progress
+ * (done of total units, total 0 if not known) on the running task and,
+ * once its slice is used up, runs due tasks of higher priority.
+ * Returns false if the running task has been cancelled; the work should
+ * then stop. Outside a task turn it only returns true.
+ */
+bool src_sched_checkpoint(uint32_t done, uint32_t total);
+
+/**
+ * True if the running task has been cancelled (no checkpoint, no turns)
+ */
+bool src_sched_cancelled(void);
+
+/**
+ * Ask a task to stop at its next checkpoint
+ */
+void src_task_cancel(src_task_t *task);
+
+#endif /* SCHEDULER_H */
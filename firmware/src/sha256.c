@@ -0,0 +1,307 @@
+/**
+ * SHA-256 Implementation (FIPS 180-4)
+ * Portable C99 core plus dispatch to accelerated block functions
+ * (sha256_shani.c, sha256_armv8.c, platform hash engines). No heap.
+ */
+
+#include "sha256.h"
+#include <string.h>
+
+const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define BSIG0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+/* Message schedule kept as a rolling 16-word window */
+#define SCHEDULE(t) \
+    (w[(t) & 15] += SSIG1(w[((t) - 2) & 15]) + w[((t) - 7) & 15] + SSIG0(w[((t) - 15) & 15]))
+
+/* One round; the caller rotates the variable names instead of the values */
+#define ROUND(a, b, c, d, e, f, g, h, t, wt) do { \
+        uint32_t t1 = (h) + BSIG1(e) + CH(e, f, g) + sha256_k[t] + (wt); \
+        (d) += t1; \
+        (h) = t1 + BSIG0(a) + MAJ(a, b, c); \
+    } while (0)
+
+#define ROUNDS8(t, W) do { \
+        ROUND(a, b, c, d, e, f, g, h, (t) + 0, W((t) + 0)); \
+        ROUND(h, a, b, c, d, e, f, g, (t) + 1, W((t) + 1)); \
+        ROUND(g, h, a, b, c, d, e, f, (t) + 2, W((t) + 2)); \
+        ROUND(f, g, h, a, b, c, d, e, (t) + 3, W((t) + 3)); \
+        ROUND(e, f, g, h, a, b, c, d, (t) + 4, W((t) + 4)); \
+        ROUND(d, e, f, g, h, a, b, c, (t) + 5, W((t) + 5)); \
+        ROUND(c, d, e, f, g, h, a, b, (t) + 6, W((t) + 6)); \
+        ROUND(b, c, d, e, f, g, h, a, (t) + 7, W((t) + 7)); \
+    } while (0)
+
+#define LOAD(t) (w[t])
+
+static uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/**
+ * Portable block function: process whole 64-byte blocks
+ */
+static void sha256_blocks_portable(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    uint32_t w[16];
+
+    while (blocks--) {
+        for (int t = 0; t < 16; t++) {
+            w[t] = load_be32(data + t * 4);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        ROUNDS8(0, LOAD);
+        ROUNDS8(8, LOAD);
+        for (int t = 16; t < 64; t += 16) {
+            ROUNDS8(t, SCHEDULE);
+            ROUNDS8(t + 8, SCHEDULE);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+
+        data += 64;
+    }
+}
+
+/*
+ * Engine table, fastest first. The first entry that is supported by the CPU
+ * and passes the known-answer tests is used; the portable engine is last
+ * and always available.
+ */
+static const sha256_engine_t sha256_engines[] = {
+#ifdef SHA256_ENGINE_SHANI
+    { "shani", sha256_blocks_shani, sha256_shani_supported },
+#endif
+#ifdef SHA256_ENGINE_ARMV8
+    { "armv8", sha256_blocks_armv8, sha256_armv8_supported },
+#endif
+#ifdef PLATFORM_SHA256_BLOCKS
+    { "platform", platform_sha256_blocks, platform_sha256_blocks_ready },
+#endif
+    { "portable", sha256_blocks_portable, NULL },
+};
+
+#define SHA256_ENGINE_COUNT (sizeof(sha256_engines) / sizeof(sha256_engines[0]))
+#define SHA256_ENGINE_PORTABLE (&sha256_engines[SHA256_ENGINE_COUNT - 1])
+
+static const sha256_engine_t *sha256_active = NULL;
+
+static void sha256_start(platform_sha256_ctx_t *ctx) {
+    static const uint32_t initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(ctx->state, initial_state, sizeof(initial_state));
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+static void sha256_absorb(sha256_blocks_fn_t blocks_fn, platform_sha256_ctx_t *ctx,
+                          const uint8_t *data, size_t size) {
+    ctx->length += size;
+
+    /* Top up a pending partial block first */
+    if (ctx->block_used > 0) {
+        size_t take = sizeof(ctx->block) - ctx->block_used;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(ctx->block + ctx->block_used, data, take);
+        ctx->block_used += take;
+        data += take;
+        size -= take;
+
+        if (ctx->block_used < sizeof(ctx->block)) {
+            return;
+        }
+        blocks_fn(ctx->state, ctx->block, 1);
+        ctx->block_used = 0;
+    }
+
+    /* Hash whole blocks straight from the caller's buffer */
+    size_t blocks = size / 64;
+    if (blocks > 0) {
+        blocks_fn(ctx->state, data, blocks);
+        data += blocks * 64;
+        size -= blocks * 64;
+    }
+
+    if (size > 0) {
+        memcpy(ctx->block, data, size);
+        ctx->block_used = size;
+    }
+}
+
+static void sha256_finish(sha256_blocks_fn_t blocks_fn, platform_sha256_ctx_t *ctx,
+                          uint8_t *hash) {
+    uint64_t bit_length = ctx->length * 8;
+    size_t used = ctx->block_used;
+
+    /* Padding: 0x80, zeros, 64-bit big-endian bit length */
+    ctx->block[used++] = 0x80;
+    if (used > 56) {
+        memset(ctx->block + used, 0, 64 - used);
+        blocks_fn(ctx->state, ctx->block, 1);
+        used = 0;
+    }
+    memset(ctx->block + used, 0, 56 - used);
+    store_be32(ctx->block + 56, (uint32_t)(bit_length >> 32));
+    store_be32(ctx->block + 60, (uint32_t)bit_length);
+    blocks_fn(ctx->state, ctx->block, 1);
+
+    for (int i = 0; i < 8; i++) {
+        store_be32(hash + i * 4, ctx->state[i]);
+    }
+
+    /* Do not leave intermediate state behind */
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static void sha256_oneshot(sha256_blocks_fn_t blocks_fn, const uint8_t *data, size_t size,
+                           uint8_t *hash) {
+    platform_sha256_ctx_t ctx;
+    sha256_start(&ctx);
+    sha256_absorb(blocks_fn, &ctx, data, size);
+    sha256_finish(blocks_fn, &ctx, hash);
+}
+
+/* FIPS 180-4 / NIST CAVP known answers */
+typedef struct {
+    const char *message;
+    uint8_t digest[32];
+} sha256_kat_t;
+
+static const sha256_kat_t sha256_kats[] = {
+    { "",
+      { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "abc",
+      { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+      { 0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c, 0xe5, 0x9e, 0x7b, 0x04, 0x92, 0x37,
+        0x0b, 0x24, 0x9b, 0x11, 0xe8, 0xf0, 0x7a, 0x51, 0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe, 0xe9, 0xd1 } },
+};
+
+/* Multi-block cross-check against the portable engine */
+#define SHA256_CROSS_CHECK_SIZE 1000
+
+size_t sha256_engine_count(void) {
+    return SHA256_ENGINE_COUNT;
+}
+
+const sha256_engine_t *sha256_engine_get(size_t index) {
+    return (index < SHA256_ENGINE_COUNT) ? &sha256_engines[index] : NULL;
+}
+
+bool sha256_engine_supported(const sha256_engine_t *engine) {
+    return engine && (!engine->supported || engine->supported());
+}
+
+bool sha256_engine_self_test(const sha256_engine_t *engine) {
+    uint8_t hash[32];
+
+    if (!sha256_engine_supported(engine)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(sha256_kats) / sizeof(sha256_kats[0]); i++) {
+        const sha256_kat_t *kat = &sha256_kats[i];
+        sha256_oneshot(engine->blocks, (const uint8_t *)kat->message, strlen(kat->message), hash);
+        if (memcmp(hash, kat->digest, sizeof(hash)) != 0) {
+            return false;
+        }
+    }
+
+    if (engine == SHA256_ENGINE_PORTABLE) {
+        return true;
+    }
+
+    /* The vectors only pass single blocks; make sure runs of blocks chain */
+    uint8_t data[SHA256_CROSS_CHECK_SIZE];
+    uint8_t expected[32];
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+    sha256_oneshot(SHA256_ENGINE_PORTABLE->blocks, data, sizeof(data), expected);
+    sha256_oneshot(engine->blocks, data, sizeof(data), hash);
+    return memcmp(hash, expected, sizeof(hash)) == 0;
+}
+
+bool sha256_engine_select(const sha256_engine_t *engine) {
+    if (!sha256_engine_self_test(engine)) {
+        return false;
+    }
+    sha256_active = engine;
+    return true;
+}
+
+const sha256_engine_t *sha256_engine_active(void) {
+    if (!sha256_active) {
+        /* SECURITY: an engine that gives a wrong answer is never used */
+        for (size_t i = 0; i < SHA256_ENGINE_COUNT; i++) {
+            if (sha256_engine_select(&sha256_engines[i])) {
+                break;
+            }
+        }
+        if (!sha256_active) {
+            sha256_active = SHA256_ENGINE_PORTABLE;
+        }
+    }
+    return sha256_active;
+}
+
+void sha256_init(platform_sha256_ctx_t *ctx) {
+    sha256_start(ctx);
+}
+
+void sha256_update(platform_sha256_ctx_t *ctx, const uint8_t *data, size_t size) {
+    sha256_absorb(sha256_engine_active()->blocks, ctx, data, size);
+}
+
+void sha256_final(platform_sha256_ctx_t *ctx, uint8_t *hash) {
+    sha256_finish(sha256_engine_active()->blocks, ctx, hash);
+}
+
+void sha256(const uint8_t *data, size_t size, uint8_t *hash) {
+    sha256_oneshot(sha256_engine_active()->blocks, data, size, hash);
+}
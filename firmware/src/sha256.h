@@ -0,0 +1,107 @@
+/**
+ * SHA-256
+ * Portable implementation for platforms without a hash engine, with
+ * dispatch to accelerated block functions where the build enables them
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+
+/* Round constants, shared with the accelerated engines */
+extern const uint32_t sha256_k[64];
+
+/* Compress `blocks` consecutive 64-byte blocks into state */
+typedef void (*sha256_blocks_fn_t)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+/* One implementation of the block function
+ * supported is the runtime CPU/peripheral check (NULL: always usable)
+ */
+typedef struct {
+    const char *name;
+    sha256_blocks_fn_t blocks;
+    bool (*supported)(void);
+} sha256_engine_t;
+
+/* Engines compiled in (per PLATFORM in the Makefile, see SHA256_ENGINES) */
+#ifdef SHA256_ENGINE_SHANI
+void sha256_blocks_shani(uint32_t state[8], const uint8_t *data, size_t blocks);
+bool sha256_shani_supported(void);
+#endif
+#ifdef SHA256_ENGINE_ARMV8
+void sha256_blocks_armv8(uint32_t state[8], const uint8_t *data, size_t blocks);
+bool sha256_armv8_supported(void);
+#endif
+
+/* Engines in preference order; the last one is the portable C engine */
+size_t sha256_engine_count(void);
+const sha256_engine_t *sha256_engine_get(size_t index);
+
+/* Runtime check only (CPUID, HWCAP, peripheral present) */
+bool sha256_engine_supported(const sha256_engine_t *engine);
+
+/* Known-answer tests (plus a multi-block cross-check against the portable
+ * engine); false if the engine is unsupported or gives a wrong answer */
+bool sha256_engine_self_test(const sha256_engine_t *engine);
+
+/* Engine used by sha256_*(); the first use picks the first engine that
+ * passes its self test */
+const sha256_engine_t *sha256_engine_active(void);
+
+/* Force an engine (benchmarks); fails if its self test does */
+bool sha256_engine_select(const sha256_engine_t *engine);
+
+/* Multi-buffer hashing (sha256_mb.c): up to SHA256_BATCH_MAX messages of
+ * the same length, one per SIMD lane */
+#define SHA256_BATCH_MAX PLATFORM_SHA256_BATCH_MAX
+
+/* Compress `blocks` blocks of each of `lanes` messages (engine width) */
+typedef void (*sha256_lanes_fn_t)(uint32_t (*state)[8], const uint8_t *const data[],
+                                  size_t blocks);
+
+typedef struct {
+    const char *name;
+    size_t lanes;
+    sha256_lanes_fn_t blocks;
+    bool (*supported)(void);
+} sha256_batch_engine_t;
+
+/* Batch engines, widest first; the last one is "serial" (sha256_*() per
+ * message) and always available. A SIMD engine is only picked over an
+ * accelerated single-buffer engine (SHA-NI, ARMv8 CE) if it is wider than
+ * SHA256_BATCH_HW_LANES. */
+#define SHA256_BATCH_HW_LANES 8
+
+size_t sha256_batch_engine_count(void);
+const sha256_batch_engine_t *sha256_batch_engine_get(size_t index);
+bool sha256_batch_engine_supported(const sha256_batch_engine_t *engine);
+bool sha256_batch_engine_self_test(const sha256_batch_engine_t *engine);
+const sha256_batch_engine_t *sha256_batch_engine_active(void);
+bool sha256_batch_engine_select(const sha256_batch_engine_t *engine);
+
+/* Incremental batch: every update passes `size` bytes of each message */
+void sha256_batch_init(platform_sha256_batch_ctx_t *ctx, size_t count);
+void sha256_batch_update(platform_sha256_batch_ctx_t *ctx, const uint8_t *const data[],
+                         size_t size);
+void sha256_batch_final(platform_sha256_batch_ctx_t *ctx, uint8_t hashes[][32]);
+
+/* One-shot batch of `count` messages of `size` bytes each */
+void sha256_batch(const uint8_t *const data[], size_t count, size_t size, uint8_t hashes[][32]);
+
+/* Start an incremental hash */
+void sha256_init(platform_sha256_ctx_t *ctx);
+
+/* Feed data into an incremental hash */
+void sha256_update(platform_sha256_ctx_t *ctx, const uint8_t *data, size_t size);
+
+/* Finish an incremental hash (hash must be 32 bytes) */
+void sha256_final(platform_sha256_ctx_t *ctx, uint8_t *hash);
+
+/* One-shot hash of a contiguous buffer */
+void sha256(const uint8_t *data, size_t size, uint8_t *hash);
+
+#endif /* SHA256_H */
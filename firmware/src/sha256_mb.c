@@ -0,0 +1,367 @@
+/**
+ * Multi-Buffer SHA-256
+ * Hashes up to SHA256_BATCH_MAX equal-length messages at once, one message
+ * per SIMD lane (SSE2/NEON: 4, AVX2: 8, AVX-512: 16). Used for per-sector
+ * leaf hashes, where many independent messages have the same length.
+ */
+
+#include "sha256.h"
+#include <string.h>
+
+#if defined(SHA256_ENGINE_SSE2) || defined(SHA256_ENGINE_AVX2) || \
+    defined(SHA256_ENGINE_AVX512) || defined(SHA256_ENGINE_NEON)
+
+#define MB_CONCAT_(a, b) a##b
+#define MB_CONCAT(a, b) MB_CONCAT_(a, b)
+
+#define MB_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define MB_CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MB_MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define MB_BSIG0(x) (MB_ROTR(x, 2) ^ MB_ROTR(x, 13) ^ MB_ROTR(x, 22))
+#define MB_BSIG1(x) (MB_ROTR(x, 6) ^ MB_ROTR(x, 11) ^ MB_ROTR(x, 25))
+#define MB_SSIG0(x) (MB_ROTR(x, 7) ^ MB_ROTR(x, 18) ^ ((x) >> 3))
+#define MB_SSIG1(x) (MB_ROTR(x, 17) ^ MB_ROTR(x, 19) ^ ((x) >> 10))
+
+/* Message words are big-endian */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define MB_LOAD_BE32(x) (x)
+#else
+#define MB_LOAD_BE32(x) __builtin_bswap32(x)
+#endif
+
+#endif
+
+#if defined(SHA256_ENGINE_SSE2) || defined(SHA256_ENGINE_AVX2) || defined(SHA256_ENGINE_AVX512)
+#include <cpuid.h>
+
+/* YMM/ZMM state must be enabled by whoever owns the CPU (OS or firmware) */
+static bool sha256_mb_xcr0(uint32_t mask) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) {
+        return false;
+    }
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    return (xcr0_lo & mask) == mask;
+}
+#endif
+
+#ifdef SHA256_ENGINE_SSE2
+#define MB_LANES 4
+#define MB_NAME sha256_blocks_sse2
+#define MB_TARGET __attribute__((target("sse2")))
+#include "sha256_mb_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_TARGET
+
+static bool sha256_sse2_supported(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+}
+#endif
+
+#ifdef SHA256_ENGINE_AVX2
+#define MB_LANES 8
+#define MB_NAME sha256_blocks_avx2
+#define MB_TARGET __attribute__((target("avx2")))
+#include "sha256_mb_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_TARGET
+
+static bool sha256_avx2_supported(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return sha256_mb_xcr0(0x6) &&
+           __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2);
+}
+#endif
+
+#ifdef SHA256_ENGINE_AVX512
+#define MB_LANES 16
+#define MB_NAME sha256_blocks_avx512
+#define MB_TARGET __attribute__((target("avx512f")))
+#include "sha256_mb_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_TARGET
+
+static bool sha256_avx512_supported(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return sha256_mb_xcr0(0xE6) &&
+           __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX512F);
+}
+#endif
+
+#ifdef SHA256_ENGINE_NEON
+#define MB_LANES 4
+#define MB_NAME sha256_blocks_neon
+#define MB_TARGET
+#include "sha256_mb_lanes.h"
+#undef MB_LANES
+#undef MB_NAME
+#undef MB_TARGET
+#endif
+
+/**
+ * Fallback: each lane through the single-buffer engine in turn
+ */
+static void sha256_blocks_serial(uint32_t (*state)[8], const uint8_t *const data[], size_t blocks) {
+    sha256_blocks_fn_t blocks_fn = sha256_engine_active()->blocks;
+    blocks_fn(state[0], data[0], blocks);
+}
+
+/* Widest first; "serial" (one lane) is last and always available */
+static const sha256_batch_engine_t sha256_batch_engines[] = {
+#ifdef SHA256_ENGINE_AVX512
+    { "avx512", 16, sha256_blocks_avx512, sha256_avx512_supported },
+#endif
+#ifdef SHA256_ENGINE_AVX2
+    { "avx2", 8, sha256_blocks_avx2, sha256_avx2_supported },
+#endif
+#ifdef SHA256_ENGINE_SSE2
+    { "sse2", 4, sha256_blocks_sse2, sha256_sse2_supported },
+#endif
+#ifdef SHA256_ENGINE_NEON
+    { "neon", 4, sha256_blocks_neon, NULL },
+#endif
+    { "serial", 1, sha256_blocks_serial, NULL },
+};
+
+#define SHA256_BATCH_ENGINE_COUNT (sizeof(sha256_batch_engines) / sizeof(sha256_batch_engines[0]))
+#define SHA256_BATCH_ENGINE_SERIAL (&sha256_batch_engines[SHA256_BATCH_ENGINE_COUNT - 1])
+
+static const sha256_batch_engine_t *sha256_batch_active_engine = NULL;
+
+/**
+ * Run `blocks` blocks of every message through an engine
+ * Lanes beyond count are fed a copy of message 0 and thrown away.
+ */
+static void sha256_batch_blocks(const sha256_batch_engine_t *engine, uint32_t (*state)[8],
+                                const uint8_t *const data[], size_t count, size_t blocks) {
+    for (size_t first = 0; first < count; first += engine->lanes) {
+        size_t lanes = count - first;
+        if (lanes >= engine->lanes) {
+            engine->blocks(&state[first], &data[first], blocks);
+            continue;
+        }
+
+        uint32_t spare_state[SHA256_BATCH_MAX][8];
+        const uint8_t *spare_data[SHA256_BATCH_MAX];
+        for (size_t l = 0; l < engine->lanes; l++) {
+            size_t from = first + (l < lanes ? l : 0);
+            memcpy(spare_state[l], state[from], sizeof(spare_state[l]));
+            spare_data[l] = data[from];
+        }
+        engine->blocks(spare_state, spare_data, blocks);
+        memcpy(&state[first], spare_state, lanes * sizeof(spare_state[0]));
+    }
+}
+
+static void sha256_batch_start(platform_sha256_batch_ctx_t *ctx, size_t count) {
+    platform_sha256_ctx_t single;
+    sha256_init(&single);
+
+    for (size_t l = 0; l < count; l++) {
+        memcpy(ctx->state[l], single.state, sizeof(ctx->state[l]));
+    }
+    ctx->count = count;
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+static void sha256_batch_absorb(const sha256_batch_engine_t *engine, platform_sha256_batch_ctx_t *ctx,
+                                const uint8_t *const data[], size_t size) {
+    const uint8_t *lane[SHA256_BATCH_MAX];
+    size_t done = 0;
+
+    ctx->length += size;
+
+    /* Top up the pending partial blocks first */
+    if (ctx->block_used > 0) {
+        size_t take = sizeof(ctx->block[0]) - ctx->block_used;
+        if (take > size) {
+            take = size;
+        }
+        for (size_t l = 0; l < ctx->count; l++) {
+            memcpy(ctx->block[l] + ctx->block_used, data[l], take);
+            lane[l] = ctx->block[l];
+        }
+        ctx->block_used += take;
+        done = take;
+
+        if (ctx->block_used < sizeof(ctx->block[0])) {
+            return;
+        }
+        sha256_batch_blocks(engine, ctx->state, lane, ctx->count, 1);
+        ctx->block_used = 0;
+    }
+
+    /* Whole blocks straight from the callers' buffers */
+    size_t blocks = (size - done) / 64;
+    if (blocks > 0) {
+        for (size_t l = 0; l < ctx->count; l++) {
+            lane[l] = data[l] + done;
+        }
+        sha256_batch_blocks(engine, ctx->state, lane, ctx->count, blocks);
+        done += blocks * 64;
+    }
+
+    if (done < size) {
+        for (size_t l = 0; l < ctx->count; l++) {
+            memcpy(ctx->block[l], data[l] + done, size - done);
+        }
+        ctx->block_used = size - done;
+    }
+}
+
+static void sha256_batch_finish(const sha256_batch_engine_t *engine, platform_sha256_batch_ctx_t *ctx,
+                                uint8_t hashes[][32]) {
+    const uint8_t *lane[SHA256_BATCH_MAX];
+    uint64_t bit_length = ctx->length * 8;
+    size_t used = ctx->block_used;
+
+    /* Same padding as sha256_final(), identical for every lane */
+    for (size_t l = 0; l < ctx->count; l++) {
+        ctx->block[l][used] = 0x80;
+        lane[l] = ctx->block[l];
+    }
+    used++;
+    if (used > 56) {
+        for (size_t l = 0; l < ctx->count; l++) {
+            memset(ctx->block[l] + used, 0, 64 - used);
+        }
+        sha256_batch_blocks(engine, ctx->state, lane, ctx->count, 1);
+        used = 0;
+    }
+    for (size_t l = 0; l < ctx->count; l++) {
+        memset(ctx->block[l] + used, 0, 56 - used);
+        for (int i = 0; i < 8; i++) {
+            ctx->block[l][56 + i] = (uint8_t)(bit_length >> (56 - i * 8));
+        }
+    }
+    sha256_batch_blocks(engine, ctx->state, lane, ctx->count, 1);
+
+    for (size_t l = 0; l < ctx->count; l++) {
+        for (int i = 0; i < 8; i++) {
+            hashes[l][i * 4] = (uint8_t)(ctx->state[l][i] >> 24);
+            hashes[l][i * 4 + 1] = (uint8_t)(ctx->state[l][i] >> 16);
+            hashes[l][i * 4 + 2] = (uint8_t)(ctx->state[l][i] >> 8);
+            hashes[l][i * 4 + 3] = (uint8_t)ctx->state[l][i];
+        }
+    }
+
+    /* Do not leave intermediate state behind */
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static void sha256_batch_oneshot(const sha256_batch_engine_t *engine, const uint8_t *const data[],
+                                 size_t count, size_t size, uint8_t hashes[][32]) {
+    platform_sha256_batch_ctx_t ctx;
+    sha256_batch_start(&ctx, count);
+    sha256_batch_absorb(engine, &ctx, data, size);
+    sha256_batch_finish(engine, &ctx, hashes);
+}
+
+/* Self test message length: several blocks plus a partial one */
+#define SHA256_BATCH_TEST_SIZE 300
+
+size_t sha256_batch_engine_count(void) {
+    return SHA256_BATCH_ENGINE_COUNT;
+}
+
+const sha256_batch_engine_t *sha256_batch_engine_get(size_t index) {
+    return (index < SHA256_BATCH_ENGINE_COUNT) ? &sha256_batch_engines[index] : NULL;
+}
+
+bool sha256_batch_engine_supported(const sha256_batch_engine_t *engine) {
+    return engine && (!engine->supported || engine->supported());
+}
+
+bool sha256_batch_engine_self_test(const sha256_batch_engine_t *engine) {
+    if (!sha256_batch_engine_supported(engine)) {
+        return false;
+    }
+
+    /* "abc" in every lane (FIPS 180-4 known answer) */
+    static const uint8_t abc_digest[32] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    const uint8_t *data[SHA256_BATCH_MAX];
+    uint8_t hashes[SHA256_BATCH_MAX][32];
+    for (size_t l = 0; l < SHA256_BATCH_MAX; l++) {
+        data[l] = (const uint8_t *)"abc";
+    }
+    sha256_batch_oneshot(engine, data, SHA256_BATCH_MAX, 3, hashes);
+    for (size_t l = 0; l < SHA256_BATCH_MAX; l++) {
+        if (memcmp(hashes[l], abc_digest, sizeof(abc_digest)) != 0) {
+            return false;
+        }
+    }
+
+    /* Distinct messages per lane, odd count: lanes must not mix */
+    static uint8_t messages[SHA256_BATCH_MAX - 1][SHA256_BATCH_TEST_SIZE];
+    uint32_t seed = 0x9E3779B9;
+    for (size_t l = 0; l < SHA256_BATCH_MAX - 1; l++) {
+        for (size_t i = 0; i < SHA256_BATCH_TEST_SIZE; i++) {
+            seed = seed * 1103515245u + 12345u;
+            messages[l][i] = (uint8_t)(seed >> 16);
+        }
+        data[l] = messages[l];
+    }
+    sha256_batch_oneshot(engine, data, SHA256_BATCH_MAX - 1, SHA256_BATCH_TEST_SIZE, hashes);
+    for (size_t l = 0; l < SHA256_BATCH_MAX - 1; l++) {
+        uint8_t expected[32];
+        sha256(messages[l], SHA256_BATCH_TEST_SIZE, expected);
+        if (memcmp(hashes[l], expected, sizeof(expected)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sha256_batch_engine_select(const sha256_batch_engine_t *engine) {
+    if (!sha256_batch_engine_self_test(engine)) {
+        return false;
+    }
+    sha256_batch_active_engine = engine;
+    return true;
+}
+
+const sha256_batch_engine_t *sha256_batch_engine_active(void) {
+    if (!sha256_batch_active_engine) {
+        /* One message through SHA-NI / ARMv8 CE is worth several lanes */
+        const sha256_engine_t *single = sha256_engine_active();
+        size_t serial_lanes = (single == sha256_engine_get(sha256_engine_count() - 1)) ?
+                              1 : SHA256_BATCH_HW_LANES;
+
+        /* SECURITY: an engine that gives a wrong answer is never used */
+        for (size_t i = 0; i + 1 < SHA256_BATCH_ENGINE_COUNT; i++) {
+            if (sha256_batch_engines[i].lanes > serial_lanes &&
+                sha256_batch_engine_select(&sha256_batch_engines[i])) {
+                break;
+            }
+        }
+        if (!sha256_batch_active_engine) {
+            sha256_batch_active_engine = SHA256_BATCH_ENGINE_SERIAL;
+        }
+    }
+    return sha256_batch_active_engine;
+}
+
+void sha256_batch_init(platform_sha256_batch_ctx_t *ctx, size_t count) {
+    sha256_batch_start(ctx, count);
+}
+
+void sha256_batch_update(platform_sha256_batch_ctx_t *ctx, const uint8_t *const data[], size_t size) {
+    sha256_batch_absorb(sha256_batch_engine_active(), ctx, data, size);
+}
+
+void sha256_batch_final(platform_sha256_batch_ctx_t *ctx, uint8_t hashes[][32]) {
+    sha256_batch_finish(sha256_batch_engine_active(), ctx, hashes);
+}
+
+void sha256_batch(const uint8_t *const data[], size_t count, size_t size, uint8_t hashes[][32]) {
+    sha256_batch_oneshot(sha256_batch_engine_active(), data, count, size, hashes);
+}
@@ -0,0 +1,75 @@
+/**
+ * Multi-buffer SHA-256 block function template
+ * Included by sha256_mb.c once per SIMD width with:
+ *   MB_LANES   lanes per vector (4, 8, 16)
+ *   MB_NAME    function name
+ *   MB_TARGET  function attributes enabling the instruction set
+ * Lane l of every vector belongs to message l; GCC vector extensions map
+ * the arithmetic onto SSE2/NEON, AVX2 or AVX-512.
+ */
+
+#define MB_VEC_BYTES (MB_LANES * 4)
+
+typedef uint32_t MB_CONCAT(mb_vec, MB_LANES) __attribute__((vector_size(MB_VEC_BYTES)));
+#define MB_VEC MB_CONCAT(mb_vec, MB_LANES)
+
+MB_TARGET
+static void MB_NAME(uint32_t (*state)[8], const uint8_t *const data[], size_t blocks) {
+    MB_VEC s[8];
+    MB_VEC w[16];
+
+    for (int i = 0; i < 8; i++) {
+        for (int l = 0; l < MB_LANES; l++) {
+            s[i][l] = state[l][i];
+        }
+    }
+
+    for (size_t block = 0; block < blocks; block++) {
+        size_t offset = block * 64;
+        for (int t = 0; t < 16; t++) {
+            for (int l = 0; l < MB_LANES; l++) {
+                uint32_t word;
+                memcpy(&word, data[l] + offset + t * 4, sizeof(word));
+                w[t][l] = MB_LOAD_BE32(word);
+            }
+        }
+
+        MB_VEC a = s[0], b = s[1], c = s[2], d = s[3];
+        MB_VEC e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int t = 0; t < 64; t++) {
+            if (t >= 16) {
+                w[t & 15] += MB_SSIG1(w[(t - 2) & 15]) + w[(t - 7) & 15] +
+                             MB_SSIG0(w[(t - 15) & 15]);
+            }
+            MB_VEC t1 = h + MB_BSIG1(e) + MB_CH(e, f, g) + sha256_k[t] + w[t & 15];
+            MB_VEC t2 = MB_BSIG0(a) + MB_MAJ(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        s[0] += a;
+        s[1] += b;
+        s[2] += c;
+        s[3] += d;
+        s[4] += e;
+        s[5] += f;
+        s[6] += g;
+        s[7] += h;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        for (int l = 0; l < MB_LANES; l++) {
+            state[l][i] = s[i][l];
+        }
+    }
+}
+
+#undef MB_VEC
+#undef MB_VEC_BYTES
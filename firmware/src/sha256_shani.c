@@ -0,0 +1,84 @@
+/**
+ * SHA-256 Block Function - x86 SHA Extensions (SHA-NI)
+ * Built when the Makefile enables SHA256_ENGINE_SHANI; used only if CPUID
+ * reports SHA, SSSE3 and SSE4.1 and the known-answer tests pass.
+ */
+
+#include "sha256.h"
+
+#ifdef SHA256_ENGINE_SHANI
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHANI_TARGET __attribute__((target("sha,ssse3,sse4.1")))
+
+bool sha256_shani_supported(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    bool ssse3 = (ecx & bit_SSSE3) != 0;
+    bool sse41 = (ecx & bit_SSE4_1) != 0;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return ssse3 && sse41 && (ebx & bit_SHA) != 0;
+}
+
+/**
+ * Process whole 64-byte blocks
+ * The SHA-NI round instructions keep the state as ABEF/CDGH halves and take
+ * message words with the round constants already added.
+ */
+SHANI_TARGET
+void sha256_blocks_shani(uint32_t state[8], const uint8_t *data, size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    /* DCBA/HGFE -> ABEF/CDGH */
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+    while (blocks--) {
+        __m128i abef_save = abef;
+        __m128i cdgh_save = cdgh;
+        __m128i msg[4];
+
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)),
+                                      byte_swap);
+        }
+
+        /* Four rounds per step; msg[] is a rolling window of W[4i..4i+15] */
+        for (int i = 0; i < 16; i++) {
+            __m128i wk = _mm_add_epi32(msg[i & 3],
+                                       _mm_loadu_si128((const __m128i *)&sha256_k[i * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+
+            if (i < 12) {
+                __m128i next = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                msg[i & 3] = _mm_sha256msg2_epu32(next, msg[(i + 3) & 3]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+        data += 64;
+    }
+
+    /* ABEF/CDGH -> DCBA/HGFE */
+    tmp = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    abef = _mm_blend_epi16(tmp, cdgh, 0xF0);
+    cdgh = _mm_alignr_epi8(cdgh, tmp, 8);
+    _mm_storeu_si128((__m128i *)&state[0], abef);
+    _mm_storeu_si128((__m128i *)&state[4], cdgh);
+}
+
+#endif /* SHA256_ENGINE_SHANI */
@@ -4,10 +4,32 @@
  */
 
 #include "spi_flash.h"
+#include "recovery_core.h"
 #include "platform.h"
 #include <string.h>
 
+/* Defaults when the platform cannot describe the chip */
+#define SPI_FLASH_DEFAULT_PAGE_SIZE 256
+#define SPI_FLASH_DEFAULT_ERASE_SIZE 4096
+#define SPI_FLASH_DEFAULT_PAGE_PROGRAM_US 700
+#define SPI_FLASH_DEFAULT_SECTOR_ERASE_MS 45
+#define SPI_FLASH_POLLS_PER_OP 8   /* Busy polls spread over the typical time */
+
+/* Operation the chip may still be busy with */
+typedef enum {
+    SPI_OP_NONE,
+    SPI_OP_PROGRAM,
+    SPI_OP_ERASE
+} spi_flash_op_t;
+
 static bool spi_initialized = false;
+static platform_spi_chip_info_t chip;
+static spi_flash_op_t pending_op = SPI_OP_NONE;
+static spi_flash_write_observer_t write_observer = NULL;
+static uint32_t flash_epoch = 0;
+
+/* Read-modify-write buffer for partially written erase blocks */
+static uint8_t rmw_block[SPI_FLASH_MAX_ERASE_SIZE];
 
 bool spi_flash_init(void) {
     if (spi_initialized) {
@@ -19,17 +41,44 @@ bool spi_flash_init(void) {
         return false;
     }
     
+    /* Chip geometry and timing hints, with sane fallbacks */
+    if (!platform_spi_get_chip_info(&chip)) {
+        memset(&chip, 0, sizeof(chip));
+    }
+    if (chip.page_size == 0 || chip.page_size > SPI_FLASH_MAX_PAGE_SIZE ||
+        (chip.page_size & (chip.page_size - 1)) != 0) {
+        chip.page_size = SPI_FLASH_DEFAULT_PAGE_SIZE;
+    }
+    if (chip.erase_size == 0 || chip.erase_size % chip.page_size != 0) {
+        chip.erase_size = SPI_FLASH_DEFAULT_ERASE_SIZE;
+    }
+    
+    /* Partial-block writes (config, caches, wipes) need the whole block in
+     * rmw_block; build with a larger SPI_FLASH_MAX_ERASE_SIZE for such parts */
+    if (chip.erase_size > SPI_FLASH_MAX_ERASE_SIZE) {
+        return false;
+    }
+    if (chip.page_program_us == 0) {
+        chip.page_program_us = SPI_FLASH_DEFAULT_PAGE_PROGRAM_US;
+    }
+    if (chip.sector_erase_ms == 0) {
+        chip.sector_erase_ms = SPI_FLASH_DEFAULT_SECTOR_ERASE_MS;
+    }
+    
     spi_initialized = true;
     return true;
 }
 
-bool spi_flash_read(uint32_t offset, uint8_t *buffer, size_t size) {
+/**
+ * Validate an access range
+ */
+static bool spi_flash_check_range(uint32_t offset, size_t size) {
     /* SECURITY: Validate parameters */
-    if (!spi_initialized || !buffer || size == 0) {
+    if (!spi_initialized || size == 0) {
         return false;
     }
     
-    /* SECURITY: Bounds checking - prevent overflow */
+    /* SECURITY: Bounds checking - prevent overflow and corruption */
     uint32_t flash_size = spi_flash_get_size();
     if (flash_size == 0) {
         return false;  /* Flash not initialized */
@@ -42,33 +91,313 @@ bool spi_flash_read(uint32_t offset, uint8_t *buffer, size_t size) {
     
     /* Check bounds */
     if (offset >= flash_size || (offset + size) > flash_size) {
-        return false;  /* Out of bounds */
+        return false;  /* Out of bounds - would corrupt flash */
+    }
+    
+    return true;
+}
+
+bool spi_flash_wait_ready(void) {
+    if (pending_op == SPI_OP_NONE) {
+        return true;
+    }
+    
+    /* Poll a few times per typical operation time, give up well past it */
+    uint32_t typical_us = (pending_op == SPI_OP_ERASE) ?
+        chip.sector_erase_ms * 1000 : chip.page_program_us;
+    uint32_t interval_us = typical_us / SPI_FLASH_POLLS_PER_OP;
+    if (interval_us == 0) {
+        interval_us = 1;
+    }
+    uint32_t timeout_us = typical_us * SPI_FLASH_TIMEOUT_FACTOR;
+    uint32_t waited_us = 0;
+    
+    /* The op stays pending on timeout: nothing is issued to a busy chip */
+    while (platform_spi_is_busy()) {
+        if (waited_us >= timeout_us) {
+            return false;
+        }
+        platform_delay_us(interval_us);
+        waited_us += interval_us;
+    }
+    
+    pending_op = SPI_OP_NONE;
+    return true;
+}
+
+bool spi_flash_read(uint32_t offset, uint8_t *buffer, size_t size) {
+    /* SECURITY: Validate parameters and bounds */
+    if (!buffer || !spi_flash_check_range(offset, size)) {
+        return false;
+    }
+    
+    /* Reads are not allowed while a program/erase is in progress */
+    if (!spi_flash_wait_ready()) {
+        return false;
     }
     
     /* Platform-specific read */
     return platform_spi_read(offset, buffer, size);
 }
 
-bool spi_flash_write(uint32_t offset, const uint8_t *buffer, size_t size) {
-    /* SECURITY: Validate parameters */
-    if (!spi_initialized || !buffer || size == 0) {
+/**
+ * Whether a program/erase touches what integrity snapshots describe: the
+ * firmware region, and config plus sector index. Log and verify cache
+ * writes leave the epoch alone so they do not force a re-measure.
+ */
+static bool spi_flash_in_measured(uint32_t offset, size_t size) {
+    uint64_t end = (uint64_t)offset + size;
+    
+    if (offset < FIRMWARE_REGION_START + (uint64_t)FIRMWARE_REGION_SIZE &&
+        end > FIRMWARE_REGION_START) {
+        return true;
+    }
+    return offset < SRC_VERIFY_CACHE_START && end > SRC_CONFIG_START;
+}
+
+/**
+ * Issue a program of data that lies within one page
+ * skip_erased: all-0xFF data needs no program (it cannot change any bit)
+ */
+static bool spi_flash_program_piece(uint32_t offset, const uint8_t *data,
+                                    size_t size, bool skip_erased) {
+    if (skip_erased) {
+        size_t i = 0;
+        while (i < size && data[i] == 0xFF) {
+            i++;
+        }
+        if (i == size) {
+            return true;
+        }
+    }
+    
+    /* Previous page must be done before the next is issued */
+    if (!spi_flash_wait_ready()) {
         return false;
     }
     
-    /* SECURITY: Bounds checking - prevent overflow and corruption */
-    uint32_t flash_size = spi_flash_get_size();
-    if (flash_size == 0) {
-        return false;  /* Flash not initialized */
+    if (spi_flash_in_measured(offset, size)) {
+        flash_epoch++;
+    }
+    if (write_observer) {
+        write_observer(offset, size, false);
+    }
+    if (!platform_spi_write(offset, data, size)) {
+        return false;
+    }
+    pending_op = SPI_OP_PROGRAM;
+    return true;
+}
+
+/**
+ * Split a program into page-sized pieces
+ */
+static bool spi_flash_program_pages(uint32_t offset, const uint8_t *data,
+                                    size_t size, bool skip_erased) {
+    while (size > 0) {
+        size_t room = chip.page_size - (offset % chip.page_size);
+        size_t len = (size < room) ? size : room;
+        
+        if (!spi_flash_program_piece(offset, data, len, skip_erased)) {
+            return false;
+        }
+        offset += len;
+        data += len;
+        size -= len;
+    }
+    return true;
+}
+
+/**
+ * Issue an erase of the block containing offset
+ */
+static bool spi_flash_erase_block(uint32_t offset) {
+    if (!spi_flash_wait_ready()) {
+        return false;
     }
     
-    /* Check for integer overflow in offset + size */
-    if (size > UINT32_MAX || offset > UINT32_MAX - size) {
-        return false;  /* Would overflow */
+    uint32_t block_start = offset - (offset % chip.erase_size);
+    if (spi_flash_in_measured(block_start, chip.erase_size)) {
+        flash_epoch++;
+    }
+    if (write_observer) {
+        write_observer(block_start, chip.erase_size, true);
     }
     
-    /* Check bounds */
-    if (offset >= flash_size || (offset + size) > flash_size) {
-        return false;  /* Out of bounds - would corrupt flash */
+    /* Platform-specific erase */
+    if (!platform_spi_erase(block_start)) {
+        return false;
+    }
+    pending_op = SPI_OP_ERASE;
+    return true;
+}
+
+/**
+ * Check whether a range already reads as erased (0xFF)
+ */
+static bool spi_flash_range_erased(uint32_t offset, size_t size) {
+    uint8_t probe[64];
+    
+    while (size > 0) {
+        size_t len = (size < sizeof(probe)) ? size : sizeof(probe);
+        if (!spi_flash_read(offset, probe, len)) {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (probe[i] != 0xFF) {
+                return false;
+            }
+        }
+        offset += len;
+        size -= len;
+    }
+    return true;
+}
+
+/**
+ * Prepare the erase block the batch is entering
+ */
+static bool spi_flash_batch_enter_block(spi_flash_batch_t *batch) {
+    uint32_t block_start = batch->offset - (batch->offset % chip.erase_size);
+    uint32_t block_end = block_start + chip.erase_size;
+    uint32_t range_end = (batch->end < block_end) ? batch->end : block_end;
+    
+    batch->block_end = block_end;
+    
+    /* Whole block rewritten: plain erase */
+    if (batch->offset == block_start && range_end == block_end) {
+        return spi_flash_erase_block(block_start);
+    }
+    
+    /* Partial block whose target bytes are already erased: just program */
+    if (spi_flash_range_erased(batch->offset, range_end - batch->offset)) {
+        return true;
+    }
+    
+    /* Read-modify-write: keep the bytes outside the range (init checked
+     * that the block fits rmw_block) */
+    if (!spi_flash_read(block_start, rmw_block, chip.erase_size) ||
+        !spi_flash_erase_block(block_start)) {
+        return false;
+    }
+    
+    /* Restore the head now, the tail once the range has been written */
+    if (batch->offset > block_start &&
+        !spi_flash_program_pages(block_start, rmw_block,
+                                 batch->offset - block_start, true)) {
+        return false;
+    }
+    batch->tail_start = range_end;
+    batch->tail_end = block_end;
+    return true;
+}
+
+bool spi_flash_batch_begin(spi_flash_batch_t *batch, uint32_t offset, size_t size) {
+    if (!batch) {
+        return false;
+    }
+    
+    memset(batch, 0, sizeof(*batch));
+    
+    /* SECURITY: Validate the whole range up front */
+    if (!spi_flash_check_range(offset, size)) {
+        return false;
+    }
+    
+    batch->offset = offset;
+    batch->end = offset + size;
+    batch->block_end = offset;  /* First write enters the first block */
+    batch->active = true;
+    return true;
+}
+
+bool spi_flash_batch_write(spi_flash_batch_t *batch, const uint8_t *data, size_t size) {
+    if (!batch || !batch->active || !data) {
+        return false;
+    }
+    
+    /* SECURITY: Never write past the range validated at begin */
+    if (size > batch->end - batch->offset) {
+        return false;
+    }
+    
+    while (size > 0) {
+        if (batch->offset == batch->block_end &&
+            !spi_flash_batch_enter_block(batch)) {
+            return false;
+        }
+        
+        /* Never cross a page (blocks are whole pages) */
+        uint32_t page_end = batch->offset - (batch->offset % chip.page_size) +
+                            chip.page_size;
+        size_t len = page_end - batch->offset;
+        if (len > size) {
+            len = size;
+        }
+        bool page_done = (batch->offset + len == page_end) ||
+                         (batch->offset + len == batch->end);
+        
+        if (batch->page_used == 0 && page_done) {
+            /* Whole piece available: program straight from the caller */
+            if (!spi_flash_program_piece(batch->offset, data, len, true)) {
+                return false;
+            }
+        } else {
+            /* Accumulate until the page is complete */
+            if (batch->page_used == 0) {
+                batch->page_offset = batch->offset;
+            }
+            memcpy(batch->page + batch->page_used, data, len);
+            batch->page_used += len;
+            
+            if (page_done) {
+                bool ok = spi_flash_program_piece(batch->page_offset, batch->page,
+                                                  batch->page_used, true);
+                batch->page_used = 0;
+                if (!ok) {
+                    return false;
+                }
+            }
+        }
+        
+        batch->offset += len;
+        data += len;
+        size -= len;
+    }
+    
+    return true;
+}
+
+bool spi_flash_batch_end(spi_flash_batch_t *batch) {
+    if (!batch || !batch->active) {
+        return false;
+    }
+    
+    bool ok = (batch->offset == batch->end);
+    
+    /* Flush a page left partial by a short stream */
+    if (batch->page_used > 0) {
+        ok = spi_flash_program_piece(batch->page_offset, batch->page,
+                                     batch->page_used, true) && ok;
+        batch->page_used = 0;
+    }
+    
+    /* Restore bytes preserved after the range */
+    if (batch->tail_end > batch->tail_start) {
+        uint32_t block_start = batch->tail_end - chip.erase_size;
+        ok = spi_flash_program_pages(batch->tail_start,
+                                     rmw_block + (batch->tail_start - block_start),
+                                     batch->tail_end - batch->tail_start, true) && ok;
+    }
+    
+    batch->active = false;
+    return spi_flash_wait_ready() && ok;
+}
+
+bool spi_flash_write(uint32_t offset, const uint8_t *buffer, size_t size) {
+    /* SECURITY: Validate parameters */
+    if (!buffer) {
+        return false;
     }
     
     /* SECURITY: Sanity check - prevent writing to critical regions without explicit permission
@@ -78,35 +407,49 @@ bool spi_flash_write(uint32_t offset, const uint8_t *buffer, size_t size) {
         /* In production, this should check if we're in recovery mode */
     }
     
-    /* Erase sector if needed before write */
-    uint32_t sector_size = 4096;  // Typical 4KB sectors
-    uint32_t sector_start = (offset / sector_size) * sector_size;
+    spi_flash_batch_t batch;
+    if (!spi_flash_batch_begin(&batch, offset, size)) {
+        return false;
+    }
     
-    if (offset % sector_size == 0) {
-        /* SECURITY: Verify sector erase is within bounds */
-        if (sector_start >= flash_size) {
-            return false;
-        }
-        if (!spi_flash_erase_sector(sector_start)) {
-            return false;
-        }
+    bool ok = spi_flash_batch_write(&batch, buffer, size);
+    return spi_flash_batch_end(&batch) && ok;
+}
+
+bool spi_flash_program(uint32_t offset, const uint8_t *buffer, size_t size) {
+    if (!buffer || !spi_flash_check_range(offset, size)) {
+        return false;
     }
     
-    /* Platform-specific write */
-    return platform_spi_write(offset, buffer, size);
+    /* Page-split program; caller guarantees only 1 -> 0 transitions.
+     * All-0xFF pages are skipped: programming them changes no bit. */
+    if (!spi_flash_program_pages(offset, buffer, size, true)) {
+        return false;
+    }
+    return spi_flash_wait_ready();
 }
 
 bool spi_flash_erase_sector(uint32_t offset) {
-    if (!spi_initialized) {
+    if (!spi_flash_check_range(offset, 1)) {
         return false;
     }
     
-    /* Platform-specific erase */
-    return platform_spi_erase(offset);
+    if (!spi_flash_erase_block(offset)) {
+        return false;
+    }
+    return spi_flash_wait_ready();
+}
+
+uint32_t spi_flash_get_epoch(void) {
+    return flash_epoch;
+}
+
+void spi_flash_set_write_observer(spi_flash_write_observer_t observer) {
+    write_observer = observer;
 }
 
 bool spi_flash_lock(void) {
-    if (!spi_initialized) {
+    if (!spi_initialized || !spi_flash_wait_ready()) {
         return false;
     }
     
@@ -115,7 +458,7 @@ bool spi_flash_lock(void) {
 }
 
 bool spi_flash_unlock(void) {
-    if (!spi_initialized) {
+    if (!spi_initialized || !spi_flash_wait_ready()) {
         return false;
     }
     
@@ -127,3 +470,11 @@ uint32_t spi_flash_get_size(void) {
     /* Platform-specific size detection */
     return platform_spi_get_size();
 }
+
+uint32_t spi_flash_get_page_size(void) {
+    return spi_initialized ? chip.page_size : SPI_FLASH_DEFAULT_PAGE_SIZE;
+}
+
+uint32_t spi_flash_get_erase_size(void) {
+    return spi_initialized ? chip.erase_size : SPI_FLASH_DEFAULT_ERASE_SIZE;
+}
@@ -10,18 +10,67 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+/* Write engine limits */
+#define SPI_FLASH_MAX_PAGE_SIZE 256      /* Largest supported program page */
+#ifndef SPI_FLASH_MAX_ERASE_SIZE
+#define SPI_FLASH_MAX_ERASE_SIZE 4096    /* Largest erase block (read-modify-write buffer) */
+#endif
+#define SPI_FLASH_TIMEOUT_FACTOR 20      /* Busy timeout = typical time x factor */
+
+/* Called with the range of every program/erase issued to the chip */
+typedef void (*spi_flash_write_observer_t)(uint32_t offset, size_t size, bool erase);
+
+/* Streaming write state (see spi_flash_batch_begin) */
+typedef struct {
+    uint32_t offset;          /* Next flash offset to receive data */
+    uint32_t end;             /* End of the batch range */
+    uint32_t block_end;       /* End of the erase block being filled */
+    uint32_t tail_start;      /* Preserved bytes to restore at batch end */
+    uint32_t tail_end;
+    bool active;
+    uint32_t page_offset;     /* Flash offset of page[0] */
+    size_t page_used;         /* Bytes accumulated in page[] */
+    uint8_t page[SPI_FLASH_MAX_PAGE_SIZE];
+} spi_flash_batch_t;
+
 /* Initialize SPI flash interface */
 bool spi_flash_init(void);
 
 /* Read data from SPI flash */
 bool spi_flash_read(uint32_t offset, uint8_t *buffer, size_t size);
 
-/* Write data to SPI flash */
+/* Write data to SPI flash
+ * Any offset/size: erases and reprograms the touched blocks, preserving
+ * bytes outside the range with read-modify-write where needed */
 bool spi_flash_write(uint32_t offset, const uint8_t *buffer, size_t size);
 
+/* Program data without erasing first (can only clear bits, 1 -> 0) */
+bool spi_flash_program(uint32_t offset, const uint8_t *buffer, size_t size);
+
 /* Erase sector (typically 4KB or 64KB) */
 bool spi_flash_erase_sector(uint32_t offset);
 
+/* Streaming writes
+ * Same result as spi_flash_write() for [offset, offset + size), but data is
+ * supplied in pieces. Blocks are erased as the stream enters them and pages
+ * are issued without waiting for the previous one, so callers can prepare
+ * the next piece while the chip programs. Only one batch may be open.
+ */
+bool spi_flash_batch_begin(spi_flash_batch_t *batch, uint32_t offset, size_t size);
+bool spi_flash_batch_write(spi_flash_batch_t *batch, const uint8_t *data, size_t size);
+bool spi_flash_batch_end(spi_flash_batch_t *batch);
+
+/* Wait for any program/erase in progress to finish; on timeout it stays
+ * pending, so reads and writes keep failing until the chip is ready */
+bool spi_flash_wait_ready(void);
+
+/* Modification epoch: changes whenever a program/erase is issued to the
+ * firmware region or the SRC config/sector index (not log or cache writes) */
+uint32_t spi_flash_get_epoch(void);
+
+/* Register the write observer (NULL to remove) */
+void spi_flash_set_write_observer(spi_flash_write_observer_t observer);
+
 /* Lock SPI flash (hardware protection) */
 bool spi_flash_lock(void);
 
@@ -31,4 +80,10 @@ bool spi_flash_unlock(void);
 /* Get flash size */
 uint32_t spi_flash_get_size(void);
 
+/* Get program page size */
+uint32_t spi_flash_get_page_size(void);
+
+/* Get erase block size */
+uint32_t spi_flash_get_erase_size(void);
+
 #endif /* SPI_FLASH_H */
@@ -0,0 +1,494 @@
+/**
+ * USB Mass Storage Bulk-Only Transport Implementation
+ */
+
+#include "usb_bot.h"
+#include <string.h>
+
+#define USB_BOT_CBW_SIZE 31
+#define USB_BOT_CSW_SIZE 13
+#define USB_BOT_CBW_SIGNATURE 0x43425355     // "USBC"
+#define USB_BOT_CSW_SIGNATURE 0x53425355     // "USBS"
+#define USB_BOT_CSW_PASSED 0x00
+#define USB_BOT_CSW_FAILED 0x01
+#define USB_BOT_READY_RETRIES 20
+#define USB_BOT_READY_DELAY_MS 100
+#define USB_BOT_MAX_READ10_BLOCKS 0xFFFF
+#define USB_BOT_DIRECT (-1)                  // Command buffer: the caller's, waited for
+#define USB_BOT_QUEUED (-2)                  // Command buffer: the caller's, by ticket
+
+#define SCSI_TEST_UNIT_READY 0x00
+#define SCSI_REQUEST_SENSE 0x03
+#define SCSI_READ_CAPACITY_10 0x25
+#define SCSI_READ_10 0x28
+
+/* Queued command */
+typedef struct {
+    uint8_t cbw[USB_BOT_CBW_SIZE];
+    uint8_t csw[USB_BOT_CSW_SIZE];
+    uint32_t tag;
+    uint32_t length;        // Data bytes expected
+    int32_t buffer;         // Read-ahead buffer it fills, or USB_BOT_DIRECT/QUEUED
+} usb_bot_command_t;
+
+/* Read-ahead buffer */
+enum {
+    USB_BOT_BUFFER_EMPTY,
+    USB_BOT_BUFFER_PENDING,
+    USB_BOT_BUFFER_READY
+};
+
+typedef struct {
+    uint8_t state;
+    uint32_t lba;
+    uint32_t blocks;
+    uint8_t data[USB_BOT_READAHEAD_SIZE];
+} usb_bot_buffer_t;
+
+/* Sequential reader: where its next read should start, and how far ahead
+ * of that it has been read already */
+typedef struct {
+    bool valid;
+    uint32_t next_lba;
+    uint32_t ahead_lba;
+    uint32_t used;
+} usb_bot_stream_t;
+
+static struct {
+    bool attached;
+    usb_bot_backend_t backend;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t max_blocks;            // Blocks per READ(10)
+    uint32_t readahead_blocks;      // Blocks per read-ahead buffer
+    uint32_t tag;
+    bool sense_pending;             // A command failed; its sense data is unread
+    bool direct_ok;                 // No command into the caller's buffer failed
+    uint32_t completed_tag;         // Commands complete in tag order
+    uint32_t ticket_failed;         // Bit per tag % USB_BOT_TICKETS
+    usb_bot_command_t queue[USB_BOT_QUEUE_DEPTH];
+    uint32_t head;
+    uint32_t count;
+    usb_bot_stream_t streams[USB_BOT_STREAMS];
+    uint32_t stream_clock;
+} bot;
+
+static usb_bot_buffer_t bot_pool[USB_BOT_READAHEAD_BUFFERS];
+
+/* Replies of READ CAPACITY and REQUEST SENSE */
+static uint8_t bot_reply[18];
+
+static void usb_bot_put32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t usb_bot_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t usb_bot_get32_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/**
+ * Reset recovery: everything queued is lost
+ */
+static void usb_bot_recover(void) {
+    for (uint32_t i = 0; i < bot.count; i++) {
+        const usb_bot_command_t *command = &bot.queue[(bot.head + i) % USB_BOT_QUEUE_DEPTH];
+        if (command->buffer >= 0) {
+            bot_pool[command->buffer].state = USB_BOT_BUFFER_EMPTY;
+        } else if (command->buffer == USB_BOT_QUEUED) {
+            bot.ticket_failed |= 1u << (command->tag % USB_BOT_TICKETS);
+        } else {
+            bot.direct_ok = false;
+        }
+    }
+    bot.completed_tag = bot.tag;
+    bot.head = 0;
+    bot.count = 0;
+    bot.backend.reset(bot.backend.context);
+}
+
+/**
+ * Queue one command: CBW, data stage (device to host only), CSW
+ */
+static bool usb_bot_submit(const uint8_t *cdb, uint8_t cdb_len, uint8_t *data,
+                           uint32_t length, int32_t buffer) {
+    if (bot.count == USB_BOT_QUEUE_DEPTH) {
+        return false;
+    }
+
+    usb_bot_command_t *command = &bot.queue[(bot.head + bot.count) % USB_BOT_QUEUE_DEPTH];
+    memset(command->cbw, 0, sizeof(command->cbw));
+    if (++bot.tag == 0) {
+        bot.tag = 1;        // 0 is never a ticket
+    }
+    command->tag = bot.tag;
+    command->length = length;
+    command->buffer = buffer;
+    usb_bot_put32(&command->cbw[0], USB_BOT_CBW_SIGNATURE);
+    usb_bot_put32(&command->cbw[4], command->tag);
+    usb_bot_put32(&command->cbw[8], length);
+    command->cbw[12] = length ? 0x80 : 0x00;
+    command->cbw[13] = bot.backend.lun;
+    command->cbw[14] = cdb_len;
+    memcpy(&command->cbw[15], cdb, cdb_len);
+    bot.count++;
+
+    void *context = bot.backend.context;
+    if (!bot.backend.submit(context, false, command->cbw, sizeof(command->cbw)) ||
+        (length && !bot.backend.submit(context, true, data, length)) ||
+        !bot.backend.submit(context, true, command->csw, sizeof(command->csw))) {
+        usb_bot_recover();
+        return false;
+    }
+    if (buffer >= 0) {
+        bot_pool[buffer].state = USB_BOT_BUFFER_PENDING;
+    }
+    return true;
+}
+
+/**
+ * Collect the oldest queued command
+ */
+static bool usb_bot_complete(void) {
+    if (bot.count == 0) {
+        return false;
+    }
+    usb_bot_command_t *command = &bot.queue[bot.head];
+
+    size_t cbw_sent = 0;
+    size_t data_got = command->length;
+    size_t csw_got = 0;
+    void *context = bot.backend.context;
+    bool transport_ok = bot.backend.wait(context, &cbw_sent) &&
+                        (command->length == 0 || bot.backend.wait(context, &data_got)) &&
+                        bot.backend.wait(context, &csw_got) &&
+                        cbw_sent == USB_BOT_CBW_SIZE && csw_got == USB_BOT_CSW_SIZE &&
+                        usb_bot_get32(&command->csw[0]) == USB_BOT_CSW_SIGNATURE &&
+                        usb_bot_get32(&command->csw[4]) == command->tag &&
+                        command->csw[12] <= USB_BOT_CSW_FAILED;
+    if (!transport_ok) {
+        /* Phase error or lost sync: the device needs a reset */
+        usb_bot_recover();
+        return false;
+    }
+
+    bot.head = (bot.head + 1) % USB_BOT_QUEUE_DEPTH;
+    bot.count--;
+    bot.completed_tag = command->tag;
+    bool ok = command->csw[12] == USB_BOT_CSW_PASSED &&
+              usb_bot_get32(&command->csw[8]) == 0 && data_got == command->length;
+    if (command->csw[12] == USB_BOT_CSW_FAILED) {
+        bot.sense_pending = true;
+    }
+    if (command->buffer >= 0) {
+        bot_pool[command->buffer].state = ok ? USB_BOT_BUFFER_READY : USB_BOT_BUFFER_EMPTY;
+    } else if (command->buffer == USB_BOT_QUEUED) {
+        uint32_t bit = 1u << (command->tag % USB_BOT_TICKETS);
+        bot.ticket_failed = ok ? (bot.ticket_failed & ~bit) : (bot.ticket_failed | bit);
+    } else if (!ok) {
+        bot.direct_ok = false;
+    }
+    return ok;
+}
+
+static bool usb_bot_direct_queued(void) {
+    for (uint32_t i = 0; i < bot.count; i++) {
+        if (bot.queue[(bot.head + i) % USB_BOT_QUEUE_DEPTH].buffer == USB_BOT_DIRECT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void usb_bot_drain(void) {
+    while (bot.count > 0) {
+        usb_bot_complete();
+    }
+}
+
+/**
+ * Run one command on its own, clearing any sense condition first
+ */
+static bool usb_bot_command(const uint8_t *cdb, uint8_t cdb_len, uint8_t *data, uint32_t length);
+
+static void usb_bot_clear_sense(void) {
+    static const uint8_t cdb[6] = { SCSI_REQUEST_SENSE, 0, 0, 0, sizeof(bot_reply), 0 };
+    if (bot.sense_pending) {
+        bot.sense_pending = false;
+        usb_bot_command(cdb, sizeof(cdb), bot_reply, sizeof(bot_reply));
+        bot.sense_pending = false;
+    }
+}
+
+static bool usb_bot_command(const uint8_t *cdb, uint8_t cdb_len, uint8_t *data, uint32_t length) {
+    usb_bot_drain();
+    usb_bot_clear_sense();
+    bot.direct_ok = true;
+    if (!usb_bot_submit(cdb, cdb_len, data, length, USB_BOT_DIRECT)) {
+        return false;
+    }
+    usb_bot_drain();
+    return bot.direct_ok;
+}
+
+static bool usb_bot_submit_read(uint32_t lba, uint32_t blocks, uint8_t *data, int32_t buffer) {
+    uint8_t cdb[10] = { SCSI_READ_10, 0,
+                        (uint8_t)(lba >> 24), (uint8_t)(lba >> 16),
+                        (uint8_t)(lba >> 8), (uint8_t)lba, 0,
+                        (uint8_t)(blocks >> 8), (uint8_t)blocks, 0 };
+    return usb_bot_submit(cdb, sizeof(cdb), data, blocks * bot.block_size, buffer);
+}
+
+bool usb_bot_attach(const usb_bot_backend_t *backend) {
+    static const uint8_t test_unit_ready[6] = { SCSI_TEST_UNIT_READY };
+    static const uint8_t read_capacity[10] = { SCSI_READ_CAPACITY_10 };
+
+    usb_bot_detach();
+    if (!backend || !backend->submit || !backend->wait || !backend->reset) {
+        return false;
+    }
+    bot.backend = *backend;
+
+    /* A freshly plugged stick reports "not ready" for a while */
+    bool ready = false;
+    for (uint32_t i = 0; i < USB_BOT_READY_RETRIES && !ready; i++) {
+        ready = usb_bot_command(test_unit_ready, sizeof(test_unit_ready), NULL, 0);
+        if (!ready) {
+            usb_bot_clear_sense();
+            platform_delay_ms(USB_BOT_READY_DELAY_MS);
+        }
+    }
+    if (!ready || !usb_bot_command(read_capacity, sizeof(read_capacity), bot_reply, 8)) {
+        return false;
+    }
+
+    /* Devices past 2TB need READ CAPACITY(16); not supported */
+    uint32_t last_lba = usb_bot_get32_be(&bot_reply[0]);
+    bot.block_size = usb_bot_get32_be(&bot_reply[4]);
+    if (last_lba == 0xFFFFFFFF || bot.block_size < 512 ||
+        bot.block_size > USB_BOT_MAX_BLOCK_SIZE ||
+        (bot.block_size & (bot.block_size - 1)) != 0 ||
+        backend->max_transfer < bot.block_size) {
+        return false;
+    }
+    bot.block_count = last_lba + 1;
+    bot.max_blocks = backend->max_transfer / bot.block_size;
+    if (bot.max_blocks > USB_BOT_MAX_READ10_BLOCKS) {
+        bot.max_blocks = USB_BOT_MAX_READ10_BLOCKS;
+    }
+    bot.readahead_blocks = USB_BOT_READAHEAD_SIZE / bot.block_size;
+    if (bot.readahead_blocks > bot.max_blocks) {
+        bot.readahead_blocks = bot.max_blocks;
+    }
+    bot.attached = true;
+    return true;
+}
+
+void usb_bot_detach(void) {
+    if (bot.count > 0) {
+        usb_bot_recover();
+    }
+    memset(&bot, 0, sizeof(bot));
+    for (uint32_t i = 0; i < USB_BOT_READAHEAD_BUFFERS; i++) {
+        bot_pool[i].state = USB_BOT_BUFFER_EMPTY;
+    }
+}
+
+bool usb_bot_is_attached(void) {
+    return bot.attached;
+}
+
+bool usb_bot_get_info(platform_usb_block_info_t *info) {
+    if (!bot.attached || !info) {
+        return false;
+    }
+    info->block_size = bot.block_size;
+    info->block_count = bot.block_count;
+    /* Longer reads are split here and queued back to back */
+    info->max_transfer_blocks = UINT32_MAX / bot.block_size;
+    return true;
+}
+
+/**
+ * Read-ahead buffer holding lba, if any
+ */
+static usb_bot_buffer_t *usb_bot_find(uint32_t lba) {
+    for (uint32_t i = 0; i < USB_BOT_READAHEAD_BUFFERS; i++) {
+        usb_bot_buffer_t *buffer = &bot_pool[i];
+        if (buffer->state != USB_BOT_BUFFER_EMPTY && lba - buffer->lba < buffer->blocks) {
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * A buffer no stream will read next: empty, or holding blocks behind
+ * every stream
+ */
+static int32_t usb_bot_free_buffer(void) {
+    for (uint32_t i = 0; i < USB_BOT_READAHEAD_BUFFERS; i++) {
+        const usb_bot_buffer_t *buffer = &bot_pool[i];
+        bool wanted = buffer->state == USB_BOT_BUFFER_PENDING;
+        for (uint32_t s = 0; s < USB_BOT_STREAMS && !wanted &&
+                             buffer->state == USB_BOT_BUFFER_READY; s++) {
+            const usb_bot_stream_t *stream = &bot.streams[s];
+            wanted = stream->valid && buffer->lba + buffer->blocks > stream->next_lba &&
+                     buffer->lba < stream->ahead_lba;
+        }
+        if (!wanted) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Track the stream a read belongs to; once it has read sequentially,
+ * queue reads of what follows into free buffers
+ */
+static void usb_bot_read_ahead(uint32_t lba, uint32_t count) {
+    usb_bot_stream_t *stream = NULL;
+    usb_bot_stream_t *oldest = &bot.streams[0];
+    for (uint32_t i = 0; i < USB_BOT_STREAMS; i++) {
+        usb_bot_stream_t *candidate = &bot.streams[i];
+        if (candidate->valid && candidate->next_lba == lba) {
+            stream = candidate;
+            break;
+        }
+        if (!candidate->valid || (oldest->valid && candidate->used < oldest->used)) {
+            oldest = candidate;
+        }
+    }
+
+    uint32_t end = lba + count;
+    if (!stream) {
+        oldest->valid = true;
+        oldest->next_lba = end;
+        oldest->ahead_lba = end;
+        oldest->used = ++bot.stream_clock;
+        return;
+    }
+    stream->next_lba = end;
+    if (stream->ahead_lba < end) {
+        stream->ahead_lba = end;
+    }
+    stream->used = ++bot.stream_clock;
+
+    while (bot.count < USB_BOT_QUEUE_DEPTH && stream->ahead_lba < bot.block_count &&
+           stream->ahead_lba - stream->next_lba < USB_BOT_STREAM_AHEAD * bot.readahead_blocks) {
+        int32_t index = usb_bot_free_buffer();
+        if (index < 0) {
+            break;
+        }
+        usb_bot_buffer_t *buffer = &bot_pool[index];
+        uint32_t blocks = bot.block_count - stream->ahead_lba;
+        if (blocks > bot.readahead_blocks) {
+            blocks = bot.readahead_blocks;
+        }
+        buffer->state = USB_BOT_BUFFER_EMPTY;
+        buffer->lba = stream->ahead_lba;
+        buffer->blocks = blocks;
+        if (!usb_bot_submit_read(buffer->lba, blocks, buffer->data, index)) {
+            break;
+        }
+        stream->ahead_lba += blocks;
+    }
+}
+
+bool usb_bot_read_blocks(uint32_t lba, uint8_t *buffer, uint32_t count) {
+    if (!bot.attached || !buffer || count == 0 || lba >= bot.block_count ||
+        count > bot.block_count - lba) {
+        return false;
+    }
+    usb_bot_clear_sense();
+
+    uint32_t first = lba;
+    uint32_t total = count;
+    bot.direct_ok = true;
+    while (count > 0 && bot.direct_ok) {
+        /* From read-ahead, waiting for it if still in flight */
+        usb_bot_buffer_t *hit = usb_bot_find(lba);
+        while (hit && hit->state == USB_BOT_BUFFER_PENDING && bot.count > 0) {
+            usb_bot_complete();
+        }
+        if (hit && hit->state == USB_BOT_BUFFER_READY) {
+            uint32_t n = hit->lba + hit->blocks - lba;
+            if (n > count) {
+                n = count;
+            }
+            memcpy(buffer, &hit->data[(lba - hit->lba) * bot.block_size], n * bot.block_size);
+            buffer += n * bot.block_size;
+            lba += n;
+            count -= n;
+            if (lba == hit->lba + hit->blocks) {
+                hit->state = USB_BOT_BUFFER_EMPTY;
+            }
+            continue;
+        }
+
+        /* Straight into the caller's buffer, up to the next buffered block */
+        uint32_t run = 1;
+        while (run < count && !usb_bot_find(lba + run)) {
+            run++;
+        }
+        while (run > 0) {
+            uint32_t blocks = run < bot.max_blocks ? run : bot.max_blocks;
+            if (bot.count == USB_BOT_QUEUE_DEPTH) {
+                usb_bot_complete();
+            }
+            if (!usb_bot_submit_read(lba, blocks, buffer, USB_BOT_DIRECT)) {
+                bot.direct_ok = false;
+                break;
+            }
+            buffer += blocks * bot.block_size;
+            lba += blocks;
+            count -= blocks;
+            run -= blocks;
+        }
+    }
+
+    /* Direct reads complete before returning; read-ahead keeps going */
+    while (bot.direct_ok && usb_bot_direct_queued()) {
+        usb_bot_complete();
+    }
+    if (!bot.direct_ok) {
+        usb_bot_drain();
+        return false;
+    }
+
+    usb_bot_read_ahead(first, total);
+    return true;
+}
+
+uint32_t usb_bot_read_start(uint32_t lba, uint8_t *buffer, uint32_t count) {
+    if (!bot.attached || !buffer || count == 0 || count > bot.max_blocks ||
+        lba >= bot.block_count || count > bot.block_count - lba) {
+        return 0;
+    }
+    usb_bot_clear_sense();
+
+    if (bot.count == USB_BOT_QUEUE_DEPTH) {
+        usb_bot_complete();
+    }
+    if (!usb_bot_submit_read(lba, count, buffer, USB_BOT_QUEUED)) {
+        return 0;
+    }
+    return bot.tag;
+}
+
+bool usb_bot_read_wait(uint32_t ticket) {
+    while ((int32_t)(bot.completed_tag - ticket) < 0 && bot.count > 0) {
+        usb_bot_complete();
+    }
+    return ticket != 0 && (int32_t)(bot.completed_tag - ticket) >= 0 &&
+           !(bot.ticket_failed & (1u << (ticket % USB_BOT_TICKETS)));
+}
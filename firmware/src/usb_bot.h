@@ -0,0 +1,89 @@
+/**
+ * USB Mass Storage Bulk-Only Transport
+ * SCSI block commands (READ CAPACITY(10), READ(10)) over the two bulk
+ * pipes of a USB mass storage device, for boards whose host controller
+ * driver gives raw bulk transfers. Provides the block device behind
+ * platform_usb_read_blocks() and so behind fat32.c.
+ *
+ * Each command is three bulk transfers (CBW, data, CSW). Up to
+ * USB_BOT_QUEUE_DEPTH commands are queued at the host controller at once,
+ * so the device never waits for the MCU between commands. Reads are split
+ * into transfers of up to the backend's max_transfer bytes, and a stream
+ * of sequential reads is read ahead into a pool of USB_BOT_READAHEAD_BUFFERS
+ * buffers while the caller works on what it has.
+ */
+
+#ifndef USB_BOT_H
+#define USB_BOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+
+#define USB_BOT_QUEUE_DEPTH 4              // Commands queued at once
+#ifndef USB_BOT_READAHEAD_BUFFERS
+#define USB_BOT_READAHEAD_BUFFERS 4        // Read-ahead pool (RAM: buffers x size)
+#endif
+#ifndef USB_BOT_READAHEAD_SIZE
+#define USB_BOT_READAHEAD_SIZE (32 * 1024) // Bytes per read-ahead command
+#endif
+#define USB_BOT_STREAMS 4                  // Sequential streams tracked
+#define USB_BOT_STREAM_AHEAD 2             // Read-ahead buffers per stream
+#define USB_BOT_MAX_BLOCK_SIZE 4096
+#define USB_BOT_TICKETS 32                 // Queued reads remembered by ticket
+
+/* Bulk pipes of one device, provided by the host controller driver or a
+ * test stand-in. Transfers complete in the order they were submitted,
+ * across both pipes. */
+typedef struct {
+    /* Queue a bulk transfer (in: device to host) */
+    bool (*submit)(void *context, bool in, uint8_t *data, size_t size);
+    /* Wait for the oldest queued transfer; actual receives bytes moved */
+    bool (*wait)(void *context, size_t *actual);
+    /* Bulk-Only Mass Storage Reset, then clear both halts; drops the queue */
+    bool (*reset)(void *context);
+    void *context;
+    uint32_t max_transfer;     // Largest data transfer in bytes (e.g. 64KB)
+    uint8_t lun;
+} usb_bot_backend_t;
+
+/**
+ * Attach to a device: wait for it to be ready and read its capacity
+ */
+bool usb_bot_attach(const usb_bot_backend_t *backend);
+
+/**
+ * Forget the device (unplugged); drops queued commands and read-ahead
+ */
+void usb_bot_detach(void);
+
+/**
+ * True once usb_bot_attach() has succeeded
+ */
+bool usb_bot_is_attached(void);
+
+/**
+ * Geometry in platform_usb_get_block_info() form
+ */
+bool usb_bot_get_info(platform_usb_block_info_t *info);
+
+/**
+ * Read count blocks at lba (from read-ahead where possible)
+ */
+bool usb_bot_read_blocks(uint32_t lba, uint8_t *buffer, uint32_t count);
+
+/**
+ * Queue one READ(10) of count blocks (at most one transfer) straight into
+ * buffer, for callers that keep their own reads in flight; no read-ahead
+ * and no copy. Returns a ticket for usb_bot_read_wait(), 0 on failure.
+ * Collect it before USB_BOT_TICKETS more commands are queued.
+ */
+uint32_t usb_bot_read_start(uint32_t lba, uint8_t *buffer, uint32_t count);
+
+/**
+ * Wait for the read with ticket; the buffer is the caller's again
+ */
+bool usb_bot_read_wait(uint32_t ticket);
+
+#endif /* USB_BOT_H */
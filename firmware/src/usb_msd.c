@@ -4,16 +4,32 @@
 
 #include "usb_msd.h"
 #include "platform.h"
+#include "json.h"
 #include <string.h>
 #include <stdio.h>
 
 static bool usb_initialized = false;
 
+/* Directory-entry cache: one listing per slot, replaced round-robin */
+typedef struct {
+    bool valid;
+    bool listed;            /* false: the directory could not be read */
+    char path[64];
+    uint32_t read_at;       /* platform_get_timestamp() of the listing */
+    uint32_t count;         /* Entries in the directory (may exceed the cache) */
+    platform_usb_dirent_t entries[SRC_USB_DIR_CACHE_ENTRIES];
+} usb_dir_cache_t;
+
+static usb_dir_cache_t usb_dir_cache[SRC_USB_DIR_CACHE_DIRS];
+static uint32_t usb_dir_cache_next = 0;
+
 bool src_usb_init(void) {
     if (usb_initialized) {
         return true;
     }
     
+    src_usb_cache_invalidate();
+    
     /* Platform-specific USB initialization */
     if (!platform_usb_init()) {
         return false;
@@ -41,21 +57,64 @@ bool src_usb_read_file(const char *path, uint8_t *buffer, size_t *size) {
     return platform_usb_read_file(path, buffer, size);
 }
 
+bool src_usb_read_start(const char *path, uint32_t offset,
+                        uint8_t *buffer, size_t size) {
+    if (!usb_initialized || !path || !buffer || size == 0) {
+        return false;
+    }
+    
+    /* Platform-specific queued read */
+    return platform_usb_read_start(path, offset, buffer, size);
+}
+
+bool src_usb_read_start_dma(const char *path, uint32_t offset,
+                            platform_dma_buffer_t *buffer, size_t size,
+                            platform_dma_callback_t callback) {
+    if (!usb_initialized || !path || !buffer || size == 0) {
+        return false;
+    }
+    
+    /* Platform-specific queued read; the buffer is the controller's until
+     * src_usb_read_wait() completes it */
+    return platform_usb_read_start_dma(path, offset, buffer, size, callback);
+}
+
+bool src_usb_read_wait(size_t *size) {
+    if (!usb_initialized || !size) {
+        return false;
+    }
+    
+    /* Platform-specific completion */
+    return platform_usb_read_wait(size);
+}
+
 bool src_usb_write_file(const char *path, const uint8_t *buffer, size_t size) {
     if (!usb_initialized || !path || !buffer || size == 0) {
         return false;
     }
     
     /* Platform-specific file write */
+    src_usb_cache_invalidate();
     return platform_usb_write_file(path, buffer, size);
 }
 
+bool src_usb_append_file(const char *path, const uint8_t *buffer, size_t size) {
+    if (!usb_initialized || !path || !buffer || size == 0) {
+        return false;
+    }
+    
+    /* Platform-specific file append */
+    src_usb_cache_invalidate();
+    return platform_usb_append_file(path, buffer, size);
+}
+
 bool src_usb_delete_file(const char *path) {
     if (!usb_initialized || !path) {
         return false;
     }
     
     /* Platform-specific file delete */
+    src_usb_cache_invalidate();
     return platform_usb_delete_file(path);
 }
 
@@ -74,31 +133,244 @@ bool src_usb_rename_file(const char *old_path, const char *new_path) {
     }
     
     /* Platform-specific file rename */
+    src_usb_cache_invalidate();
     return platform_usb_rename_file(old_path, new_path);
 }
 
-void src_update_manifest(void) {
+void src_usb_cache_invalidate(void) {
+    for (uint32_t i = 0; i < SRC_USB_DIR_CACHE_DIRS; i++) {
+        usb_dir_cache[i].valid = false;
+    }
+}
+
+/**
+ * Listing of a directory, read from USB if not cached or stale
+ */
+static const usb_dir_cache_t *src_usb_cached_dir(const char *dir) {
+    uint32_t now = platform_get_timestamp();
+    usb_dir_cache_t *slot = NULL;
+    
+    for (uint32_t i = 0; i < SRC_USB_DIR_CACHE_DIRS; i++) {
+        usb_dir_cache_t *cached = &usb_dir_cache[i];
+        if (cached->valid && strcmp(cached->path, dir) == 0) {
+            if (now - cached->read_at < SRC_USB_DIR_CACHE_TTL_MS) {
+                return cached;
+            }
+            slot = cached;
+            break;
+        }
+    }
+    if (!slot) {
+        slot = &usb_dir_cache[usb_dir_cache_next];
+        usb_dir_cache_next = (usb_dir_cache_next + 1) % SRC_USB_DIR_CACHE_DIRS;
+    }
+    
+    snprintf(slot->path, sizeof(slot->path), "%s", dir);
+    slot->listed = platform_usb_list_dir(dir, slot->entries,
+                                         SRC_USB_DIR_CACHE_ENTRIES, &slot->count);
+    slot->read_at = now;
+    slot->valid = true;
+    return slot;
+}
+
+bool src_usb_stat(const char *path, platform_usb_dirent_t *entry) {
+    if (!usb_initialized || !path || !entry) {
+        return false;
+    }
+    
+    /* Paths the cache cannot hold go to the device */
+    const char *name = strrchr(path, '/');
+    size_t dir_len = name ? (size_t)(name - path) : 0;
+    if (!name || dir_len >= sizeof(usb_dir_cache[0].path) ||
+        strlen(name + 1) >= PLATFORM_USB_NAME_MAX) {
+        return platform_usb_stat(path, entry);
+    }
+    name++;
+    
+    char dir[sizeof(usb_dir_cache[0].path)];
+    if (dir_len == 0) {
+        snprintf(dir, sizeof(dir), "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)dir_len, path);
+    }
+    const usb_dir_cache_t *cached = src_usb_cached_dir(dir);
+    if (!cached->listed) {
+        return false;
+    }
+    
+    uint32_t stored = cached->count < SRC_USB_DIR_CACHE_ENTRIES ?
+                      cached->count : SRC_USB_DIR_CACHE_ENTRIES;
+    for (uint32_t i = 0; i < stored; i++) {
+        if (strcmp(cached->entries[i].name, name) == 0) {
+            *entry = cached->entries[i];
+            return true;
+        }
+    }
+    
+    /* Not every entry fit the cache */
+    return cached->count > SRC_USB_DIR_CACHE_ENTRIES && platform_usb_stat(path, entry);
+}
+
+/**
+ * Append text to a JSON string body, escaping what JSON requires
+ */
+static void src_json_escape(char *out, size_t size, const char *text) {
+    size_t used = strlen(out);
+    for (; *text && used + 7 < size; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            out[used++] = '\\';
+            out[used++] = (char)c;
+        } else if (c < 0x20) {
+            used += (size_t)snprintf(out + used, size - used, "\\u%04x", c);
+        } else {
+            out[used++] = (char)c;
+        }
+    }
+    out[used] = '\0';
+}
+
+void src_update_manifest(const src_manifest_json_t *manifest) {
     char manifest_path[256];
     snprintf(manifest_path, sizeof(manifest_path), 
             "/SECURITY_RECOVERY/manifest.json");
     
-    /* Generate manifest JSON */
-    char manifest_json[1024];
-    snprintf(manifest_json, sizeof(manifest_json),
+    char board_id[2 * sizeof(manifest->board_id) + 8] = "";
+    src_json_escape(board_id, sizeof(board_id), manifest->board_id);
+    
+    /* Generate manifest JSON; backup_a/backup_b stay for older tools */
+    char manifest_json[SRC_MANIFEST_JSON_MAX_SIZE];
+    size_t used = (size_t)snprintf(manifest_json, sizeof(manifest_json),
             "{\n"
-            "  \"version\": \"1.0\",\n"
+            "  \"version\": \"1.1\",\n"
             "  \"board_id\": \"%s\",\n"
             "  \"backup_a\": \"%s\",\n"
             "  \"backup_b\": \"%s\",\n"
-            "  \"timestamp\": %lu\n"
-            "}\n",
-            "DEFAULT",  // Should use actual board_id from config
+            "  \"timestamp\": %lu,\n"
+            "  \"backups\": [",
+            board_id,
             "A.bin",
             "B.bin",
-            (unsigned long)platform_get_timestamp());
+            (unsigned long)manifest->timestamp);
+    
+    for (uint32_t i = 0; i < manifest->backup_count && used < sizeof(manifest_json); i++) {
+        const src_manifest_json_backup_t *backup = &manifest->backups[i];
+        char hash_str[65];
+        for (int j = 0; j < 32; j++) {
+            snprintf(&hash_str[j * 2], 3, "%02x", backup->hash[j]);
+        }
+        used += (size_t)snprintf(manifest_json + used, sizeof(manifest_json) - used,
+                "%s\n"
+                "    {\"name\": \"%s\", \"generation\": %lu, \"size\": %lu, "
+                "\"sha256\": \"%s\"}",
+                i == 0 ? "" : ",",
+                backup->name,
+                (unsigned long)backup->generation,
+                (unsigned long)backup->size,
+                hash_str);
+    }
+    if (used < sizeof(manifest_json)) {
+        used += (size_t)snprintf(manifest_json + used, sizeof(manifest_json) - used,
+                                 "\n  ]\n}\n");
+    }
+    if (used >= sizeof(manifest_json)) {
+        return;
+    }
+    
+    src_usb_write_file(manifest_path, (uint8_t *)manifest_json, used);
+}
+
+/**
+ * Fill one backup from an entry of the "backups" array
+ */
+static bool src_json_read_backup(const char *json, const json_token_t *tokens, int count,
+                                 int object, src_manifest_json_backup_t *backup) {
+    int name = json_object_get(json, tokens, count, object, "name");
+    if (name < 0 || !json_get_string(json, &tokens[name], backup->name, sizeof(backup->name))) {
+        return false;
+    }
+    
+    int value = json_object_get(json, tokens, count, object, "generation");
+    if (value >= 0 && !json_get_u32(json, &tokens[value], &backup->generation)) {
+        return false;
+    }
+    value = json_object_get(json, tokens, count, object, "size");
+    if (value >= 0 && !json_get_u32(json, &tokens[value], &backup->size)) {
+        return false;
+    }
+    value = json_object_get(json, tokens, count, object, "sha256");
+    if (value >= 0) {
+        backup->has_hash = json_get_hex(json, &tokens[value], backup->hash,
+                                        sizeof(backup->hash));
+        if (!backup->has_hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool src_read_manifest_json(src_manifest_json_t *manifest) {
+    if (!manifest) {
+        return false;
+    }
+    memset(manifest, 0, sizeof(*manifest));
+    
+    char json[SRC_MANIFEST_JSON_MAX_SIZE];
+    size_t size = sizeof(json);
+    if (!src_usb_read_file("/SECURITY_RECOVERY/manifest.json", (uint8_t *)json, &size)) {
+        return false;
+    }
+    
+    json_token_t tokens[SRC_MANIFEST_JSON_MAX_TOKENS];
+    int count = json_parse(json, size, tokens, SRC_MANIFEST_JSON_MAX_TOKENS);
+    if (count <= 0 || tokens[0].type != JSON_OBJECT) {
+        return false;
+    }
     
-    src_usb_write_file(manifest_path, (uint8_t *)manifest_json, 
-                      strlen(manifest_json));
+    int value = json_object_get(json, tokens, count, 0, "version");
+    if (value < 0 ||
+        !json_get_string(json, &tokens[value], manifest->version, sizeof(manifest->version))) {
+        return false;
+    }
+    value = json_object_get(json, tokens, count, 0, "board_id");
+    if (value >= 0 &&
+        !json_get_string(json, &tokens[value], manifest->board_id, sizeof(manifest->board_id))) {
+        return false;
+    }
+    value = json_object_get(json, tokens, count, 0, "timestamp");
+    if (value >= 0 && !json_get_u32(json, &tokens[value], &manifest->timestamp)) {
+        return false;
+    }
+    
+    /* Version 1.1 lists each backup; 1.0 only names them */
+    int backups = json_object_get(json, tokens, count, 0, "backups");
+    if (backups >= 0) {
+        for (uint32_t i = 0; i < SRC_MANIFEST_JSON_MAX_BACKUPS; i++) {
+            int entry = json_array_get(tokens, count, backups, i);
+            if (entry < 0) {
+                break;
+            }
+            if (!src_json_read_backup(json, tokens, count, entry,
+                                      &manifest->backups[manifest->backup_count++])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    const char *keys[SRC_MANIFEST_JSON_MAX_BACKUPS] = { "backup_a", "backup_b" };
+    for (uint32_t i = 0; i < SRC_MANIFEST_JSON_MAX_BACKUPS; i++) {
+        value = json_object_get(json, tokens, count, 0, keys[i]);
+        if (value < 0) {
+            continue;
+        }
+        src_manifest_json_backup_t *backup = &manifest->backups[manifest->backup_count];
+        if (!json_get_string(json, &tokens[value], backup->name, sizeof(backup->name))) {
+            return false;
+        }
+        manifest->backup_count++;
+    }
+    return true;
 }
 
 void src_update_metadata(const uint8_t *firmware_hash) {
@@ -9,6 +9,40 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "platform.h"
+
+/* manifest.json: unsigned summary of the stick for people and host tools.
+ * Recovery only uses it to pass over images it would reject anyway;
+ * manifest.bin/manifest.sig are what authenticate them. */
+#define SRC_MANIFEST_JSON_MAX_SIZE 1024
+#define SRC_MANIFEST_JSON_MAX_TOKENS 48
+#define SRC_MANIFEST_JSON_MAX_BACKUPS 2
+
+/* One full backup listed in manifest.json (0 = not listed) */
+typedef struct {
+    char name[16];
+    uint32_t generation;
+    uint32_t size;
+    bool has_hash;
+    uint8_t hash[32];
+} src_manifest_json_backup_t;
+
+typedef struct {
+    char version[8];
+    char board_id[32];        // Empty if not listed
+    uint32_t timestamp;
+    uint32_t backup_count;
+    src_manifest_json_backup_t backups[SRC_MANIFEST_JSON_MAX_BACKUPS];
+} src_manifest_json_t;
+
+/* Directory-entry cache
+ * src_usb_stat() answers from a listing of the file's directory, read once
+ * and kept for SRC_USB_DIR_CACHE_TTL_MS, so checking the files of a
+ * recovery directory costs one directory read. Changes made through
+ * src_usb_* drop the cache. */
+#define SRC_USB_DIR_CACHE_DIRS 4
+#define SRC_USB_DIR_CACHE_ENTRIES 24
+#define SRC_USB_DIR_CACHE_TTL_MS 5000
 
 /* Initialize USB Mass Storage interface */
 bool src_usb_init(void);
@@ -19,9 +53,24 @@ bool src_usb_check_present(void);
 /* Read file from USB device */
 bool src_usb_read_file(const char *path, uint8_t *buffer, size_t *size);
 
+/* Queue a chunked read of path at offset (see platform_usb_read_start) */
+bool src_usb_read_start(const char *path, uint32_t offset,
+                        uint8_t *buffer, size_t size);
+
+/* Queue a chunked read into a DMA pool buffer (see platform_usb_read_start_dma) */
+bool src_usb_read_start_dma(const char *path, uint32_t offset,
+                            platform_dma_buffer_t *buffer, size_t size,
+                            platform_dma_callback_t callback);
+
+/* Wait for the oldest queued chunked read; size receives bytes read */
+bool src_usb_read_wait(size_t *size);
+
 /* Write file to USB device */
 bool src_usb_write_file(const char *path, const uint8_t *buffer, size_t size);
 
+/* Append to a file created by src_usb_write_file */
+bool src_usb_append_file(const char *path, const uint8_t *buffer, size_t size);
+
 /* Delete file from USB device */
 bool src_usb_delete_file(const char *path);
 
@@ -31,8 +80,17 @@ bool src_usb_file_exists(const char *path);
 /* Rename file */
 bool src_usb_rename_file(const char *old_path, const char *new_path);
 
+/* Size and type of a file, from the directory-entry cache */
+bool src_usb_stat(const char *path, platform_usb_dirent_t *entry);
+
+/* Forget cached directory listings (e.g. after the stick was swapped) */
+void src_usb_cache_invalidate(void);
+
 /* Update manifest.json */
-void src_update_manifest(void);
+void src_update_manifest(const src_manifest_json_t *manifest);
+
+/* Read and parse manifest.json; older files list backup names only */
+bool src_read_manifest_json(src_manifest_json_t *manifest);
 
 /* Update metadata.txt */
 void src_update_metadata(const uint8_t *firmware_hash);
@@ -0,0 +1,163 @@
+/**
+ * Verified-Image Cache Implementation
+ */
+
+#include "verify_cache.h"
+#include "spi_flash.h"
+#include "crypto.h"
+#include "platform.h"
+#include <string.h>
+
+#if (VERIFY_CACHE_ENTRIES > 0xFFFF)
+#error "Too many verify cache entries for the cache header"
+#endif
+
+#if (64 + VERIFY_CACHE_ENTRIES * 40 + 32) > SRC_VERIFY_CACHE_SIZE
+#error "Verify cache does not fit SRC_VERIFY_CACHE_SIZE"
+#endif
+
+static verify_cache_t cache;
+static uint8_t device_key[32];
+static uint8_t key_id[32];
+static bool cache_enabled = false;
+
+/**
+ * MAC over the cache contents up to the mac field
+ */
+static bool verify_cache_mac(const verify_cache_t *state, uint8_t *mac) {
+    return crypto_hmac_sha256(device_key, sizeof(device_key),
+                              (const uint8_t *)state, offsetof(verify_cache_t, mac),
+                              mac) == CRYPTO_SUCCESS;
+}
+
+/**
+ * Empty cache for the current verification key (RAM only)
+ */
+static void verify_cache_reset(void) {
+    memset(&cache, 0, sizeof(cache));
+    cache.magic = VERIFY_CACHE_MAGIC;
+    cache.version = VERIFY_CACHE_VERSION;
+    memcpy(cache.key_id, key_id, sizeof(cache.key_id));
+}
+
+/**
+ * Check the cache read from flash: well formed, written under the current
+ * key and carrying this device's MAC
+ */
+static bool verify_cache_authentic(void) {
+    if (cache.magic != VERIFY_CACHE_MAGIC ||
+        cache.version != VERIFY_CACHE_VERSION ||
+        cache.count > VERIFY_CACHE_ENTRIES ||
+        memcmp(cache.key_id, key_id, sizeof(key_id)) != 0) {
+        return false;
+    }
+    
+    uint8_t mac[32];
+    if (!verify_cache_mac(&cache, mac)) {
+        return false;
+    }
+    
+    /* SECURITY: Constant-time compare */
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(mac); i++) {
+        diff |= mac[i] ^ cache.mac[i];
+    }
+    return diff == 0;
+}
+
+/**
+ * MAC the cache and write it to flash
+ */
+static bool verify_cache_store(void) {
+    if (!verify_cache_mac(&cache, cache.mac)) {
+        return false;
+    }
+    return spi_flash_write(SRC_VERIFY_CACHE_START, (const uint8_t *)&cache, sizeof(cache));
+}
+
+/**
+ * Record a digest that has just verified, replacing the oldest entry
+ * once the cache is full
+ */
+static void verify_cache_insert(const uint8_t *hash) {
+    verify_cache_entry_t *slot;
+    if (cache.count < VERIFY_CACHE_ENTRIES) {
+        slot = &cache.entries[cache.count++];
+    } else {
+        slot = &cache.entries[0];
+        for (uint32_t i = 1; i < VERIFY_CACHE_ENTRIES; i++) {
+            if (cache.entries[i].sequence < slot->sequence) {
+                slot = &cache.entries[i];
+            }
+        }
+    }
+    
+    memcpy(slot->hash, hash, sizeof(slot->hash));
+    slot->timestamp = platform_get_timestamp();
+    slot->sequence = cache.sequence++;
+    
+    /* A lost write only costs a full verification next time */
+    verify_cache_store();
+}
+
+bool verify_cache_init(void) {
+    cache_enabled = false;
+    memset(&cache, 0, sizeof(cache));
+    
+    if (!platform_get_device_key(device_key) || !platform_get_verify_key_id(key_id)) {
+        return false;
+    }
+    cache_enabled = true;
+    
+    /* SECURITY: Anything that does not authenticate is discarded */
+    if (!spi_flash_read(SRC_VERIFY_CACHE_START, (uint8_t *)&cache, sizeof(cache)) ||
+        !verify_cache_authentic()) {
+        verify_cache_reset();
+    }
+    return true;
+}
+
+bool verify_cache_contains(const uint8_t *hash) {
+    if (!cache_enabled || !hash) {
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < cache.count; i++) {
+        if (memcmp(cache.entries[i].hash, hash, sizeof(cache.entries[i].hash)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int verify_cache_verify_hash(const uint8_t *hash,
+                             const uint8_t *signature, size_t sig_size) {
+    /* SECURITY: Same parameter checks as a full verification */
+    if (!hash || !signature) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (sig_size < CRYPTO_MIN_SIGNATURE_SIZE ||
+        sig_size > CRYPTO_MAX_SIGNATURE_SIZE) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    if (verify_cache_contains(hash)) {
+        return CRYPTO_SUCCESS;
+    }
+    
+    int result = crypto_verify_hash(hash, signature, sig_size);
+    if (result == CRYPTO_SUCCESS && cache_enabled) {
+        verify_cache_insert(hash);
+    }
+    return result;
+}
+
+bool verify_cache_clear(void) {
+    if (!cache_enabled) {
+        return true;
+    }
+    
+    verify_cache_reset();
+    return verify_cache_store();
+}
@@ -0,0 +1,67 @@
+/**
+ * Verified-Image Cache
+ * Remembers the SHA-256 of images (and signed manifests) whose signature
+ * has verified, so verifying the same image again (recovery retries, boot
+ * loops, enhanced recovery checks) skips the public-key operation. Kept in
+ * the SRC reserved region, authenticated with an HMAC under the device key
+ * and bound to the verification key by its key id: a cache copied from
+ * another board, edited in flash, or written under a rotated key is
+ * discarded.
+ */
+
+#ifndef VERIFY_CACHE_H
+#define VERIFY_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "recovery_core.h"
+
+#define VERIFY_CACHE_ENTRIES 32
+#define VERIFY_CACHE_MAGIC 0x43565253        // "SRVC"
+#define VERIFY_CACHE_VERSION 1
+
+typedef struct {
+    uint8_t hash[32];         // SHA-256 whose signature verified
+    uint32_t timestamp;       // platform_get_timestamp() when it verified
+    uint32_t sequence;        // Insertion order; the lowest is replaced first
+} verify_cache_entry_t;
+
+/* Stored at SRC_VERIFY_CACHE_START */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t sequence;        // Sequence of the next insertion
+    uint8_t key_id[32];       // platform_get_verify_key_id() at insertion
+    uint8_t reserved[20];
+    verify_cache_entry_t entries[VERIFY_CACHE_ENTRIES];
+    uint8_t mac[32];          // HMAC-SHA256 of everything above, device key
+} verify_cache_t;
+
+/**
+ * Load the cache from flash and authenticate it
+ * Without a device key or key id from the platform the cache stays
+ * disabled and every verification runs in full.
+ */
+bool verify_cache_init(void);
+
+/**
+ * Verify a signature over an already computed SHA-256 digest, skipping
+ * the public-key operation if the digest has verified before
+ * Returns: same codes as crypto_verify_hash()
+ */
+int verify_cache_verify_hash(const uint8_t *hash,
+                             const uint8_t *signature, size_t sig_size);
+
+/**
+ * Check whether a digest has verified before
+ */
+bool verify_cache_contains(const uint8_t *hash);
+
+/**
+ * Forget every entry (in RAM and in flash)
+ */
+bool verify_cache_clear(void);
+
+#endif /* VERIFY_CACHE_H */